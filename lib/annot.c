@@ -175,9 +175,8 @@ static WFDB_Time round_to_time(double x)
     }
 }
 
-static int get_ann_table(WFDB_Annotator i)
+static int get_ann_table(WFDB_Context *ctx, WFDB_Annotator i)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     char *p1, *p2;
     int a;
     WFDB_Annotation annot;
@@ -186,9 +185,9 @@ static int get_ann_table(WFDB_Annotator i)
     ctx->iad[i]->tmul = 1.0;
     ctx->iad[i]->afreq = 0.0;
 
-    if (getann(i, &annot) < 0)	/* prime the pump */
+    if (getann_ctx(ctx, i, &annot) < 0)	/* prime the pump */
 	return (-1);
-    while (getann(i,&annot) == 0 && annot.time == 0L &&
+    while (getann_ctx(ctx, i,&annot) == 0 && annot.time == 0L &&
 	   annot.anntyp == NOTE && annot.subtyp == 0) {
 	if (annot.aux == NULL || *annot.aux < 1)
 	    continue;
@@ -207,25 +206,24 @@ static int get_ann_table(WFDB_Annotator i)
 	p2 = p1 + strcspn(p1, " \t"); /* non-whitespace (mnemonic) */
 	if (p2 != p1) {
 	    if (*p2)
-		setanndesc(a, p2 + 1);
+		setanndesc_ctx(ctx, a, p2 + 1);
 	    else
-		setanndesc(a, (char *)NULL);
+		setanndesc_ctx(ctx, a, (char *)NULL);
 	    *p2 = 0;
-	    setannstr(a, p1);
+	    setannstr_ctx(ctx, a, p1);
 	}
     }
     if (annot.time != 0L || annot.anntyp != NOTE || annot.subtyp != 0 ||
 	annot.aux == NULL) {
-	(void)ungetann(i, &annot);
+	(void)ungetann_ctx(ctx, i, &annot);
     }
 
-    setiafreq(i, getifreq());
+    setiafreq_ctx(ctx, i, getifreq_ctx(ctx));
     return (0);
 }
 
-static int put_ann_table(WFDB_Annotator i)
+static int put_ann_table(WFDB_Context *ctx, WFDB_Annotator i)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int a, flag = 0, n;
     char buf[256], *str = NULL;
     WFDB_Annotation annot;
@@ -238,7 +236,7 @@ static int put_ann_table(WFDB_Annotator i)
 	(void)snprintf(buf+1, sizeof(buf)-1, "## time resolution: %.12g", ctx->oafreq);
 	buf[0] = strlen(buf+1);
 	ctx->oad[i]->afreq = ctx->oafreq;
-	if (putann(i, &annot) < 0) return (-1);
+	if (putann_ctx(ctx, i, &annot) < 0) return (-1);
 	flag = 1;
     }
     for (a = 0; a <= ACMAX; a++)
@@ -246,38 +244,38 @@ static int put_ann_table(WFDB_Annotator i)
 	    if (flag < 2) { /* mark the beginning of the table */
 		(void)snprintf(buf+1, sizeof(buf)-1, "## annotation type definitions");
 		buf[0] = strlen(buf+1);
-		if (putann(i, &annot) < 0) return (-1);
+		if (putann_ctx(ctx, i, &annot) < 0) return (-1);
 	    }
-	    if (anndesc(a))
-		n = wfdb_asprintf(&str, "%d %s %s", a, annstr(a), anndesc(a));
+	    if (anndesc_ctx(ctx, a))
+		n = wfdb_asprintf(&str, "%d %s %s", a, annstr_ctx(ctx, a),
+				  anndesc_ctx(ctx, a));
 	    else
-		n = wfdb_asprintf(&str, "%d %s ", a, annstr(a));
+		n = wfdb_asprintf(&str, "%d %s ", a, annstr_ctx(ctx, a));
 	    if (!str) return (-1);
 	    annot.aux[0] = (n > 255 ? 255 : n);
 	    memcpy(annot.aux + 1, str, n);
 	    SFREE(str);
-	    if (putann(i, &annot) < 0) return (-1);
+	    if (putann_ctx(ctx, i, &annot) < 0) return (-1);
 	    flag = 2;
 	}
     if (flag == 2) {	/* if a table was written, mark its end */
 	(void)snprintf(buf+1, sizeof(buf)-1, "## end of definitions");
 	buf[0] = strlen(buf+1);
-	if (putann(i, &annot) < 0) return (-1);
+	if (putann_ctx(ctx, i, &annot) < 0) return (-1);
     }
 
     if (flag) {	/* if a table was written, mark its end */
 	annot.anntyp = 0;
 	annot.aux = NULL;
-	if (putann(i, &annot) < 0) return (-1);
+	if (putann_ctx(ctx, i, &annot) < 0) return (-1);
     }
 
     return (0);
 }
 
 /* Allocate workspace for up to n input annotators. */
-static int allociann(unsigned n)
+static int allociann(WFDB_Context *ctx, unsigned n)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
 
     if (ctx->maxiann < n) {     /* allocate input annotator data structures */
         unsigned m = ctx->maxiann;
@@ -293,9 +291,8 @@ static int allociann(unsigned n)
 }
 
 /* Allocate workspace for up to n output annotators. */
-static int allocoann(unsigned n)
+static int allocoann(WFDB_Context *ctx, unsigned n)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
 
     if (ctx->maxoann < n) {     /* allocate output annotator data structures */
         unsigned m = ctx->maxoann;
@@ -325,7 +322,7 @@ int annopen_ctx(WFDB_Context *ctx, char *record, const WFDB_Anninfo *aiarray,
     if (*record == '+')		/* don't close open annotation files */
 	record++;		/* discard the '+' prefix */
     else
-	wfdb_anclose();		/* close previously opened annotation files */
+	wfdb_anclose_ctx(ctx);  /* close previously opened annotation files */
 
     /* If no annotation files are to be opened, report whether errors
        occurred while closing previously-opened files. */
@@ -349,13 +346,14 @@ int annopen_ctx(WFDB_Context *ctx, char *record, const WFDB_Anninfo *aiarray,
 	    noafneeded++;
 	    break;
 	  default:
-	    wfdb_error(
-		     "annopen: illegal stat %d for annotator %s, record %s\n",
-		     aiarray[i].stat, aiarray[i].name, record);
+	    wfdb_error_ctx(ctx,
+			   "annopen: illegal stat %d for annotator %s, "
+			   "record %s\n", aiarray[i].stat, aiarray[i].name,
+			   record);
 	    return (-5);
 	}
     /* Allocate workspace. */
-    if (allociann(niafneeded) < 0 || allocoann(noafneeded) < 0)
+    if (allociann(ctx, niafneeded) < 0 || allocoann(ctx, noafneeded) < 0)
 	return (-3);
 
     for (i = 0; i < nann; i++) { /* open the annotation files */
@@ -366,11 +364,12 @@ int annopen_ctx(WFDB_Context *ctx, char *record, const WFDB_Anninfo *aiarray,
 	  case WFDB_READ:	/* standard (MIT-format) input file */
 	  case WFDB_AHA_READ:	/* AHA-format input file */
 	    ia = ctx->iad[ctx->niaf];
-	    wfdb_setirec(record);
-	    if ((ia->file=wfdb_open(aiarray[i].name,record,WFDB_READ)) ==
-		NULL) {
-		wfdb_error("annopen: can't read annotator %s for record %s\n",
-			 aiarray[i].name, record);
+	    wfdb_setirec_ctx(ctx, record);
+	    if ((ia->file = wfdb_open_ctx(ctx, aiarray[i].name, record,
+					  WFDB_READ)) == NULL) {
+		wfdb_error_ctx(ctx,
+			       "annopen: can't read annotator %s for record "
+			       "%s\n", aiarray[i].name, record);
 		return (-3);
 	    }
 	    ia->info.name = NULL;
@@ -385,10 +384,12 @@ int annopen_ctx(WFDB_Context *ctx, char *record, const WFDB_Anninfo *aiarray,
 	    if ((ia->word & 0xff) ||
 		ammap(a) == NOTQRS || a == '[' || a == ']') {
 		if (aiarray[i].stat != WFDB_READ) {
-		    wfdb_error("warning (annopen, annotator %s, record %s):\n",
-			     aiarray[i].name, record);
-		    wfdb_error(" file appears to be in MIT format\n");
-		    wfdb_error(" ... continuing under that assumption\n");
+		    wfdb_error_ctx(ctx,
+				   "warning (annopen, annotator %s, record "
+				   "%s):\n", aiarray[i].name, record);
+		    wfdb_error_ctx(ctx, " file appears to be in MIT format\n");
+		    wfdb_error_ctx(ctx,
+				   " ... continuing under that assumption\n");
 		}
 		(ia->info).stat = WFDB_READ;
 		/* read any initial null annotation(s) */
@@ -399,28 +400,31 @@ int annopen_ctx(WFDB_Context *ctx, char *record, const WFDB_Anninfo *aiarray,
 	    }
 	    else {
 		if (aiarray[i].stat != WFDB_AHA_READ) {
-		    wfdb_error("warning (annopen, annotator %s, record %s):\n",
-			     aiarray[i].name, record);
-		    wfdb_error(" file appears to be in AHA format\n");
-		    wfdb_error(" ... continuing under that assumption\n");
+		    wfdb_error_ctx(ctx,
+				   "warning (annopen, annotator %s, record "
+				   "%s):\n", aiarray[i].name, record);
+		    wfdb_error_ctx(ctx, " file appears to be in AHA format\n");
+		    wfdb_error_ctx(ctx,
+				   " ... continuing under that assumption\n");
 		}
 		ia->info.stat = WFDB_AHA_READ;
 	    }
 	    ia->ann.anntyp = 0;    /* any pushed-back annot is invalid */
 	    ctx->niaf++;
-	    (void)get_ann_table(ctx->niaf-1);
+	    (void)get_ann_table(ctx, ctx->niaf-1);
 	    break;
 
 	  case WFDB_WRITE:	/* standard (MIT-format) output file */
 	  case WFDB_AHA_WRITE:	/* AHA-format output file */
 	    oa = ctx->oad[ctx->noaf];
 	    /* Quit (with message from wfdb_checkname) if name is illegal */
-	    if (wfdb_checkname(aiarray[i].name, "annotator"))
+	    if (wfdb_checkname_ctx(ctx, aiarray[i].name, "annotator"))
 		return (-4);
-	    if ((oa->file=wfdb_open(aiarray[i].name,record,WFDB_WRITE)) ==
-		NULL) {
-		wfdb_error("annopen: can't write annotator %s for record %s\n",
-			 aiarray[i].name, record);
+	    if ((oa->file = wfdb_open_ctx(ctx, aiarray[i].name, record,
+					  WFDB_WRITE)) == NULL) {
+		wfdb_error_ctx(ctx,
+			       "annopen: can't write annotator %s for record "
+			       "%s\n", aiarray[i].name, record);
 		return (-4);
 	    }
 	    oa->info.name = NULL;
@@ -451,7 +455,7 @@ int getann_ctx(WFDB_Context *ctx, WFDB_Annotator n, WFDB_Annotation *annot)
     struct iadata *ia;
 
     if (n >= ctx->niaf || (ia = ctx->iad[n]) == NULL || ia->file == NULL) {
-	wfdb_error("getann: can't read annotator %d\n", n);
+	wfdb_error_ctx(ctx, "getann: can't read annotator %d\n", n);
 		return (-2);
     }
 
@@ -466,8 +470,8 @@ int getann_ctx(WFDB_Context *ctx, WFDB_Annotator n, WFDB_Annotation *annot)
     if (ia->ateof) {
 	if (ia->ateof != -1)
 	    return (-1);	/* reached logical EOF */
-	wfdb_error("getann: unexpected EOF in annotator %s\n",
-		 ia->info.name);
+	wfdb_error_ctx(ctx, "getann: unexpected EOF in annotator %s\n",
+		       ia->info.name);
 	return (-3);
     }
     *annot = ia->ann;
@@ -519,8 +523,9 @@ int getann_ctx(WFDB_Context *ctx, WFDB_Annotator n, WFDB_Annotation *annot)
 	ia->ann.anntyp = ammap(a);	 /* convert to MIT annotation code */
 	ia->ann_tt = (WFDB_Time)wfdb_g32(ia->file);  /* time of annotation */
 	if (wfdb_g16(ia->file) <= 0)	 /* serial number (starts at 1) */
-	    wfdb_error("getann: unexpected annot number in annotator %s\n",
-		       ia->info.name);
+	    wfdb_error_ctx(ctx,
+			   "getann: unexpected annot number in annotator %s\n",
+			   ia->info.name);
 	ia->ann.subtyp = wfdb_getc(ia->file); /* MIT annotation subtype */
 	if (a == 'U' && ia->ann.subtyp == 0)
 	    ia->ann.subtyp = -1;	 /* unreadable (noise subtype -1) */
@@ -559,15 +564,15 @@ int ungetann_ctx(WFDB_Context *ctx, WFDB_Annotator n, const WFDB_Annotation *ann
 {
 
     if (n >= ctx->niaf || ctx->iad[n] == NULL) {
-	wfdb_error("ungetann: annotator %d is not initialized\n", n);
+	wfdb_error_ctx(ctx, "ungetann: annotator %d is not initialized\n", n);
 	return (-2);
     }
     if (ctx->iad[n]->pann.anntyp) {
-	wfdb_error("ungetann: pushback buffer is full\n");
-	wfdb_error(
-		 "ungetann: annotation at %"WFDB_Pd_TIME", annotator %d "
-		 "not pushed back\n",
-		 annot->time, n);
+	wfdb_error_ctx(ctx, "ungetann: pushback buffer is full\n");
+	wfdb_error_ctx(ctx,
+		       "ungetann: annotation at %"WFDB_Pd_TIME", annotator %d "
+		       "not pushed back\n",
+		       annot->time, n);
 	return (-1);
     }
     ctx->iad[n]->pann = *annot;
@@ -594,13 +599,13 @@ int putann_ctx(WFDB_Context *ctx, WFDB_Annotator n, const WFDB_Annotation *annot
     struct oadata *oa;
 
     if (n >= ctx->noaf || (oa = ctx->oad[n]) == NULL || oa->file == NULL) {
-	wfdb_error("putann: can't write annotation file %d\n", n);
+	wfdb_error_ctx(ctx, "putann: can't write annotation file %d\n", n);
 	return (-2);
     }
     t = annot->time;
     if (!oa->table_written) {
 	oa->table_written = 1;
-	if (put_ann_table(n) < 0)
+	if (put_ann_table(ctx, n) < 0)
 	    return (-1);
     }
     delta = (unsigned_time) t - oa->ann.time;
@@ -619,7 +624,8 @@ int putann_ctx(WFDB_Context *ctx, WFDB_Annotator n, const WFDB_Annotation *annot
 	   on a 64-bit system would require 2^32 SKIPs (24 GB), so
 	   it's better to catch such bugs beforehand. */
 	if (t == WFDB_TIME_MIN || t == WFDB_TIME_MAX) {
-	    wfdb_error("putann: time overflow in annotation file %d\n", n);
+	    wfdb_error_ctx(ctx,
+			   "putann: time overflow in annotation file %d\n", n);
 	    return (-1);
 	}
 	if (t > oa->ann.time) {
@@ -692,8 +698,8 @@ int putann_ctx(WFDB_Context *ctx, WFDB_Annotator n, const WFDB_Annotation *annot
 	break;
     }
     if (wfdb_ferror(oa->file)) {
-	wfdb_error("putann: write error on annotation file %s\n",
-		   oa->info.name);
+	wfdb_error_ctx(ctx, "putann: write error on annotation file %s\n",
+		       oa->info.name);
 	return (-1);
     }
     oa->ann = *annot;
@@ -728,7 +734,7 @@ int iannsettime_ctx(WFDB_Context *ctx, WFDB_Time t)
 	if (ia->ann.time >= t) {	/* "rewind" the annotation file */
 	    ia->pann.anntyp = 0;	/* flush pushback buffer */
 	    if (wfdb_fseek(ia->file, 0L, 0) == -1) {
-		wfdb_error("iannsettime: improper seek\n");
+		wfdb_error_ctx(ctx, "iannsettime: improper seek\n");
 		return (-1);
 	    }
 	    ia->ann.subtyp = ia->ann.chan = ia->ann.num = ia->ateof = 0;
@@ -739,9 +745,9 @@ int iannsettime_ctx(WFDB_Context *ctx, WFDB_Time t)
 		    ia->tt += wfdb_g32(ia->file);
 		    ia->word = wfdb_g16(ia->file);
 		}
-	    (void)getann(i, &tempann);
+	    (void)getann_ctx(ctx, i, &tempann);
 	}
-	while (ia->ann.time < t && (stat = getann(i, &tempann)) == 0)
+	while (ia->ann.time < t && (stat = getann_ctx(ctx, i, &tempann)) == 0)
 	    ;
 	if (stat < 0) niavalid--;
     }
@@ -923,7 +929,7 @@ int setecgstr_ctx(WFDB_Context *ctx, int code, const char *string)
 	SSTRCPY(cstring[code], string);
 	return (0);
     }
-    wfdb_error("setecgstr: illegal annotation code %d\n", code);
+    wfdb_error_ctx(ctx, "setecgstr: illegal annotation code %d\n", code);
     return (-1);
 }
 
@@ -982,7 +988,7 @@ int setannstr_ctx(WFDB_Context *ctx, int code, const char *string)
 	return (0);
     }
     else {
-	wfdb_error("setannstr: illegal annotation code %d\n", code);
+	wfdb_error_ctx(ctx, "setannstr: illegal annotation code %d\n", code);
 	return (-1);
     }
 }
@@ -1023,7 +1029,7 @@ int setanndesc_ctx(WFDB_Context *ctx, int code, const char *string)
 	return (0);
     }
     else {
-	wfdb_error("setanndesc: illegal annotation code %d\n", code);
+	wfdb_error_ctx(ctx, "setanndesc: illegal annotation code %d\n", code);
 	return (-1);
     }
 }
@@ -1065,8 +1071,8 @@ void setiafreq_ctx(WFDB_Context *ctx, WFDB_Annotator n, WFDB_Frequency f)
     if (n < ctx->niaf && (ia = ctx->iad[n]) != NULL) {
 	if (f > 0.0 && ia->afreq > 0.0)
 	    ia->tmul = f / ia->afreq;
-	else if (f > 0.0 && (sfreq = sampfreq(NULL)) > 0.0)
-	    ia->tmul = f * getspf() / sfreq;
+	else if (f > 0.0 && (sfreq = sampfreq_ctx(ctx, NULL)) > 0.0)
+	    ia->tmul = f * getspf_ctx(ctx) / sfreq;
 	else
 	    ia->tmul = 1.0;
 
@@ -1090,7 +1096,7 @@ WFDB_Frequency getiafreq_ctx(WFDB_Context *ctx, WFDB_Annotator n)
 	if (ia->afreq > 0.0)
 	    return (ia->afreq * ia->tmul);
 	else
-	    return (sampfreq(NULL) * ia->tmul / getspf());
+	    return (sampfreq_ctx(ctx, NULL) * ia->tmul / getspf_ctx(ctx));
     }
     else {
 	return (-2);
@@ -1165,8 +1171,9 @@ void oannclose_ctx(WFDB_Context *ctx, WFDB_Annotator n)
 	if (wfdb_fclose(oa->file))
 	    errflag = 1;
 	if (errflag) {
-	    wfdb_error("oannclose: write error on annotation file %s\n",
-		       oa->info.name);
+	    wfdb_error_ctx(ctx,
+			   "oannclose: write error on annotation file %s\n",
+			   oa->info.name);
 	    ctx->annclose_error = -7;
 	}
 	if (oa->out_of_order) {
@@ -1176,9 +1183,9 @@ void oannclose_ctx(WFDB_Context *ctx, WFDB_Annotator n)
 	    if (p) dosort = strtol(p, NULL, 10);
 	    if (dosort) {
 		if (system(NULL) != 0) {
-		    wfdb_error(
-			 "Rearranging annotations for output annotator %s ...",
-			 oa->info.name);
+		    wfdb_error_ctx(ctx,
+				   "Rearranging annotations for output "
+				   "annotator %s ...", oa->info.name);
 		    /* The option '-r.' tells sortann to change its
 		       WFDB path to the current directory (i.e, it
 		       should only attempt to read the annotation file
@@ -1192,12 +1199,13 @@ void oannclose_ctx(WFDB_Context *ctx, WFDB_Annotator n)
 		    wfdb_asprintf(&cmdbuf, "sortann -r. %s -a %s",
 				  oa->rname, oa->info.name);
 		    if (cmdbuf && system(cmdbuf) == 0) {
-			wfdb_error("done!\n");
+			wfdb_error_ctx(ctx, "done!\n");
 			oa->out_of_order = 0;
 		    }
 		    else
-		      wfdb_error(
-			       "\nAnnotations still need to be rearranged.\n");
+		      wfdb_error_ctx(ctx,
+				     "\nAnnotations still need to be "
+				     "rearranged.\n");
 		    SFREE(cmdbuf);
 		    if (ctx->annclose_error == 0)
 			ctx->annclose_error = -6;
@@ -1205,9 +1213,11 @@ void oannclose_ctx(WFDB_Context *ctx, WFDB_Annotator n)
 	    }
 	}
 	if (oa->out_of_order) {
-	    wfdb_error("Use the command:\n  sortann -r %s -a %s\n",
-		       oa->rname, oa->info.name);
-	    wfdb_error("to rearrange annotations in the correct order.\n");
+	    wfdb_error_ctx(ctx, "Use the command:\n"
+			   "  sortann -r %s -a %s\n", oa->rname,
+			   oa->info.name);
+	    wfdb_error_ctx(ctx,
+			   "to rearrange annotations in the correct order.\n");
 	    if (ctx->annclose_error == 0)
 		ctx->annclose_error = -6;
 	}
@@ -1316,22 +1326,30 @@ int wfdb_setannpos(int code, int newval)
 
 /* Private functions (for the use of other WFDB library functions only). */
 
-void wfdb_oaflush(void)
+void wfdb_oaflush_ctx(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     unsigned int i;
 
     for (i = 0; i < ctx->noaf; i++)
 	(void)wfdb_fflush(ctx->oad[i]->file);
 }
 
-void wfdb_anclose(void)
+void wfdb_oaflush(void)
+{
+    wfdb_oaflush_ctx(wfdb_get_default_context());
+}
+
+void wfdb_anclose_ctx(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     WFDB_Annotator an;
 
     for (an = ctx->niaf; an != 0; an--)
-	iannclose(an-1);
+	iannclose_ctx(ctx, an-1);
     for (an = ctx->noaf; an != 0; an--)
-	oannclose(an-1);
+	oannclose_ctx(ctx, an-1);
+}
+
+void wfdb_anclose(void)
+{
+    wfdb_anclose_ctx(wfdb_get_default_context());
 }
@@ -0,0 +1,341 @@
+/* file: blkcache.c	2026
+   Shared cache of decoded blocks of signal frames.
+
+   When many contexts read the same records (for example, in a server that
+   handles each request in its own context), each of them would otherwise
+   read and decode the same parts of the same signal files.  If the block
+   cache is enabled (see setblkcache), the frames of each signal group in
+   one of the fixed-width formats (16, 61, 80, 160, 212, 24, 32, 310 and
+   311) are decoded WFDB_BCBLK frames at a time into blocks that are shared
+   by all contexts.  A block holds the raw sample values of each frame as
+   decoded from the file, before invalid samples are replaced and before
+   skew, resampling, or signal selection are applied, so that a block
+   depends only on the contents of the signal file.  A block is identified
+   by the signal file's device and inode numbers, size, and modification and
+   status change times, to the nanosecond where the system records them (so
+   that the cache is not consulted for a file that has changed), by the
+   group's format, byte offset and frame size, and by the block number.
+
+   Blocks are never modified once they have been added to the cache.  Each
+   block has a reference count;  a context holds a reference to the block it
+   is reading, so the block's samples can be copied without locking.  Only
+   looking up, adding, and releasing blocks require the cache's lock, which
+   is never held while a signal file is read or decoded.  The least recently
+   used unreferenced blocks are discarded whenever the total size of the
+   cached blocks exceeds the budget.
+
+   The cache is used only for local signal files that can be seeked.  It is
+   not used for remote files, or on platforms without fstat(2) and fileno().
+*/
+
+#include "signal_internal.h"
+
+#ifdef WFDB_THREADS
+#include <pthread.h>
+
+static pthread_mutex_t bclock = PTHREAD_MUTEX_INITIALIZER;
+#define BCLOCK()	pthread_mutex_lock(&bclock)
+#define BCUNLOCK()	pthread_mutex_unlock(&bclock)
+#else
+#define BCLOCK()
+#define BCUNLOCK()
+#endif
+
+static int bcinit;		/* 1 once the budget has been set */
+static long bcbudget;		/* maximum total size of cached blocks (bytes) */
+static long bctotal;		/* total size of cached blocks (bytes) */
+static long bchits, bcmisses;	/* lookup counters (see blkcachestats) */
+static struct bcblock **bchash;	/* hash table of cached blocks */
+static unsigned long bchsize;	/* number of entries in bchash */
+static unsigned long bcnblk;	/* number of cached blocks */
+static struct bcblock *bcmru, *bclru;	/* ends of the LRU list */
+
+/* Nanoseconds of a file's modification and status change times, if struct
+   stat provides them (see lib/meson.build). */
+#if defined(HAVE_ST_MTIM)
+#define ST_MTIMENS(st)	((st).st_mtim.tv_nsec)
+#define ST_CTIMENS(st)	((st).st_ctim.tv_nsec)
+#elif defined(HAVE_ST_MTIMESPEC)
+#define ST_MTIMENS(st)	((st).st_mtimespec.tv_nsec)
+#define ST_CTIMENS(st)	((st).st_ctimespec.tv_nsec)
+#else
+#define ST_MTIMENS(st)	0L
+#define ST_CTIMENS(st)	0L
+#endif
+
+static unsigned long bchashkey(const struct bckey *k)
+{
+    unsigned long long h = k->ino;
+
+    h = h * 31 + k->dev;
+    h = h * 31 + (unsigned long long)k->mtime;
+    h = h * 31 + (unsigned long)k->mtimens;
+    h = h * 31 + (unsigned long)k->start;
+    h = h * 31 + (unsigned long long)k->blk;
+    return ((unsigned long)(h ^ (h >> 29)));
+}
+
+static int bckeyeq(const struct bckey *a, const struct bckey *b)
+{
+    return (a->blk == b->blk && a->ino == b->ino && a->dev == b->dev &&
+	    a->size == b->size && a->mtime == b->mtime &&
+	    a->mtimens == b->mtimens && a->ctime == b->ctime &&
+	    a->ctimens == b->ctimens &&
+	    a->start == b->start && a->fmt == b->fmt && a->spf == b->spf);
+}
+
+/* Remove b from the LRU list.  The caller must hold the lock. */
+static void bcunlink(struct bcblock *b)
+{
+    if (b->prev) b->prev->next = b->next;
+    else bcmru = b->next;
+    if (b->next) b->next->prev = b->prev;
+    else bclru = b->prev;
+    b->prev = b->next = NULL;
+}
+
+/* Make b the most recently used block.  The caller must hold the lock. */
+static void bctouch(struct bcblock *b)
+{
+    if (bcmru == b)
+	return;
+    if (b->prev || b->next || bclru == b)
+	bcunlink(b);
+    b->next = bcmru;
+    if (bcmru) bcmru->prev = b;
+    bcmru = b;
+    if (bclru == NULL) bclru = b;
+}
+
+/* Double the size of the hash table, if possible.  The caller must hold the
+   lock. */
+static void bcrehash(void)
+{
+    struct bcblock **h, *b, *next;
+    unsigned long i, n = bchsize ? 2*bchsize : 256;
+
+    if ((h = calloc(n, sizeof(struct bcblock *))) == NULL)
+	return;
+    for (i = 0; i < bchsize; i++)
+	for (b = bchash[i]; b; b = next) {
+	    next = b->hnext;
+	    b->hnext = h[bchashkey(&b->key) & (n-1)];
+	    h[bchashkey(&b->key) & (n-1)] = b;
+	}
+    free(bchash);
+    bchash = h;
+    bchsize = n;
+}
+
+/* Discard unreferenced blocks, least recently used first, until the cache
+   is within its budget.  The caller must hold the lock. */
+static void bctrim(void)
+{
+    struct bcblock *b, *prev, **bp;
+
+    for (b = bclru; b && bctotal > bcbudget; b = prev) {
+	prev = b->prev;
+	if (b->refs > 0)
+	    continue;
+	for (bp = &bchash[bchashkey(&b->key) & (bchsize-1)]; *bp != b;
+	     bp = &(*bp)->hnext)
+	    ;
+	*bp = b->hnext;
+	bcunlink(b);
+	bctotal -= b->size;
+	bcnblk--;
+	free(b->v);
+	free(b);
+    }
+}
+
+/* Function setblkcache sets the maximum total size, in bytes, of the blocks
+kept in the shared block cache.  If nbytes is zero, the cache is disabled:
+signal groups opened by subsequent calls to isigopen do not use it, and
+cached blocks are discarded as soon as no context is reading them.  If nbytes
+is negative, the size is taken from the environment variable WFDBBLKCACHE, or
+the cache is disabled if WFDBBLKCACHE is not set to a positive integer.
+Unlike most WFDB library settings, this one applies to all contexts, since
+they share the cache. */
+
+void setblkcache(long nbytes)
+{
+    if (nbytes < 0) {
+	char *p;
+
+	nbytes = (p = getenv("WFDBBLKCACHE")) ? strtol(p, NULL, 10) : 0;
+	if (nbytes < 0) nbytes = 0;
+    }
+    BCLOCK();
+    bcbudget = nbytes;
+    bcinit = 1;
+    bctrim();
+    BCUNLOCK();
+}
+
+/* Function blkcachestats reports the number of blocks that have been found
+in the shared block cache (hits), and the number that have been read and
+decoded because they were not found (misses), since the program started. */
+
+void blkcachestats(long *hits, long *misses)
+{
+    BCLOCK();
+    if (hits) *hits = bchits;
+    if (misses) *misses = bcmisses;
+    BCUNLOCK();
+}
+
+/* isgbcinit: if the block cache is enabled, and if the signal file of input
+   signal group ig (which is in format fmt, and has just been opened) can be
+   read through it, allocate the group's cache state. */
+void isgbcinit(WFDB_Context *ctx, struct igdata *ig, int fmt)
+{
+#if WFDB_MMAP_SUPPORT
+    struct stat st;
+    int budget;
+
+    (void)ctx;		/* the cache is shared by all contexts */
+    ig->bc = NULL;
+    BCLOCK();
+    if (!bcinit) {
+	BCUNLOCK();
+	setblkcache(-1);
+	BCLOCK();
+    }
+    budget = (bcbudget > 0);
+    BCUNLOCK();
+    if (!budget || !ig->seek || ig->fp == NULL ||
+	ig->fp->type != WFDB_LOCAL || ig->fp->fp == stdin)
+	return;
+    switch (fmt) {
+      case 16: case 61: case 80: case 160: case 212:
+      case 24: case 32: case 310: case 311:
+	break;
+      default:
+	return;
+    }
+    if (fstat(fileno(ig->fp->fp), &st) || !S_ISREG(st.st_mode) ||
+	(ig->bc = calloc(1, sizeof(struct igbc))) == NULL)
+	return;
+    ig->bc->key.dev = st.st_dev;
+    ig->bc->key.ino = st.st_ino;
+    ig->bc->key.size = st.st_size;
+    ig->bc->key.mtime = st.st_mtime;
+    ig->bc->key.mtimens = ST_MTIMENS(st);
+    ig->bc->key.ctime = st.st_ctime;
+    ig->bc->key.ctimens = ST_CTIMENS(st);
+    ig->bc->key.fmt = fmt;
+    ig->bc->fpos = -1;
+#else
+    (void)ctx;
+    ig->bc = NULL;
+#endif
+}
+
+/* isgbcfree: release the block being read by input signal group ig, if any,
+   and free the group's cache state. */
+void isgbcfree(WFDB_Context *ctx, struct igdata *ig)
+{
+    (void)ctx;
+    if (ig->bc) {
+	if (ig->bc->blk)
+	    bcrelease(ig->bc->blk);
+	free(ig->bc);
+	ig->bc = NULL;
+    }
+}
+
+/* bcget: return the cached block identified by key, with a reference that
+   the caller must release using bcrelease, or NULL if there is none. */
+struct bcblock *bcget(const struct bckey *key)
+{
+    struct bcblock *b = NULL;
+
+    BCLOCK();
+    if (bchsize > 0)
+	for (b = bchash[bchashkey(key) & (bchsize-1)]; b; b = b->hnext)
+	    if (bckeyeq(&b->key, key)) {
+		b->refs++;
+		bctouch(b);
+		break;
+	    }
+    if (b) bchits++;
+    else bcmisses++;
+    BCUNLOCK();
+    return (b);
+}
+
+/* bcnew: allocate a block with room for nsamp samples, or return NULL if
+   there is not enough memory.  The block is not yet in the cache. */
+struct bcblock *bcnew(size_t nsamp)
+{
+    struct bcblock *b;
+
+    if ((b = calloc(1, sizeof(struct bcblock))) == NULL)
+	return (NULL);
+    if (nsamp > ((size_t)-1) / sizeof(WFDB_Sample) ||
+	(b->v = malloc(nsamp * sizeof(WFDB_Sample))) == NULL) {
+	free(b);
+	return (NULL);
+    }
+    b->size = sizeof(struct bcblock) + nsamp * sizeof(WFDB_Sample);
+    b->refs = 1;
+    return (b);
+}
+
+/* bcput: add block b (allocated by bcnew and filled by the caller) to the
+   cache, identified by key.  If another context has added the same block
+   meanwhile, b is freed and the other block is returned instead.  In either
+   case, the caller holds a reference to the block returned.  If b is empty,
+   or if there is not enough memory to enlarge the cache's hash table, b is
+   freed and NULL is returned. */
+struct bcblock *bcput(const struct bckey *key, struct bcblock *b)
+{
+    struct bcblock *c;
+    unsigned long h;
+
+    if (b->n == 0) {
+	free(b->v);
+	free(b);
+	return (NULL);
+    }
+    b->key = *key;
+    BCLOCK();
+    if (bcnblk >= bchsize)
+	bcrehash();
+    if (bchsize == 0) {
+	BCUNLOCK();
+	free(b->v);
+	free(b);
+	return (NULL);
+    }
+    h = bchashkey(key) & (bchsize-1);
+    for (c = bchash[h]; c; c = c->hnext)
+	if (bckeyeq(&c->key, key)) {
+	    c->refs++;
+	    bctouch(c);
+	    BCUNLOCK();
+	    free(b->v);
+	    free(b);
+	    return (c);
+	}
+    b->hnext = bchash[h];
+    bchash[h] = b;
+    bctouch(b);
+    bctotal += b->size;
+    bcnblk++;
+    bctrim();
+    BCUNLOCK();
+    return (b);
+}
+
+/* bcrelease: release a reference to block b, obtained from bcget or bcput.
+   Once no context is reading it, a block is discarded if the cache has
+   exceeded its budget. */
+void bcrelease(struct bcblock *b)
+{
+    BCLOCK();
+    if (--b->refs == 0 && bctotal > bcbudget)
+	bctrim();
+    BCUNLOCK();
+}
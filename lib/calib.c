@@ -65,11 +65,13 @@ int calopen_ctx(WFDB_Context *ctx, const char *cfname)
 
     if (*cfname == '+')		/* don't empty the calibration list */
 	cfname++;		/* discard the '+' prefix */
-    else flushcal();		/* empty the calibration list */
+    else flushcal_ctx(ctx);		/* empty the calibration list */
 
     /* Quit if file can't be found or opened. */
-    if ((cfile = wfdb_open(cfname, (char *)NULL, WFDB_READ)) == NULL) {
-	wfdb_error("calopen: can't read calibration file %s\n", cfname);
+    if ((cfile = wfdb_open_ctx(ctx, cfname, (char *)NULL, WFDB_READ)) ==
+	NULL) {
+	wfdb_error_ctx(ctx, "calopen: can't read calibration file %s\n",
+		       cfname);
 	return (-2);
     }
 
@@ -208,11 +210,13 @@ int newcal_ctx(WFDB_Context *ctx, const char *cfname)
     WFDB_FILE *cfile;
     int errflag;
 
-    if (wfdb_checkname(cfname, "calibration file") < 0)
+    if (wfdb_checkname_ctx(ctx, cfname, "calibration file") < 0)
 	return (-1);
 
-    if ((cfile = wfdb_open(cfname, (char *)NULL, WFDB_WRITE)) == NULL) {
-	wfdb_error("newcal: can't create calibration file %s\n", cfname);
+    if ((cfile = wfdb_open_ctx(ctx, cfname, (char *)NULL, WFDB_WRITE)) ==
+	NULL) {
+	wfdb_error_ctx(ctx, "newcal: can't create calibration file %s\n",
+		       cfname);
 	return (-1);
     }
 
@@ -248,7 +252,7 @@ int newcal_ctx(WFDB_Context *ctx, const char *cfname)
     if (wfdb_fclose(cfile))
 	errflag = 1;
     if (errflag) {
-	wfdb_error("newcal: write error in calibration file\n");
+	wfdb_error_ctx(ctx, "newcal: write error in calibration file\n");
 	return (-1);
     }
     return (0);
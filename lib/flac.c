@@ -13,9 +13,122 @@
 
 #ifdef WFDB_FLAC_SUPPORT
 
+/* Frame index for FLAC signal files.
+
+   FLAC__stream_decoder_seek_absolute finds a sample by bisecting the
+   stream (between the nearest points of its SEEKTABLE, if it has one),
+   reading and decoding FLAC frames at each step.  To avoid most of these
+   reads, each FLAC input group that can be seeked keeps an index of the
+   FLAC frames whose positions are known:  those listed in the stream's
+   SEEKTABLE, which is read when the group is opened, and those that the
+   group's decoder has reached since then.  If the index lists a FLAC frame
+   that begins no more than FLAC_MAXSKIP samples before the target of a
+   seek, and the target is known to lie within the stream, flac_isseek
+   (or a decode-ahead worker) moves directly to that FLAC frame and
+   discards the samples that precede the target. */
+
+#define FLAC_MAXSKIP	65536	/* samples per signal */
+
+struct fxpoint {		/* a FLAC frame whose position is known */
+    FLAC__uint64 samp;		/* number of its first sample (of each
+				   signal) */
+    FLAC__uint64 pos;		/* byte offset of the FLAC frame */
+};
+
+struct igfx {			/* frame index for a signal group */
+    struct fxpoint *pt;		/* known FLAC frames, in order */
+    unsigned long n;		/* number of entries in pt */
+    unsigned long max;		/* number of entries allocated */
+    FLAC__uint64 skip;		/* samples to discard after moving to an
+				   indexed FLAC frame (see iflac_samples) */
+};
+
+/* Return the index of the last entry of fx that begins at or before
+   sample tt, or -1 if there is none. */
+static long fx_find(const struct igfx *fx, FLAC__uint64 tt)
+{
+    unsigned long lo = 0, hi = fx->n, mid;
+
+    while (lo < hi) {
+	mid = lo + (hi - lo) / 2;
+	if (fx->pt[mid].samp <= tt)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return ((long)lo - 1);
+}
+
+/* Add a FLAC frame to the index, unless it is already listed.  If there is
+   not enough memory, the index is left unchanged. */
+static void fx_add(struct igfx *fx, FLAC__uint64 samp, FLAC__uint64 pos)
+{
+    struct fxpoint *pt;
+    unsigned long max;
+    long i = fx_find(fx, samp);
+
+    if (i >= 0 && fx->pt[i].samp == samp)
+	return;
+    if (fx->n == fx->max) {
+	max = fx->max ? 2 * fx->max : 256;
+	if ((pt = realloc(fx->pt, max * sizeof(struct fxpoint))) == NULL)
+	    return;
+	fx->pt = pt;
+	fx->max = max;
+    }
+    i++;
+    memmove(&fx->pt[i+1], &fx->pt[i], (fx->n - i) * sizeof(struct fxpoint));
+    fx->pt[i].samp = samp;
+    fx->pt[i].pos = pos;
+    fx->n++;
+}
+
+/* Return the indexed FLAC frame from which sample tt can be reached, or
+   NULL if there is none.  Unless tt is the first sample of an indexed
+   FLAC frame, a later FLAC frame must also be indexed, so that tt is
+   known to be within the stream. */
+static const struct fxpoint *fx_lookup(const struct igfx *fx, FLAC__uint64 tt)
+{
+    long i = fx_find(fx, tt);
+
+    if (i < 0 || tt - fx->pt[i].samp > FLAC_MAXSKIP ||
+	(tt != fx->pt[i].samp && (unsigned long)i + 1 == fx->n))
+	return (NULL);
+    return (&fx->pt[i]);
+}
+
+static void isgfxfree(struct igdata *g)
+{
+    if (g->fx) {
+	free(g->fx->pt);
+	free(g->fx);
+	g->fx = NULL;
+    }
+}
+
+/* Read the metadata of a newly opened FLAC input group, and start its
+   frame index with the FLAC frames listed in the stream's SEEKTABLE (see
+   iflac_metadata) and the first FLAC frame.  If the position of the first
+   FLAC frame cannot be determined, the index is not used. */
+static void isgfxinit(struct igdata *g)
+{
+    struct igfx *fx = g->fx;
+    FLAC__uint64 audio;
+    unsigned long i;
+
+    if (!FLAC__stream_decoder_process_until_end_of_metadata(g->flacdec) ||
+	!FLAC__stream_decoder_get_decode_position(g->flacdec, &audio)) {
+	isgfxfree(g);
+	return;
+    }
+    for (i = 0; i < fx->n; i++)
+	fx->pt[i].pos += audio;
+    fx_add(fx, 0, audio);
+}
+
 /* The following functions (iflac_read, iflac_seek, iflac_tell,
-   iflac_length, iflac_eof, iflac_error, and iflac_samples) are used
-   as callbacks for the FLAC library.  The client_data argument is the
+   iflac_length, iflac_eof, iflac_metadata, iflac_error, and
+   iflac_samples) are used as callbacks for the FLAC library.  The client_data argument is the
    value passed to FLAC__stream_decoder_init_stream, which is a
    pointer to a struct igdata. */
 
@@ -102,31 +215,55 @@ static FLAC__bool iflac_eof(const FLAC__StreamDecoder *dec, void *client_data)
     return (wfdb_feof(g->fp));
 }
 
-/* iflac_error is called by the FLAC library when the input stream
-   appears invalid or corrupted. */
-static void iflac_error(const FLAC__StreamDecoder *decoder,
-			FLAC__StreamDecoderErrorStatus status,
-			void *client_data)
+/* iflac_metadata is called by the FLAC library when it reads the
+   stream's SEEKTABLE (the only metadata block requested by flac_isopen
+   besides STREAMINFO).  The offsets of the seek points are relative to the
+   first FLAC frame, whose position is not yet known;  isgfxinit adjusts
+   them once it is.  Placeholders, and points that libFLAC has left
+   unfilled, are ignored. */
+static void iflac_metadata(const FLAC__StreamDecoder *dec,
+			   const FLAC__StreamMetadata *md, void *client_data)
 {
     struct igdata *g = client_data;
+    const FLAC__StreamMetadata_SeekPoint *p;
+    unsigned i;
+
+    if (md->type != FLAC__METADATA_TYPE_SEEKTABLE || g->fx == NULL)
+	return;
+    p = md->data.seek_table.points;
+    for (i = 0; i < md->data.seek_table.num_points; i++, p++)
+	if (p->sample_number != FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER &&
+	    p->frame_samples > 0)
+	    fx_add(g->fx, p->sample_number, p->stream_offset);
+}
 
+/* flac_errmsg returns the message describing a FLAC decoding error. */
+static const char *flac_errmsg(FLAC__StreamDecoderErrorStatus status)
+{
     switch (status) {
       case FLAC__STREAM_DECODER_ERROR_STATUS_LOST_SYNC:
-	wfdb_error("getvec: unable to decode FLAC (lost sync)\n");
-	break;
+	return ("getvec: unable to decode FLAC (lost sync)\n");
       case FLAC__STREAM_DECODER_ERROR_STATUS_BAD_HEADER:
-	wfdb_error("getvec: unable to decode FLAC (invalid header)\n");
-	break;
+	return ("getvec: unable to decode FLAC (invalid header)\n");
       case FLAC__STREAM_DECODER_ERROR_STATUS_FRAME_CRC_MISMATCH:
-	wfdb_error("getvec: unable to decode FLAC (CRC mismatch)\n");
-	break;
+	return ("getvec: unable to decode FLAC (CRC mismatch)\n");
       case FLAC__STREAM_DECODER_ERROR_STATUS_UNPARSEABLE_STREAM:
-	wfdb_error("getvec: unable to decode FLAC (unsupported format)\n");
-	break;
+	return ("getvec: unable to decode FLAC (unsupported format)\n");
       default:
-	wfdb_error("getvec: unable to decode FLAC\n");
-	break;
+	return ("getvec: unable to decode FLAC\n");
     }
+}
+
+/* iflac_error is called by the FLAC library when the input stream
+   appears invalid or corrupted. */
+static void iflac_error(const FLAC__StreamDecoder *decoder,
+			FLAC__StreamDecoderErrorStatus status,
+			void *client_data)
+{
+    struct igdata *g = client_data;
+    WFDB_Context *ctx = g->fp->ctx;
+
+    wfdb_error_ctx(ctx, "%s", flac_errmsg(status));
     /* Note that if an error is detected, the FLAC library will still
        subsequently invoke iflac_samples, with a buffer of zeroes
        rather than valid data. */
@@ -140,20 +277,26 @@ iflac_samples(const FLAC__StreamDecoder *dec, const FLAC__Frame *ffrm,
 	      const FLAC__int32 *const buf[], void *client_data)
 {
     struct igdata *g = client_data;
+    WFDB_Context *ctx = g->fp->ctx;
     size_t nsig = ffrm->header.channels;
     size_t nsamp = ffrm->header.blocksize;
     size_t oldsize, newsize, frmsize, bufsize, spf, ipos, orem, s, n;
     char *nbuf;
     FLAC__int32 *p;
+    FLAC__uint64 fpos;
 
     /* g->data is the number of signals in the group. */
     if (nsig != g->data) {
-	wfdb_error("getvec: wrong number of signals in FLAC signal file\n");
+	wfdb_error_ctx(ctx,
+		       "getvec: wrong number of signals in FLAC "
+		       "signal file\n");
 	g->stat = -2;
     }
     /* g->datb is the group sample resolution. */
     if (ffrm->header.bits_per_sample > g->datb) {
-	wfdb_error("getvec: wrong sample resolution in FLAC signal file\n");
+	wfdb_error_ctx(ctx,
+		       "getvec: wrong sample resolution in FLAC "
+		       "signal file\n");
 	g->stat = -2;
     }
     /* If the resolution or number of signals is incorrect, or if an
@@ -163,6 +306,15 @@ iflac_samples(const FLAC__StreamDecoder *dec, const FLAC__Frame *ffrm,
     if (g->stat < 0)
 	return (FLAC__STREAM_DECODER_WRITE_STATUS_ABORT);
 
+    /* The next FLAC frame begins where this one ends;  add it to the
+       frame index.  (If this FLAC frame was reached by seek_absolute, its
+       header has been adjusted to describe only the samples passed to
+       us, but the sum below is still the number of the next sample.) */
+    if (g->fx &&
+	ffrm->header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER &&
+	FLAC__stream_decoder_get_decode_position(dec, &fpos))
+	fx_add(g->fx, ffrm->header.number.sample_number + nsamp, fpos);
+
     /* g->buf is the start of the input buffer.
 
        g->bp points to the next sample (FLAC__int32) to be retrieved.
@@ -218,8 +370,18 @@ iflac_samples(const FLAC__StreamDecoder *dec, const FLAC__Frame *ffrm,
     }
 
     /* g->count is the number of initial samples to skip, following a
-       seek (see flac_isseek). */
-    if (g->count > nsamp) {
+       seek (see flac_isseek).  If the seek used the frame index, the
+       number to skip is g->fx->skip instead. */
+    if (g->fx && g->fx->skip > 0) {
+	if (g->fx->skip > nsamp) {
+	    g->fx->skip -= nsamp;
+	    return (FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE);
+	}
+	ipos = g->fx->skip;
+	nsamp -= ipos;
+	g->fx->skip = 0;
+    }
+    else if (g->count > nsamp) {
 	g->count -= nsamp;
 	return (FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE);
     }
@@ -253,20 +415,563 @@ iflac_samples(const FLAC__StreamDecoder *dec, const FLAC__Frame *ffrm,
     return (FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE);
 }
 
+/* Decode-ahead for FLAC signal files.
+
+   Decoding FLAC is much slower than reading uncompressed samples, and
+   normally it is done by the reading thread, one FLAC frame at a time,
+   as getvec needs more samples.  If decode-ahead is enabled (see
+   setiflacthreads), each FLAC signal group instead has a set of worker
+   threads, each with its own stream decoder, and a ring of buffers,
+   each of which receives the samples of a span of FA_CHUNK samples per
+   signal (rounded down to whole frames).  Each worker seeks its decoder
+   to the beginning of the next span that has been requested (using the
+   stream's SEEKTABLE if it has one), decodes the span, and stores its
+   samples in frame order, so that flac_getsamp only has to return them
+   one by one.  Spans are requested in order, and are used in the same
+   order by the reading thread;  after a seek, one span is requested,
+   and the number requested ahead doubles with each span used, up to
+   the size of the ring, so that random access does not start decoding
+   far beyond the samples that are needed.
+
+   The workers read the signal file using pread(), so decode-ahead is
+   used only for local files that can be seeked.  Errors detected by a
+   worker are recorded in its span, and reported by the reading thread
+   when it reaches that span. */
+
+#if defined(WFDB_THREADS) && WFDB_MMAP_SUPPORT
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define FA_CHUNK	65536	/* samples per signal in each span */
+
+#define FA_IDLE		0	/* span not requested */
+#define FA_QUEUED	1	/* waiting for a worker */
+#define FA_BUSY		2	/* being decoded by a worker */
+#define FA_DONE		3	/* decoded, samples ready */
+
+struct fatask {			/* a span of samples to be decoded */
+    WFDB_Time start;		/* sample number (of each signal) at which
+				   the span begins */
+    long nsamp;			/* number of samples (of each signal) decoded;
+				   less than the span's length at the end of
+				   the stream or after an error */
+    FLAC__int32 *buf;		/* decoded samples, in frame order */
+    int state;			/* FA_IDLE, FA_QUEUED, FA_BUSY, or FA_DONE */
+    int stat;			/* 1: OK, -1: seek failed, -2: decoding
+				   error */
+    const char *msg;		/* error message, if stat == -2 */
+};
+
+struct faworker {		/* a decoding thread */
+    struct igfa *fa;		/* decode-ahead state of its group */
+    pthread_t thread;
+    FLAC__StreamDecoder *dec;	/* the thread's own stream decoder */
+    FLAC__uint64 pos;		/* decoder's read position in the file */
+    struct fatask *task;	/* span being decoded */
+    unsigned skip;		/* samples to discard before the span */
+};
+
+struct igfa {			/* decode-ahead state for a signal group */
+    pthread_mutex_t lock;	/* protects the counters and each fatask's
+				   state */
+    pthread_cond_t work;	/* signaled when a span is requested */
+    pthread_cond_t done;	/* signaled when a span is decoded */
+    int fd;			/* descriptor of the signal file */
+    FLAC__uint64 len;		/* length of the signal file in bytes */
+    unsigned nsig;		/* number of signals in the group */
+    unsigned spf;		/* samples per signal per frame */
+    unsigned bits;		/* group sample resolution */
+    const struct igfx *fx;	/* the group's frame index, if any (not
+				   modified while decode-ahead is used) */
+    long spanlen;		/* samples per signal in each span */
+    struct fatask *task;	/* ring of spans */
+    unsigned ntask;		/* number of spans in the ring */
+    unsigned long issued;	/* number of spans requested */
+    unsigned long taken;	/* number of spans taken by workers */
+    unsigned long used;		/* number of spans used by flac_getsamp */
+    int cur;			/* 1 if span (used-1) is being read */
+    unsigned depth;		/* maximum number of spans requested ahead */
+    WFDB_Time next;		/* first sample of the next span to be
+				   requested (-1 if not yet positioned) */
+    int end;			/* 1 if no more spans are to be used */
+    int endstat;		/* g->stat at that point (0 or -2) */
+    const char *endmsg;		/* error message, if endstat == -2 */
+    struct faworker *worker;	/* decoding threads */
+    unsigned nworker;		/* number of decoding threads */
+    int quit;			/* if nonzero, the workers should exit */
+};
+
+/* The following functions (fa_read, fa_seek, fa_tell, fa_length,
+   fa_eof, fa_error, and fa_samples) are the FLAC library callbacks for
+   the workers' decoders.  The client_data argument is a pointer to a
+   struct faworker. */
+
+static FLAC__StreamDecoderReadStatus
+fa_read(const FLAC__StreamDecoder *dec, FLAC__byte buffer[],
+	size_t *bytes, void *client_data)
+{
+    struct faworker *w = client_data;
+    ssize_t n;
+
+    if (*bytes == 0)
+	return (FLAC__STREAM_DECODER_READ_STATUS_ABORT);
+    do {
+	n = pread(w->fa->fd, buffer, *bytes, (off_t)w->pos);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+	return (FLAC__STREAM_DECODER_READ_STATUS_ABORT);
+    *bytes = n;
+    w->pos += n;
+    if (n == 0)
+	return (FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM);
+    else
+	return (FLAC__STREAM_DECODER_READ_STATUS_CONTINUE);
+}
+
+static FLAC__StreamDecoderSeekStatus
+fa_seek(const FLAC__StreamDecoder *dec, FLAC__uint64 pos, void *client_data)
+{
+    struct faworker *w = client_data;
+
+    if (pos > w->fa->len)
+	return (FLAC__STREAM_DECODER_SEEK_STATUS_ERROR);
+    w->pos = pos;
+    return (FLAC__STREAM_DECODER_SEEK_STATUS_OK);
+}
+
+static FLAC__StreamDecoderTellStatus
+fa_tell(const FLAC__StreamDecoder *dec, FLAC__uint64 *pos, void *client_data)
+{
+    struct faworker *w = client_data;
+
+    *pos = w->pos;
+    return (FLAC__STREAM_DECODER_TELL_STATUS_OK);
+}
+
+static FLAC__StreamDecoderLengthStatus
+fa_length(const FLAC__StreamDecoder *dec, FLAC__uint64 *len,
+	  void *client_data)
+{
+    struct faworker *w = client_data;
+
+    *len = w->fa->len;
+    return (FLAC__STREAM_DECODER_LENGTH_STATUS_OK);
+}
+
+static FLAC__bool fa_eof(const FLAC__StreamDecoder *dec, void *client_data)
+{
+    struct faworker *w = client_data;
+
+    return (w->pos >= w->fa->len);
+}
+
+static void fa_error(const FLAC__StreamDecoder *decoder,
+		     FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+    struct faworker *w = client_data;
+
+    if (w->task && w->task->stat > 0) {
+	w->task->stat = -2;
+	w->task->msg = flac_errmsg(status);
+    }
+}
+
+/* fa_samples stores the samples of a decoded FLAC frame in the span
+   being decoded, discarding those that precede or follow it. */
+static FLAC__StreamDecoderWriteStatus
+fa_samples(const FLAC__StreamDecoder *dec, const FLAC__Frame *ffrm,
+	   const FLAC__int32 *const buf[], void *client_data)
+{
+    struct faworker *w = client_data;
+    struct igfa *fa = w->fa;
+    struct fatask *t = w->task;
+    size_t nsig = fa->nsig, spf = fa->spf;
+    size_t nsamp = ffrm->header.blocksize, ipos, f, o, n, s;
+    FLAC__int32 *p;
+
+    if (t->stat < 0)
+	return (FLAC__STREAM_DECODER_WRITE_STATUS_ABORT);
+    if (ffrm->header.channels != nsig) {
+	t->stat = -2;
+	t->msg = "getvec: wrong number of signals in FLAC signal file\n";
+	return (FLAC__STREAM_DECODER_WRITE_STATUS_ABORT);
+    }
+    if (ffrm->header.bits_per_sample > fa->bits) {
+	t->stat = -2;
+	t->msg = "getvec: wrong sample resolution in FLAC signal file\n";
+	return (FLAC__STREAM_DECODER_WRITE_STATUS_ABORT);
+    }
+    if (w->skip >= nsamp) {
+	w->skip -= nsamp;
+	return (FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE);
+    }
+    ipos = w->skip;
+    nsamp -= ipos;
+    w->skip = 0;
+    if (nsamp > (size_t)(fa->spanlen - t->nsamp))
+	nsamp = fa->spanlen - t->nsamp;
+
+    /* Store each signal's samples at its place in each frame. */
+    while (nsamp != 0) {
+	f = t->nsamp / spf;
+	o = t->nsamp % spf;
+	n = spf - o;
+	if (n > nsamp) n = nsamp;
+	p = t->buf + f * nsig * spf + o;
+	for (s = 0; s < nsig; s++, p += spf)
+	    memcpy(p, buf[s] + ipos, n * sizeof(FLAC__int32));
+	ipos += n;
+	nsamp -= n;
+	t->nsamp += n;
+    }
+    return (FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE);
+}
+
+/* fa_decode is invoked by a worker in order to decode span t. */
+static void fa_decode(struct faworker *w, struct fatask *t)
+{
+    FLAC__StreamDecoderState state;
+    FLAC__uint64 tt = t->start;
+    const struct fxpoint *x;
+    long oldn;
+
+    t->nsamp = 0;
+    t->stat = 1;
+    t->msg = NULL;
+    w->task = t;
+    w->skip = 0;
+
+    /* After an error, the decoder must be flushed before it can seek. */
+    state = FLAC__stream_decoder_get_state(w->dec);
+    if (state == FLAC__STREAM_DECODER_SEEK_ERROR ||
+	state == FLAC__STREAM_DECODER_ABORTED)
+	FLAC__stream_decoder_flush(w->dec);
+
+    /* If the group's frame index lists a FLAC frame from which the span
+       can be reached, move to it.  (The decoder must first read the
+       stream's metadata, if it has not yet done so.)  Otherwise, as in
+       flac_isseek, seek to the sample before the span (if any), so that a
+       span that begins at the end of the stream is empty rather than an
+       error. */
+    if (w->fa->fx && (x = fx_lookup(w->fa->fx, tt)) &&
+	FLAC__stream_decoder_process_until_end_of_metadata(w->dec) &&
+	FLAC__stream_decoder_flush(w->dec)) {
+	w->pos = x->pos;
+	w->skip = tt - x->samp;
+    }
+    else {
+	if (tt != 0) {
+	    tt--;
+	    w->skip = 1;
+	}
+	if (!FLAC__stream_decoder_seek_absolute(w->dec, tt)) {
+	    if (t->stat > 0)
+		t->stat = -1;
+	    return;
+	}
+    }
+    while (t->stat > 0 && t->nsamp < w->fa->spanlen) {
+	oldn = t->nsamp;
+	if (!FLAC__stream_decoder_process_single(w->dec)) {
+	    if (t->stat > 0) {
+		t->stat = -2;
+		t->msg = "getvec: unexpected FLAC decoding error\n";
+	    }
+	    break;
+	}
+	if (t->nsamp == oldn) {
+	    state = FLAC__stream_decoder_get_state(w->dec);
+	    if (state == FLAC__STREAM_DECODER_END_OF_STREAM)
+		break;
+	    else if (state != FLAC__STREAM_DECODER_SEARCH_FOR_METADATA &&
+		     state != FLAC__STREAM_DECODER_READ_METADATA &&
+		     state != FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC &&
+		     state != FLAC__STREAM_DECODER_READ_FRAME &&
+		     t->stat > 0) {
+		t->stat = -2;
+		t->msg = "getvec: unknown FLAC decoding state\n";
+	    }
+	}
+    }
+}
+
+static void *fa_run(void *arg)
+{
+    struct faworker *w = arg;
+    struct igfa *fa = w->fa;
+    struct fatask *t;
+
+    pthread_mutex_lock(&fa->lock);
+    while (!fa->quit) {
+	if (fa->taken == fa->issued) {
+	    pthread_cond_wait(&fa->work, &fa->lock);
+	    continue;
+	}
+	t = &fa->task[fa->taken++ % fa->ntask];
+	t->state = FA_BUSY;
+	pthread_mutex_unlock(&fa->lock);
+	fa_decode(w, t);
+	pthread_mutex_lock(&fa->lock);
+	t->state = FA_DONE;
+	pthread_cond_broadcast(&fa->done);
+    }
+    pthread_mutex_unlock(&fa->lock);
+    return (NULL);
+}
+
+/* Request spans, up to the current depth, from the workers.  The caller
+   must hold fa->lock. */
+static void fa_issue(struct igfa *fa)
+{
+    struct fatask *t;
+    int n = 0;
+
+    while (!fa->end && fa->issued - fa->used < fa->depth &&
+	   fa->issued - fa->used + fa->cur < fa->ntask) {
+	t = &fa->task[fa->issued++ % fa->ntask];
+	t->start = fa->next;
+	t->state = FA_QUEUED;
+	fa->next += fa->spanlen;
+	n++;
+    }
+    if (n)
+	pthread_cond_broadcast(&fa->work);
+}
+
+/* Discard all requested and decoded spans, waiting for any that are
+   being decoded.  The caller must hold fa->lock. */
+static void fa_cancel(struct igfa *fa)
+{
+    unsigned i;
+
+    fa->issued = fa->taken;
+    for (i = 0; i < fa->ntask; i++)
+	while (fa->task[i].state == FA_BUSY)
+	    pthread_cond_wait(&fa->done, &fa->lock);
+    for (i = 0; i < fa->ntask; i++)
+	fa->task[i].state = FA_IDLE;
+    fa->issued = fa->taken = fa->used = 0;
+    fa->cur = fa->end = 0;
+}
+
+/* isgfanext makes the next decoded span of signal group g available to
+   flac_getsamp, and returns g->stat. */
+static int isgfanext(WFDB_Context *ctx, struct igdata *g)
+{
+    struct igfa *fa = g->fa;
+    struct fatask *t;
+    long nframes, left;
+
+    pthread_mutex_lock(&fa->lock);
+    if (fa->cur) {		/* release the span that has been read */
+	fa->task[(fa->used - 1) % fa->ntask].state = FA_IDLE;
+	fa->cur = 0;
+    }
+    if (fa->end) {
+	pthread_mutex_unlock(&fa->lock);
+	if (fa->endstat < 0 && g->stat > 0)
+	    wfdb_error_ctx(ctx, "%s", fa->endmsg);
+	g->packptr = g->bp = g->be = g->buf;
+	return (g->stat = fa->endstat);
+    }
+    if (fa->next < 0)		/* not yet positioned: start at sample 0 */
+	fa->next = g->start;
+    fa_issue(fa);
+    t = &fa->task[fa->used % fa->ntask];
+    while (t->state != FA_DONE)
+	pthread_cond_wait(&fa->done, &fa->lock);
+    fa->used++;
+    fa->cur = 1;
+    if (t->stat < 0 || t->nsamp < fa->spanlen) {
+	fa->end = 1;
+	fa->endstat = (t->stat < 0) ? -2 : 0;
+	fa->endmsg = (t->stat == -1) ?
+	    "getvec: unable to seek in FLAC signal file\n" : t->msg;
+    }
+    else {
+	if (fa->depth < fa->ntask)
+	    fa->depth *= 2;
+	fa_issue(fa);
+    }
+    pthread_mutex_unlock(&fa->lock);
+
+    nframes = t->nsamp / fa->spf;
+    if (fa->end && fa->endstat == 0 && (left = t->nsamp % fa->spf) != 0)
+	wfdb_error_ctx(ctx, "getvec: warning: %ld samples left over at "
+		       "end of file\n", left);
+    if (nframes == 0)
+	return (isgfanext(ctx, g));
+    g->bp = (char *)t->buf;
+    g->packptr = g->be = g->bp + nframes * fa->nsig * fa->spf *
+	sizeof(FLAC__int32);
+    return (g->stat);
+}
+
+/* isgfaseek positions signal group g at sample tt (of each signal).  It
+   returns -1 if the decoder could not seek there, or 1 otherwise. */
+static int isgfaseek(WFDB_Context *ctx, struct igdata *g, WFDB_Time tt)
+{
+    struct igfa *fa = g->fa;
+    struct fatask *t;
+    int stat;
+
+    pthread_mutex_lock(&fa->lock);
+    fa_cancel(fa);
+    fa->next = tt;
+    fa->depth = 1;
+    fa_issue(fa);
+    /* Wait for the first span, so that a failed seek can be reported
+       now, as it is without decode-ahead. */
+    t = &fa->task[0];
+    while (t->state != FA_DONE)
+	pthread_cond_wait(&fa->done, &fa->lock);
+    if ((stat = t->stat) == -1)
+	fa_cancel(fa);
+    pthread_mutex_unlock(&fa->lock);
+    g->packptr = g->bp = g->be = g->buf;
+    return (stat == -1 ? -1 : 1);
+}
+
+/* Stop the workers of signal group g and free its decode-ahead state. */
+static void isgfafree(struct igdata *g)
+{
+    struct igfa *fa = g->fa;
+    unsigned i;
+
+    if (fa == NULL)
+	return;
+    pthread_mutex_lock(&fa->lock);
+    fa->quit = 1;
+    pthread_cond_broadcast(&fa->work);
+    pthread_mutex_unlock(&fa->lock);
+    for (i = 0; i < fa->nworker; i++) {
+	(void)pthread_join(fa->worker[i].thread, NULL);
+	FLAC__stream_decoder_delete(fa->worker[i].dec);
+    }
+    for (i = 0; i < fa->ntask; i++)
+	free(fa->task[i].buf);
+    pthread_cond_destroy(&fa->done);
+    pthread_cond_destroy(&fa->work);
+    pthread_mutex_destroy(&fa->lock);
+    free(fa->task);
+    free(fa->worker);
+    free(fa);
+    g->fa = NULL;
+}
+
+/* Set up decode-ahead for a newly opened FLAC signal group, if it is
+   enabled and possible.  If anything fails, the group is decoded by the
+   reading thread as usual. */
+static void isgfainit(WFDB_Context *ctx, struct igdata *g)
+{
+    struct igfa *fa;
+    struct faworker *w;
+    struct stat st;
+    size_t spansize;
+    int i, n;
+
+    g->fa = NULL;
+    if (iflacthreads == 0) setiflacthreads_ctx(ctx, -1);
+    if ((n = iflacthreads) <= 0 || !g->seek || g->fp == NULL ||
+	g->fp->type != WFDB_LOCAL || g->fp->fp == stdin ||
+	fstat(fileno(g->fp->fp), &st) || !S_ISREG(st.st_mode))
+	return;
+    if ((fa = calloc(1, sizeof(struct igfa))) == NULL)
+	return;
+    fa->fd = fileno(g->fp->fp);
+    fa->len = st.st_size;
+    fa->nsig = g->data;
+    fa->spf = g->packspf;
+    fa->bits = g->datb;
+    fa->fx = g->fx;
+    fa->spanlen = (FA_CHUNK / fa->spf) * fa->spf;
+    if (fa->spanlen == 0) fa->spanlen = fa->spf;
+    fa->ntask = 2 * n;
+    fa->depth = 1;
+    fa->next = -1;
+    spansize = (size_t)fa->spanlen * fa->nsig * sizeof(FLAC__int32);
+    pthread_mutex_init(&fa->lock, NULL);
+    pthread_cond_init(&fa->work, NULL);
+    pthread_cond_init(&fa->done, NULL);
+    g->fa = fa;
+    if ((fa->task = calloc(fa->ntask, sizeof(struct fatask))) == NULL ||
+	(fa->worker = calloc(n, sizeof(struct faworker))) == NULL) {
+	isgfafree(g);
+	return;
+    }
+    for (i = 0; i < (int)fa->ntask; i++)
+	if ((fa->task[i].buf = malloc(spansize)) == NULL) {
+	    isgfafree(g);
+	    return;
+	}
+    for (i = 0; i < n; i++) {
+	w = &fa->worker[fa->nworker];
+	w->fa = fa;
+	if ((w->dec = FLAC__stream_decoder_new()) == NULL)
+	    break;
+	if (FLAC__stream_decoder_init_stream(w->dec, &fa_read, &fa_seek,
+					     &fa_tell, &fa_length, &fa_eof,
+					     &fa_samples, NULL, &fa_error,
+					     w) ||
+	    pthread_create(&w->thread, NULL, fa_run, w)) {
+	    FLAC__stream_decoder_delete(w->dec);
+	    break;
+	}
+	fa->nworker++;
+    }
+    if (fa->nworker == 0)
+	isgfafree(g);
+}
+
+#else	/* decode-ahead is not available */
+
+static int isgfanext(WFDB_Context *ctx, struct igdata *g)
+{
+    (void)ctx;
+    return (g->stat = -2);
+}
+
+static int isgfaseek(WFDB_Context *ctx, struct igdata *g, WFDB_Time tt)
+{
+    (void)ctx; (void)g; (void)tt;
+    return (-1);
+}
+
+static void isgfafree(struct igdata *g)
+{
+    (void)g;
+}
+
+static void isgfainit(WFDB_Context *ctx, struct igdata *g)
+{
+    (void)ctx;
+    g->fa = NULL;
+}
+
+#endif
+
 /* Read and return the next sample from a FLAC signal file. */
-int flac_getsamp(struct igdata *g)
+int flac_getsamp(WFDB_Context *ctx, struct igdata *g)
 {
     FLAC__int32 *ibp;
     FLAC__StreamDecoderState state;
     unsigned oldcount;
 
     /* If the next frame has not yet been decoded, read more data from
-       the input file. */
+       the input file (or, if decode-ahead is enabled, wait for the
+       workers to decode it). */
     while (g->bp == g->packptr) {
+	if (g->fa) {
+	    if (isgfanext(ctx, g) <= 0)
+		return (0);
+	    continue;
+	}
 	oldcount = g->packcount;
 	if (!FLAC__stream_decoder_process_single(g->flacdec)) {
 	    if (g->stat != -2) {
-		wfdb_error("getvec: unexpected FLAC decoding error\n");
+		wfdb_error_ctx(ctx,
+			       "getvec: unexpected FLAC decoding error\n");
 		g->stat = -2;
 	    }
 	    return (0);
@@ -279,8 +984,9 @@ int flac_getsamp(struct igdata *g)
 	    switch (state) {
 	      case FLAC__STREAM_DECODER_END_OF_STREAM:
 		if (g->packcount != 0)
-		    wfdb_error("getvec: warning: %d samples left over"
-			       " at end of file\n", g->packcount);
+		    wfdb_error_ctx(ctx,
+				   "getvec: warning: %d samples left over at "
+				   "end of file\n", g->packcount);
 		g->packcount = 0;
 		g->stat = 0;
 		return (0);
@@ -289,7 +995,7 @@ int flac_getsamp(struct igdata *g)
 	      case FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC:
 		break;
 	      default:
-		wfdb_error("getvec: unknown FLAC decoding state\n");
+		wfdb_error_ctx(ctx, "getvec: unknown FLAC decoding state\n");
 		g->stat = -2;
 		return (0);
 	    }
@@ -305,29 +1011,30 @@ int flac_getsamp(struct igdata *g)
 /* Open a FLAC stream decoder for an input signal group.  The input
    file (ig->fp) has already been opened and the buffer (ig->buf) has
    already been allocated. */
-int flac_isopen(struct igdata *ig, struct hsdata **hs, unsigned ns)
+int flac_isopen(WFDB_Context *ctx, struct igdata *ig, struct hsdata **hs,
+		unsigned ns)
 {
     unsigned int i;
     char *p;
 
     if (ns > FLAC__MAX_CHANNELS) {
-	wfdb_error(
-	    "isigopen: cannot store %u signals in a single FLAC file\n",
-	    ns);
+	wfdb_error_ctx(ctx,
+		       "isigopen: cannot store %u signals in a single "
+		       "FLAC file\n", ns);
 	return (-1);
     }
     for (i = 1; i < ns; i++) {
 	if (hs[i]->info.spf != hs[0]->info.spf) {
-	    wfdb_error(
-	       "isigopen: every signal in a FLAC file must have\n"
-	       "  the same sampling frequency\n");
+	    wfdb_error_ctx(ctx,
+			   "isigopen: every signal in a FLAC file must have\n"
+			   "  the same sampling frequency\n");
 	    return (-1);
 	}
     }
 
     ig->flacdec = FLAC__stream_decoder_new();
     if (!ig->flacdec) {
-	wfdb_error("isigopen: cannot initialize stream decoder\n");
+	wfdb_error_ctx(ctx, "isigopen: cannot initialize stream decoder\n");
 	return (-1);
     }
     /* If the WFDB_FLAC_CHECK_MD5 environment variable is defined, try
@@ -343,25 +1050,44 @@ int flac_isopen(struct igdata *ig, struct hsdata **hs, unsigned ns)
     ig->packspf = hs[0]->info.spf;
     ig->packptr = ig->be = ig->bp = ig->buf + ig->bsize;
     ig->packcount = 0;
+    /* If the file can be seeked, keep an index of its FLAC frames (see
+       isgfxinit), starting with those listed in its SEEKTABLE. */
+    ig->fx = NULL;
+    if (ig->seek && (ig->fx = calloc(1, sizeof(struct igfx))))
+	FLAC__stream_decoder_set_metadata_respond(ig->flacdec,
+					       FLAC__METADATA_TYPE_SEEKTABLE);
     if (FLAC__stream_decoder_init_stream(ig->flacdec, &iflac_read,
 					 &iflac_seek, &iflac_tell,
 					 &iflac_length, &iflac_eof,
-					 &iflac_samples, NULL,
+					 &iflac_samples, &iflac_metadata,
 					 &iflac_error, ig)) {
-	wfdb_error("isigopen: cannot open stream decoder\n");
+	wfdb_error_ctx(ctx, "isigopen: cannot open stream decoder\n");
 	FLAC__stream_decoder_delete(ig->flacdec);
+	isgfxfree(ig);
 	return (-1);
     }
+    if (ig->fx)
+	isgfxinit(ig);
+    /* Verifying the MD5 hash requires decoding the whole stream in
+       order, so decode-ahead is not used in that case. */
+    if (p == NULL || *p == '\0')
+	isgfainit(ctx, ig);
+    else
+	ig->fa = NULL;
     return (0);
 }
 
 /* Close a stream decoder. */
-int flac_isclose(struct igdata *ig)
+int flac_isclose(WFDB_Context *ctx, struct igdata *ig)
 {
     int stat = 0;
 
+    isgfafree(ig);
+    isgfxfree(ig);
     if (!FLAC__stream_decoder_finish(ig->flacdec)) {
-	wfdb_error("isigclose: warning: incorrect MD5 hash in FLAC input\n");
+	wfdb_error_ctx(ctx,
+		       "isigclose: warning: incorrect MD5 hash in "
+		       "FLAC input\n");
 	stat = -1;
     }
     FLAC__stream_decoder_delete(ig->flacdec);
@@ -369,9 +1095,10 @@ int flac_isclose(struct igdata *ig)
 }
 
 /* Seek to the given frame number in an input stream. */
-int flac_isseek(struct igdata *ig, WFDB_Time t)
+int flac_isseek(WFDB_Context *ctx, struct igdata *ig, WFDB_Time t)
 {
     FLAC__StreamDecoderState state;
+    const struct fxpoint *x;
     WFDB_Time tt;
 
     /* If there was a previous seek error, clear the decoder state so
@@ -387,6 +1114,8 @@ int flac_isseek(struct igdata *ig, WFDB_Time t)
     ig->packcount = 0;
     ig->stat = 1;
     ig->count = 0;
+    if (ig->fx)
+	ig->fx->skip = 0;
 
     /* Seek to the desired sample.  Note that seek_absolute will
        return an error if the given sample number is greater than or
@@ -396,6 +1125,17 @@ int flac_isseek(struct igdata *ig, WFDB_Time t)
        to 1 so that iflac_samples will discard the first sample from
        each signal. */
     tt = t * ig->packspf + ig->start;
+    if (ig->fa)
+	return (ig->stat = isgfaseek(ctx, ig, tt));
+    /* If the frame index lists a FLAC frame from which tt can be reached,
+       move to the beginning of that FLAC frame, and let iflac_samples
+       discard the samples that precede tt. */
+    if (ig->fx && (x = fx_lookup(ig->fx, tt)) && x->pos <= LONG_MAX &&
+	wfdb_fseek(ig->fp, (long)x->pos, SEEK_SET) == 0 &&
+	FLAC__stream_decoder_flush(ig->flacdec)) {
+	ig->fx->skip = tt - x->samp;
+	return (ig->stat);
+    }
     if (tt != 0) {
 	tt--;
 	ig->count = 1;
@@ -409,25 +1149,31 @@ int flac_isseek(struct igdata *ig, WFDB_Time t)
 
 #else /* !WFDB_FLAC_SUPPORT */
 
-int flac_getsamp(struct igdata *ig)
+int flac_getsamp(WFDB_Context *ctx, struct igdata *ig)
 {
+    (void)ctx;
     ig->stat = -1;
     return (0);
 }
 
-int flac_isopen(struct igdata *ig, struct hsdata **hs, unsigned ns)
+int flac_isopen(WFDB_Context *ctx, struct igdata *ig, struct hsdata **hs,
+		unsigned ns)
 {
-    wfdb_error("isigopen: libwfdb was compiled without FLAC support\n");
+    (void)ig; (void)hs; (void)ns;
+    wfdb_error_ctx(ctx,
+		   "isigopen: libwfdb was compiled without FLAC support\n");
     return (-1);
 }
 
-int flac_isclose(struct igdata *ig)
+int flac_isclose(WFDB_Context *ctx, struct igdata *ig)
 {
+    (void)ctx; (void)ig;
     return (-1);
 }
 
-int flac_isseek(struct igdata *ig, WFDB_Time t)
+int flac_isseek(WFDB_Context *ctx, struct igdata *ig, WFDB_Time t)
 {
+    (void)ctx; (void)ig; (void)t;
     return (-1);
 }
 
@@ -436,6 +1182,98 @@ int flac_isseek(struct igdata *ig, WFDB_Time t)
 /* Routines for writing FLAC signal files. */
 
 #ifdef WFDB_FLAC_SUPPORT
+#include <FLAC/metadata.h>
+
+/* Seek table for FLAC output files.
+
+   So that readers can find any part of a FLAC signal file quickly (see
+   the frame index above), a SEEKTABLE block with room for
+   WFDB_FLAC_SEEKPOINTS (by default, FLAC_SEEKPOINTS) points is reserved
+   when the file is opened, and is filled in as FLAC frames are written.
+   At first, every FLAC frame is listed;  each time the table is full,
+   every other point is removed, and the spacing between points is
+   doubled, so that the points remain spread evenly over the whole file
+   however long it becomes.  (The length of the file is not known in
+   advance, so libFLAC's own templates of evenly spaced points cannot be
+   used.)  The table is written by libFLAC when the encoder is finished,
+   if the output file can be seeked;  otherwise it contains only
+   placeholders, which readers ignore. */
+
+#define FLAC_SEEKPOINTS		1024	/* default number of seek points */
+#define FLAC_MAXSEEKPOINTS	65536	/* maximum number of seek points */
+
+struct ogsk {			/* seek table state for a signal group */
+    FLAC__StreamMetadata *md;	/* the SEEKTABLE block */
+    unsigned n;			/* number of points filled in */
+    FLAC__uint64 step;		/* FLAC frames per seek point */
+    FLAC__uint64 frame;		/* number of FLAC frames written */
+    FLAC__uint64 samp;		/* number of samples (of each signal)
+				   written */
+    FLAC__uint64 pos;		/* number of bytes written */
+    FLAC__uint64 audio;		/* byte offset of the first FLAC frame */
+};
+
+/* Record a chunk of the output file, written by oflac_write, in the seek
+   table.  samples is the number of samples (of each signal) in the chunk,
+   which is either a complete FLAC frame or (if samples is zero) metadata.
+   libFLAC itself fills in only points whose sample numbers fall within
+   the FLAC frame being written, so it never modifies the points filled in
+   here, which belong to earlier FLAC frames. */
+static void oflac_mark(struct ogsk *sk, size_t bytes, unsigned samples)
+{
+    FLAC__StreamMetadata_SeekPoint *p = sk->md->data.seek_table.points;
+    unsigned i, max = sk->md->data.seek_table.num_points;
+
+    if (samples > 0) {
+	if (sk->frame == 0)
+	    sk->audio = sk->pos;
+	if (sk->frame % sk->step == 0 && sk->n == max) {
+	    for (i = 0; 2 * i < sk->n; i++)
+		p[i] = p[2 * i];
+	    for (sk->n = i; i < max; i++) {
+		p[i].sample_number = FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER;
+		p[i].stream_offset = 0;
+		p[i].frame_samples = 0;
+	    }
+	    sk->step *= 2;
+	}
+	if (sk->frame % sk->step == 0 && sk->n < max) {
+	    p[sk->n].sample_number = sk->samp;
+	    p[sk->n].stream_offset = sk->pos - sk->audio;
+	    p[sk->n].frame_samples = samples;
+	    sk->n++;
+	}
+	sk->frame++;
+	sk->samp += samples;
+    }
+    sk->pos += bytes;
+}
+
+static void osgskfree(struct ogdata *og)
+{
+    if (og->sk) {
+	if (og->sk->md)
+	    FLAC__metadata_object_delete(og->sk->md);
+	free(og->sk);
+	og->sk = NULL;
+    }
+}
+
+/* Reserve a seek table of n points for a FLAC output group whose encoder
+   has not yet been initialized.  If this fails, the file is written
+   without a seek table. */
+static void osgskinit(struct ogdata *og, unsigned n)
+{
+    if ((og->sk = calloc(1, sizeof(struct ogsk))) == NULL)
+	return;
+    og->sk->step = 1;
+    if ((og->sk->md = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE))
+	== NULL ||
+	!FLAC__metadata_object_seektable_template_append_placeholders(
+	    og->sk->md, n) ||
+	!FLAC__stream_encoder_set_metadata(og->flacenc, &og->sk->md, 1))
+	osgskfree(og);
+}
 
 /* The following functions (oflac_write, oflac_seek, and oflac_tell)
    are used as callbacks for the FLAC library.  The client_data
@@ -452,8 +1290,9 @@ oflac_write(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
     struct ogdata *g = client_data;
     if (wfdb_fwrite(buffer, 1, bytes, g->fp) != bytes)
 	return (FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR);
-    else
-	return (FLAC__STREAM_ENCODER_WRITE_STATUS_OK);
+    if (g->sk)
+	oflac_mark(g->sk, bytes, samples);
+    return (FLAC__STREAM_ENCODER_WRITE_STATUS_OK);
 }
 
 /* oflac_seek is called by the FLAC library in order to move to a
@@ -487,81 +1326,136 @@ oflac_tell(const FLAC__StreamEncoder *encoder,
     }
 }
 
-/* Write the next sample to a FLAC signal file. */
-int flac_putsamp(WFDB_Sample v, int fmt, struct ogdata *g)
+/* Samples are buffered in frame order (as they are passed to putvec), in a
+   buffer that holds the frames containing FLAC_OBUFLEN samples of each
+   signal, and are passed to the encoder when the buffer is full. */
+#define FLAC_OBUFLEN	4096
+
+/* Discard the upper bits of a sample, by sign-extending it from the
+   group's resolution.  If sample values passed to the FLAC encoder exceed
+   the specified number of "bits per sample", the result is unpredictable:
+   the encoder might discard the upper bits, or it might actually encode
+   some values outside the stated range.  To ensure that the results are
+   consistent and predictable, even if the caller supplies invalid sample
+   values to putvec, we discard the upper bits before passing them to the
+   encoder. */
+static FLAC__int32 flac_sext(WFDB_Sample v, int bits)
 {
-    FLAC__int32 *obp;
-    const FLAC__int32 *channels[FLAC__MAX_CHANNELS];
-    unsigned spf, i;
     struct { WFDB_Sample v : 8; } v8;
     struct { WFDB_Sample v : 16; } v16;
     struct { WFDB_Sample v : 24; } v24;
 
-    /* If sample values passed to the FLAC encoder exceed the
-       specified number of "bits per sample", the result is
-       unpredictable: the encoder might discard the upper bits, or it
-       might actually encode some values outside the stated range.  To
-       ensure that the results are consistent and predictable, even if
-       the caller supplies invalid sample values to putvec, we discard
-       the upper bits by sign-extending values before passing them to
-       the encoder. */
-    switch (fmt) {
-      case 508: v = v8.v = v; break;
-      case 516: v = v16.v = v; break;
-      case 524: v = v24.v = v; break;
+    switch (bits) {
+      case 8: v = v8.v = v; break;
+      case 16: v = v16.v = v; break;
+      case 24: v = v24.v = v; break;
     }
+    return (v);
+}
 
-    obp = (FLAC__int32 *) g->bp;
-    *obp++ = v;
-
-    /* The output buffer is exactly the size of one frame, so when obp
-       reaches g->be we have one frame's worth of data to encode. */
-    if (obp == (FLAC__int32 *) g->be) {
-	obp = (FLAC__int32 *) g->buf;
-	spf = g->packspf;
-	for (i = 0; obp != (FLAC__int32 *) g->be; i++) {
-	    channels[i] = obp;
-	    obp += spf;
-	}
-	if (!FLAC__stream_encoder_process(g->flacenc, channels, spf)) {
-	    wfdb_error("putvec: error writing FLAC signal data\n");
-	    return (-1);
-	}
-	g->bp = g->buf;
+/* Pass the complete frames in the output buffer of a FLAC signal group to
+   the encoder.  og->data is the number of signals in the group. */
+static int flac_osflush(WFDB_Context *ctx, struct ogdata *g)
+{
+    const FLAC__int32 *channels[FLAC__MAX_CHANNELS];
+    FLAC__int32 *ibp = (FLAC__int32 *) g->buf, *p;
+    unsigned nsig = g->data, spf = g->packspf, frmlen = nsig * spf;
+    unsigned nframes, f, s;
+    FLAC__bool ok;
+
+    nframes = ((FLAC__int32 *) g->bp - ibp) / frmlen;
+    if (nframes == 0)
 	return (0);
-    }
+
+    /* If each signal has one sample per frame, the buffer contains
+       interleaved samples, as the encoder accepts them.  Otherwise, the
+       samples of each signal must be gathered from each frame. */
+    if (spf == 1)
+	ok = FLAC__stream_encoder_process_interleaved(g->flacenc, ibp,
+						      nframes);
     else {
-	g->bp = (char *) obp;
-	return (0);
+	p = (FLAC__int32 *) g->packbuf;
+	for (s = 0; s < nsig; s++) {
+	    channels[s] = p;
+	    for (f = 0; f < nframes; f++, p += spf)
+		memcpy(p, ibp + f * frmlen + s * spf,
+		       spf * sizeof(FLAC__int32));
+	}
+	ok = FLAC__stream_encoder_process(g->flacenc, channels,
+					  nframes * spf);
     }
+    g->bp = g->buf;
+    if (!ok) {
+	wfdb_error_ctx(ctx, "putvec: error writing FLAC signal data\n");
+	return (-1);
+    }
+    return (0);
 }
 
-int flac_osinit(struct ogdata *og, const WFDB_Siginfo *si, unsigned ns)
+/* Write the next sample to a FLAC signal file. */
+int flac_putsamp(WFDB_Context *ctx, WFDB_Sample v, int fmt, struct ogdata *g)
+{
+    FLAC__int32 *obp;
+
+    obp = (FLAC__int32 *) g->bp;
+    *obp++ = flac_sext(v, fmt - 500);
+    g->bp = (char *) obp;
+
+    /* The output buffer holds a whole number of frames, so when obp
+       reaches g->be we have a block of complete frames to encode. */
+    if (obp == (FLAC__int32 *) g->be)
+	return (flac_osflush(ctx, g));
+    else
+	return (0);
+}
+
+/* Frame encoder for the FLAC formats (see osgencoder), used by putvecs to
+   buffer one frame (n samples) at a time.  As for the other formats, -1
+   is returned if the frame would fill the buffer, so that the caller will
+   write its samples using flac_putsamp, which passes the buffer to the
+   encoder when it is full.  og->datb is the group sample resolution. */
+int flac_encode(struct ogdata *og, const WFDB_Sample *v, unsigned n)
+{
+    FLAC__int32 *p = (FLAC__int32 *) og->bp;
+    int bits = og->datb;
+
+    if (og->be - og->bp <= (long)(n * sizeof(FLAC__int32))) return (-1);
+    for ( ; n > 0; n--)
+	*p++ = flac_sext(*v++, bits);
+    og->bp = (char *) p;
+    return (0);
+}
+
+int flac_osinit(WFDB_Context *ctx, struct ogdata *og,
+		const WFDB_Siginfo *si, unsigned ns)
 {
     FLAC__StreamEncoder *enc;
     char *p;
     int min = 0, max = 0;
-    unsigned int i;
+    unsigned int i, nframes;
 
     if (ns > FLAC__MAX_CHANNELS) {
-	wfdb_error(
-	    "osigfopen: cannot store %u signals in a single FLAC file\n",
-	    ns);
+	wfdb_error_ctx(ctx,
+		       "osigfopen: cannot store %u signals in a single "
+		       "FLAC file\n", ns);
 	return (-1);
     }
     for (i = 1; i < ns; i++) {
 	if (si[i].spf != si[0].spf) {
-	    wfdb_error(
-	       "osigfopen: every signal in a FLAC file must have\n"
-	       "  the same sampling frequency\n");
+	    wfdb_error_ctx(ctx,
+			   "osigfopen: every signal in a FLAC file must have\n"
+			   "  the same sampling frequency\n");
 	    return (-1);
 	}
     }
 
+    if (oflacthreads == 0) setoflac_ctx(ctx, -1, -1, -1);
     og->flacenc = enc = FLAC__stream_encoder_new();
     og->packspf = si->spf;
+    og->data = ns;
+    og->datb = si->fmt - 500;
     if (!enc) {
-	wfdb_error("osigfopen: cannot initialize stream encoder\n");
+	wfdb_error_ctx(ctx, "osigfopen: cannot initialize stream encoder\n");
 	return (-1);
     }
     FLAC__stream_encoder_set_channels(enc, ns);
@@ -573,21 +1467,35 @@ int flac_osinit(struct ogdata *og, const WFDB_Siginfo *si, unsigned ns)
        will have problems when trying to read the file. */
     FLAC__stream_encoder_set_total_samples_estimate(enc, (FLAC__uint64) -1);
 
-    /* Make the buffer exactly large enough to hold a single frame.
-       (Also note that setting og->bsize to a non-zero value prevents
-       wfdb_osflush from trying to flush the output buffer.) */
-    og->bsize = ns * si->spf * sizeof(FLAC__int32);
-
-    /* The following environment variables may be used to set
-       parameters for the FLAC compression algorithm. */
-
-    if (p = getenv("WFDB_FLAC_COMPRESSION_LEVEL"))
-	FLAC__stream_encoder_set_compression_level(enc, strtol(p, NULL, 10));
-    else
-	FLAC__stream_encoder_set_compression_level(enc, 5);
+    /* Make the buffer large enough to hold a whole number of frames,
+       containing (at least) FLAC_OBUFLEN samples of each signal.  (Also
+       note that setting og->bsize to a non-zero value prevents
+       wfdb_osflush from trying to flush the output buffer.)  If there is
+       more than one sample per frame, the samples of each signal are
+       gathered into og->packbuf before being passed to the encoder. */
+    nframes = (FLAC_OBUFLEN + si->spf - 1) / si->spf;
+    og->bsize = nframes * ns * si->spf * sizeof(FLAC__int32);
+    if (si->spf > 1) {
+	SUALLOC(og->packbuf, og->bsize, 1);
+	if (og->packbuf == NULL)
+	    return (-1);
+    }
 
-    if (p = getenv("WFDB_FLAC_BLOCK_SIZE"))
-	FLAC__stream_encoder_set_blocksize(enc, strtol(p, NULL, 10));
+    /* The compression level, block size and number of threads are set by
+       setoflac (or by environment variables, see setoflac_ctx below).  The
+       following environment variables may be used to set other parameters
+       for the FLAC compression algorithm. */
+
+    FLAC__stream_encoder_set_compression_level(enc, oflaclevel);
+    if (oflacbsize > 0)
+	FLAC__stream_encoder_set_blocksize(enc, oflacbsize);
+#if FLAC_API_VERSION_CURRENT >= 14
+    /* Multithreaded encoding requires libFLAC 1.5 or later.  If libFLAC
+       was built without thread support, or cannot use as many threads as
+       requested, it encodes the stream in a single thread. */
+    if (oflacthreads > 1)
+	(void)FLAC__stream_encoder_set_num_threads(enc, oflacthreads);
+#endif
     if (p = getenv("WFDB_FLAC_STEREO")) {
 	if (p[0] == 'a' || p[0] == 'A') { /* auto */
 	    FLAC__stream_encoder_set_do_mid_side_stereo(enc, 1);
@@ -641,51 +1549,145 @@ int flac_osinit(struct ogdata *og, const WFDB_Siginfo *si, unsigned ns)
     return (0);
 }
 
-int flac_osopen(struct ogdata *og)
+int flac_osopen(WFDB_Context *ctx, struct ogdata *og)
 {
+    char *p;
+    long n = FLAC_SEEKPOINTS;
+
+    /* The seek table can be filled in only if the output file can be
+       rewritten when it is closed.  Setting WFDB_FLAC_SEEKPOINTS to 0
+       disables the seek table. */
+    og->sk = NULL;
+    if (p = getenv("WFDB_FLAC_SEEKPOINTS"))
+	n = strtol(p, NULL, 10);
+    if (n > FLAC_MAXSEEKPOINTS)
+	n = FLAC_MAXSEEKPOINTS;
+    if (n > 0 && og->fp->type == WFDB_LOCAL && og->fp->fp != stdout)
+	osgskinit(og, n);
+
     if (FLAC__stream_encoder_init_stream(og->flacenc, &oflac_write,
 					 &oflac_seek, &oflac_tell,
 					 NULL, og)) {
-	wfdb_error("osigfopen: cannot open stream encoder\n");
+	wfdb_error_ctx(ctx, "osigfopen: cannot open stream encoder\n");
 	return (-1);
     }
     return (0);
 }
 
-int flac_osclose(struct ogdata *og)
+int flac_osclose(WFDB_Context *ctx, struct ogdata *og)
 {
     int stat = 0;
 
+    /* Encode any complete frames remaining in the buffer.  (As before, the
+       samples of an incomplete frame are discarded.) */
+    if (og->bp && flac_osflush(ctx, og) < 0)
+	stat = -1;
+    SFREE(og->packbuf);
     if (!FLAC__stream_encoder_finish(og->flacenc)) {
-	wfdb_error("osigclose: error writing FLAC signal file\n");
+	wfdb_error_ctx(ctx, "osigclose: error writing FLAC signal file\n");
 	stat = -1;
     }
     FLAC__stream_encoder_delete(og->flacenc);
+    osgskfree(og);
     og->bp = og->be = og->buf;
     return (stat);
 }
 
 #else /* !WFDB_FLAC_SUPPORT */
 
-int flac_putsamp(WFDB_Sample v, int fmt, struct ogdata *g)
+int flac_putsamp(WFDB_Context *ctx, WFDB_Sample v, int fmt, struct ogdata *g)
+{
+    (void)ctx; (void)v; (void)fmt; (void)g;
+    return (-1);
+}
+
+int flac_osinit(WFDB_Context *ctx, struct ogdata *og,
+		const WFDB_Siginfo *si, unsigned ns)
 {
+    (void)og; (void)si; (void)ns;
+    wfdb_error_ctx(ctx,
+		   "osigfopen: libwfdb was compiled without FLAC support\n");
     return (-1);
 }
 
-int flac_osinit(struct ogdata *og, const WFDB_Siginfo *si, unsigned ns)
+int flac_osopen(WFDB_Context *ctx, struct ogdata *og)
 {
-    wfdb_error("osigfopen: libwfdb was compiled without FLAC support\n");
+    (void)ctx; (void)og;
     return (-1);
 }
 
-int flac_osopen(struct ogdata *og)
+int flac_osclose(WFDB_Context *ctx, struct ogdata *og)
 {
+    (void)ctx; (void)og;
     return (-1);
 }
 
-int flac_osclose(struct ogdata *og)
+int flac_encode(struct ogdata *og, const WFDB_Sample *v, unsigned n)
 {
+    (void)og; (void)v; (void)n;
     return (-1);
 }
 
 #endif
+
+/* Function setiflacthreads sets the number of threads that decode each
+FLAC-compressed signal group opened by subsequent calls to isigopen, while
+the application reads the samples that they have already decoded (see
+"Decode-ahead" above).  If n is zero, FLAC signal files are decoded by the
+reading thread, as they are needed.  If n is negative, the number is taken
+from the environment variable WFDBFLACTHREADS, and decode-ahead is disabled
+if WFDBFLACTHREADS is not set to a positive integer. */
+
+void setiflacthreads_ctx(WFDB_Context *ctx, int n)
+{
+#if defined(WFDB_THREADS) && WFDB_MMAP_SUPPORT
+    if (n < 0) {
+	char *p;
+
+	n = (p = getenv("WFDBFLACTHREADS")) ? strtol(p, NULL, 10) : 0;
+    }
+    iflacthreads = (n > 0) ? n : -1;
+#else
+    (void)n;
+    iflacthreads = -1;
+#endif
+}
+
+void setiflacthreads(int n)
+{
+    setiflacthreads_ctx(wfdb_get_default_context(), n);
+}
+
+/* Function setoflac sets parameters for the FLAC encoders of output signal
+groups opened by subsequent calls to osigopen or osigfopen:  the compression
+level (0 to 8;  higher levels give smaller files, but take longer to
+encode), the block size (the number of samples of each signal in each FLAC
+frame, or 0 to let libFLAC choose it according to the compression level),
+and the number of threads that encode each group (used only with libFLAC
+1.5 or later).  If any of these arguments is negative, the corresponding
+parameter is taken from the environment variable WFDB_FLAC_COMPRESSION_LEVEL,
+WFDB_FLAC_BLOCK_SIZE, or WFDB_FLAC_THREADS, and if that variable is not set,
+the default (level 5, libFLAC's block size, and 1 thread) is used. */
+
+void setoflac_ctx(WFDB_Context *ctx, int level, int blocksize, int nthreads)
+{
+    char *p;
+
+    if (level < 0)
+	level = (p = getenv("WFDB_FLAC_COMPRESSION_LEVEL")) ?
+	    strtol(p, NULL, 10) : 5;
+    if (blocksize < 0)
+	blocksize = (p = getenv("WFDB_FLAC_BLOCK_SIZE")) ?
+	    strtol(p, NULL, 10) : 0;
+    if (nthreads < 0)
+	nthreads = (p = getenv("WFDB_FLAC_THREADS")) ?
+	    strtol(p, NULL, 10) : 1;
+    oflaclevel = (level > 0) ? level : 0;
+    oflacbsize = (blocksize > 0) ? blocksize : 0;
+    oflacthreads = (nthreads > 1) ? nthreads : 1;
+}
+
+void setoflac(int level, int blocksize, int nthreads)
+{
+    setoflac_ctx(wfdb_get_default_context(), level, blocksize, nthreads);
+}
@@ -17,16 +17,30 @@ void read_edf_str(char *buf, int size, WFDB_FILE *ifile)
     }
 }
 
+/* Make sure that hsd has room for at least nsig signals. */
+static void hsdalloc(WFDB_Context *ctx, unsigned nsig)
+{
+    if (maxhsig < nsig) {
+	unsigned m = maxhsig;
+
+	SREALLOC(hsd, nsig, sizeof(struct hsdata *));
+	while (m < nsig) {
+	    SUALLOC(hsd[m], 1, sizeof(struct hsdata));
+	    m++;
+	}
+	maxhsig = nsig;
+    }
+}
+
 /* get header information from an EDF file */
-int edfparse(WFDB_FILE *ifile)
+int edfparse(WFDB_Context *ctx, WFDB_FILE *ifile)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     char buf[81], *edf_fname, *p;
     double *pmax, *pmin, spr, baseline;
     int format, i, s, nsig, offset, day, month, year, hour, minute, second;
     long adcrange, *dmax, *dmin, nframes;
 
-    edf_fname = wfdbfile(NULL, NULL);
+    edf_fname = wfdbfile_ctx(ctx, NULL, NULL);
 
     /* Read the first 8 bytes and check for the magic string.  (This might
        accept some non-EDF files.) */
@@ -36,7 +50,7 @@ int edfparse(WFDB_FILE *ifile)
     else if (strncmp(buf+1, "BIOSEMI", 7) == 0)
 	format = 24;	/* BDF */
     else {
-	wfdb_error("init: '%s' is not EDF or EDF+\n", edf_fname);
+	wfdb_error_ctx(ctx, "init: '%s' is not EDF or EDF+\n", edf_fname);
 	return (-2);
     }
 
@@ -63,21 +77,12 @@ int edfparse(WFDB_FILE *ifile)
     sscanf(buf+4, "%d", &nsig);
 
     if (nsig < 1 || (nsig + 1)*256 != offset) {
-	wfdb_error("init: '%s' is not EDF or EDF+\n", edf_fname);
+	wfdb_error_ctx(ctx, "init: '%s' is not EDF or EDF+\n", edf_fname);
 	return (-2);
     }
 
     /* Allocate workspace. */
-    if (maxhsig < nsig) {
-	unsigned m = maxhsig;
-
-	SREALLOC(hsd, nsig, sizeof(struct hsdata *));
-	while (m < nsig) {
-	    SUALLOC(hsd[m], 1, sizeof(struct hsdata));
-	    m++;
-	}
-	maxhsig = nsig;
-    }
+    hsdalloc(ctx, nsig);
     SUALLOC(dmax, nsig, sizeof(long));
     SUALLOC(dmin, nsig, sizeof(long));
     SUALLOC(pmax, nsig, sizeof(double));
@@ -162,11 +167,11 @@ int edfparse(WFDB_FILE *ifile)
     ffreq = 1.0 / spr;	/* frame frequency = 1/(seconds per EDF block) */
     cfreq = ffreq; /* set sampling and counter frequencies to match */
     sfreq = ffreq * spfmax;
-    if (getafreq() == 0.0) setafreq(sfreq);
+    if (getafreq_ctx(ctx) == 0.0) setafreq_ctx(ctx, sfreq);
     gvmode |= WFDB_HIGHRES;
     snprintf(buf, sizeof(buf), "%02d:%02d:%02d %02d/%02d/%04d",
 	    hour, minute, second, day, month, year);
-    setbasetime(buf);
+    setbasetime_ctx(ctx, buf);
 
     SFREE(pmin);
     SFREE(pmax);
@@ -176,14 +181,218 @@ int edfparse(WFDB_FILE *ifile)
     return (nsig);
 }
 
-int readheader(const char *record)
+/* The functions below maintain a cache of parsed segment headers.  When a
+multi-segment record is read, isigopen is called (with in_msrec set) each time
+that getvec or isigsettime crosses a segment boundary, and readheader would
+otherwise reopen and reparse the segment's header each time.  Entries are kept
+in most-recently-used order, and the least recently used entry is discarded
+once there are more than hclimit of them.
+
+A cached header is identified by the name passed to readheader, the current
+record name (which may appear in the WFDB path as %r), and the generation
+number of the WFDB path, which wfdbio.c increments whenever the path changes.
+(The location of the header file itself is not known without opening it, and
+avoiding that is the point of the cache.) */
+
+static void hcentryfree(struct hcentry *e)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
-    char *p, *q;
-    WFDB_Frequency f;
+    unsigned s;
+
+    for (s = 0; s < e->nsig; s++) {
+	SFREE(e->hs[s].info.fname);
+	SFREE(e->hs[s].info.units);
+	SFREE(e->hs[s].info.desc);
+    }
+    SFREE(e->hs);
+    SFREE(e->record);
+    SFREE(e->btstr);
+    SFREE(e);
+}
+
+/* Discard all but the n most recently used entries. */
+static void hcachetrim(WFDB_Context *ctx, int n)
+{
+    struct hcentry *e, **ep = &hcache;
+
+    while (*ep && n-- > 0)
+	ep = &(*ep)->next;
+    while (e = *ep) {
+	*ep = e->next;
+	hcentryfree(e);
+	nhcache--;
+    }
+}
+
+void hcachefree(WFDB_Context *ctx)
+{
+    hcachetrim(ctx, 0);
+}
+
+/* Move the headers cached in another context (that of the segment
+   prefetcher) into this one, as if they had been read under the WFDB path
+   generation path_gen of this context. */
+static struct hcentry *hcachetake(WFDB_Context *ctx)
+{
+    struct hcentry *e = hcache;
+
+    hcache = NULL;
+    nhcache = 0;
+    return (e);
+}
+
+void hcachemove(WFDB_Context *ctx, WFDB_Context *from, unsigned path_gen)
+{
+    struct hcentry *e, *next;
+
+    if (hclimit == 0) sethcache_ctx(ctx, -1);
+    for (e = hcachetake(from); e; e = next) {
+	next = e->next;
+	if (hclimit > 0) {
+	    e->path_gen = path_gen;
+	    e->next = hcache;
+	    hcache = e;
+	    nhcache++;
+	}
+	else
+	    hcentryfree(e);
+    }
+    hcachetrim(ctx, hclimit);
+}
+
+/* Function sethcache sets the maximum number of segment headers that are
+cached.  If n is zero, caching is disabled;  if n is negative, the limit is
+taken from the environment variable WFDBHCACHE if it is set, or is
+WFDB_DEFHCACHE otherwise. */
+
+void sethcache_ctx(WFDB_Context *ctx, int n)
+{
+    if (n < 0) {
+	char *p;
+
+	if ((p = getenv("WFDBHCACHE")) == NULL ||
+	    (n = strtol(p, NULL, 10)) < 0)
+	    n = WFDB_DEFHCACHE;
+    }
+    hcachetrim(ctx, n);
+    hclimit = (n > 0) ? n : -1;
+}
+
+void sethcache(int n)
+{
+    sethcache_ctx(wfdb_get_default_context(), n);
+}
+
+/* Find the cached copy of a segment header, and move it to the head of the
+   list.  An entry for the same segment that was read under another WFDB
+   path is stale, and is discarded. */
+static struct hcentry *hcachefind(WFDB_Context *ctx, const char *record)
+{
+    struct hcentry *e, **ep = &hcache;
+
+    if (hclimit == 0) sethcache_ctx(ctx, -1);
+    while (e = *ep) {
+	if (strcmp(e->record, record) == 0 &&
+	    strcmp(e->irec, ctx->irec) == 0) {
+	    *ep = e->next;
+	    if (e->path_gen != ctx->wfdb_path_gen) {
+		hcentryfree(e);
+		nhcache--;
+		return (NULL);
+	    }
+	    e->next = hcache;
+	    return (hcache = e);
+	}
+	ep = &e->next;
+    }
+    return (NULL);
+}
+
+/* Add a copy of the header that readheader has just parsed into hsd. */
+static void hcachestore(WFDB_Context *ctx, const char *record,
+			const struct hcentry *hc)
+{
+    struct hcentry *e = NULL;
+    unsigned s;
+
+    SUALLOC(e, 1, sizeof(struct hcentry));
+    *e = *hc;
+    e->record = e->btstr = NULL;
+    e->hs = NULL;
+    SSTRCPY(e->record, record);
+    SSTRCPY(e->btstr, hc->btstr);
+    (void)strcpy(e->irec, ctx->irec);
+    e->path_gen = ctx->wfdb_path_gen;
+    SUALLOC(e->hs, e->nsig, sizeof(struct hsdata));
+    for (s = 0; s < e->nsig; s++) {
+	e->hs[s] = *hsd[s];
+	copysi(&e->hs[s].info, &hsd[s]->info);
+    }
+    e->next = hcache;
+    hcache = e;
+    if (++nhcache > hclimit)
+	hcachetrim(ctx, hclimit);
+}
+
+/* Set the variables that readheader would set if it reread the header that
+   is cached in e. */
+static int hcacheapply(WFDB_Context *ctx, const struct hcentry *e,
+		       const char *record)
+{
+    unsigned s;
+
+    if (e->freq > (WFDB_Frequency)0.) {
+	if (ffreq > (WFDB_Frequency)0. && e->freq != ffreq) {
+	    wfdb_error_ctx(ctx, "warning (init):\n");
+	    wfdb_error_ctx(ctx, " record %s sampling frequency differs",
+			   record);
+	    wfdb_error_ctx(ctx, " from that of previously opened record\n");
+	}
+	else
+	    ffreq = e->freq;
+    }
+    else if (ffreq == (WFDB_Frequency)0.)
+	ffreq = WFDB_DEFFREQ;
+    sfreq = ffreq;
+    cfreq = (e->ctrfreq > 0.0) ? e->ctrfreq : ffreq;
+    bcount = e->basecount;
+    if (nsamples == (WFDB_Time)0L)
+	nsamples = e->nsamp;
+    if (e->btstr && btime == 0L) {
+	char *p = NULL;
+	int stat;
+
+	SSTRCPY(p, e->btstr);	/* setbasetime modifies its argument */
+	stat = setbasetime_ctx(ctx, p);
+	SFREE(p);
+	if (stat < 0)
+	    return (-2);
+    }
+
+    hsdalloc(ctx, e->nsig);
+    for (s = 0; s < e->nsig; s++) {
+	struct hsdata *hs = hsd[s];
+
+	SFREE(hs->info.fname);
+	SFREE(hs->info.units);
+	SFREE(hs->info.desc);
+	copysi(&hs->info, &e->hs[s].info);
+	hs->start = e->hs[s].start;
+	hs->skew = e->hs[s].skew;
+    }
+    spfmax = e->maxspf;
+    setgvmode_ctx(ctx, gvmode);	/* Reset sfreq if appropriate. */
+    return (e->nsig);
+}
+
+int readheader(WFDB_Context *ctx, const char *record)
+{
+    char *p, *q, btbuf[80];
+    WFDB_Frequency f, cf;
     WFDB_Signal s;
     WFDB_Time ns;
     unsigned int i, nsig;
+    int cache;
+    struct hcentry hc, *e;
     static const char sep[] = " \t\n\r";
 
     /* If another input header file was opened, close it. */
@@ -210,29 +419,38 @@ int readheader(const char *record)
 	return (0);
     }
 
+    /* If this is a segment of a multi-segment record, its header may have
+       been read already. */
+    if (cache = in_msrec) {
+	if (e = hcachefind(ctx, record))
+	    return (hcacheapply(ctx, e, record));
+	cache = (hclimit > 0);
+    }
+
     /* If the final component of the record name includes a '.', assume it is a
        file name. */
     q = (char *)record + strlen(record) - 1;
     while (q > record && *q != '.' && *q != '/' && *q != ':' && *q != '\\')
 	q--;
     if (*q == '.') {
-	if ((hheader = wfdb_open(NULL, record, WFDB_READ)) == NULL) {
-	    wfdb_error("init: can't open %s\n", record);
+	if ((hheader = wfdb_open_ctx(ctx, NULL, record, WFDB_READ)) == NULL) {
+	    wfdb_error_ctx(ctx, "init: can't open %s\n", record);
 	    return (-1);
 	}
 	else if (strcmp(q+1, "hea"))	/* assume EDF if suffix is not '.hea' */
-	    return (edfparse(hheader));
+	    return (edfparse(ctx, hheader));
     }
 
     /* Otherwise, assume the file name is record.hea. */
-    else if ((hheader = wfdb_open("hea", record, WFDB_READ)) == NULL) {
-	wfdb_error("init: can't open header for record %s\n", record);
+    else if ((hheader = wfdb_open_ctx(ctx, "hea", record, WFDB_READ)) ==
+	     NULL) {
+	wfdb_error_ctx(ctx, "init: can't open header for record %s\n", record);
 	return (-1);
     }
 
     /* Read the first line and check for a magic string. */
     if (wfdb_getline(&linebuf, &linebufsize, hheader) == 0) {
-        wfdb_error("init: record %s header is empty\n", record);
+        wfdb_error_ctx(ctx, "init: record %s header is empty\n", record);
 	    return (-2);
     }
     if (strncmp("#wfdb", linebuf, 5) == 0) { /* found the magic string */
@@ -243,10 +461,12 @@ int readheader(const char *record)
 	    (i > 1 && major == WFDB_MAJOR && minor > WFDB_MINOR) ||
 	    (i > 2 && major == WFDB_MAJOR && minor == WFDB_MINOR &&
 	     release > WFDB_RELEASE)) {
-	    wfdb_error("init: reading record %s requires WFDB library "
-		       "version %d.%d.%d or later\n"
-"  (the most recent version is always available from http://physionet.org)\n",
-		       record, major, minor, release);
+	    wfdb_error_ctx(ctx,
+			   "init: reading record %s requires WFDB library "
+			   "version %d.%d.%d or later\n"
+			   "  (the most recent version is always available "
+			   "from http://physionet.org)\n", record, major,
+			   minor, release);
 	    return (-1);
 	}
     }
@@ -255,8 +475,9 @@ int readheader(const char *record)
        non-comment line. */
     while ((p = strtok(linebuf, sep)) == NULL || *p == '#') {
 	if (wfdb_getline(&linebuf, &linebufsize, hheader) == 0) {
-	    wfdb_error("init: can't find record name in record %s header\n",
-		     record);
+	    wfdb_error_ctx(ctx,
+			   "init: can't find record name in record "
+			   "%s header\n", record);
 	    return (-2);
 	}
     }
@@ -265,9 +486,9 @@ int readheader(const char *record)
 	;
     if (*q == '/') {
 	if (in_msrec) {
-	    wfdb_error(
-	  "init: record %s cannot be nested in another multi-segment record\n",
-		     record);
+	    wfdb_error_ctx(ctx,
+			   "init: record %s cannot be nested in another "
+			   "multi-segment record\n", record);
 	    return (-2);
 	}
 	segments = strtol(q+1, NULL, 10);
@@ -292,8 +513,9 @@ int readheader(const char *record)
 		break;
 
 	if (q > s && (r > s || strcmp(p, s+1) != 0)) {
-	    wfdb_error("init: record name in record %s header is incorrect\n",
-		       record);
+	    wfdb_error_ctx(ctx,
+			   "init: record name in record %s header "
+			   "is incorrect\n", record);
 	    return (-2);
 	}
     }
@@ -304,7 +526,8 @@ int readheader(const char *record)
        have two or more.) */
     if ((p = strtok((char *)NULL, sep)) == NULL) {
 	/* The file appears to be an old-style header file. */
-	wfdb_error("init: obsolete format in record %s header\n", record);
+	wfdb_error_ctx(ctx, "init: obsolete format in record %s header\n",
+		       record);
 	return (-2);
     }
 
@@ -313,17 +536,19 @@ int readheader(const char *record)
     nsig = (unsigned)strtol(p, NULL, 10);
 
     /* Determine the frame rate, if present and not set already. */
+    f = (WFDB_Frequency)0.;
     if (p = strtok((char *)NULL, sep)) {
 	if ((f = (WFDB_Frequency)strtod(p, NULL)) <= (WFDB_Frequency)0.) {
-	    wfdb_error(
-		 "init: sampling frequency in record %s header is incorrect\n",
-		 record);
+	    wfdb_error_ctx(ctx,
+			   "init: sampling frequency in record %s header "
+			   "is incorrect\n", record);
 	    return (-2);
 	}
 	if (ffreq > (WFDB_Frequency)0. && f != ffreq) {
-	    wfdb_error("warning (init):\n");
-	    wfdb_error(" record %s sampling frequency differs", record);
-	    wfdb_error(" from that of previously opened record\n");
+	    wfdb_error_ctx(ctx, "warning (init):\n");
+	    wfdb_error_ctx(ctx, " record %s sampling frequency differs",
+			   record);
+	    wfdb_error_ctx(ctx, " from that of previously opened record\n");
 	}
 	else
 	    ffreq = f;
@@ -349,23 +574,23 @@ int readheader(const char *record)
 		bcount = strtod(++p, NULL);
 	}
     }
-    if (cfreq <= 0.0) cfreq = ffreq;
+    if ((cf = cfreq) <= 0.0) cfreq = ffreq;
 
     /* Determine the number of samples per signal, if present and not
        set already. */
     if (p = strtok((char *)NULL, sep)) {
 	if ((ns = strtotime(p, NULL, 10)) < 0L) {
-	    wfdb_error(
-		"init: number of samples in record %s header is incorrect\n",
-		record);
+	    wfdb_error_ctx(ctx,
+			   "init: number of samples in record %s header "
+			   "is incorrect\n", record);
 	    return (-2);
 	}
 	if (nsamples == (WFDB_Time)0L)
 	    nsamples = ns;
 	else if (ns > (WFDB_Time)0L && ns != nsamples && !in_msrec) {
-	    wfdb_error("warning (init):\n");
-	    wfdb_error(" record %s duration differs", record);
-	    wfdb_error(" from that of previously opened record\n");
+	    wfdb_error_ctx(ctx, "warning (init):\n");
+	    wfdb_error_ctx(ctx, " record %s duration differs", record);
+	    wfdb_error_ctx(ctx, " from that of previously opened record\n");
 	    /* nsamples must match the shortest record duration. */
 	    if (nsamples > ns)
 		nsamples = ns;
@@ -374,10 +599,18 @@ int readheader(const char *record)
     else
 	ns = (WFDB_Time)0L;
 
-    /* Determine the base time and date, if present and not set already. */
-    if ((p = strtok((char *)NULL,"\n\r")) != NULL &&
-	btime == 0L && setbasetime(p) < 0)
-	return (-2);	/* error message will come from setbasetime */
+    /* Determine the base time and date, if present and not set already.
+       (Keep a copy for the header cache, since setbasetime modifies the
+       string, and the signal specifications will overwrite it.) */
+    *btbuf = '\0';
+    if ((p = strtok((char *)NULL,"\n\r")) != NULL) {
+	if (strlen(p) < sizeof(btbuf))
+	    (void)strcpy(btbuf, p);
+	else
+	    cache = 0;
+	if (btime == 0L && setbasetime_ctx(ctx, p) < 0)
+	    return (-2);	/* error message will come from setbasetime */
+    }
 
     /* Special processing for master header of a multi-segment record. */
     if (segments && !in_msrec) {
@@ -391,26 +624,26 @@ int readheader(const char *record)
 	    /* Get next segment spec, skip empty lines and comments. */
 	    do {
 		if (wfdb_getline(&linebuf, &linebufsize, hheader) == 0) {
-		    wfdb_error(
-			"init: unexpected EOF in header file for record %s\n",
-			record);
+		    wfdb_error_ctx(ctx,
+				   "init: unexpected EOF in header file for "
+				   "record %s\n", record);
 		    SFREE(segarray);
 		    segments = 0;
 		    return (-2);
 		}
 	    } while ((p = strtok(linebuf, sep)) == NULL || *p == '#');
 	    if (*p == '+') {
-		wfdb_error(
-		    "init: `%s' is not a valid segment name in record %s\n",
-		    p, record);
+		wfdb_error_ctx(ctx,
+			       "init: `%s' is not a valid segment name in "
+			       "record %s\n", p, record);
 		SFREE(segarray);
 		segments = 0;
 		return (-2);
 	    }
 	    if (strlen(p) > WFDB_MAXRNL) {
-		wfdb_error(
-		    "init: `%s' is too long for a segment name in record %s\n",
-		    p, record);
+		wfdb_error_ctx(ctx,
+			       "init: `%s' is too long for a segment name in "
+			       "record %s\n", p, record);
 		SFREE(segarray);
 		segments = 0;
 		return (-2);
@@ -418,9 +651,9 @@ int readheader(const char *record)
 	    (void)strcpy(segp->recname, p);
 	    if ((p = strtok((char *)NULL, sep)) == NULL ||
 		(segp->nsamp = strtotime(p, NULL, 10)) < 0L) {
-		wfdb_error(
-		"init: length must be specified for segment %s in record %s\n",
-		           segp->recname, record);
+		wfdb_error_ctx(ctx,
+			       "init: length must be specified for segment "
+			       "%s in record %s\n", segp->recname, record);
 		SFREE(segarray);
 		segments = 0;
 		return (-2);
@@ -433,26 +666,17 @@ int readheader(const char *record)
 	if (msnsamples == 0L)
 	    msnsamples = ns;
 	else if (ns != msnsamples) {
-	    wfdb_error("warning (init): in record %s, "
-		       "stated record length (%"WFDB_Pd_TIME")\n",
-		       record, msnsamples);
-	    wfdb_error(" does not match sum of segment lengths "
-		       "(%"WFDB_Pd_TIME")\n", ns);
+	    wfdb_error_ctx(ctx, "warning (init): in record %s, "
+			   "stated record length (%"WFDB_Pd_TIME")\n",
+			   record, msnsamples);
+	    wfdb_error_ctx(ctx, " does not match sum of segment lengths "
+			   "(%"WFDB_Pd_TIME")\n", ns);
 	}
 	return (0);
     }
 
     /* Allocate workspace. */
-    if (maxhsig < nsig) {
-	unsigned m = maxhsig;
-
-	SREALLOC(hsd, nsig, sizeof(struct hsdata *));
-	while (m < nsig) {
-	    SUALLOC(hsd[m], 1, sizeof(struct hsdata));
-	    m++;
-	}
-	maxhsig = nsig;
-    }
+    hsdalloc(ctx, nsig);
 
     /* Now get information for each signal. */
     for (s = 0; s < nsig; s++) {
@@ -465,9 +689,9 @@ int readheader(const char *record)
 	   non-empty, non-comment line. */
 	do {
 	    if (wfdb_getline(&linebuf, &linebufsize, hheader) == 0) {
-		wfdb_error(
-			"init: unexpected EOF in header file for record %s\n",
-			record);
+		wfdb_error_ctx(ctx,
+			       "init: unexpected EOF in header file for "
+			       "record %s\n", record);
 		return (-2);
 	    }
 	} while ((p = strtok(linebuf, sep)) == NULL || *p == '#');
@@ -494,8 +718,9 @@ int readheader(const char *record)
 	/* Determine the signal format. */
 	if ((p = strtok((char *)NULL, sep)) == NULL ||
 	    !isfmt(hs->info.fmt = strtol(p, NULL, 10))) {
-	    wfdb_error("init: illegal format for signal %d, record %s\n",
-		       s, record);
+	    wfdb_error_ctx(ctx,
+			   "init: illegal format for signal %d, record %s\n",
+			   s, record);
 	    return (-2);
 	}
 	hs->info.spf = 1;
@@ -586,8 +811,9 @@ int readheader(const char *record)
 	if (s && (hp == NULL || (hs->info.group == hp->info.group &&
 	    (hs->info.fmt != hp->info.fmt ||
 	     hs->info.bsize != hp->info.bsize)))) {
-	    wfdb_error("init: error in specification of signal %d or %d\n",
-		       s-1, s);
+	    wfdb_error_ctx(ctx,
+			   "init: error in specification of signal %d or %d\n",
+			   s-1, s);
 	    return (-2);
 	}
 
@@ -600,13 +826,22 @@ int readheader(const char *record)
 	    (void)snprintf(hs->info.desc, WFDB_MAXDSL+1,
 			  "record %s, signal %d", record, s);
     }
-    setgvmode(gvmode);		/* Reset sfreq if appropriate. */
+    if (cache) {
+	hc.nsig = nsig;
+	hc.freq = f;
+	hc.ctrfreq = cf;
+	hc.basecount = bcount;
+	hc.nsamp = ns;
+	hc.btstr = *btbuf ? btbuf : NULL;
+	hc.maxspf = spfmax;
+	hcachestore(ctx, record, &hc);
+    }
+    setgvmode_ctx(ctx, gvmode);	/* Reset sfreq if appropriate. */
     return (s);			/* return number of available signals */
 }
 
-void hsdfree(void)
+void hsdfree(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     struct hsdata *hs;
 
     if (hsd) {
@@ -0,0 +1,264 @@
+/* file: readahead.c	2026
+   Read-ahead for input signal files.
+
+   Normally, when getvec has decoded all of the samples in a signal group's
+   input buffer, the buffer is refilled by reading the signal file, so that
+   decoding and reading alternate, and neither proceeds while the other is
+   in progress.  If read-ahead is enabled (see setireadahead), each group
+   has a second buffer, which an I/O thread fills with the following block
+   of the file while the samples in the first buffer are being decoded.
+   When the first buffer is exhausted, the buffers are exchanged, and the
+   thread begins to read the next block.  For records stored on network
+   file systems, this allows records to be read at the full bandwidth of
+   the storage system.
+
+   Read-ahead is used only for local signal files that can be seeked, and
+   are neither memory-mapped nor FLAC-compressed.  (Remote files are read
+   using the context's libcurl handle, which cannot be shared between
+   threads.)  Before a signal file is repositioned or closed, isgracancel
+   waits for any read in progress and discards its results.
+*/
+
+#include "signal_internal.h"
+
+#ifdef WFDB_THREADS
+#include <pthread.h>
+
+#define RA_IDLE		0	/* no read requested */
+#define RA_QUEUED	1	/* waiting for the I/O thread */
+#define RA_BUSY		2	/* being read by the I/O thread */
+#define RA_DONE		3	/* read complete, buffer ready */
+
+struct igra {			/* read-ahead state for a signal group */
+    struct igra *next;		/* next request in the I/O thread's queue */
+    WFDB_FILE *fp;		/* signal file */
+    char *buf;			/* buffer to be filled by the I/O thread */
+    int len;			/* number of bytes requested */
+    int nread;			/* number of bytes read */
+    int state;			/* RA_IDLE, RA_QUEUED, RA_BUSY, or RA_DONE */
+};
+
+struct raio {			/* I/O thread for a context */
+    pthread_t thread;
+    pthread_mutex_t lock;	/* protects the queue and each igra's state */
+    pthread_cond_t work;	/* signaled when a request is queued */
+    pthread_cond_t done;	/* signaled when a request is completed */
+    struct igra *head, *tail;	/* queue of pending requests */
+    int quit;			/* if nonzero, the thread should exit */
+};
+
+static void *raio_run(void *arg)
+{
+    struct raio *io = arg;
+    struct igra *ra;
+
+    pthread_mutex_lock(&io->lock);
+    while (!io->quit) {
+	if ((ra = io->head) == NULL) {
+	    pthread_cond_wait(&io->work, &io->lock);
+	    continue;
+	}
+	if ((io->head = ra->next) == NULL)
+	    io->tail = NULL;
+	ra->state = RA_BUSY;
+	pthread_mutex_unlock(&io->lock);
+	ra->nread = wfdb_fread(ra->buf, 1, ra->len, ra->fp);
+	pthread_mutex_lock(&io->lock);
+	ra->state = RA_DONE;
+	pthread_cond_broadcast(&io->done);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return (NULL);
+}
+
+static struct raio *raio_start(WFDB_Context *ctx)
+{
+    struct raio *io = NULL;
+
+    SUALLOC(io, 1, sizeof(struct raio));
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->work, NULL);
+    pthread_cond_init(&io->done, NULL);
+    if (pthread_create(&io->thread, NULL, raio_run, io)) {
+	pthread_cond_destroy(&io->done);
+	pthread_cond_destroy(&io->work);
+	pthread_mutex_destroy(&io->lock);
+	SFREE(io);
+	iramode = -1;		/* don't try again */
+    }
+    return (io);
+}
+
+/* Ask the I/O thread to read the next block into ra->buf. */
+static void raio_queue(struct raio *io, struct igra *ra)
+{
+    pthread_mutex_lock(&io->lock);
+    ra->state = RA_QUEUED;
+    ra->next = NULL;
+    if (io->tail)
+	io->tail->next = ra;
+    else
+	io->head = ra;
+    io->tail = ra;
+    pthread_cond_signal(&io->work);
+    pthread_mutex_unlock(&io->lock);
+}
+
+/* Set up read-ahead for a newly opened signal group, if it is enabled and
+   possible. */
+void isgrainit(WFDB_Context *ctx, struct igdata *g)
+{
+    struct igra *ra = NULL;
+
+    if (iramode == 0) setireadahead_ctx(ctx, -1);
+    if (iramode < 0 || g->fp == NULL || g->fp->type != WFDB_LOCAL ||
+	!g->seek || g->flacdec || g->bsize <= 0)
+	return;
+    if (ctx->raio == NULL && (ctx->raio = raio_start(ctx)) == NULL)
+	return;
+    SUALLOC(ra, 1, sizeof(struct igra));
+    SUALLOC(ra->buf, 1, g->bsize);
+    ra->fp = g->fp;
+    g->ra = ra;
+}
+
+/* Function isgfill refills the input buffer of signal group g, setting
+g->stat to the number of bytes read (0 at the end of the file), and returns
+this number.  It is invoked by the r8 macro. */
+
+int isgfill(WFDB_Context *ctx, struct igdata *g)
+{
+    struct igra *ra = g->ra;
+    struct raio *io = ctx->raio;
+    int n = (g->bsize > 0) ? g->bsize : ibsize;
+
+    if (ra) {			/* wait for the block being read, if any */
+	pthread_mutex_lock(&io->lock);
+	while (ra->state == RA_QUEUED || ra->state == RA_BUSY)
+	    pthread_cond_wait(&io->done, &io->lock);
+	pthread_mutex_unlock(&io->lock);
+    }
+    if (ra && ra->state == RA_DONE) {
+	char *t = g->buf;
+
+	g->buf = ra->buf;
+	ra->buf = t;
+	n = ra->nread;
+    }
+    else
+	n = wfdb_fread(g->buf, 1, n, g->fp);
+    g->stat = n;
+    g->be = (g->bp = g->buf) + n;
+    if (ra) {
+	ra->len = g->bsize;
+	raio_queue(io, ra);
+    }
+    return (n);
+}
+
+/* Wait for, and discard, any read requested for signal group g. */
+void isgracancel(WFDB_Context *ctx, struct igdata *g)
+{
+    struct igra *ra = g->ra, *prev, *r;
+    struct raio *io = ctx->raio;
+
+    if (ra == NULL)
+	return;
+    pthread_mutex_lock(&io->lock);
+    if (ra->state == RA_QUEUED) {	/* not started -- remove it */
+	for (prev = NULL, r = io->head; r != ra; prev = r, r = r->next)
+	    ;
+	if (prev)
+	    prev->next = ra->next;
+	else
+	    io->head = ra->next;
+	if (io->tail == ra)
+	    io->tail = prev;
+    }
+    while (ra->state == RA_BUSY)
+	pthread_cond_wait(&io->done, &io->lock);
+    ra->state = RA_IDLE;
+    pthread_mutex_unlock(&io->lock);
+}
+
+/* Release the read-ahead state of signal group g (before closing it). */
+void isgrafree(WFDB_Context *ctx, struct igdata *g)
+{
+    if (g->ra) {
+	isgracancel(ctx, g);
+	SFREE(g->ra->buf);
+	SFREE(g->ra);
+    }
+}
+
+/* Stop the I/O thread. */
+void raiofree(WFDB_Context *ctx)
+{
+    struct raio *io = ctx->raio;
+
+    if (io) {
+	pthread_mutex_lock(&io->lock);
+	io->quit = 1;
+	pthread_cond_signal(&io->work);
+	pthread_mutex_unlock(&io->lock);
+	(void)pthread_join(io->thread, NULL);
+	pthread_cond_destroy(&io->done);
+	pthread_cond_destroy(&io->work);
+	pthread_mutex_destroy(&io->lock);
+	SFREE(io);
+	ctx->raio = NULL;
+    }
+}
+
+#else	/* !WFDB_THREADS: buffers are always filled synchronously */
+
+void isgrainit(WFDB_Context *ctx, struct igdata *g)
+{
+}
+
+int isgfill(WFDB_Context *ctx, struct igdata *g)
+{
+    int n = (g->bsize > 0) ? g->bsize : ibsize;
+
+    g->stat = n = wfdb_fread(g->buf, 1, n, g->fp);
+    g->be = (g->bp = g->buf) + n;
+    return (n);
+}
+
+void isgracancel(WFDB_Context *ctx, struct igdata *g)
+{
+}
+
+void isgrafree(WFDB_Context *ctx, struct igdata *g)
+{
+}
+
+void raiofree(WFDB_Context *ctx)
+{
+}
+
+#endif
+
+/* Function setireadahead enables (if mode is positive) or disables (if mode
+is zero) read-ahead for input signal files opened by subsequent calls to
+isigopen.  If mode is negative, read-ahead is enabled only if the environment
+variable WFDBREADAHEAD is set to a positive integer. */
+
+void setireadahead_ctx(WFDB_Context *ctx, int mode)
+{
+#ifdef WFDB_THREADS
+    if (mode < 0) {
+	char *p;
+
+	mode = ((p = getenv("WFDBREADAHEAD")) && strtol(p, NULL, 10) > 0);
+    }
+    iramode = mode ? 1 : -1;
+#else
+    iramode = -1;
+#endif
+}
+
+void setireadahead(int mode)
+{
+    setireadahead_ctx(wfdb_get_default_context(), mode);
+}
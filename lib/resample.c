@@ -0,0 +1,363 @@
+/* file: resample.c	2026
+   Block resampling of input signals (see setifreq).
+
+   When an application has chosen an input sampling frequency (ifreq) that
+   differs from that of the record (sfreq), setifreq finds integers mticks
+   and nticks such that each raw sample interval spans nticks subintervals
+   ("ticks") and each resampled interval spans mticks ticks.  getvec then
+   produces one resampled vector at a time, by linear interpolation between
+   the two most recent raw vectors.
+
+   This file provides the engines used by getvecs to resample a block of
+   vectors at once:
+
+   - rslgetvecs reproduces getvec's linear interpolation exactly, sharing
+     its state (gv0, gv1, gvtime, and rgvtime), so that calls of getvec and
+     getvecs can be mixed freely.  Raw vectors are read in blocks by
+     rgetvecs rather than one at a time, and the interpolation phase of each
+     output is tracked incrementally rather than found by a 64-bit modulus.
+     If the raw frequency is an integer multiple of the resampled frequency
+     (nticks == 1), the phase is always zero, and each output vector is
+     simply copied from its raw vector.
+
+   - rsfgetvecs is used instead (by both getvec and getvecs) if a polyphase
+     FIR filter has been selected by setiresamp.  The filter is a windowed
+     sinc whose cutoff is the lower of the raw and resampled Nyquist
+     frequencies, so that decimation does not alias.  Its coefficients are
+     computed once by setifreq, in fixed point, as a table of nticks phases;
+     each phase is normalized so that its coefficients sum to exactly 1.0,
+     and the filter therefore passes constant signals unchanged.  Raw
+     samples are kept per signal (planar) so that the inner product for each
+     output is a contiguous loop that the compiler can vectorize.
+*/
+
+#include "signal_internal.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
+
+#define RS_BLK		256	/* raw vectors read at once */
+#define RS_Q		20	/* fraction bits in FIR coefficients */
+#define RS_ZEROS	8	/* zero crossings on each side of the sinc */
+#define RS_MAXCOEF	(1L<<20)/* maximum size of the FIR coefficient table */
+
+struct rsfir {			/* polyphase FIR resampler state */
+    long L, M;			/* raw and resampled intervals, in ticks */
+    long dq, dr;		/* M/L and M%L */
+    int half;			/* taps on each side of an output */
+    int ntaps;			/* taps per phase (2*half) */
+    int nsig;			/* number of signals */
+    int *coef;			/* ntaps coefficients for each of L phases */
+    int cap;			/* samples allocated for each signal in x */
+    WFDB_Sample *x;		/* raw samples, cap for each signal */
+    WFDB_Sample *v;		/* raw vectors, as read by rgetvecs */
+    int nx;			/* number of samples of each signal in x */
+    int last;			/* index in x of the last raw sample (INT_MAX
+				   until the end of the input is reached) */
+    long n0;			/* index in x of the latest raw sample at or
+				   before the next output */
+    long ph;			/* phase of the next output (0 to L-1) */
+    int stat;			/* 1, or status at the end of the input */
+};
+
+/* rsfdesign: compute the coefficient table of f.  The prototype filter is
+   sinc(fc*t)*fc, windowed by a Blackman window that spans half raw samples
+   on each side, where t is in raw sample intervals and fc is the ratio of the
+   cutoff to the raw Nyquist frequency. */
+static void rsfdesign(struct rsfir *f)
+{
+    double fc = (f->L >= f->M) ? 1.0 : (double)f->L / f->M, h, t, u;
+    int *c, j, jmax, sum;
+    long p;
+
+    for (p = 0; p < f->L; p++) {
+	c = f->coef + p * f->ntaps;
+	for (j = sum = jmax = 0; j < f->ntaps; j++) {
+	    t = (j - (f->half - 1)) - (double)p / f->L;
+	    u = t / f->half;
+	    if (u <= -1.0 || u >= 1.0)
+		h = 0.0;
+	    else {
+		h = (t == 0.0) ? fc : sin(M_PI * fc * t) / (M_PI * t);
+		h *= 0.42 + 0.5 * cos(M_PI * u) + 0.08 * cos(2.0 * M_PI * u);
+	    }
+	    c[j] = (int)floor(h * (1 << RS_Q) + 0.5);
+	    sum += c[j];
+	    if (c[j] > c[jmax]) jmax = j;
+	}
+	/* Make the coefficients of this phase sum to exactly 1. */
+	c[jmax] += (1 << RS_Q) - sum;
+    }
+}
+
+/* rsfinit: set up the FIR resampler, if one has been selected (rsfilter > 0)
+   and the ratio of frequencies allows it.  Any samples read previously are
+   discarded.  The first output is taken at phase ph (0 to nticks-1) of the
+   raw interval that begins with the raw sample following the next back raw
+   samples to be read (see rsfhist).  The value returned is 1
+   if the FIR resampler will be used, or 0 otherwise (in which case
+   resampling is by linear interpolation). */
+int rsfinit(WFDB_Context *ctx, long back, long ph)
+{
+    struct rsfir *f = rsf;
+    double half = (nticks >= mticks) ? RS_ZEROS :
+	ceil((double)RS_ZEROS * mticks / nticks);
+
+    /* Very large coefficient tables are needed only for unusual ratios of
+       frequencies (such as 1000:999);  these are resampled by linear
+       interpolation instead. */
+    if (rsfilter <= 0 || nvsig <= 0 || 2 * half * nticks > RS_MAXCOEF) {
+	rsffree(ctx);
+	return (0);
+    }
+    if (f == NULL || f->L != nticks || f->M != mticks || f->nsig != nvsig) {
+	rsffree(ctx);
+	SUALLOC(f, 1, sizeof(struct rsfir));
+	f->L = nticks;
+	f->M = mticks;
+	f->dq = f->M / f->L;
+	f->dr = f->M % f->L;
+	f->half = (int)half;
+	f->ntaps = 2 * f->half;
+	f->nsig = nvsig;
+	f->cap = f->ntaps + f->half + RS_BLK;
+	SUALLOC(f->coef, f->L * f->ntaps, sizeof(int));
+	SUALLOC(f->x, f->nsig * f->cap, sizeof(WFDB_Sample));
+	SUALLOC(f->v, f->nsig * RS_BLK, sizeof(WFDB_Sample));
+	rsfdesign(f);
+	rsf = f;
+    }
+    /* The first raw sample is read into x[half-1];  the positions before
+       it are filled with copies of it when it is read (see rsfill). */
+    f->nx = f->half - 1;
+    f->n0 = f->nx + back;
+    f->last = INT_MAX;
+    f->ph = ph;
+    f->stat = 1;
+    return (1);
+}
+
+/* rsfhist: return the number of raw samples that precede each output within
+   the window of the FIR resampler, or 0 if it is not in use.  isgsettime
+   begins reading this many samples early, so that the outputs that follow a
+   seek are the same as those of a sequential read. */
+long rsfhist(WFDB_Context *ctx)
+{
+    return (rsf ? rsf->half - 1 : 0);
+}
+
+void rsffree(WFDB_Context *ctx)
+{
+    if (rsf) {
+	SFREE(rsf->coef);
+	SFREE(rsf->x);
+	SFREE(rsf->v);
+	SFREE(rsf);
+    }
+}
+
+/* rsfill: discard the raw samples that precede the window of the next
+   output (reading and discarding any that have not yet been read, if the
+   resampled interval is long), and read as many more as will fit.  At the
+   end of the input, the remainder of x is filled with copies of the last raw
+   sample, so that the final outputs can be calculated.  The value returned
+   is 0 if no more samples can be read, and 1 otherwise. */
+static int rsfill(WFDB_Context *ctx, struct rsfir *f)
+{
+    WFDB_Sample *xs;
+    long skip = 0, start = f->n0 - f->half + 1;
+    int first = (f->nx < f->half), i, m, n, s;
+
+    if (f->stat <= 0)
+	return (0);
+    if (start > f->nx) {
+	skip = start - f->nx;
+	start = f->nx;
+    }
+    if (start > 0) {
+	for (s = 0, xs = f->x; s < f->nsig; s++, xs += f->cap)
+	    memmove(xs, xs + start, (f->nx - start) * sizeof(WFDB_Sample));
+	f->nx -= start;
+	f->n0 -= start;
+    }
+    f->n0 -= skip;
+    while (skip > 0) {
+	m = (skip > RS_BLK) ? RS_BLK : skip;
+	if ((n = rgetvecs(ctx, f->v, m)) < m) {
+	    f->stat = (n < 0) ? n : -1;
+	    return (0);
+	}
+	skip -= n;
+    }
+    m = f->cap - f->half - f->nx;
+    if (m > RS_BLK) m = RS_BLK;
+    n = rgetvecs(ctx, f->v, m);
+    if (n > 0) {
+	for (s = 0, xs = f->x + f->nx; s < f->nsig; s++, xs += f->cap)
+	    for (i = 0; i < n; i++)
+		xs[i] = f->v[i*f->nsig + s];
+	if (first)
+	    for (s = 0, xs = f->x; s < f->nsig; s++, xs += f->cap)
+		for (i = 0; i < f->nx; i++)
+		    xs[i] = xs[f->nx];
+	f->nx += n;
+    }
+    if (n < m) {	/* end of input, or error */
+	f->stat = (n < 0) ? n : -1;
+	if (first && n <= 0)
+	    return (0);
+	f->last = f->nx - 1;
+	for (s = 0, xs = f->x; s < f->nsig; s++, xs += f->cap)
+	    for (i = f->nx; i < f->cap; i++)
+		xs[i] = xs[f->last];
+	f->nx = f->cap;
+    }
+    return (1);
+}
+
+/* rsfgetvecs: read up to n vectors resampled by the FIR resampler.  The
+   value returned is as for getvecs.  An output is WFDB_INVALID_SAMPLE if
+   any raw sample within its window is invalid. */
+long rsfgetvecs(WFDB_Context *ctx, WFDB_Sample *vector, long n)
+{
+    struct rsfir *f = rsf;
+    const WFDB_Sample *xp;
+    const int *c;
+    WFDB_Time acc;
+    long k;
+    int bad, j, s;
+
+    for (k = 0; k < n; k++, vector += f->nsig) {
+	while (f->n0 + f->half >= f->nx && rsfill(ctx, f))
+	    ;
+	if (f->n0 + f->half >= f->nx || f->n0 > f->last)
+	    break;		/* beyond the last raw sample */
+	c = f->coef + f->ph * f->ntaps;
+	xp = f->x + f->n0 - f->half + 1;
+	for (s = 0; s < f->nsig; s++, xp += f->cap) {
+	    acc = (WFDB_Time)1 << (RS_Q - 1);
+	    bad = 0;
+	    for (j = 0; j < f->ntaps; j++) {
+		acc += (WFDB_Time)c[j] * xp[j];
+		bad |= (xp[j] == WFDB_INVALID_SAMPLE);
+	    }
+	    acc >>= RS_Q;
+	    if (bad)
+		vector[s] = WFDB_INVALID_SAMPLE;
+	    else if (acc > WFDB_SAMPLE_MAX)
+		vector[s] = WFDB_SAMPLE_MAX;
+	    else if (acc < WFDB_SAMPLE_MIN)
+		vector[s] = WFDB_SAMPLE_MIN;
+	    else
+		vector[s] = (WFDB_Sample)acc;
+	}
+	f->n0 += f->dq;
+	if ((f->ph += f->dr) >= f->L) {
+	    f->ph -= f->L;
+	    f->n0++;
+	}
+    }
+    rgvstat = (k > 0) ? (int)nisig : f->stat;
+    return ((k > 0 || f->stat >= 0) ? k : f->stat);
+}
+
+/* rslgetvecs: read up to n vectors resampled by linear interpolation, as by
+   the same number of calls to getvec.  Raw vectors are read into rsbuf, of
+   which the first nvsig samples hold a copy of gv1;  p0 and p1 then take the
+   place of gv0 and gv1 in getvec, and their contents are copied back to gv0
+   and gv1 before returning.  The value returned is as for getvecs. */
+long rslgetvecs(WFDB_Context *ctx, WFDB_Sample *vector, long n)
+{
+    WFDB_Sample *p0, *p1, *pe;
+    WFDB_Time ph, tlast;
+    long k = 0, m;
+    int i, nsig = nvsig;
+
+    if (rsbuflen < (RS_BLK + 1) * nsig) {
+	SREALLOC(rsbuf, (RS_BLK + 1) * nsig, sizeof(WFDB_Sample));
+	rsbuflen = (RS_BLK + 1) * nsig;
+    }
+    p0 = gv0;
+    p1 = pe = rsbuf;
+    (void)memcpy(p1, gv1, nsig * sizeof(WFDB_Sample));
+    while (k < n) {
+	if (rgvtime > mnticks) {
+	    rgvtime -= mnticks;
+	    gvtime  -= mnticks;
+	}
+	/* Read the raw vectors needed for the remaining outputs (all of
+	   them, if they fit in rsbuf). */
+	if (gvtime > rgvtime) {
+	    if (p0 != gv0) {
+		(void)memcpy(gv0, p0, nsig * sizeof(WFDB_Sample));
+		p0 = gv0;
+	    }
+	    (void)memcpy(rsbuf, p1, nsig * sizeof(WFDB_Sample));
+	    p1 = rsbuf;
+	    tlast = gvtime + (WFDB_Time)(n - k - 1) * mticks;
+	    m = (long)((tlast - rgvtime + nticks - 1) / nticks);
+	    if (m > RS_BLK) m = RS_BLK;
+	    if ((m = rgetvecs(ctx, rsbuf + nsig, m)) <= 0) {
+		rgvstat = (int)m;
+		break;
+	    }
+	    rgvstat = (int)nisig;
+	    pe = rsbuf + m * nsig;
+	}
+	/* Produce outputs until another raw vector is needed. */
+	for ( ; k < n; k++, vector += nsig) {
+	    while (gvtime > rgvtime) {
+		if (p1 == pe)
+		    break;
+		p0 = p1;
+		p1 += nsig;
+		rgvtime += nticks;
+	    }
+	    if (gvtime > rgvtime)
+		break;
+	    /* rgvtime is a multiple of nticks, and gvtime is within the
+	       preceding raw interval, so this is gvtime % nticks. */
+	    if ((ph = gvtime - (rgvtime - nticks)) == nticks)
+		ph = 0;
+	    if (ph == 0)
+		(void)memcpy(vector, p0, nsig * sizeof(WFDB_Sample));
+	    else
+		for (i = 0; i < nsig; i++)
+		    vector[i] = p0[i] + ph*(p1[i]-p0[i])/nticks;
+	    p0 = p1;
+	    gvtime += mticks;
+	}
+    }
+    if (p0 != gv0)
+	(void)memcpy(gv0, p0, nsig * sizeof(WFDB_Sample));
+    (void)memcpy(gv1, p1, nsig * sizeof(WFDB_Sample));
+    return ((k > 0 || rgvstat >= 0) ? k : rgvstat);
+}
+
+/* Function setiresamp selects the method by which getvec and getvecs
+resample the input signals when setifreq has been used to choose an input
+sampling frequency other than that of the record.  If mode is WFDB_RSLINEAR,
+samples are linearly interpolated between the nearest raw samples, as in
+earlier versions of the library.  If mode is WFDB_RSFIR, samples are
+calculated by a polyphase FIR (windowed sinc) filter, which also removes the
+frequencies above the Nyquist frequency of the resampled signals.  If mode is
+negative, the method is taken from the environment variable WFDBRESAMP (0:
+linear, 1: FIR), or is linear if WFDBRESAMP is not set.  The method takes
+effect at the next call of setifreq. */
+
+void setiresamp_ctx(WFDB_Context *ctx, int mode)
+{
+    if (mode < 0) {
+	char *p;
+
+	mode = (p = getenv("WFDBRESAMP")) ? strtol(p, NULL, 10) : 0;
+    }
+    rsfilter = (mode == WFDB_RSFIR) ? 1 : -1;
+}
+
+void setiresamp(int mode)
+{
+    setiresamp_ctx(wfdb_get_default_context(), mode);
+}
@@ -0,0 +1,249 @@
+/* file: segprefetch.c	2026
+   Background prefetching of the segments of multi-segment records.
+
+   When a multi-segment record is read sequentially, getvec opens the next
+   segment only when the current one is exhausted, and must then wait while
+   its header is found and parsed and its signal files are opened and read.
+   For remote records, or local ones that are not already in the page cache,
+   this can take hundreds of milliseconds per segment.  If prefetching is
+   enabled (see setsegprefetch), a thread does this work for the next
+   segment while the current one is being read, so that switching segments
+   requires only taking over the results.
+*/
+
+#include "signal_internal.h"
+
+#ifdef WFDB_THREADS
+#include <pthread.h>
+
+/* The prefetching thread works in a private context, so that it does not
+   disturb the state of the caller's context.  Once the thread has been
+   joined, the header that it parsed is moved into the caller's header cache
+   (see readheader), and the signal files that it opened are handed to
+   isigopen by segfopen. */
+
+struct pffile {
+    char *fname;		/* signal file name, as given in the header */
+    WFDB_FILE *fp;		/* file opened by the prefetching thread */
+};
+
+struct segprefetch {
+    WFDB_Context *pctx;		/* context used by the prefetching thread */
+    pthread_t thread;		/* the prefetching thread */
+    int busy;			/* 1 if the thread has not yet been joined */
+    int ready;			/* 1 if the files are available to isigopen */
+    char recname[WFDB_MAXRNL+1];/* name of the segment being prefetched */
+    char irec[WFDB_MAXRNL+1];	/* current record name when started */
+    unsigned path_gen;		/* WFDB path generation when started */
+    long bufsize;		/* input buffer size (see setibsize) */
+    struct pffile *file;	/* signal files opened by the thread */
+    unsigned nfile;		/* number of entries in file */
+    unsigned maxfile;		/* number of entries allocated in file */
+};
+
+/* The prefetching thread.  Within this function, ctx is the private
+   context, and the macros defined in signal_internal.h refer to it. */
+static void *segprefetch_run(void *arg)
+{
+    struct segprefetch *pf = arg;
+    WFDB_Context *ctx = pf->pctx;
+    char *buf = NULL;
+    int n, s;
+
+    in_msrec = 1;
+    if ((n = readheader(ctx, pf->recname)) > 0 &&
+	pf->maxfile < (unsigned)n) {
+	SREALLOC(pf->file, n, sizeof(struct pffile));
+	pf->maxfile = n;
+    }
+    for (s = 0; s < n; s++) {
+	struct hsdata *hs = hsd[s];
+	WFDB_FILE *fp;
+	long len;
+
+	/* Open the file for each signal group once. */
+	if (hs->info.fmt == 0 || strcmp(hs->info.fname, "-") == 0 ||
+	    (s > 0 && hs->info.group == hsd[s-1]->info.group))
+	    continue;
+	if ((fp = wfdb_open_ctx(ctx, hs->info.fname, NULL, WFDB_READ)) ==
+	    NULL)
+	    continue;
+
+	/* Read the first buffer of samples, then rewind the file.  Local
+	   data remain in the system's page cache, and remote data in the
+	   netfile's page cache, until isigopen reads them. */
+	if (hs->info.bsize >= 0) {
+	    len = (hs->info.bsize > 0) ? hs->info.bsize : pf->bufsize;
+	    SALLOC(buf, 1, len);
+	    if (wfdb_fseek(fp, hs->start, SEEK_SET) == 0)
+		(void)wfdb_fread(buf, 1, len, fp);
+	    (void)wfdb_fseek(fp, 0L, SEEK_SET);
+	}
+	pf->file[pf->nfile].fname = NULL;
+	SSTRCPY(pf->file[pf->nfile].fname, hs->info.fname);
+	pf->file[pf->nfile++].fp = fp;
+    }
+    SFREE(buf);
+    in_msrec = 0;
+    isigclose(ctx);		/* close the header, free hsd */
+    return (NULL);
+}
+
+/* Wait for the prefetching thread to finish, if it is running. */
+static void segprefetch_join(struct segprefetch *pf)
+{
+    if (pf->busy) {
+	(void)pthread_join(pf->thread, NULL);
+	pf->busy = 0;
+    }
+}
+
+/* Close any prefetched files that isigopen did not take. */
+static void segprefetch_clear(struct segprefetch *pf)
+{
+    while (pf->nfile > 0) {
+	struct pffile *f = &pf->file[--pf->nfile];
+
+	SFREE(f->fname);
+	if (f->fp) (void)wfdb_fclose(f->fp);
+    }
+    pf->ready = 0;
+}
+
+/* Function setsegprefetch enables (if mode is positive) or disables (if mode
+is zero) prefetching of the segments of multi-segment records.  If mode is
+negative, prefetching is enabled only if the environment variable
+WFDBPREFETCH is set to a positive integer. */
+
+void setsegprefetch_ctx(WFDB_Context *ctx, int mode)
+{
+    struct segprefetch *pf = ctx->segpf;
+
+    if (mode < 0) {
+	char *p;
+
+	mode = ((p = getenv("WFDBPREFETCH")) && strtol(p, NULL, 10) > 0);
+    }
+    if (mode && pf == NULL) {
+	SUALLOC(pf, 1, sizeof(struct segprefetch));
+	if ((pf->pctx = wfdb_context_new()) == NULL) {
+	    SFREE(pf);
+	    return;
+	}
+	pf->pctx->error_print = 0;	/* errors are reported by isigopen */
+	sethcache_ctx(pf->pctx, 1);
+	ctx->segpf = pf;
+    }
+    else if (!mode && pf)
+	segprefetchfree(ctx);
+    ctx->segpfmode = mode ? 1 : -1;
+}
+
+/* Start prefetching the named segment. */
+void segprefetch(WFDB_Context *ctx, const char *record)
+{
+    struct segprefetch *pf;
+
+    if (ctx->segpfmode == 0) setsegprefetch_ctx(ctx, -1);
+    if ((pf = ctx->segpf) == NULL || *record == '~')
+	return;
+    segprefetch_join(pf);
+    segprefetch_clear(pf);
+    hcachefree(pf->pctx);
+    (void)strcpy(pf->recname, record);
+    (void)strcpy(pf->irec, ctx->irec);
+    wfdb_copy_path_ctx(pf->pctx, ctx);
+    pf->path_gen = ctx->wfdb_path_gen;
+    pf->bufsize = (ibsize > 0) ? ibsize : BUFSIZ;
+    if (pthread_create(&pf->thread, NULL, segprefetch_run, pf) == 0)
+	pf->busy = 1;
+}
+
+/* Prepare to open the named segment.  If it is the one being prefetched,
+   wait for the prefetching thread, and take over its results;  otherwise,
+   discard them. */
+void segadopt(WFDB_Context *ctx, const char *record)
+{
+    struct segprefetch *pf = ctx->segpf;
+    unsigned i;
+
+    if (pf == NULL || (!pf->busy && pf->nfile == 0))
+	return;
+    segprefetch_join(pf);
+    if (strcmp(record, pf->recname) || strcmp(ctx->irec, pf->irec) ||
+	ctx->wfdb_path_gen != pf->path_gen) {
+	segprefetch_clear(pf);
+	hcachefree(pf->pctx);
+	return;
+    }
+    hcachemove(ctx, pf->pctx, pf->path_gen);
+    for (i = 0; i < pf->nfile; i++)
+	if (pf->file[i].fp)	/* NULL if already taken by segfopen */
+	    wfdb_fsetctx(pf->file[i].fp, ctx);
+    pf->ready = 1;
+}
+
+/* Return the prefetched file for the named signal file, or NULL if there is
+   none (in which case isigopen opens the file itself). */
+WFDB_FILE *segfopen(WFDB_Context *ctx, const char *fname)
+{
+    struct segprefetch *pf = ctx->segpf;
+    unsigned i;
+
+    if (pf == NULL || !pf->ready)
+	return (NULL);
+    for (i = 0; i < pf->nfile; i++)
+	if (pf->file[i].fp && strcmp(pf->file[i].fname, fname) == 0) {
+	    WFDB_FILE *fp = pf->file[i].fp;
+
+	    pf->file[i].fp = NULL;
+	    return (fp);
+	}
+    return (NULL);
+}
+
+void segprefetchfree(WFDB_Context *ctx)
+{
+    struct segprefetch *pf = ctx->segpf;
+
+    if (pf) {
+	segprefetch_join(pf);
+	segprefetch_clear(pf);
+	SFREE(pf->file);
+	wfdb_sigclose_ctx(pf->pctx);
+	wfdb_context_free(pf->pctx);
+	SFREE(pf);
+	ctx->segpf = NULL;
+    }
+}
+
+#else	/* !WFDB_THREADS: segments are opened only when needed */
+
+void setsegprefetch_ctx(WFDB_Context *ctx, int mode)
+{
+    ctx->segpfmode = -1;
+}
+
+void segprefetch(WFDB_Context *ctx, const char *record)
+{
+}
+
+void segadopt(WFDB_Context *ctx, const char *record)
+{
+}
+
+WFDB_FILE *segfopen(WFDB_Context *ctx, const char *fname)
+{
+    return (NULL);
+}
+
+void segprefetchfree(WFDB_Context *ctx)
+{
+}
+
+#endif
+
+void setsegprefetch(int mode)
+{
+    setsegprefetch_ctx(wfdb_get_default_context(), mode);
+}
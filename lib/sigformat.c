@@ -3,9 +3,8 @@
 
 /* r212: read and return the next sample from a format 212 signal file
    (2 12-bit samples bit-packed in 3 bytes) */
-static int r212(struct igdata *g)
+static int r212(WFDB_Context *ctx, struct igdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int v;
 
     /* Obtain the next 12-bit value right-justified in v. */
@@ -22,9 +21,8 @@ static int r212(struct igdata *g)
 }
 
 /* w212: write the next sample to a format 212 signal file */
-void w212(WFDB_Sample v, struct ogdata *g)
+void w212(WFDB_Context *ctx, WFDB_Sample v, struct ogdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     /* Samples are buffered here and written in pairs, as three bytes. */
     switch (g->count++) {
       case 0:	g->data = v & 0xfff; break;
@@ -37,9 +35,8 @@ void w212(WFDB_Sample v, struct ogdata *g)
 }
 
 /* f212: flush output to a format 212 signal file */
-void f212(struct ogdata *g)
+void f212(WFDB_Context *ctx, struct ogdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     /* If we have one leftover sample, write it as two bytes. */
     if (g->count == 1) {
 	w16(g->data, g);
@@ -49,9 +46,8 @@ void f212(struct ogdata *g)
 
 /* r310: read and return the next sample from a format 310 signal file
    (3 10-bit samples bit-packed in 4 bytes) */
-static int r310(struct igdata *g)
+static int r310(WFDB_Context *ctx, struct igdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int v;
 
     /* Obtain the next 10-bit value right-justified in v. */
@@ -70,9 +66,8 @@ static int r310(struct igdata *g)
 }
 
 /* w310: write the next sample to a format 310 signal file */
-void w310(WFDB_Sample v, struct ogdata *g)
+void w310(WFDB_Context *ctx, WFDB_Sample v, struct ogdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     /* Samples are buffered here and written in groups of three, as two
        left-justified 15-bit words. */
     switch (g->count++) {
@@ -87,9 +82,8 @@ void w310(WFDB_Sample v, struct ogdata *g)
 }
 
 /* f310: flush output to a format 310 signal file */
-void f310(struct ogdata *g)
+void f310(WFDB_Context *ctx, struct ogdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     switch (g->count) {
       case 0:  break;
       /* If we have one leftover sample, write it as two bytes. */
@@ -110,9 +104,8 @@ void f310(struct ogdata *g)
 /* r311: read and return the next sample from a format 311 signal file
    (3 10-bit samples bit-packed in 4 bytes; note that formats 310 and 311
    differ in the layout of the bit-packed data) */
-static int r311(struct igdata *g)
+static int r311(WFDB_Context *ctx, struct igdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int v;
 
     /* Obtain the next 10-bit value right-justified in v. */
@@ -133,9 +126,8 @@ static int r311(struct igdata *g)
 }
 
 /* w311: write the next sample to a format 311 signal file */
-void w311(WFDB_Sample v, struct ogdata *g)
+void w311(WFDB_Context *ctx, WFDB_Sample v, struct ogdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     /* Samples are buffered here and written in groups of three, bit-packed
        into the 30 low bits of a 32-bit word. */
     switch (g->count++) {
@@ -150,9 +142,8 @@ void w311(WFDB_Sample v, struct ogdata *g)
 }
 
 /* f311: flush output to a format 311 signal file */
-void f311(struct ogdata *g)
+void f311(WFDB_Context *ctx, struct ogdata *g)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     switch (g->count) {
       case 0:	break;
       /* If we have one leftover sample, write it as two bytes. */
@@ -172,9 +163,877 @@ void f311(struct ogdata *g)
     }
 }
 
-int isgsetframe(WFDB_Group g, WFDB_Time t)
+/* Frame decoders.  Each of these functions decodes the next n samples of a
+   signal group (one complete frame) directly from the group's input buffer,
+   producing exactly the same values as n successive invocations of the
+   corresponding rN() function or macro.  Since the whole frame is decoded
+   only if it is already present in the buffer, the buffer bounds are checked
+   once per frame rather than once per byte.  If fewer bytes are available, a
+   decoder returns -1 without consuming any input, and the caller falls back
+   on the rN() routines (which refill the buffer and detect the end of the
+   file.)  isgdecoder() selects the decoder for each input signal group when
+   it is opened. */
+
+static int d16(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+
+    if (g->be - g->bp < 2L*n) return (-1);
+    for ( ; n > 0; n--, p += 2)
+	*v++ = (short)(p[0] | (p[1] << 8));
+    g->bp = (char *)p;
+    return (0);
+}
+
+static int d61(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+
+    if (g->be - g->bp < 2L*n) return (-1);
+    for ( ; n > 0; n--, p += 2)
+	*v++ = (short)((p[0] << 8) | p[1]);
+    g->bp = (char *)p;
+    return (0);
+}
+
+static int d80(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+
+    if (g->be - g->bp < (long)n) return (-1);
+    for ( ; n > 0; n--)
+	*v++ = *p++ - (1 << 7);
+    g->bp = (char *)p;
+    return (0);
+}
+
+static int d160(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+
+    if (g->be - g->bp < 2L*n) return (-1);
+    for ( ; n > 0; n--, p += 2)
+	*v++ = (p[0] | (p[1] << 8)) - (1 << 15);
+    g->bp = (char *)p;
+    return (0);
+}
+
+static int d24(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+
+    if (g->be - g->bp < 3L*n) return (-1);
+    for ( ; n > 0; n--, p += 3)
+	*v++ = ((p[0] | (p[1] << 8) | (p[2] << 16)) ^ 0x800000) - 0x800000;
+    g->bp = (char *)p;
+    return (0);
+}
+
+static int d32(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+
+    if (g->be - g->bp < 4L*n) return (-1);
+    for ( ; n > 0; n--, p += 4)
+	*v++ = (int)(p[0] | (p[1] << 8) | (p[2] << 16) |
+		     ((unsigned)p[3] << 24));
+    g->bp = (char *)p;
+    return (0);
+}
+
+/* In format 212, a frame with an odd number of samples ends in the middle of
+   a 3-byte pair;  g->count and g->data carry the state across frames just as
+   they do for r212(). */
+static int d212(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+    unsigned m = n - g->count;
+
+    if (g->be - g->bp < (long)(g->count + 3*(m/2) + 2*(m&1))) return (-1);
+    if (g->count && n > 0) {
+	*v++ = ((((g->data >> 4) & 0xf00) | *p++) ^ 0x800) - 0x800;
+	g->count = 0;
+	n--;
+    }
+    if (n >= 16) {	/* long frame:  unpack its complete units at once */
+	m = n & ~1U;
+	(void)unpack212(p, v, m);
+	p += 3*(m/2);
+	v += m;
+	n -= m;
+    }
+    for ( ; n >= 2; n -= 2, p += 3) {
+	*v++ = ((p[0] | ((p[1] & 0x0f) << 8)) ^ 0x800) - 0x800;
+	*v++ = ((p[2] | ((p[1] & 0xf0) << 4)) ^ 0x800) - 0x800;
+    }
+    if (n) {
+	g->data = (short)(p[0] | (p[1] << 8));
+	g->count = 1;
+	*v = ((g->data & 0xfff) ^ 0x800) - 0x800;
+	p += 2;
+    }
+    g->bp = (char *)p;
+    return (0);
+}
+
+/* d212x2: format 212 with two samples per frame, the most common layout */
+static int d212x2(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+
+    (void)n;	/* always 2 */
+    if (g->be - g->bp < 3) return (-1);
+    v[0] = ((p[0] | ((p[1] & 0x0f) << 8)) ^ 0x800) - 0x800;
+    v[1] = ((p[2] | ((p[1] & 0xf0) << 4)) ^ 0x800) - 0x800;
+    g->bp += 3;
+    return (0);
+}
+
+/* In formats 310 and 311, each group of three samples occupies four bytes.
+   Complete groups that begin at a frame boundary are unpacked together;  a
+   frame that does not begin or end on a group boundary is handled one
+   sample at a time at its edges, with g->count, g->data and g->datb holding
+   the partially-decoded group as in r310() and r311(). */
+static int d310(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+    unsigned c = g->count, i, need = 4*(n/3);
+    int x;
+
+    for (i = 0; i < n%3; i++)
+	if ((c + i) % 3 != 2) need += 2;
+    if (g->be - g->bp < (long)need) return (-1);
+    if (c == 0 && n >= 24) {	/* long frame:  unpack complete units */
+	i = n - n%3;
+	(void)unpack310(p, v, i);
+	p += 4*(i/3);
+	v += i;
+	n -= i;
+    }
+    for ( ; n > 0; n--) {
+	if (c == 0 && n >= 3) {
+	    unsigned w0 = p[0] | (p[1] << 8), w1 = p[2] | (p[3] << 8);
+
+	    *v++ = (((w0 >> 1) & 0x3ff) ^ 0x200) - 0x200;
+	    *v++ = (((w1 >> 1) & 0x3ff) ^ 0x200) - 0x200;
+	    x = (w0 >> 11) | ((w1 >> 11) << 5);
+	    p += 4;
+	    n -= 2;
+	}
+	else switch (c) {
+	  case 0:	x = (g->data = (short)(p[0] | (p[1] << 8))) >> 1;
+			p += 2; c = 1; break;
+	  case 1:	x = (g->datb = (short)(p[0] | (p[1] << 8))) >> 1;
+			p += 2; c = 2; break;
+	  default:	x = ((g->data & 0xf800) >> 11) | ((g->datb & 0xf800) >> 6);
+			c = 0; break;
+	}
+	*v++ = ((x & 0x3ff) ^ 0x200) - 0x200;
+    }
+    g->count = c;
+    g->bp = (char *)p;
+    return (0);
+}
+
+static int d311(struct igdata *g, WFDB_Sample *v, unsigned n)
+{
+    const unsigned char *p = (const unsigned char *)g->bp;
+    unsigned c = g->count, i, need = 4*(n/3);
+    int x;
+
+    for (i = 0; i < n%3; i++)
+	need += ((c + i) % 3 == 0) ? 2 : 1;
+    if (g->be - g->bp < (long)need) return (-1);
+    if (c == 0 && n >= 24) {	/* long frame:  unpack complete units */
+	i = n - n%3;
+	(void)unpack311(p, v, i);
+	p += 4*(i/3);
+	v += i;
+	n -= i;
+    }
+    for ( ; n > 0; n--) {
+	if (c == 0 && n >= 3) {
+	    unsigned long w = p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16) |
+		((unsigned long)p[3] << 24);
+
+	    *v++ = ((w & 0x3ff) ^ 0x200) - 0x200;
+	    *v++ = (((w >> 10) & 0x3ff) ^ 0x200) - 0x200;
+	    x = w >> 20;
+	    p += 4;
+	    n -= 2;
+	}
+	else switch (c) {
+	  case 0:	x = g->data = (short)(p[0] | (p[1] << 8));
+			p += 2; c = 1; break;
+	  case 1:	g->datb = *p++;
+			x = ((g->data & 0xfc00) >> 10) | ((g->datb & 0xf) << 6);
+			c = 2; break;
+	  default:	g->datb |= *p++ << 8;
+			x = g->datb >> 4;
+			c = 0; break;
+	}
+	*v++ = ((x & 0x3ff) ^ 0x200) - 0x200;
+    }
+    g->count = c;
+    g->bp = (char *)p;
+    return (0);
+}
+
+/* isgdecoder: select the frame decoder for an input signal group of the
+   specified format, containing spf samples per frame in total.  Groups in
+   other formats (0, 8, and the FLAC formats) are read one sample at a time
+   by getskewedframe(). */
+void isgdecoder(struct igdata *ig, int fmt, unsigned spf)
+{
+    ig->spf = spf;
+    ig->decode = NULL;
+    ig->unpack = NULL;
+    ig->bps = 0;
+    if (spf == 0)
+	return;
+    switch (fmt) {
+      case 16:	ig->decode = d16;   ig->invalid = -(1 << 15); ig->bps = 2; break;
+      case 61:	ig->decode = d61;   ig->invalid = -(1 << 15); ig->bps = 2; break;
+      case 80:	ig->decode = d80;   ig->invalid = -(1 << 7);  ig->bps = 1; break;
+      case 160:	ig->decode = d160;  ig->invalid = -(1 << 15); ig->bps = 2; break;
+      case 24:	ig->decode = d24;   ig->invalid = -(1 << 23); ig->bps = 3; break;
+      case 32:	ig->decode = d32;   ig->invalid = INT_MIN;    ig->bps = 4; break;
+      case 212:	ig->decode = (spf == 2) ? d212x2 : d212;
+		ig->invalid = -(1 << 11); break;
+      case 310:	ig->decode = d310;  ig->invalid = -(1 << 9);  break;
+      case 311:	ig->decode = d311;  ig->invalid = -(1 << 9);  break;
+    }
+
+    /* In the bit-packed formats, runs of frames that fill whole units are
+       decoded by the block unpackers. */
+    switch (fmt) {
+      case 212:	ig->unpack = unpack212;
+		ig->ufr = (spf % 2) ? 2 : 1;
+		ig->ubytes = 3 * (spf * ig->ufr / 2);
+		break;
+      case 310:	ig->unpack = unpack310;
+		ig->ufr = (spf % 3) ? 3 : 1;
+		ig->ubytes = 4 * (spf * ig->ufr / 3);
+		break;
+      case 311:	ig->unpack = unpack311;
+		ig->ufr = (spf % 3) ? 3 : 1;
+		ig->ubytes = 4 * (spf * ig->ufr / 3);
+		break;
+    }
+}
+
+/* isgunpack: decode as many as nf frames of signal group ig into v with the
+   group's block unpacker, and return the number of frames decoded.  Only
+   frames that are entirely in the input buffer, and that begin on a unit
+   boundary, are decoded;  their number is a multiple of ig->ufr, so that
+   the group is left on a unit boundary.  *bad is set to 1 if any of the
+   samples is invalid, or to 0 otherwise. */
+static long isgunpack(struct igdata *ig, WFDB_Sample *v, long nf, int *bad)
+{
+    long m;
+
+    if (ig->unpack == NULL || ig->count != 0 || ig->stat <= 0)
+	return (0L);
+    if ((m = (ig->be - ig->bp) / ig->ubytes) > nf / ig->ufr)
+	m = nf / ig->ufr;
+    if (m <= 0)
+	return (0L);
+    *bad = (*ig->unpack)((const unsigned char *)ig->bp, v,
+			 m * ig->ufr * ig->spf);
+    ig->bp += m * ig->ubytes;
+    return (m * ig->ufr);
+}
+
+/* isgselect: record which samples of each frame of input signal group g
+   belong to selected signals (see isigselect).  In the fixed-width formats,
+   the samples of the other signals need not be decoded at all;  isgdecode()
+   decodes each run of selected samples and steps over the rest. */
+void isgselect(WFDB_Context *ctx, WFDB_Group g)
+{
+    struct igdata *ig = igd[g];
+    struct isdata *is;
+    WFDB_Signal s;
+    unsigned i;
+
+    SFREE(ig->run);
+    ig->nrun = ig->nsel = 0;
+    for (s = 0; s < nisig && isd[s]->info.group != g; s++)
+	;
+    for (i = 0; s < nisig && (is = isd[s])->info.group == g; s++) {
+	if (!is->skip) {
+	    if (ig->run == NULL)
+		SALLOC(ig->run, 2*ig->nsig, sizeof(unsigned));
+	    if (ig->nrun > 0 &&
+		ig->run[2*ig->nrun-2] + ig->run[2*ig->nrun-1] == i)
+		ig->run[2*ig->nrun-1] += is->info.spf;
+	    else {
+		ig->run[2*ig->nrun] = i;
+		ig->run[2*ig->nrun+1] = is->info.spf;
+		ig->nrun++;
+	    }
+	    ig->nsel++;
+	}
+	i += is->info.spf;
+    }
+    if (ig->nsel == ig->nsig || ig->bps == 0)
+	SFREE(ig->run);
+}
+
+/* isgdecode: decode the next frame of signal group ig into v, leaving the
+   samples of unselected signals undecoded if the group's run table permits.
+   As for the frame decoders, the return value is -1 if the frame is not
+   entirely in the buffer. */
+static int isgdecode(struct igdata *ig, WFDB_Sample *v)
+{
+    char *p = ig->bp;
+    const unsigned *r;
+    unsigned n;
+
+    if (ig->bps == 0 || ig->nsel == ig->nsig)
+	return ((*ig->decode)(ig, v, ig->spf));
+    if (ig->be - p < (long)ig->bps * ig->spf) return (-1);
+    for (r = ig->run, n = ig->nrun; n > 0; n--, r += 2) {
+	ig->bp = p + ig->bps * r[0];
+	(void)(*ig->decode)(ig, v + r[0], r[1]);
+    }
+    ig->bp = p + ig->bps * ig->spf;
+    return (0);
+}
+
+/* Frame encoders.  These are the output counterparts of the frame decoders
+   above:  each one packs the next n samples of an output signal group (one
+   frame, already converted to the values to be stored) into the group's
+   output buffer, exactly as n successive invocations of the corresponding
+   wN() function or macro would.  An encoder returns -1 without writing
+   anything unless the frame fits in the buffer with at least one byte to
+   spare;  the caller then uses the wN() routines, which flush the buffer
+   when it fills (the spare byte ensures that the buffer is never left full,
+   as wN() would then write past its end). */
+
+static int e8(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+
+    if (g->be - g->bp <= (long)n) return (-1);
+    for ( ; n > 0; n--)
+	*p++ = (char)*v++;
+    g->bp = p;
+    return (0);
+}
+
+static int e16(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+
+    if (g->be - g->bp <= 2L*n) return (-1);
+    if (n >= 16) {	/* long frame:  pack it at once */
+	pack16(v, (unsigned char *)p, n);
+	p += 2*n;
+    }
+    else for ( ; n > 0; n--, v++, p += 2) {
+	p[0] = (char)*v;
+	p[1] = (char)(*v >> 8);
+    }
+    g->bp = p;
+    return (0);
+}
+
+static int e61(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+
+    if (g->be - g->bp <= 2L*n) return (-1);
+    for ( ; n > 0; n--, v++, p += 2) {
+	p[0] = (char)(*v >> 8);
+	p[1] = (char)*v;
+    }
+    g->bp = p;
+    return (0);
+}
+
+static int e80(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+
+    if (g->be - g->bp <= (long)n) return (-1);
+    for ( ; n > 0; n--)
+	*p++ = (char)((*v++ & 0xff) + (1 << 7));
+    g->bp = p;
+    return (0);
+}
+
+static int e160(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+    int x;
+
+    if (g->be - g->bp <= 2L*n) return (-1);
+    for ( ; n > 0; n--, p += 2) {
+	x = (*v++ & 0xffff) + (1 << 15);
+	p[0] = (char)x;
+	p[1] = (char)(x >> 8);
+    }
+    g->bp = p;
+    return (0);
+}
+
+static int e24(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+
+    if (g->be - g->bp <= 3L*n) return (-1);
+    if (n >= 16) {	/* long frame:  pack it at once */
+	pack24(v, (unsigned char *)p, n);
+	p += 3*n;
+    }
+    else for ( ; n > 0; n--, v++, p += 3) {
+	p[0] = (char)*v;
+	p[1] = (char)(*v >> 8);
+	p[2] = (char)(*v >> 16);
+    }
+    g->bp = p;
+    return (0);
+}
+
+static int e32(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+
+    if (g->be - g->bp <= 4L*n) return (-1);
+    for ( ; n > 0; n--, v++, p += 4) {
+	p[0] = (char)*v;
+	p[1] = (char)(*v >> 8);
+	p[2] = (char)(*v >> 16);
+	p[3] = (char)(*v >> 24);
+    }
+    g->bp = p;
+    return (0);
+}
+
+/* As in the frame decoders, g->count and g->data (and g->datb) hold a
+   partially-filled group of bit-packed samples between frames, so that
+   f212(), f310() and f311() can flush it as usual. */
+static int e212(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+    unsigned m = n - g->count;
+
+    if (g->be - g->bp <= (long)(3*(g->count + m/2))) return (-1);
+    if (g->count && n > 0) {
+	p[0] = (char)g->data;
+	p[1] = (char)((g->data >> 8) | ((*v >> 4) & 0xf0));
+	p[2] = (char)*v++;
+	p += 3;
+	g->count = 0;
+	n--;
+    }
+    if (n >= 16) {	/* long frame:  pack its complete units at once */
+	m = n & ~1U;
+	pack212(v, (unsigned char *)p, m);
+	v += m;
+	p += 3*(m/2);
+	n -= m;
+    }
+    for ( ; n >= 2; n -= 2, v += 2, p += 3) {
+	p[0] = (char)v[0];
+	p[1] = (char)(((v[0] >> 8) & 0x0f) | ((v[1] >> 4) & 0xf0));
+	p[2] = (char)v[1];
+    }
+    if (n) {
+	g->data = *v & 0xfff;
+	g->count = 1;
+    }
+    g->bp = p;
+    return (0);
+}
+
+static int e310(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+    unsigned c = g->count, i, need = 4*(n/3);
+
+    for (i = 0; i < n%3; i++)
+	if ((c + i) % 3 == 2) need += 4;
+    if (g->be - g->bp <= (long)need) return (-1);
+    if (c == 0 && n >= 24) {	/* long frame:  pack complete units */
+	i = n - n%3;
+	pack310(v, (unsigned char *)p, i);
+	v += i;
+	p += 4*(i/3);
+	n -= i;
+    }
+    for ( ; n > 0; n--, v++) {
+	if (c == 0 && n >= 3) {
+	    int w0 = ((v[0] << 1) & 0x7fe) | (v[2] << 11);
+	    int w1 = ((v[1] << 1) & 0x7fe) | ((v[2] << 6) & 0xf800);
+
+	    p[0] = (char)w0; p[1] = (char)(w0 >> 8);
+	    p[2] = (char)w1; p[3] = (char)(w1 >> 8);
+	    p += 4;
+	    v += 2;
+	    n -= 2;
+	}
+	else switch (c) {
+	  case 0:	g->data = (*v << 1) & 0x7fe; c = 1; break;
+	  case 1:	g->datb = (*v << 1) & 0x7fe; c = 2; break;
+	  default:	g->data |= (*v << 11);
+			g->datb |= ((*v << 6) & ~0x7fe);
+			p[0] = (char)g->data; p[1] = (char)(g->data >> 8);
+			p[2] = (char)g->datb; p[3] = (char)(g->datb >> 8);
+			p += 4;
+			c = 0; break;
+	}
+    }
+    g->count = c;
+    g->bp = p;
+    return (0);
+}
+
+static int e311(struct ogdata *g, const WFDB_Sample *v, unsigned n)
+{
+    char *p = g->bp;
+    unsigned c = g->count, i, need = 4*(n/3);
+
+    for (i = 0; i < n%3; i++)
+	if ((c + i) % 3 != 0) need += 2;
+    if (g->be - g->bp <= (long)need) return (-1);
+    if (c == 0 && n >= 24) {	/* long frame:  pack complete units */
+	i = n - n%3;
+	pack311(v, (unsigned char *)p, i);
+	v += i;
+	p += 4*(i/3);
+	n -= i;
+    }
+    for ( ; n > 0; n--, v++) {
+	if (c == 0 && n >= 3) {
+	    unsigned long w = (v[0] & 0x3ff) | ((unsigned long)(v[1] & 0x3ff) << 10)
+		| ((unsigned long)(v[2] & 0x3ff) << 20);
+
+	    p[0] = (char)w; p[1] = (char)(w >> 8);
+	    p[2] = (char)(w >> 16); p[3] = (char)(w >> 24);
+	    p += 4;
+	    v += 2;
+	    n -= 2;
+	}
+	else switch (c) {
+	  case 0:	g->data = *v & 0x3ff; c = 1; break;
+	  case 1:	g->data |= (*v << 10);
+			p[0] = (char)g->data; p[1] = (char)(g->data >> 8);
+			p += 2;
+			g->datb = (*v >> 6) & 0xf;
+			c = 2; break;
+	  default:	g->datb |= (*v << 4);
+			g->datb &= 0x3fff;
+			p[0] = (char)g->datb; p[1] = (char)(g->datb >> 8);
+			p += 2;
+			c = 0; break;
+	}
+    }
+    g->count = c;
+    g->bp = p;
+    return (0);
+}
+
+/* osgencoder: select the frame encoder for an output signal group of the
+   specified format.  Groups in format 0 (and in the FLAC formats, if the
+   library is built without FLAC support) are written one sample at a time
+   by putvec().  The encoder for the FLAC formats (flac_encode) is defined
+   in flac.c.  Groups in formats 16, 24, 212, 310 and 311 also have a block
+   packer, which putvecs() uses to encode many frames at once. */
+void osgencoder(struct ogdata *og, int fmt)
+{
+    switch (fmt) {
+      case 8:	og->encode = e8;    og->invalid = -(1 << 15); break;
+      case 16:	og->encode = e16;   og->invalid = -(1 << 15); break;
+      case 61:	og->encode = e61;   og->invalid = -(1 << 15); break;
+      case 80:	og->encode = e80;   og->invalid = -(1 << 7);  break;
+      case 160:	og->encode = e160;  og->invalid = -(1 << 15); break;
+      case 24:	og->encode = e24;   og->invalid = -(1 << 23); break;
+      case 32:	og->encode = e32;   og->invalid = INT_MIN;    break;
+      case 212:	og->encode = e212;  og->invalid = -(1 << 11); break;
+      case 310:	og->encode = e310;  og->invalid = -(1 << 9);  break;
+      case 311:	og->encode = e311;  og->invalid = -(1 << 9);  break;
+#ifdef WFDB_FLAC_SUPPORT
+      case 508:	og->encode = flac_encode; og->invalid = -(1 << 7);  break;
+      case 516:	og->encode = flac_encode; og->invalid = -(1 << 15); break;
+      case 524:	og->encode = flac_encode; og->invalid = -(1 << 23); break;
+#endif
+      default:	og->encode = NULL;  break;
+    }
+
+    og->pack = NULL;
+    switch (fmt) {
+      case 16:	og->pack = pack16;  og->unsamp = 1; og->unbytes = 2; break;
+      case 24:	og->pack = pack24;  og->unsamp = 1; og->unbytes = 3; break;
+      case 212:	og->pack = pack212; og->unsamp = 2; og->unbytes = 3; break;
+      case 310:	og->pack = pack310; og->unsamp = 3; og->unbytes = 4; break;
+      case 311:	og->pack = pack311; og->unsamp = 3; og->unbytes = 4; break;
+    }
+}
+
+/* Checkpoints for format 8.  Since each format 8 sample is stored as the
+   difference between it and the previous sample, its value depends on all of
+   the samples that precede it, and seeking to it requires reading the signal
+   file from the beginning.  If checkpoints are enabled (see setiseekindex),
+   the sample values of a format 8 group are recorded every cpint frames as
+   the group is read, and isgsetframe seeks to the nearest checkpoint at or
+   before the desired frame, then reads forward from there.  Checkpoint 0,
+   which is not stored, is the frame 0 state, in which each signal has its
+   initial value. */
+
+/* Record the current sample values of signal group ig, whose first signal is
+   s, if ig->frame is the first frame that follows the last checkpoint by
+   ig->cpint frames. */
+static void isgcheckpoint(WFDB_Context *ctx, struct igdata *ig,
+			  WFDB_Signal s)
+{
+    WFDB_Sample *p;
+    unsigned i;
+
+    if (ig->frame != (ig->ncp + 1) * (WFDB_Time)ig->cpint)
+	return;
+    if (ig->ncp >= ig->maxcp) {
+	unsigned n = ig->maxcp ? 2*ig->maxcp : 64;
+
+	SREALLOC(ig->cp, (size_t)n * ig->nsig, sizeof(WFDB_Sample));
+	ig->maxcp = n;
+    }
+    p = ig->cp + (size_t)ig->ncp++ * ig->nsig;
+    for (i = 0; i < ig->nsig; i++)
+	*p++ = isd[s+i]->samp;
+}
+
+/* Position format 8 signal group g, whose first signal is s, at frame t, and
+   set the sample values of its signals to those of frame t-1. */
+static int isg8setframe(WFDB_Context *ctx, WFDB_Group g, WFDB_Signal s,
+			WFDB_Time t)
+{
+    struct igdata *ig = igd[g];
+    struct isdata *is;
+    WFDB_Time tc;
+    WFDB_Sample *p;
+    unsigned i, k;
+    long cpint;
+    int c, stat;
+
+    /* Find the last checkpoint at or before frame t. */
+    k = (t / ig->cpint < ig->ncp) ? t / ig->cpint : ig->ncp;
+    tc = (WFDB_Time)k * ig->cpint;
+
+    /* Unless the current position lies between it and frame t (in which
+       case it is faster to continue from there), seek to the checkpoint
+       and restore the sample values recorded there.  (The nested call to
+       isgsetframe expects an absolute time.) */
+    if (ig->frame < tc || ig->frame > t) {
+	cpint = ig->cpint;
+	ig->cpint = 0;
+	stat = isgsetframe(ctx, g, in_msrec ? tc + segp->samp0 : tc);
+	ig->cpint = cpint;
+	if (stat)
+	    return (stat);
+	for (i = 0, p = k ? ig->cp + (size_t)(k-1) * ig->nsig : NULL;
+	     i < ig->nsig; i++)
+	    isd[s+i]->samp = p ? *p++ : isd[s+i]->info.initval;
+	ig->frame = tc;
+    }
+
+    /* Read forward to frame t, recording any checkpoints passed along the
+       way. */
+    while (ig->frame < t) {
+	for (i = 0; i < ig->nsig; i++)
+	    for (is = isd[s+i], c = 0; c < is->info.spf; c++)
+		is->samp += r8(ig);
+	if (ig->stat <= 0) {
+	    ig->frame = -1;
+	    return (-1);
+	}
+	ig->frame++;
+	isgcheckpoint(ctx, ig, s);
+    }
+
+    /* Reset the getvec sample-within-frame counter and the time (if signal
+       0 belongs to the group), and disable checksum testing. */
+    gvc = ispfmax;
+    if (s == 0) istime = in_msrec ? t + segp->samp0 : t;
+    for (i = 0; i < ig->nsig; i++)
+	isd[s+i]->info.nsamp = (WFDB_Time)0L;
+    return (0);
+}
+
+/* Shared block cache (see blkcache.c).  A signal group that uses the cache
+   reads each frame from the cached block that contains it.  The group's
+   signal file is read only to fill a block that is not in the cache, or to
+   read the frames at the end of the file that do not fill a block; when the
+   group is repositioned, isgsetframe records only the frame to be read
+   next, and the file itself is positioned when it must next be read. */
+
+/* Read the next frame of signal group ig into v, one sample at a time if the
+   frame decoder cannot decode it from the input buffer.  Return 0 if the
+   entire frame was read, or -1 at the end of the signal file. */
+static int isgbcrawframe(WFDB_Context *ctx, struct igdata *ig,
+			 WFDB_Sample *v)
+{
+    unsigned i;
+
+    if (ig->stat > 0 && (*ig->decode)(ig, v, ig->spf) == 0)
+	return (0);
+    for (i = 0; i < ig->spf && ig->stat > 0; i++) {
+	switch (ig->bc->key.fmt) {
+	  case 16:	v[i] = r16(ig); break;
+	  case 61:	v[i] = r61(ig); break;
+	  case 80:	v[i] = r80(ig); break;
+	  case 160:	v[i] = r160(ig); break;
+	  case 212:	v[i] = r212(ctx, ig); break;
+	  case 24:	v[i] = r24(ig); break;
+	  case 32:	v[i] = r32(ig); break;
+	  case 310:	v[i] = r310(ctx, ig); break;
+	  case 311:	v[i] = r311(ctx, ig); break;
+	}
+    }
+    return (ig->stat > 0 ? 0 : -1);
+}
+
+/* Position the signal file of group g at frame f (relative to the start of
+   the segment), by seeking to the beginning of the block that contains it
+   and reading forward.  The nested call to isgsetframe must not disturb the
+   state of the record as a whole, so the time, the getvec sample-within-frame
+   counter, and the checksum counters that it resets are restored;  istime is
+   set to -1 beforehand so that isgsetframe cannot assume that the file is
+   already positioned.  in_msrec is also cleared, so that isgsetframe takes f
+   as a frame of the current segment's signal file, which (as when the cache
+   is not used) may be read beyond the segment length given by the header of
+   a multi-segment record. */
+static int isgbcseek(WFDB_Context *ctx, WFDB_Group g, WFDB_Time f)
+{
+    struct igdata *ig = igd[g];
+    struct igbc *bc = ig->bc;
+    WFDB_Sample *v = NULL;
+    WFDB_Signal s;
+    WFDB_Time t = istime, *nsamp = NULL;
+    int c = gvc, m = in_msrec, stat;
+    long i;
+
+    for (s = 0; s < nisig && isd[s]->info.group != g; s++)
+	;
+    SUALLOC(nsamp, ig->nsig, sizeof(WFDB_Time));
+    for (i = 0; i < ig->nsig; i++)
+	nsamp[i] = isd[s+i]->info.nsamp;
+    ig->bc = NULL;
+    istime = -1;
+    in_msrec = 0;
+    stat = isgsetframe(ctx, g, f - f % WFDB_BCBLK);
+    in_msrec = m;
+    ig->bc = bc;
+    istime = t;
+    gvc = c;
+    for (i = 0; i < ig->nsig; i++)
+	isd[s+i]->info.nsamp = nsamp[i];
+    SFREE(nsamp);
+    if ((i = f % WFDB_BCBLK) > 0 && stat == 0) {
+	SUALLOC(v, ig->spf, sizeof(WFDB_Sample));
+	while (i-- > 0 && stat == 0)
+	    stat = isgbcrawframe(ctx, ig, v);
+	SFREE(v);
+    }
+    bc->fpos = (stat == 0) ? f : -1;
+    return (stat);
+}
+
+/* Read and decode block k of signal group g, add it to the block cache, and
+   return it, or return NULL if it cannot be read. */
+static struct bcblock *isgbcread(WFDB_Context *ctx, WFDB_Group g,
+				 WFDB_Time k)
+{
+    struct igdata *ig = igd[g];
+    struct igbc *bc = ig->bc;
+    struct bcblock *b;
+    long m, n;
+    int bad;
+
+    if ((bc->fpos != k * WFDB_BCBLK &&
+	 isgbcseek(ctx, g, k * WFDB_BCBLK) < 0) ||
+	(b = bcnew((size_t)WFDB_BCBLK * ig->spf)) == NULL)
+	return (NULL);
+    for (n = 0; n < WFDB_BCBLK; ) {
+	if ((m = isgunpack(ig, b->v + n * ig->spf, WFDB_BCBLK - n, &bad)) > 0)
+	    n += m;
+	else if (isgbcrawframe(ctx, ig, b->v + n * ig->spf) < 0)
+	    break;
+	else
+	    n++;
+    }
+    /* A block that ends with the file may be followed by a partial frame,
+       which is read (when it is needed) by getskewedframe;  the file is then
+       repositioned by isgbcseek, so that it is read exactly as it would be
+       if the cache were not in use. */
+    bc->fpos = (n == WFDB_BCBLK) ? (k + 1) * WFDB_BCBLK : -1;
+    b->n = n;
+    return (bcput(&bc->key, b));
+}
+
+/* Copy the next frame of signal group g into v from the block cache, and
+   return 0.  If the frame is not available from the cache (at the end of
+   the signal file, or if the block containing it cannot be read), position
+   the signal file so that getskewedframe can read the frame, and return
+   -1. */
+static int isgbcframe(WFDB_Context *ctx, WFDB_Group g, WFDB_Sample *v)
+{
+    struct igdata *ig = igd[g];
+    struct igbc *bc = ig->bc;
+    struct bcblock *b = bc->blk;
+    WFDB_Time i, k;
+
+    /* Usually, the frame is in the block being read. */
+    if (b == NULL || (i = bc->frame - b->key.blk * WFDB_BCBLK) < 0 ||
+	i >= WFDB_BCBLK) {
+	if (b) bcrelease(b);
+	k = bc->frame / WFDB_BCBLK;
+	i = bc->frame % WFDB_BCBLK;
+	bc->key.start = ig->start;
+	bc->key.spf = ig->spf;
+	bc->key.blk = k;
+	if ((b = bcget(&bc->key)) == NULL)
+	    b = isgbcread(ctx, g, k);
+	bc->blk = b;
+    }
+    if (b && i < b->n) {
+	(void)memcpy(v, b->v + i * ig->spf, ig->spf * sizeof(WFDB_Sample));
+	bc->frame++;
+	return (0);
+    }
+    if (bc->fpos != bc->frame)
+	(void)isgbcseek(ctx, g, bc->frame);
+    bc->frame++;
+    if (bc->fpos >= 0) bc->fpos++;
+    return (-1);
+}
+
+/* Check that frame t of a group that uses the block cache, and that has nn
+   samples per frame, does not begin beyond the end of the signal file.  This
+   is the test made by isgsetframe for memory-mapped signal files;  as for
+   those, a failed seek leaves the group at the end of its file. */
+static int isgbccheck(struct igdata *ig, unsigned nn, WFDB_Time t)
+{
+    long long b, d = 1;
+
+    switch (ig->bc->key.fmt) {
+      case 80:	b = nn; break;
+      case 16:
+      case 61:
+      case 160:	b = 2LL*nn; break;
+      case 24:	b = 3LL*nn; break;
+      case 32:	b = 4LL*nn; break;
+      case 212:	b = 3LL*nn; d = 2; break;
+      default:	b = 4LL*nn; d = 3; break;	/* 310 and 311 */
+    }
+    if (t < 0 || (b > 0 && t > LLONG_MAX / b) ||
+	(t * b) / d > ig->bc->key.size - ig->start)
+	return (-1);
+    return (0);
+}
+
+int isgsetframe(WFDB_Context *ctx, WFDB_Group g, WFDB_Time t)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int i, trem = 0;
     long nb, tt;
     struct igdata *ig;
@@ -191,7 +1050,8 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
     for (s = 0; s < nisig && g != isd[s]->info.group; s++)
 	;
     if (s == nisig) {
-	wfdb_error("isgsettime: incorrect signal group number %d\n", g);
+	wfdb_error_ctx(ctx, "isgsettime: incorrect signal group number %d\n",
+		       g);
 	return (-2);
     }
 
@@ -202,7 +1062,9 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	WFDB_Group h;
 
 	if (t >= msnsamples) {
-	    wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+	    wfdb_error_ctx(ctx,
+			   "isigsettime: improper seek on signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	while (t < tseg->samp0)
@@ -211,9 +1073,9 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	    tseg++;
 	if (segp != tseg) {
 	    segp = tseg;
-	    if (isigopen(segp->recname, NULL, (int)nvsig) <= 0) {
-	        wfdb_error("isigsettime: can't open segment %s\n",
-			   segp->recname);
+	    if (isigopen_ctx(ctx, segp->recname, NULL, (int)nvsig) <= 0) {
+	        wfdb_error_ctx(ctx, "isigsettime: can't open segment %s\n",
+			       segp->recname);
 		return (-1);
 	    }
 	    /* Following isigopen(), nigroup may have changed and
@@ -232,10 +1094,10 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	       functional for multi-segment records, because it cannot
 	       read signals from two different segments at once.) */
 	    for (h = 1; h < nigroup; h++)
-		if (i = isgsetframe(h, t))
+		if (i = isgsetframe(ctx, h, t))
 		    return (i);
 	    if (g == 0)
-		return (isgsetframe(0, t));
+		return (isgsetframe(ctx, 0, t));
 	    else
 		return (0);
 	}
@@ -244,9 +1106,24 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 
     ig = igd[g];
     ig->initial_skip = 0;
+    if (ig->cpint)		/* format 8 with checkpoints */
+	return (isg8setframe(ctx, g, s, t));
     /* Determine the number of samples per frame for signals in the group. */
     for (n = nn = 0; s+n < nisig && isd[s+n]->info.group == g; n++)
 	nn += isd[s+n]->info.spf;
+    /* If the group uses the block cache, record the frame to be read next;
+       the signal file is positioned later, if it must be read. */
+    if (ig->bc) {
+	ig->bc->frame = t;
+	if (isgbccheck(ig, nn, t) < 0)
+	    return (-1);
+	gvc = ispfmax;
+	if (s == 0) istime = in_msrec ? t + segp->samp0 : t;
+	while (n-- != 0)
+	    isd[s+n]->info.nsamp = (WFDB_Time)0L;
+	return (0);
+    }
+    isgracancel(ctx, ig);	/* discard any block being read ahead */
     /* Determine the number of bytes per sample interval in the file. */
     switch (isd[s]->info.fmt) {
       case 0:
@@ -266,8 +1143,10 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
       case 508:
       case 516:
       case 524:
-	if (flac_isseek(ig, t) < 0) {
-	    wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+	if (flac_isseek(ctx, ig, t) < 0) {
+	    wfdb_error_ctx(ctx,
+			   "isigsettime: improper seek on signal group %d\n",
+			   g);
 	    return (-1);
 	}
 
@@ -289,14 +1168,16 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
       case 61:
       case 160:
 	if (nn > UINT_MAX / 2) {
-	    wfdb_error("isigsettime: overflow in signal group %d\n", g);
+	    wfdb_error_ctx(ctx, "isigsettime: overflow in signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	b = 2*nn;
 	break;
       case 212:
 	if (nn > UINT_MAX / 3) {
-	    wfdb_error("isigsettime: overflow in signal group %d\n", g);
+	    wfdb_error_ctx(ctx, "isigsettime: overflow in signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	/* Reset the input counter. */
@@ -306,10 +1187,10 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	if ((nn & 1) && (t & 1)) {
 	    if (in_msrec)
 		t += segp->samp0;	/* restore absolute time */
-	    if (i = isgsetframe(g, t - 1))
+	    if (i = isgsetframe(ctx, g, t - 1))
 		return (i);
 	    for (j = 0; j < nn; j++)
-		(void)r212(ig);
+		(void)r212(ctx, ig);
 	    istime++;
 	    for (n = 0; s+n < nisig && isd[s+n]->info.group == g; n++)
 		isd[s+n]->info.nsamp = (WFDB_Time)0L;
@@ -318,7 +1199,8 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	b = 3*nn; d = 2; break;
       case 310:
 	if (nn > UINT_MAX / 4) {
-	    wfdb_error("isigsettime: overflow in signal group %d\n", g);
+	    wfdb_error_ctx(ctx, "isigsettime: overflow in signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	/* Reset the input counter. */
@@ -328,10 +1210,10 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	if ((nn % 3) && (trem = (t % 3))) {
 	    if (in_msrec)
 		t += segp->samp0;	/* restore absolute time */
-	    if (i = isgsetframe(g, t - trem))
+	    if (i = isgsetframe(ctx, g, t - trem))
 		return (i);
 	    for (j = nn*trem; j > 0; j--)
-		(void)r310(ig);
+		(void)r310(ctx, ig);
 	    istime += trem;
 	    for (n = 0; s+n < nisig && isd[s+n]->info.group == g; n++)
 		isd[s+n]->info.nsamp = (WFDB_Time)0L;
@@ -340,7 +1222,8 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	b = 4*nn; d = 3; break;
       case 311:
 	if (nn > UINT_MAX / 4) {
-	    wfdb_error("isigsettime: overflow in signal group %d\n", g);
+	    wfdb_error_ctx(ctx, "isigsettime: overflow in signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	/* Reset the input counter. */
@@ -350,10 +1233,10 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	if ((nn % 3) && (trem = (t % 3))) {
 	    if (in_msrec)
 		t += segp->samp0;	/* restore absolute time */
-	    if (i = isgsetframe(g, t - trem))
+	    if (i = isgsetframe(ctx, g, t - trem))
 		return (i);
 	    for (j = nn*trem; j > 0; j--)
-		(void)r311(ig);
+		(void)r311(ctx, ig);
 	    istime += trem;
 	    for (n = 0; s+n < nisig && isd[s+n]->info.group == g; n++)
 		isd[s+n]->info.nsamp = (WFDB_Time)0L;
@@ -362,14 +1245,16 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	b = 4*nn; d = 3; break;
       case 24:
 	if (nn > UINT_MAX / 3) {
-	    wfdb_error("isigsettime: overflow in signal group %d\n", g);
+	    wfdb_error_ctx(ctx, "isigsettime: overflow in signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	b = 3*nn;
 	break;
       case 32:
 	if (nn > UINT_MAX / 4) {
-	    wfdb_error("isigsettime: overflow in signal group %d\n", g);
+	    wfdb_error_ctx(ctx, "isigsettime: overflow in signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	b = 4*nn;
@@ -377,13 +1262,27 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
     }
 
     if (t > (LONG_MAX / b) || ((long) (t * b))/d > (LONG_MAX - ig->start)) {
-	wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+	wfdb_error_ctx(ctx, "isigsettime: improper seek on signal group %d\n",
+		       g);
 	return (-1);
     }
 
-    /* Seek to the beginning of the block which contains the desired sample.
-       For normal files, use fseek() to do so. */
-    if (ig->seek) {
+    /* If the signal file is mapped into memory, just move the input pointer
+       to the desired sample. */
+    if (ig->fp->type == WFDB_MMAP) {
+	nb = (t*b)/d + ig->start;
+	ig->be = ig->buf + ig->fp->maplen;
+	if (nb > ig->fp->maplen) {
+	    ig->bp = ig->be;
+	    ig->stat = 0;
+	    return (-1);
+	}
+	ig->bp = ig->buf + nb;
+	ig->stat = 1;
+    }
+    /* Otherwise, seek to the beginning of the block which contains the
+       desired sample.  For normal files, use fseek() to do so. */
+    else if (ig->seek) {
 	tt = t*b;
 	nb = tt/d + ig->start;
 	if ((i = ig->bsize) == 0) i = ibsize;
@@ -391,7 +1290,9 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	   desired sample. */
 	tt = nb/i;
 	if (wfdb_fseek(ig->fp, tt*i, 0)) {
-	    wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+	    wfdb_error_ctx(ctx,
+			   "isigsettime: improper seek on signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	nb %= i;
@@ -408,8 +1309,9 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	   read and has passed out of the buffer, requiring a rewind ... */
 	if (t < t0) {
 	    if (wfdb_fseek(ig->fp, 0L, 0)) {
-		wfdb_error("isigsettime: improper seek on signal group %d\n",
-			   g);
+		wfdb_error_ctx(ctx,
+			       "isigsettime: improper seek on signal group "
+			       "%d\n", g);
 		return (-1);
 	    }
 	    tt = t*b;
@@ -430,14 +1332,18 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
 	    nb -= wfdb_fread(ig->buf, 1, ig->bsize, ig->fp);
     }
 
-    /* Reset the block pointer to indicate nothing has been read in the
-       current block. */
-    ig->bp = ig->be;
-    ig->stat = 1;
-    /* Read any bytes in the current block that precede the desired sample. */
-    while (nb-- > 0 && ig->stat > 0)
-	i = r8(ig);
-    if (ig->stat <= 0) return (-1);
+    /* Unless the file is mapped, read up to the desired sample. */
+    if (ig->fp->type != WFDB_MMAP) {
+	/* Reset the block pointer to indicate nothing has been read in the
+	   current block. */
+	ig->bp = ig->be;
+	ig->stat = 1;
+	/* Read any bytes in the current block that precede the desired
+	   sample. */
+	while (nb-- > 0 && ig->stat > 0)
+	    i = r8(ig);
+	if (ig->stat <= 0) return (-1);
+    }
 
     /* Reset the getvec sample-within-frame counter. */
     gvc = ispfmax;
@@ -454,15 +1360,80 @@ int isgsetframe(WFDB_Group g, WFDB_Time t)
    invalid sample */
 #define VFILL	((gvmode & WFDB_GVPAD) ? is->samp : WFDB_INVALID_SAMPLE)
 
-int getskewedframe(WFDB_Sample *vector)
+/* getblkframes: read up to n frames into vector, exactly as n invocations of
+   getframe would, for a record with a single signal group in one of the
+   bit-packed formats, using the group's block unpacker (see sigpack.c).  The
+   value returned is the number of frames read, which is 0 if none could be
+   read in this way;  the caller then reads the next frame using getframe,
+   which refills the input buffer, handles the first frame of the record
+   and any frame that is not on a unit boundary, and detects the end of the
+   signal file and checksum errors. */
+long getblkframes(WFDB_Context *ctx, WFDB_Sample *vector, long n)
+{
+    struct igdata *ig;
+    struct isdata *is;
+    WFDB_Signal s;
+    WFDB_Sample *p, v;
+    unsigned sum;
+    long k, nf;
+    int bad, c, off, spf;
+
+    if (nigroup != 1 || (ig = igd[0])->unpack == NULL || ig->bc ||
+	ig->cpint || ig->initial_skip || need_sigmap || (int)framelen != tspf ||
+	istime <= 0)
+	return (0L);
+    /* Leave the frame that ends each signal (if known) for getframe, which
+       verifies the signal's checksum. */
+    for (s = 0; s < nisig; s++) {
+	if ((is = isd[s])->skip)
+	    return (0L);
+	if (is->info.nsamp > 0 && n >= is->info.nsamp)
+	    n = is->info.nsamp - 1;
+    }
+    if (n <= 0 || (nf = isgunpack(ig, vector, n, &bad)) == 0)
+	return (0L);
+
+    /* Update the checksums and the last valid samples, and replace any
+       invalid samples, as getskewedframe does. */
+    for (s = off = 0; s < nisig; s++, off += spf) {
+	is = isd[s];
+	spf = is->info.spf;
+	sum = 0;
+	if (bad) {
+	    for (k = 0, p = vector + off; k < nf; k++, p += tspf)
+		for (c = 0; c < spf; c++) {
+		    sum += (unsigned)(v = p[c]);
+		    if (v == ig->invalid)
+			p[c] = VFILL;
+		    else
+			is->samp = v;
+		}
+	}
+	else {
+	    for (k = 0, p = vector + off; k < nf; k++, p += tspf)
+		for (c = 0; c < spf; c++)
+		    sum += (unsigned)p[c];
+	    is->samp = vector[(nf - 1) * tspf + off + spf - 1];
+	}
+	is->info.cksum -= (int)(sum & 0xffff);
+	if (is->info.nsamp > 0)
+	    is->info.nsamp -= nf;
+	else if (is->info.nsamp == 0)
+	    is->info.nsamp = -1;
+    }
+    istime += nf;
+    return (nf);
+}
+
+int getskewedframe(WFDB_Context *ctx, WFDB_Sample *vector)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int c, stat;
     struct isdata *is;
     struct igdata *ig;
     WFDB_Group g;
     WFDB_Sample v, *vecstart = vector;
     WFDB_Signal s;
+    unsigned ndecoded = 0;
 
     if ((stat = (int)nisig) == 0) return (nvsig > 0 ? -1 : 0);
     if (istime == 0L) {
@@ -473,7 +1444,7 @@ int getskewedframe(WFDB_Sample *vector)
 	/* Go through groups in reverse order since seeking on group 0
 	   should always be done last. */
 	if (igd[--g]->initial_skip)
-	    isgsetframe(g, (in_msrec ? segp->samp0 : 0));
+	    isgsetframe(ctx, g, (in_msrec ? segp->samp0 : 0));
     }
 
     /* If the vector needs to be rearranged (variable-layout record),
@@ -484,7 +1455,29 @@ int getskewedframe(WFDB_Sample *vector)
     for (s = 0; s < nisig; s++) {
 	is = isd[s];
 	ig = igd[is->info.group];
-	for (c = 0; c < is->info.spf; c++, vector++) {
+	/* At the first signal of a group, try to decode the group's entire
+	   frame at once;  if that succeeds, ndecoded is the number of signals
+	   (this one and those that follow in the same group) whose samples
+	   are already in vector. */
+	if (ndecoded == 0 &&
+	    (s == 0 || isd[s-1]->info.group != is->info.group) &&
+	    (ig->bc ? isgbcframe(ctx, is->info.group, vector) == 0 :
+	     (ig->decode && ig->stat > 0 && isgdecode(ig, vector) == 0)))
+	    ndecoded = ig->nsig;
+	if (ndecoded > 0) {
+	    ndecoded--;
+	    if (is->skip)	/* unselected signal (see isigselect) */
+		for (c = 0; c < is->info.spf; c++)
+		    *vector++ = VFILL;
+	    else for (c = 0; c < is->info.spf; c++, vector++) {
+		if ((v = *vector) == ig->invalid)
+		    *vector = VFILL;
+		else
+		    is->samp = v;
+		is->info.cksum -= v;
+	    }
+	}
+	else for (c = 0; c < is->info.spf; c++, vector++) {
 	    switch (is->info.fmt) {
 	      case 0:	/* null signal: return sample tagged as invalid */
 		  *vector = v = VFILL;
@@ -522,21 +1515,21 @@ int getskewedframe(WFDB_Sample *vector)
 		    is->samp = *vector;
 		break;
 	      case 212:	/* 2 12-bit amplitudes bit-packed in 3 bytes */
-		*vector = v = r212(ig);
+		*vector = v = r212(ctx, ig);
 		if (v == -1 << 11)
 		    *vector = VFILL;
 		else
 		    is->samp = *vector;
 		break;
 	      case 310:	/* 3 10-bit amplitudes bit-packed in 4 bytes */
-		*vector = v = r310(ig);
+		*vector = v = r310(ctx, ig);
 		if (v == -1 << 9)
 		    *vector = VFILL;
 		else
 		    is->samp = *vector;
 		break;
 	      case 311:	/* 3 10-bit amplitudes bit-packed in 4 bytes */
-		*vector = v = r311(ig);
+		*vector = v = r311(ctx, ig);
 		if (v == -1 << 9)
 		    *vector = VFILL;
 		else
@@ -557,21 +1550,21 @@ int getskewedframe(WFDB_Sample *vector)
 		    is->samp = *vector;
 		break;
 	      case 508:	/* 8-bit compressed FLAC */
-		*vector = v = flac_getsamp(ig);
+		*vector = v = flac_getsamp(ctx, ig);
 		if (v == -1 << 7)
 		    *vector = VFILL;
 		else
 		    is->samp = *vector;
 		break;
 	      case 516:	/* 16-bit compressed FLAC */
-		*vector = v = flac_getsamp(ig);
+		*vector = v = flac_getsamp(ctx, ig);
 		if (v == -1 << 15)
 		    *vector = VFILL;
 		else
 		    is->samp = *vector;
 		break;
 	      case 524:	/* 24-bit compressed FLAC */
-		*vector = v = flac_getsamp(ig);
+		*vector = v = flac_getsamp(ctx, ig);
 		if (v == -1 << 23)
 		    *vector = VFILL;
 		else
@@ -586,38 +1579,54 @@ int getskewedframe(WFDB_Sample *vector)
 		    stat = -3;
 		}
 		else if (is->info.nsamp > (WFDB_Time)0L) {
-		    wfdb_error("getvec: unexpected EOF in signal %d\n", s);
+		    wfdb_error_ctx(ctx,
+				   "getvec: unexpected EOF in signal %d\n", s);
 		    stat = -3;
 		}
 		else if (in_msrec && segp && segp < segend) {
 		    segp++;
-		    if (isigopen(segp->recname, NULL, (int)nvsig) <= 0) {
-			wfdb_error("getvec: error opening segment %s\n",
-				   segp->recname);
+		    if (isigopen_ctx(ctx, segp->recname, NULL,
+				     (int)nvsig) <= 0) {
+			wfdb_error_ctx(ctx,
+				       "getvec: error opening segment %s\n",
+				       segp->recname);
 			stat = -3;
 			return (stat);  /* avoid looping if segment is bad */
 		    }
 		    else {
+			/* Start reading ahead into the following segment. */
+			if (segp < segend)
+			    segprefetch(ctx, (segp+1)->recname);
 			istime = segp->samp0;
-			return (getskewedframe(vecstart));
+			return (getskewedframe(ctx, vecstart));
 		    }
 		}
 		else
 		    stat = -1;
 	    }
-	    is->info.cksum -= v;
+	    if (is->skip)
+		*vector = VFILL;
+	    else
+		is->info.cksum -= v;
+	}
+	/* At the end of each frame of a format 8 group, record a checkpoint
+	   if one is due. */
+	if (ig->cpint && ig->stat > 0 &&
+	    (s+1 == nisig || isd[s+1]->info.group != is->info.group)) {
+	    ig->frame++;
+	    isgcheckpoint(ctx, ig, s + 1 - ig->nsig);
 	}
 	if (is->info.nsamp >= 0 && --is->info.nsamp == 0 &&
-	    (is->info.cksum & 0xffff) &&
+	    (is->info.cksum & 0xffff) && !is->nocksum &&
 	    !in_msrec && !isedf &&
 	    is->info.fmt != 0) {
-	    wfdb_error("getvec: checksum error in signal %d\n", s);
+	    wfdb_error_ctx(ctx, "getvec: checksum error in signal %d\n", s);
 	    stat = -4;
 	}
     }
 
     if (need_sigmap)
-	sigmap(vecstart, ovec);
+	sigmap(ctx, vecstart, ovec);
     else if (framelen != tspf)
 	for (s = framelen; s < tspf; s++)
 	    vecstart[s] = WFDB_INVALID_SAMPLE;
@@ -677,29 +1686,97 @@ WFDB_Sample meansamp(const WFDB_Sample *s, int n)
     }
 }
 
-int rgetvec(WFDB_Sample *vector)
+/* rgvdecimate: reduce nf consecutive frames in fbuf (as read by getframe)
+   to one sample per signal per frame in vbuf, replacing the samples of each
+   oversampled signal by their mean (as calculated by meansamp).  The samples
+   of each signal are processed for all nf frames at once, and the tests for
+   invalid samples are accumulated rather than branched on, so that the inner
+   loops are short and free of function calls. */
+static void rgvdecimate(WFDB_Context *ctx, const WFDB_Sample *fbuf,
+			WFDB_Sample *vbuf, long nf)
+{
+    const WFDB_Sample *p;
+    WFDB_Signal s;
+    long j;
+    int c, off, sf, sh;
+
+    for (s = off = 0; s < nvsig; off += sf, s++) {
+	sf = vsd[s]->info.spf;
+	p = fbuf + off;
+	if (sf == 1) {
+	    for (j = 0; j < nf; j++, p += tspf)
+		vbuf[j*nvsig + s] = *p;
+	}
+	else if (WFDB_SAMPLE_MAX > WFDB_TIME_MAX / INT_MAX) {
+	    for (j = 0; j < nf; j++, p += tspf)
+		vbuf[j*nvsig + s] = meansamp(p, sf);
+	}
+	else {
+	    /* If sf is a power of two, the floor of the quotient (see
+	       meansamp) can be found by an arithmetic shift. */
+	    for (sh = 0; (1 << sh) < sf; sh++)
+		;
+	    if ((1 << sh) != sf)
+		sh = -1;
+	    for (j = 0; j < nf; j++, p += tspf) {
+		WFDB_Time sum = sf / 2;
+		int invalid = 0;
+
+		for (c = 0; c < sf; c++) {
+		    sum += p[c];
+		    invalid |= (p[c] == WFDB_INVALID_SAMPLE);
+		}
+		if (invalid)
+		    vbuf[j*nvsig + s] = WFDB_INVALID_SAMPLE;
+		else if (sh >= 0)
+		    vbuf[j*nvsig + s] = sum >> sh;
+		else
+		    vbuf[j*nvsig + s] = (sum + (sum < 0)) / sf - (sum < 0);
+	    }
+	}
+    }
+}
+
+/* rgvexpand: expand nf consecutive frames in fbuf (as read by getframe) to
+   ispfmax sample vectors per frame in vbuf, repeating samples of signals that
+   have fewer than ispfmax samples per frame (zero-order interpolation, as in
+   rgetvec).  Sample s of vector c of each frame is always the same sample of
+   the frame, so a table of their indices (gvmap) is built once, and the
+   vectors of each frame are then gathered from it in a single loop. */
+static void rgvexpand(WFDB_Context *ctx, const WFDB_Sample *fbuf,
+		      WFDB_Sample *vbuf, long nf)
+{
+    WFDB_Signal s;
+    long j;
+    int c, k, n = ispfmax * nvsig, off, sf;
+
+    for (s = off = 0; s < nvsig; off += sf, s++) {
+	sf = vsd[s]->info.spf;
+	for (c = 0; c < ispfmax; c++)
+	    gvmap[c*nvsig + s] = off + (unsigned)((long)c * sf / ispfmax);
+    }
+    for (j = 0; j < nf; j++, fbuf += tspf, vbuf += n)
+	for (k = 0; k < n; k++)
+	    vbuf[k] = fbuf[gvmap[k]];
+}
+
+int rgetvec(WFDB_Context *ctx, WFDB_Sample *vector)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     WFDB_Sample *tp;
     WFDB_Signal s;
-    static int stat;
 
     if (ispfmax < 2)	/* all signals at the same frequency */
-	return (getframe(vector));
+	return (getframe_ctx(ctx, vector));
 
     if ((gvmode & WFDB_HIGHRES) != WFDB_HIGHRES) {
 	/* return one sample per frame, decimating by averaging if necessary */
-	stat = getframe(tvector);
-	for (s = 0, tp = tvector; s < nvsig; s++) {
-	    int sf = vsd[s]->info.spf;
-	    *vector++ = meansamp(tp, sf);
-	    tp += sf;
-	}
+	gvstat = getframe_ctx(ctx, tvector);
+	rgvdecimate(ctx, tvector, vector, 1L);
     }
     else {			/* return ispfmax samples per frame, using
 				   zero-order interpolation if necessary */
 	if (gvc >= ispfmax) {
-	    stat = getframe(tvector);
+	    gvstat = getframe_ctx(ctx, tvector);
 	    gvc = 0;
 	}
 	for (s = 0, tp = tvector; s < nvsig; s++) {
@@ -720,5 +1797,86 @@ int rgetvec(WFDB_Sample *vector)
 	}
 	gvc++;
     }
-    return (stat);
+    return (gvstat);
+}
+
+/* rgetvecs: read up to n sample vectors (as returned by rgetvec) into
+   vector.  For records with multiple sampling frequencies, whole frames are
+   read WFDB_GVBLK at a time into gvblk, then decimated or expanded together
+   by rgvdecimate or rgvexpand.  The value returned is as for getvecs. */
+long rgetvecs(WFDB_Context *ctx, WFDB_Sample *vector, long n)
+{
+    WFDB_Sample *fp;
+    long i = 0, m, nf, vpf;
+    int highres = ((gvmode & WFDB_HIGHRES) == WFDB_HIGHRES), stat = 0;
+
+    if (ispfmax < 2)	/* all signals at the same frequency */
+	return (getframes_ctx(ctx, vector, n));
+
+    /* In high-resolution mode, finish the current frame first. */
+    while (highres && gvc < ispfmax && i < n) {
+	if ((stat = rgetvec(ctx, vector)) <= 0) {
+	    if (stat == -4) i++;
+	    goto done;
+	}
+	i++;
+	vector += nvsig;
+    }
+
+    /* Read and convert as many whole frames as are needed. */
+    vpf = highres ? ispfmax : 1;	/* vectors per frame */
+    if (n - i >= vpf) {
+	if (gvblklen < WFDB_GVBLK * tspf) {
+	    SREALLOC(gvblk, WFDB_GVBLK * tspf, sizeof(WFDB_Sample));
+	    gvblklen = WFDB_GVBLK * tspf;
+	}
+	if (highres && gvmaplen < ispfmax * nvsig) {
+	    SREALLOC(gvmap, ispfmax * nvsig, sizeof(unsigned));
+	    gvmaplen = ispfmax * nvsig;
+	}
+	while (n - i >= vpf) {
+	    if ((m = (n - i) / vpf) > WFDB_GVBLK)
+		m = WFDB_GVBLK;
+	    for (nf = 0, fp = gvblk; nf < m; nf++, fp += tspf)
+		if ((stat = getframe_ctx(ctx, fp)) <= 0)
+		    break;
+	    if (highres)
+		rgvexpand(ctx, gvblk, vector, nf);
+	    else
+		rgvdecimate(ctx, gvblk, vector, nf);
+	    i += nf * vpf;
+	    vector += nf * vpf * nvsig;
+	    if (nf < m) {
+		gvstat = stat;
+		if (!highres) {
+		    /* A checksum error is reported after the last frame,
+		       which is valid. */
+		    if (stat == -4) {
+			rgvdecimate(ctx, fp, vector, 1L);
+			i++;
+		    }
+		    goto done;
+		}
+		/* Leave the frame for rgetvec (below), which will return
+		   the status with its first vector. */
+		(void)memcpy(tvector, fp, tspf * sizeof(WFDB_Sample));
+		gvc = 0;
+		break;
+	    }
+	}
+    }
+
+    /* Read any remaining vectors one at a time. */
+    while (i < n) {
+	if ((stat = rgetvec(ctx, vector)) <= 0) {
+	    if (stat == -4) i++;
+	    break;
+	}
+	i++;
+	vector += nvsig;
+    }
+
+  done:
+    if (stat == -4) gvpend = stat;	/* reported by the next getvecs */
+    return ((i > 0 || stat >= 0) ? i : stat);
 }
@@ -36,9 +36,8 @@
    number that follows indicates the length of the gap in sample intervals.
  */
 
-void sigmap_cleanup(void)
+void sigmap_cleanup(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int i;
 
     need_sigmap = nvsig = tspf = vspfmax = 0;
@@ -63,13 +62,13 @@ void sigmap_cleanup(void)
     }
 }
 
-int make_vsd(void)
+int make_vsd(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int i;
 
     if (nvsig != nisig) {
-	wfdb_error("make_vsd: oops! nvsig = %d, nisig = %d\n", nvsig, nisig);
+	wfdb_error_ctx(ctx, "make_vsd: oops! nvsig = %d, nisig = %d\n", nvsig,
+		       nisig);
 	return (-1);
     }
     for (i = 0; i < maxvsig; i++) {
@@ -96,9 +95,8 @@ int make_vsd(void)
     return (nvsig);
 }
 
-int sigmap_init(int first_segment)
+int sigmap_init(WFDB_Context *ctx, int first_segment)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int i, j, k, kmax, s, ivmin, ivmax;
     double ovmin, ovmax;
     struct sigmapinfo *ps;
@@ -124,7 +122,7 @@ int sigmap_init(int first_segment)
 	    s += k;
 	}
 	SALLOC(ovec, tspf, sizeof(WFDB_Sample));
-	return (make_vsd());
+	return (make_vsd(ctx));
     }
 
     else if (need_sigmap) {	/* set up the input side of the map */
@@ -143,9 +141,10 @@ int sigmap_init(int first_segment)
 	    for (s = 0; s < tspf; s += smi[s].spf)
 		if (strcmp(smi[s].desc, isd[i]->info.desc) == 0) {
 		    if ((kmax = smi[s].spf) != isd[i]->info.spf) {
-			wfdb_error(
-		   "sigmap_init: unexpected spf for signal %d in segment %s\n",
-		                   i, segp->recname);
+			wfdb_error_ctx(ctx,
+				       "sigmap_init: unexpected spf for "
+				       "signal %d in segment %s\n", i,
+				       segp->recname);
 			if (kmax > isd[i]->info.spf)
 			    kmax = isd[i]->info.spf;
 		    }
@@ -154,9 +153,10 @@ int sigmap_init(int first_segment)
 			ps->index = j + k;
 			ps->scale = ps->gain / isd[i]->info.gain;
 			if (ps->scale < 1.0)
-			    wfdb_error(
-	       "sigmap_init: loss of precision in signal %d in segment %s\n",
-				       i, segp->recname);
+			    wfdb_error_ctx(ctx,
+					   "sigmap_init: loss of precision "
+					   "in signal %d in segment %s\n", i,
+					   segp->recname);
 			ps->offset = ps->baseline -
 			             ps->scale * isd[i]->info.baseline + 0.5;
 
@@ -197,8 +197,9 @@ int sigmap_init(int first_segment)
 		    break;
 		}
 	if (j > tspf) {
-	    wfdb_error("sigmap_init: frame size too large in segment %s\n",
-		       segp->recname);
+	    wfdb_error_ctx(ctx,
+			   "sigmap_init: frame size too large in segment %s\n",
+			   segp->recname);
 	    return (-1);
 	}
     }
@@ -208,15 +209,16 @@ int sigmap_init(int first_segment)
 	   record */
 	ispfmax = vspfmax;
 	if (nisig > nvsig) {
-	    wfdb_error("sigmap_init: wrong number of signals in segment %s\n",
-		       segp->recname);
+	    wfdb_error_ctx(ctx,
+			   "sigmap_init: wrong number of signals in segment "
+			   "%s\n", segp->recname);
 	    return (-1);
 	}
 	for (i = 0; i < nisig; i++) {
 	    if (isd[i]->info.spf != vsd[i]->info.spf) {
-		wfdb_error(
-		    "sigmap_init: wrong spf for signal %d in segment %s\n",
-		    i, segp->recname);
+		wfdb_error_ctx(ctx,
+			       "sigmap_init: wrong spf for signal %d in "
+			       "segment %s\n", i, segp->recname);
 		return (-1);
 	    }
 	}
@@ -228,15 +230,14 @@ int sigmap_init(int first_segment)
 	vspfmax = ispfmax;
 	for (s = tspf = 0; s < nisig; s++)
 	    tspf += isd[s]->info.spf;
-	return (make_vsd());
+	return (make_vsd(ctx));
     }
 
     return (0);
 }
 
-int sigmap(WFDB_Sample *vector, const WFDB_Sample *ivec)
+int sigmap(WFDB_Context *ctx, WFDB_Sample *vector, const WFDB_Sample *ivec)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int i;
     double v;
 
@@ -52,6 +52,9 @@ visible outside of this file:
  osigclose	(closes output signals)
  isgsetframe	(skips to a specified frame number in a specified signal group)
  getskewedframe	(reads an input frame, without skew correction)
+ isgdecoder	(selects the frame decoder for an input signal group)
+ isgselect	(finds the samples to be decoded in an input signal group)
+ isigselapply	(applies the current signal selection to the input signals)
  meansamp       (calculates mean of an array of samples)
  rgetvec        (reads a sample from each input signal without resampling)
  openosig       (opens output signals)
@@ -66,6 +69,7 @@ This file also contains definitions of the following WFDB library functions:
  osigopen	(opens output signals according to a header file)
  osigfopen	(opens output signals by name)
  findsig [10.4.12] (find an input signal with a specified name)
+ isigselect [11.0] (selects the input signals to be read by getvec)
  getspf [9.6]	(returns number of samples returned by getvec per frame)
  setgvmode [9.0](sets getvec operating mode)
  getgvmode [10.5.3](returns getvec operating mode)
@@ -73,12 +77,27 @@ This file also contains definitions of the following WFDB library functions:
  getifreq [10.2.6](returns the getvec sampling frequency)
  getvec		(reads a (possibly resampled) sample from each input signal)
  getframe [9.0]	(reads an input frame)
+ getvecs [11.0]	(reads a block of sample vectors)
+ getframes [11.0] (reads a block of input frames)
+ getphys [11.0]	(reads a block of sample vectors in physical units)
+ getphysf [11.0] (reads a block of sample vectors in physical units, as float)
+ getvecsp [11.0] (reads a block of sample vectors into per-signal arrays)
+ getvecs16 [11.0] (reads a block of sample vectors as 16-bit samples)
+ getframes16 [11.0] (reads a block of input frames as 16-bit samples)
  putvec		(writes a sample to each output signal)
+ putvecs [11.0]	(writes a block of frames to the output signals)
  isigsettime	(skips to a specified time in each signal)
  isgsettime	(skips to a specified time in a specified signal group)
  tnextvec [10.4.13] (skips to next valid sample of a specified signal)
  setibsize [5.0](sets the default buffer size for getvec)
+ setimmap [11.0] (enables or disables memory-mapped input signal files)
+ sethcache [11.0] (sets the number of segment headers to be cached)
+ setireadahead [11.0] (enables or disables read-ahead for input signal files)
+ setiflacthreads [11.0] (sets the number of threads decoding each FLAC file)
+ setiseekindex [11.0] (sets the interval between format 8 checkpoints)
+ setiresamp [11.0] (selects the getvec resampling method)
  setobsize [5.0](sets the default buffer size for putvec)
+ setoflac [11.0] (sets the FLAC compression level, block size and threads)
  newheader	(creates a new header file)
  setheader [5.0](creates or rewrites a header file given signal specifications)
  setmsheader [9.1] (creates or rewrites a header for a multi-segment record)
@@ -106,9 +125,12 @@ This file also contains definitions of the following WFDB library functions:
  adumuv		(converts ADC units to microvolts)
  muvadu		(converts microvolts to ADC units)
  aduphys [6.0]	(converts ADC units to physical units)
+ aduphysv [11.0] (converts an array of samples to physical units)
  physadu [6.0]	(converts physical units to ADC units)
  sample [10.3.0](get a sample from a given signal at a given time)
  sample_valid [10.3.0](verify that last value returned by sample was valid)
+ setsampcache [11.0] (sets the size of the cache used by sample)
+ sampcachestats [11.0] (reports the effectiveness of the cache used by sample)
 
 (Numbers in brackets in the list above indicate the first version of the WFDB
 library that included the corresponding function.  Functions not so marked
@@ -146,13 +168,13 @@ applications should use the methods illustrated immediately below instead.
 #include "signal_internal.h"
 
 #include <time.h>
+#include <math.h>
 
 /* Local functions. */
 
 /* Allocate workspace for up to n input signals. */
-int allocisig(unsigned int n)
+int allocisig(WFDB_Context *ctx, unsigned int n)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     if (maxisig < n) {
 	unsigned m = maxisig;
 
@@ -167,9 +189,8 @@ int allocisig(unsigned int n)
 }
 
 /* Allocate workspace for up to n input signal groups. */
-int allocigroup(unsigned int n)
+int allocigroup(WFDB_Context *ctx, unsigned int n)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     if (maxigroup < n) {
 	unsigned m = maxigroup;
 
@@ -184,9 +205,8 @@ int allocigroup(unsigned int n)
 }
 
 /* Allocate workspace for up to n output signals. */
-int allocosig(unsigned int n)
+int allocosig(WFDB_Context *ctx, unsigned int n)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     if (maxosig < n) {
 	unsigned m = maxosig;
 
@@ -201,9 +221,8 @@ int allocosig(unsigned int n)
 }
 
 /* Allocate workspace for up to n output signal groups. */
-int allocogroup(unsigned int n)
+int allocogroup(WFDB_Context *ctx, unsigned int n)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     if (maxogroup < n) {
 	unsigned m = maxogroup;
 
@@ -243,16 +262,19 @@ int copysi(WFDB_Siginfo *to, const WFDB_Siginfo *from)
     return (1);
 }
 
-void isigclose(void)
+void isigclose(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     struct isdata *is;
     struct igdata *ig;
 
-    if (sbuf && !in_msrec) {
-	SFREE(sbuf);
+    if (sbcache && !in_msrec) {
+	sbfree(ctx);
 	sample_vflag = 0;
     }
+    if (!in_msrec) {
+	SFREE(isigsel);
+	nisigsel = 0;
+    }
     if (isd) {
 	while (maxisig)
 	    if (is = isd[--maxisig]) {
@@ -269,9 +291,17 @@ void isigclose(void)
     if (igd) {
 	while (maxigroup)
 	    if (ig = igd[--maxigroup]) {
+		isgrafree(ctx, ig);
+		isgbcfree(ctx, ig);
+		SFREE(ig->run);
+		SFREE(ig->cp);
 		if (ig->flacdec)
-		    flac_isclose(ig);
-		if (ig->fp) (void)wfdb_fclose(ig->fp);
+		    flac_isclose(ctx, ig);
+		if (ig->fp) {
+		    if (ig->fp->type == WFDB_MMAP)
+			ig->buf = NULL;	/* unmapped by wfdb_fclose */
+		    (void)wfdb_fclose(ig->fp);
+		}
 		SFREE(ig->buf);
 		SFREE(ig);
 	    }
@@ -281,18 +311,18 @@ void isigclose(void)
 
     istime = 0L;
     gvc = ispfmax = 1;
+    gvpend = 0;
     if (hheader) {
 	(void)wfdb_fclose(hheader);
 	hheader = NULL;
     }
     SFREE(linebuf);
     if (nosig == 0 && maxhsig != 0)
-	hsdfree();
+	hsdfree(ctx);
 }
 
-int osigclose(void)
+int osigclose(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     struct osdata *os;
     struct ogdata *og;
     WFDB_Group g;
@@ -302,7 +332,7 @@ int osigclose(void)
 	if (ogd && (og = ogd[g]))
 	    og->force_flush = 1;
 
-    wfdb_osflush();
+    wfdb_osflush_ctx(ctx);
 
     if (osd) {
 	while (maxosig)
@@ -321,7 +351,7 @@ int osigclose(void)
 	    if (og = ogd[--maxogroup]) {
 		if (og->fp) {
 		    if (og->flacenc)
-			flac_osclose(og);
+			flac_osclose(ctx, og);
 
 		    /* If a block size has been defined, null-pad the buffer */
 		    if (og->bsize)
@@ -340,8 +370,9 @@ int osigclose(void)
 			og->fp = NULL;
 		    }
 		    if (errflag) {
-			wfdb_error("osigclose: write error"
-				   " in signal group %d\n", maxogroup);
+			wfdb_error_ctx(ctx,
+				       "osigclose: write error in signal "
+				       "group %d\n", maxogroup);
 			stat = -4;
 		    }
 		}
@@ -358,18 +389,48 @@ int osigclose(void)
 	if (wfdb_fclose(oheader))
 	    errflag = 1;
 	if (errflag) {
-	    wfdb_error("osigclose: write error in header file\n");
+	    wfdb_error_ctx(ctx, "osigclose: write error in header file\n");
 	    stat = -4;
 	}
 	if (outinfo == oheader) outinfo = NULL;
 	oheader = NULL;
     }
     if (nisig == 0 && maxhsig != 0)
-	hsdfree();
+	hsdfree(ctx);
 
     return (stat);
 }
 
+/* Mark the input signals that are not selected (see isigselect), and set
+   up the signal groups to skip their samples. */
+static void isigselapply(WFDB_Context *ctx)
+{
+    struct isdata *is;
+    WFDB_Signal s, v;
+    WFDB_Group g;
+
+    for (s = 0; s < nisig; s++) {
+	is = isd[s];
+	if (isigsel == NULL)
+	    is->skip = 0;
+	else if (need_sigmap) {
+	    /* In a variable-layout record, the signals of each segment are
+	       matched with those of the layout by description, as in
+	       sigmap_init. */
+	    for (is->skip = 1, v = 0; v < nvsig && v < nisigsel; v++)
+		if (isigsel[v] &&
+		    strcmp(vsd[v]->info.desc, is->info.desc) == 0)
+		    is->skip = 0;
+	}
+	else
+	    is->skip = (s >= nisigsel || !isigsel[s]);
+	if (is->skip)
+	    is->nocksum = 1;
+    }
+    for (g = 0; g < nigroup; g++)
+	isgselect(ctx, g);
+}
+
 /* WFDB library functions. */
 
 int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsig)
@@ -379,26 +440,29 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
     struct hsdata *hs;
     struct isdata *is;
     struct igdata *ig;
-    WFDB_Signal s, si, sj;
+    WFDB_Signal s, si, sj, sk;
     WFDB_Group g;
 
     /* Close previously opened input signals unless otherwise requested. */
     if (*record == '+') record++;
-    else isigclose();
+    else isigclose(ctx);
 
     /* Remove trailing .hea, if any, from record name. */
     wfdb_striphea(record);
 
     /* Save the current record name. */
-    if (!in_msrec) wfdb_setirec(record);
+    if (!in_msrec) wfdb_setirec_ctx(ctx, record);
+
+    /* If this segment has been prefetched, take over the results. */
+    if (in_msrec) segadopt(ctx, record);
 
     /* Read the header and determine how many signals are available. */
-    if ((navail = readheader(record)) <= 0) {
+    if ((navail = readheader(ctx, record)) <= 0) {
 	if (navail == 0 && segments) {	/* this is a multi-segment record */
 	    in_msrec = 1;
 	    first_segment = 1;
 	    /* Open the first segment to get signal information. */
-	    if (segp && (navail = readheader(segp->recname)) >= 0) {
+	    if (segp && (navail = readheader(ctx, segp->recname)) >= 0) {
 		if (msbtime == 0L) msbtime = btime;
 		if (msbdate == (WFDB_Date)0) msbdate = bdate;
 	    }
@@ -406,7 +470,8 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
 		in_msrec = 0;
 	}
 	if (navail == 0 && nsig)
-	    wfdb_error("isigopen: record %s has no signals\n", record);
+	    wfdb_error_ctx(ctx, "isigopen: record %s has no signals\n",
+			   record);
 	if (navail <= 0)
 	    return (navail);
     }
@@ -431,17 +496,22 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
 
     /* Allocate input signals and signal group workspace. */
     nn = nisig + nsig;
-    if (allocisig(nn) != nn)
+    if (allocisig(ctx, nn) != nn)
 	return (-1);	/* failed, nisig is unchanged, allocisig emits error */
     nn = nigroup + hsd[navail-1]->info.group + 1;
     if (nn > nigroup + nsig)
 	nn = nigroup + nsig;
-    if (allocigroup(nn) != nn)
+    if (allocigroup(ctx, nn) != nn)
 	return (-1);	/* failed, allocigroup emits error */
 
     /* Set default buffer size (if not set already by setibsize). */
     if (ibsize <= 0) ibsize = BUFSIZ;
 
+    /* Determine whether to map signal files (if not set already by
+       setimmap). */
+    if (immap == 0) setimmap_ctx(ctx, -1);
+    if (iseekint == 0) setiseekindex_ctx(ctx, -1);
+
     /* Open the signal files.  One signal group is handled per iteration.  In
        this loop, si counts through the entries that have been read from hsd,
        and s counts the entries that have been added to isd. */
@@ -466,22 +536,35 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
 	    if ((ig->bsize = hs->info.bsize) == 0) ig->bsize = ibsize;
 	    ig->seek = 1;
 	}
-	SALLOC(ig->buf, 1, ig->bsize);
 
 	/* Check that the signal file is readable. */
 	if (hs->info.fmt == 0)
 	    ig->fp = NULL;	/* Don't open a file for a null signal. */
 	else {
-	    ig->fp = wfdb_open(hs->info.fname, (char *)NULL, WFDB_READ);
+	    if ((ig->fp = segfopen(ctx, hs->info.fname)) == NULL)
+		ig->fp = wfdb_open_ctx(ctx, hs->info.fname, (char *)NULL,
+				       WFDB_READ);
 	    /* Skip this group if the signal file can't be opened. */
-	    if (ig->fp == NULL) {
-	        SFREE(ig->buf);
+	    if (ig->fp == NULL)
 		continue;
-	    }
+	    isgbcinit(ctx, ig, hs->info.fmt);
 	}
 
+	/* If possible and requested, map the signal file into memory and
+	   read from the mapping directly;  otherwise allocate a buffer.  The
+	   mapped file's own read pointer is left at the end of the file, so
+	   that r8() finds end-of-file when the mapped data are exhausted. */
+	if (immap > 0 && ig->fp && ig->seek && !isflacfmt(hs->info.fmt) &&
+	    wfdb_fmap(ig->fp) == 0) {
+	    (void)wfdb_fseek(ig->fp, 0L, SEEK_END);
+	    ig->buf = ig->fp->map;
+	    ig->bsize = 0;
+	}
+	else
+	    SALLOC(ig->buf, 1, ig->bsize);
+
 	if (isflacfmt(hs->info.fmt)) {
-	    if (flac_isopen(ig, &hsd[si], sj - si) < 0) {
+	    if (flac_isopen(ctx, ig, &hsd[si], sj - si) < 0) {
 		SFREE(ig->buf);
 		wfdb_fclose(ig->fp);
 		continue;
@@ -489,10 +572,21 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
 	}
 
 	/* All tests passed -- fill in remaining data for this group. */
-	ig->be = ig->bp = ig->buf + ig->bsize;
+	if (ig->fp && ig->fp->type == WFDB_MMAP) {
+	    ig->be = ig->buf + ig->fp->maplen;
+	    ig->bp = (hs->start < ig->fp->maplen) ? ig->buf + hs->start : ig->be;
+	}
+	else
+	    ig->be = ig->bp = ig->buf + ig->bsize;
 	ig->start = hs->start;
 	ig->initial_skip = (ig->start > 0);
 	ig->stat = 1;
+	ig->count = 0;
+	ig->nsig = sj - si;
+	isgrainit(ctx, ig);
+	for (nn = 0, sk = si; sk < sj; sk++)
+	    nn += hsd[sk]->info.spf;
+	isgdecoder(ig, hs->info.fmt, nn);
 	while (si < sj && s < nsig) {
 	    copysi(&is->info, &hs->info);
 	    is->info.group = nigroup + g;
@@ -503,14 +597,22 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
 		is = isd[nisig + s];
 	    }
 	}
+	/* Keep checkpoints for a format 8 group if setiseekindex has enabled
+	   them and all of the group's signals are open. */
+	if (iseekint > 0 && ig->seek && si == sj &&
+	    isd[nisig + s - 1]->info.fmt == 8) {
+	    ig->cpint = iseekint;
+	    ig->frame = ig->initial_skip ? -1 : 0;
+	}
 	g++;
     }
 
     /* Produce a warning message if none of the requested signals could be
        opened. */
     if (s == 0 && nsig)
-	wfdb_error("isigopen: none of the signals for record %s is readable\n",
-		 record);
+	wfdb_error_ctx(ctx,
+		       "isigopen: none of the signals for record %s "
+		       "is readable\n", record);
 
     /* Check that the total number of samples per frame is less than
        or equal to INT_MAX. */
@@ -518,9 +620,10 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
     for (si = 0; si < s; si++) {
 	spflimit -= isd[nisig + si]->info.spf;
 	if (spflimit < 0) {
-	    wfdb_error("isigopen: total frame size too large in record %s\n",
-		       record);
-	    isigclose();
+	    wfdb_error_ctx(ctx,
+			   "isigopen: total frame size too large in record "
+			   "%s\n", record);
+	    isigclose(ctx);
 	    return (-3);
 	}
     }
@@ -538,12 +641,13 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
     }
     nisig += s;		/* Update the count of open input signals. */
     nigroup += g;	/* Update the count of open input signal groups. */
-    if (sigmap_init(first_segment) < 0) {
-	isigclose();
+    if (sigmap_init(ctx, first_segment) < 0) {
+	isigclose(ctx);
 	return (-3);
     }
+    isigselapply(ctx);
     spfmax = ispfmax;
-    setgvmode(gvmode);	/* Reset sfreq if appropriate. */
+    setgvmode_ctx(ctx, gvmode);	/* Reset sfreq if appropriate. */
     gvc = ispfmax;	/* Initialize getvec's sample-within-frame counter. */
 
     /* Determine the total number of samples per frame. */
@@ -561,16 +665,22 @@ int isigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, int nsi
     /* If deskewing is required, allocate the deskewing buffer (unless this is
        a multi-segment record and dsbuf has been allocated already). */
     if (skewmax != 0 && (!in_msrec || dsbuf == NULL)) {
-	if (tspf > INT_MAX / (skewmax + 1)) {
-	    wfdb_error("isigopen: maximum skew too large in record %s\n",
-		       record);
-	    isigclose();
+	if (tspf > INT_MAX / (skewmax + 1 + WFDB_DSBLK)) {
+	    wfdb_error_ctx(ctx,
+			   "isigopen: maximum skew too large in record %s\n",
+			   record);
+	    isigclose(ctx);
 	    return (-3);
 	}
 	dsbi = -1;	/* mark buffer contents as invalid */
 	dsblen = tspf * (skewmax + 1);
-	SALLOC(dsbuf, dsblen, sizeof(WFDB_Sample));
+	SALLOC(dsbuf, dsblen + tspf * WFDB_DSBLK, sizeof(WFDB_Sample));
     }
+
+    /* If a multi-segment record has just been opened, start reading ahead
+       into its second segment. */
+    if (first_segment && segp < segend)
+	segprefetch(ctx, (segp+1)->recname);
     return (s);
 }
 
@@ -579,19 +689,18 @@ int isigopen(char *record, WFDB_Siginfo *siarray, int nsig)
     return isigopen_ctx(wfdb_get_default_context(), record, siarray, nsig);
 }
 
-static int openosig(const char *func, WFDB_Siginfo *si_out,
+static int openosig(WFDB_Context *ctx, const char *func, WFDB_Siginfo *si_out,
 		    const WFDB_Siginfo *si_in, unsigned int nsig)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     struct osdata *os, *op;
     struct ogdata *og;
     WFDB_Signal s;
     unsigned int ga;
 
     /* Allocate workspace for output signals. */
-    if (allocosig(nosig + nsig) < 0) return (-3);
+    if (allocosig(ctx, nosig + nsig) < 0) return (-3);
     /* Allocate workspace for output signal groups. */
-    if (allocogroup(nogroup + si_in[nsig-1].group + 1) < 0) return (-3);
+    if (allocogroup(ctx, nogroup + si_in[nsig-1].group + 1) < 0) return (-3);
 
     /* Initialize local variables. */
     if (obsize <= 0) obsize = BUFSIZ;
@@ -627,8 +736,8 @@ static int openosig(const char *func, WFDB_Siginfo *si_out,
 		unsigned ns = 1;
 		while (s + ns < nsig && si_in[ns].group == si_in[0].group)
 		    ns++;
-		if (flac_osinit(og, si_in, ns) < 0) {
-		    osigclose();
+		if (flac_osinit(ctx, og, si_in, ns) < 0) {
+		    osigclose(ctx);
 		    return (-3);
 		}
 	    }
@@ -638,6 +747,7 @@ static int openosig(const char *func, WFDB_Siginfo *si_out,
 	    SALLOC(og->buf, 1, obuflen);
 	    og->bp = og->buf;
 	    og->be = og->buf + obuflen;
+	    og->spf = 0;
 	    if (os->info.fmt == 0) {
 		/* If the signal file name was NULL or "~", don't create a
 		   signal file. */
@@ -650,31 +760,35 @@ static int openosig(const char *func, WFDB_Siginfo *si_out,
 	    }
 	    if (os->info.fmt != 0) {
 		/* An error in opening an output file is fatal. */
-		og->fp = wfdb_open(os->info.fname,(char *)NULL, WFDB_WRITE);
+		og->fp = wfdb_open_ctx(ctx, os->info.fname, (char *)NULL,
+				       WFDB_WRITE);
 		if (og->fp == NULL) {
-		    wfdb_error("%s: can't open %s\n", func, os->info.fname);
+		    wfdb_error_ctx(ctx, "%s: can't open %s\n", func,
+				   os->info.fname);
 		    SFREE(og->buf);
-		    osigclose();
+		    osigclose(ctx);
 		    return (-3);
 		}
 	    }
-	    if (isflacfmt(os->info.fmt) && flac_osopen(og) < 0) {
+	    if (isflacfmt(os->info.fmt) && flac_osopen(ctx, og) < 0) {
 		SFREE(og->buf);
-		osigclose();
+		osigclose(ctx);
 		return (-3);
 	    }
+	    osgencoder(og, os->info.fmt);
 	    nogroup++;
 	}
 	else {
 	    /* This signal belongs to the same group as the previous signal. */
 	    if (os->info.fmt != op->info.fmt ||
 		os->info.bsize != op->info.bsize) {
-		wfdb_error(
-		    "%s: error in specification of signal %d or %d\n",
-		    func, s-1, s);
+		wfdb_error_ctx(ctx,
+			       "%s: error in specification of signal %d or "
+			       "%d\n", func, s-1, s);
 		return (-2);
 	    }
 	}
+	og->spf += os->info.spf;
     }
     return (s);
 }
@@ -687,16 +801,17 @@ int osigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, unsigne
 
     /* Close previously opened output signals unless otherwise requested. */
     if (*record == '+') record++;
-    else osigclose();
+    else osigclose(ctx);
 
     /* Remove trailing .hea, if any, from record name. */
     wfdb_striphea(record);
 
-    if ((n = readheader(record)) < 0)
+    if ((n = readheader(ctx, record)) < 0)
 	return (n);
     if (n < nsig) {
-	wfdb_error("osigopen: record %s has fewer signals than needed\n",
-		 record);
+	wfdb_error_ctx(ctx,
+		       "osigopen: record %s has fewer signals than needed\n",
+		       record);
 	return (-3);
     }
 
@@ -704,7 +819,7 @@ int osigopen_ctx(WFDB_Context *ctx, char *record, WFDB_Siginfo *siarray, unsigne
     if (!hsi) return (-3);
     for (s = 0; s < nsig; s++)
 	hsi[s] = hsd[s]->info;
-    s = openosig("osigopen", siarray, hsi, nsig);
+    s = openosig(ctx, "osigopen", siarray, hsi, nsig);
     SFREE(hsi);
     return (s);
 }
@@ -720,7 +835,7 @@ int osigfopen_ctx(WFDB_Context *ctx, const WFDB_Siginfo *siarray, unsigned int n
     const WFDB_Siginfo *si;
 
     /* Close any open output signals. */
-    stat = osigclose();
+    stat = osigclose(ctx);
 
     /* Do nothing further if there are no signals to open. */
     if (siarray == NULL || nsig == 0) return (stat);
@@ -737,8 +852,9 @@ int osigfopen_ctx(WFDB_Context *ctx, const WFDB_Siginfo *siarray, unsigned int n
 	   at zero and increase in steps of 1. */
 	if (strlen(si->fname) + strlen(si->desc) > 200 ||
 	    si->bsize < 0 || !isfmt(si->fmt)) {
-	    wfdb_error("osigfopen: error in specification of signal %d\n",
-		       s);
+	    wfdb_error_ctx(ctx,
+			   "osigfopen: error in specification of signal %d\n",
+			   s);
 	    return (-2);
 	}
 	if (!((s == 0 && si->group == 0) ||
@@ -746,14 +862,14 @@ int osigfopen_ctx(WFDB_Context *ctx, const WFDB_Siginfo *siarray, unsigned int n
 	     strcmp(si->fname, (si-1)->fname) == 0) ||
 	    (s && si->group == (si-1)->group + 1 &&
 	     strcmp(si->fname, (si-1)->fname) != 0))) {
-	    wfdb_error(
-		     "osigfopen: incorrect file name or group for signal %d\n",
-		     s);
+	    wfdb_error_ctx(ctx,
+			   "osigfopen: incorrect file name or group for "
+			   "signal %d\n", s);
 	    return (-2);
 	}
     }
 
-    return (openosig("osigfopen", NULL, siarray, nsig));
+    return (openosig(ctx, "osigfopen", NULL, siarray, nsig));
 }
 
 int osigfopen(const WFDB_Siginfo *siarray, unsigned int nsig)
@@ -874,7 +990,7 @@ int setifreq_ctx(WFDB_Context *ctx, WFDB_Frequency f)
 
     if (g <= 0.0) {
 	ifreq = 0.0;
-	wfdb_error("setifreq: no open input record\n");
+	wfdb_error_ctx(ctx, "setifreq: no open input record\n");
 	return (-1);
     }
     if (f > 0.0) {
@@ -882,7 +998,8 @@ int setifreq_ctx(WFDB_Context *ctx, WFDB_Frequency f)
 	    SREALLOC(gv0, nvsig, sizeof(WFDB_Sample));
 	    SREALLOC(gv1, nvsig, sizeof(WFDB_Sample));
 	}
-	setafreq(ifreq = f);
+	setafreq_ctx(ctx, ifreq = f);
+	if (rsfilter == 0) setiresamp_ctx(ctx, -1);
 	/* The 0.005 below is the maximum tolerable error in the resampling
 	   frequency (in Hz).  The code in the while loop implements Euclid's
 	   algorithm for finding the greatest common divisor of two integers,
@@ -898,11 +1015,15 @@ int setifreq_ctx(WFDB_Context *ctx, WFDB_Frequency f)
 	/* Raw and resampled intervals begin simultaneously once every mnticks
 	   subintervals; we say an epoch begins at these times. */
 	mnticks = mticks * nticks;
+	/* If a FIR resampler has been selected (see setiresamp), it reads
+	   the input itself. */
+	if (ifreq != sfreq && rsfinit(ctx, 0L, 0L))
+	    return (0);
 	/* gvtime is the number of subintervals from the beginning of the
 	   current epoch to the next sample to be returned by getvec(). */
 	gvtime = 0;
-	rgvstat = rgetvec(gv0);
-	rgvstat = rgetvec(gv1);
+	rgvstat = rgetvec(ctx, gv0);
+	rgvstat = rgetvec(ctx, gv1);
 	/* rgvtime is the number of subintervals from the beginning of the
 	   current epoch to the most recent sample returned by rgetvec(). */
 	rgvtime = nticks;
@@ -910,7 +1031,8 @@ int setifreq_ctx(WFDB_Context *ctx, WFDB_Frequency f)
     }
     else {
 	ifreq = 0.0;
-	wfdb_error("setifreq: improper frequency %g (must be > 0)\n", f);
+	wfdb_error_ctx(ctx, "setifreq: improper frequency %g (must be > 0)\n",
+		       f);
 	return (-1);
     }
 }
@@ -935,7 +1057,11 @@ int getvec_ctx(WFDB_Context *ctx, WFDB_Sample *vector)
     int i, nsig;
 
     if (ifreq == 0.0 || ifreq == sfreq)	/* no resampling necessary */
-	return (rgetvec(vector));
+	return (rgetvec(ctx, vector));
+    if (rsf) {				/* resample using the FIR filter */
+	(void)rsfgetvecs(ctx, vector, 1L);
+	return (rgvstat);
+    }
 
     /* Resample the input. */
     if (rgvtime > mnticks) {
@@ -946,7 +1072,7 @@ int getvec_ctx(WFDB_Context *ctx, WFDB_Sample *vector)
     while (gvtime > rgvtime) {
 	for (i = 0; i < nsig; i++)
 	    gv0[i] = gv1[i];
-	rgvstat = rgetvec(gv1);
+	rgvstat = rgetvec(ctx, gv1);
 	rgvtime += nticks;
     }
     for (i = 0; i < nsig; i++) {
@@ -962,43 +1088,383 @@ int getvec(WFDB_Sample *vector)
     return getvec_ctx(wfdb_get_default_context(), vector);
 }
 
+/* getvecs reads up to nframes consecutive sample vectors (as returned by
+   getvec) into buf, which must have room for nframes * nsig samples, where
+   nsig is the number of input signals.  Vectors are stored one after
+   another (sample i of vector j is in buf[j*nsig + i]).  The value returned
+   is the number of vectors read; this is less than nframes only if the end
+   of the input was reached or an error occurred.  If no vectors could be
+   read, the (negative) status that getvec would have returned is returned
+   instead.  If the last vector read failed its checksum, it is counted, and
+   the next call returns -4 without reading anything (see getframes). */
+long getvecs_ctx(WFDB_Context *ctx, WFDB_Sample *buf, long nframes)
+{
+    int stat;
+
+    if (nframes <= 0) return (0L);
+    if (gvpend) {	/* report a checksum error found by the last call */
+	stat = gvpend;
+	gvpend = 0;
+	return (stat);
+    }
+    if (nvsig <= 0) return (getvec_ctx(ctx, buf));
+    if (ifreq == 0.0 || ifreq == sfreq)	/* no resampling necessary */
+	return (rgetvecs(ctx, buf, nframes));
+    if (rsf)				/* resample using the FIR filter */
+	return (rsfgetvecs(ctx, buf, nframes));
+    return (rslgetvecs(ctx, buf, nframes));
+}
+
+long getvecs(WFDB_Sample *buf, long nframes)
+{
+    return getvecs_ctx(wfdb_get_default_context(), buf, nframes);
+}
+
+/* getdsframes reads up to n (at most WFDB_DSBLK) frames into buf, deskewing
+   them, and stopping after the first frame for which getskewedframe does not
+   return a positive status.  The number of frames assembled is stored in *np,
+   and the status of the last frame read is returned.
+
+   Frame k of the output requires the samples of each signal s from input
+   frame k + skew[s], so that input frames are read skewmax frames ahead of
+   the output.  dsbuf holds a window of consecutive input frames, of which
+   the dsbi'th is the input frame for the next output frame, and the first
+   dsnf have been read.  Each signal's samples are copied for a block of
+   frames at once from a fixed offset in the window;  when the window is
+   full, the skewmax frames still needed are moved to the beginning of
+   dsbuf, so that frames never wrap around the end of dsbuf. */
+static int getdsframes(WFDB_Context *ctx, WFDB_Sample *buf, long n, long *np)
+{
+    const WFDB_Sample *p;
+    WFDB_Sample *q;
+    int c, j, maxskew = dsblen / tspf - 1, s, sk, stat = -1;
+    long k, m = 0;
+
+    if (dsbi < 0) {	/* dsbuf contents are invalid -- refill dsbuf */
+	dsbi = dsnf = 0;
+	while (dsnf < maxskew)
+	    if ((stat = getskewedframe(ctx, dsbuf + tspf * dsnf++)) < 0)
+		break;
+	if (stat < 0) {	/* return the (partial) first frame */
+	    m = n = 1;
+	    istime++;
+	}
+    }
+    else if (dsnf + n > maxskew + WFDB_DSBLK) {
+	(void)memmove(dsbuf, dsbuf + tspf * dsbi,
+		      tspf * (dsnf - dsbi) * sizeof(WFDB_Sample));
+	dsnf -= dsbi;
+	dsbi = 0;
+    }
+
+    /* Read the input frames needed.  istime is advanced after each one, as
+       by getframe, since getskewedframe treats a frame read while istime is
+       0 as the first of the record (and may reset istime at the beginning
+       of a segment). */
+    while (m < n) {
+	stat = getskewedframe(ctx, dsbuf + tspf * dsnf++);
+	istime++;
+	m++;
+	if (stat <= 0)
+	    break;
+    }
+
+    /* Assemble the deskewed frames from the data in dsbuf. */
+    for (j = s = 0; s < nvsig; j += c, s++) {
+	c = vsd[s]->info.spf;
+	if ((sk = vsd[s]->skew) > maxskew) sk = maxskew;
+	p = dsbuf + tspf * (dsbi + sk) + j;
+	q = buf + j;
+	if (c == 1)
+	    for (k = 0; k < m; k++, p += tspf, q += tspf)
+		*q = *p;
+	else
+	    for (k = 0; k < m; k++, p += tspf, q += tspf)
+		(void)memcpy(q, p, c * sizeof(WFDB_Sample));
+    }
+    dsbi += m;
+    *np = m;
+    return (stat);
+}
+
 int getframe_ctx(WFDB_Context *ctx, WFDB_Sample *vector)
 {
-    int stat = -1;
+    int stat;
+    long n;
+
+    if (dsbuf)		/* signals must be deskewed */
+	return (getdsframes(ctx, vector, 1L, &n));
+    stat = getskewedframe(ctx, vector);
+    istime++;
+    return (stat);
+}
+
+int getframe(WFDB_Sample *vector)
+{
+    return getframe_ctx(wfdb_get_default_context(), vector);
+}
+
+/* getframes is to getframe as getvecs is to getvec:  it reads up to
+   nframes consecutive frames into buf, each occupying as many elements as
+   are filled by a single call to getframe (the sum of the samples per frame
+   of all input signals).
 
+   A frame that fails its checksum (for which getframe would return -4) is
+   stored and counted like any other, but it ends the block;  its status is
+   saved in gvpend, and returned by the next call of getframes or getvecs,
+   which reads nothing.  (isigsettime discards it.) */
+long getframes_ctx(WFDB_Context *ctx, WFDB_Sample *buf, long nframes)
+{
+    int flen, stat = 0;
+    long n;
+
+    if (nframes <= 0) return (0L);
+    if (gvpend) {	/* report a checksum error found by the last call */
+	stat = gvpend;
+	gvpend = 0;
+	return (stat);
+    }
+    if ((flen = tspf) <= 0) return (getframe_ctx(ctx, buf));
     if (dsbuf) {	/* signals must be deskewed */
-	int c, i, j, s;
+	long m;
 
-	/* First, obtain the samples needed. */
-	if (dsbi < 0) {	/* dsbuf contents are invalid -- refill dsbuf */
-	    for (dsbi = i = 0; i < dsblen; dsbi = i += tspf) {
-		stat = getskewedframe(dsbuf + dsbi);
-		if (stat < 0)
-		    break;
+	for (n = 0; n < nframes; n += m, buf += m * flen) {
+	    stat = getdsframes(ctx, buf, nframes - n > WFDB_DSBLK ?
+			       WFDB_DSBLK : nframes - n, &m);
+	    if (stat <= 0) {
+		n += m - (stat != -4);
+		break;
 	    }
-	    dsbi = 0;
 	}
-	else {		/* replace oldest frame in dsbuf only */
-	    stat = getskewedframe(dsbuf + dsbi);
-	    if ((dsbi += tspf) >= dsblen) dsbi = 0;
+    }
+    else
+	for (n = 0; n < nframes; n++, buf += flen) {
+	    long m;
+
+	    /* Decode as many frames as possible at once (see getblkframes),
+	       then read the next frame with getframe. */
+	    if ((m = getblkframes(ctx, buf, nframes - n)) > 0) {
+		n += m;
+		buf += m * flen;
+		if (n == nframes) break;
+	    }
+	    if ((stat = getframe_ctx(ctx, buf)) <= 0) {
+		if (stat == -4) n++;
+		break;
+	    }
 	}
+    if (stat == -4) gvpend = stat;
+    return ((n > 0 || stat >= 0) ? n : stat);
+}
+
+long getframes(WFDB_Sample *buf, long nframes)
+{
+    return getframes_ctx(wfdb_get_default_context(), buf, nframes);
+}
+
+/* getphysblk, getvecsp, and getblk16 (below) use physblk to read up to k
+   vectors (or frames, if frames is nonzero) of len samples each into
+   physbuf, growing it as needed to hold WFDB_PHYSBLK of them.  The value
+   returned is that of getvecs (or getframes).  *endp is set if the caller
+   should stop after this block:  because fewer than k were read, or because
+   the last one failed its checksum.  In the latter case the -4 is left in
+   gvpend, so that it is reported by the caller's next call (as by getvecs)
+   rather than lost when the caller reads its next block. */
+static long physblk(WFDB_Context *ctx, long k, int len, int frames,
+		    int *endp)
+{
+    long m;
+
+    if (physbuflen < WFDB_PHYSBLK * len) {
+	SREALLOC(physbuf, WFDB_PHYSBLK * len, sizeof(WFDB_Sample));
+	physbuflen = WFDB_PHYSBLK * len;
+    }
+    m = frames ? getframes_ctx(ctx, physbuf, k) :
+	getvecs_ctx(ctx, physbuf, k);
+    *endp = (m < k || gvpend != 0);
+    return (m);
+}
+
+/* getphys and getphysf read up to nframes sample vectors (as getvecs does),
+   and store them in buf in physical units, as doubles or floats respectively.
+   Each sample is converted as by aduphys, except that invalid samples become
+   NaN.  If layout is WFDB_INTERLEAVED, the vectors are stored one after
+   another, as by getvecs;  if layout is WFDB_PLANAR, the samples of each
+   signal are stored together (sample j of signal i is in buf[i*nframes+j]).
+   The value returned is as for getvecs.
+
+   getphysblk does the work for both:  it reads WFDB_PHYSBLK vectors at a time
+   into physbuf, then converts them one signal at a time, so that the gain and
+   baseline of each signal are looked up once per block rather than once per
+   sample. */
+static long getphysblk(WFDB_Context *ctx, double *dbuf, float *fbuf,
+		       long nframes, int layout)
+{
+    const WFDB_Sample *in;
+    double b, g;
+    long k, m, n, stride;
+    int end, nsig = nvsig, s;
+
+    if (layout != WFDB_INTERLEAVED && layout != WFDB_PLANAR) {
+	wfdb_error_ctx(ctx, "getphys: improper layout %d\n", layout);
+	return (-1L);
+    }
+    if (nsig <= 0 || nframes <= 0)
+	return (nsig <= 0 ? -1L : 0L);
+    stride = (layout == WFDB_PLANAR) ? 1 : nsig;
+    for (n = 0; n < nframes; n += m) {
+	k = (nframes - n > WFDB_PHYSBLK) ? WFDB_PHYSBLK : nframes - n;
+	if ((m = physblk(ctx, k, nsig, 0, &end)) <= 0)
+	    return (n > 0 ? n : m);
+	for (s = 0; s < nsig; s++) {
+	    long o = (layout == WFDB_PLANAR) ? s * nframes + n : n * nsig + s;
+
+	    b = vsd[s]->info.baseline;
+	    if ((g = vsd[s]->info.gain) == 0.) g = WFDB_DEFGAIN;
+	    in = physbuf + s;
+	    if (dbuf) {
+		double *out = dbuf + o;
+
+		for (k = 0; k < m; k++)
+		    out[k*stride] = (in[k*nsig] == WFDB_INVALID_SAMPLE) ?
+			NAN : (in[k*nsig] - b) / g;
+	    }
+	    else {
+		float *out = fbuf + o;
 
-	/* Assemble the deskewed frame from the data in dsbuf. */
-	for (j = s = 0; s < nvsig; s++) {
-	    if ((i = j + dsbi + vsd[s]->skew*tspf) >= dsblen) i %= dsblen;
-	    for (c = 0; c < vsd[s]->info.spf; c++)
-		vector[j++] = dsbuf[i++];
+		for (k = 0; k < m; k++)
+		    out[k*stride] = (in[k*nsig] == WFDB_INVALID_SAMPLE) ?
+			NAN : (float)((in[k*nsig] - b) / g);
+	    }
+	}
+	if (end) {
+	    n += m;
+	    break;
 	}
     }
-    else		/* no deskewing necessary */
-	stat = getskewedframe(vector);
-    istime++;
-    return (stat);
+    return (n);
 }
 
-int getframe(WFDB_Sample *vector)
+long getphys_ctx(WFDB_Context *ctx, double *buf, long nframes, int layout)
 {
-    return getframe_ctx(wfdb_get_default_context(), vector);
+    return getphysblk(ctx, buf, NULL, nframes, layout);
+}
+
+long getphys(double *buf, long nframes, int layout)
+{
+    return getphys_ctx(wfdb_get_default_context(), buf, nframes, layout);
+}
+
+long getphysf_ctx(WFDB_Context *ctx, float *buf, long nframes, int layout)
+{
+    return getphysblk(ctx, NULL, buf, nframes, layout);
+}
+
+long getphysf(float *buf, long nframes, int layout)
+{
+    return getphysf_ctx(wfdb_get_default_context(), buf, nframes, layout);
+}
+
+/* getvecsp reads up to nframes sample vectors (as getvecs does), storing the
+   samples of each signal i contiguously in the caller's array sigbuf[i],
+   which must have room for nframes samples.  If sigbuf[i] is NULL, the
+   samples of signal i are discarded.  The value returned is as for getvecs.
+
+   Vectors are read WFDB_PHYSBLK at a time into physbuf, which is small
+   enough to remain in cache while it is scattered into the output arrays;
+   each signal's samples are then copied in one pass over the block. */
+long getvecsp_ctx(WFDB_Context *ctx, WFDB_Sample **sigbuf, long nframes)
+{
+    const WFDB_Sample *in;
+    WFDB_Sample *out;
+    long k, m, n;
+    int end, nsig = nvsig, s;
+
+    if (nsig <= 0 || nframes <= 0)
+	return (nsig <= 0 ? -1L : 0L);
+    for (n = 0; n < nframes; n += m) {
+	k = (nframes - n > WFDB_PHYSBLK) ? WFDB_PHYSBLK : nframes - n;
+	if ((m = physblk(ctx, k, nsig, 0, &end)) <= 0)
+	    return (n > 0 ? n : m);
+	for (s = 0; s < nsig; s++) {
+	    if ((out = sigbuf[s]) == NULL)
+		continue;
+	    out += n;
+	    in = physbuf + s;
+	    for (k = 0; k < m; k++, in += nsig)
+		out[k] = *in;
+	}
+	if (end) {
+	    n += m;
+	    break;
+	}
+    }
+    return (n);
+}
+
+long getvecsp(WFDB_Sample **sigbuf, long nframes)
+{
+    return getvecsp_ctx(wfdb_get_default_context(), sigbuf, nframes);
+}
+
+/* getvecs16 and getframes16 are equivalent to getvecs and getframes, except
+   that they store samples as 16-bit WFDB_Sample16 values, which halves the
+   memory needed to hold the samples of a record in formats of up to 16 bits.
+   Invalid samples become WFDB_INVALID_SAMPLE16;  other samples are clipped
+   to the range WFDB_SAMPLE16_MIN to WFDB_SAMPLE16_MAX.
+
+   getblk16 does the work for both:  it reads WFDB_PHYSBLK vectors or frames
+   at a time into physbuf, and narrows them into buf. */
+static long getblk16(WFDB_Context *ctx, WFDB_Sample16 *buf, long nframes,
+		     int frames)
+{
+    const WFDB_Sample *in;
+    WFDB_Sample v;
+    long i, k, m, n;
+    int end, len = frames ? tspf : nvsig;
+
+    if (len <= 0 || nframes <= 0)
+	return (len <= 0 ? -1L : 0L);
+    for (n = 0; n < nframes; n += m, buf += m * len) {
+	k = (nframes - n > WFDB_PHYSBLK) ? WFDB_PHYSBLK : nframes - n;
+	if ((m = physblk(ctx, k, len, frames, &end)) <= 0)
+	    return (n > 0 ? n : m);
+	for (i = 0, in = physbuf; i < m * len; i++) {
+	    if ((v = in[i]) == WFDB_INVALID_SAMPLE)
+		buf[i] = WFDB_INVALID_SAMPLE16;
+	    else if (v < WFDB_SAMPLE16_MIN)
+		buf[i] = WFDB_SAMPLE16_MIN;
+	    else if (v > WFDB_SAMPLE16_MAX)
+		buf[i] = WFDB_SAMPLE16_MAX;
+	    else
+		buf[i] = (WFDB_Sample16)v;
+	}
+	if (end) {
+	    n += m;
+	    break;
+	}
+    }
+    return (n);
+}
+
+long getvecs16_ctx(WFDB_Context *ctx, WFDB_Sample16 *buf, long nframes)
+{
+    return getblk16(ctx, buf, nframes, 0);
+}
+
+long getvecs16(WFDB_Sample16 *buf, long nframes)
+{
+    return getvecs16_ctx(wfdb_get_default_context(), buf, nframes);
+}
+
+long getframes16_ctx(WFDB_Context *ctx, WFDB_Sample16 *buf, long nframes)
+{
+    return getblk16(ctx, buf, nframes, 1);
+}
+
+long getframes16(WFDB_Sample16 *buf, long nframes)
+{
+    return getframes16_ctx(wfdb_get_default_context(), buf, nframes);
 }
 
 int putvec_ctx(WFDB_Context *ctx, const WFDB_Sample *vector)
@@ -1062,11 +1528,11 @@ int putvec_ctx(WFDB_Context *ctx, const WFDB_Sample *vector)
 	      case 160:	/* 16-bit offset binary amplitudes */
 		w160(samp, og); os->samp = samp; break;
 	      case 212:	/* 2 12-bit amplitudes bit-packed in 3 bytes */
-		w212(samp, og); os->samp = samp; break;
+		w212(ctx, samp, og); os->samp = samp; break;
 	      case 310:	/* 3 10-bit amplitudes bit-packed in 4 bytes */
-		w310(samp, og); os->samp = samp; break;
+		w310(ctx, samp, og); os->samp = samp; break;
 	      case 311:	/* 3 10-bit amplitudes bit-packed in 4 bytes */
-		w311(samp, og); os->samp = samp; break;
+		w311(ctx, samp, og); os->samp = samp; break;
 	      case 24: /* 24-bit amplitudes */
 	        w24(samp, og); os->samp = samp; break;
 	      case 32: /* 32-bit amplitudes */
@@ -1075,13 +1541,13 @@ int putvec_ctx(WFDB_Context *ctx, const WFDB_Sample *vector)
 	      case 508: /* 8-bit compressed FLAC */
 	      case 516:	/* 16-bit compressed FLAC */
 	      case 524:	/* 24-bit compressed FLAC */
-		if (flac_putsamp(samp, os->info.fmt, og) < 0)
+		if (flac_putsamp(ctx, samp, os->info.fmt, og) < 0)
 		    stat = -1;
 		os->samp = samp;
 		break;
 	    }
 	    if (wfdb_ferror(og->fp)) {
-		wfdb_error("putvec: write error in signal %d\n", s);
+		wfdb_error_ctx(ctx, "putvec: write error in signal %d\n", s);
 		stat = -1;
 	    }
 	    else
@@ -1097,27 +1563,202 @@ int putvec(const WFDB_Sample *vector)
     return putvec_ctx(wfdb_get_default_context(), vector);
 }
 
+/* pvconvert: convert one frame of the samples of the output signal group
+   that begins with signal s, from *framep, into the values to be stored in
+   v, updating the checksums as putvec does.  *framep is advanced past these
+   samples, and the number of the first signal of the next group is
+   returned.  *statp is set to 0 if a format 8 first difference had to be
+   clipped. */
+static WFDB_Signal pvconvert(WFDB_Context *ctx, const WFDB_Sample **framep,
+			     WFDB_Sample *v, WFDB_Signal s, int *statp)
+{
+    int c, dif;
+    const WFDB_Sample *frame = *framep;
+    struct osdata *os;
+    WFDB_Group g = osd[s]->info.group;
+    WFDB_Sample samp, invalid = ogd[g]->invalid;
+
+    for ( ; s < nosig && osd[s]->info.group == g; s++) {
+	os = osd[s];
+	if (os->info.nsamp++ == (WFDB_Time)0L)
+	    os->info.initval = os->samp = *frame;
+	for (c = 0; c < os->info.spf; c++, frame++) {
+	    if ((samp = *frame) == WFDB_INVALID_SAMPLE)
+		samp = invalid;
+	    if (os->info.fmt == 8) {
+		/* Handle large slew rates sensibly. */
+		if ((dif = samp - os->samp) < -128) { dif = -128; *statp = 0; }
+		else if (dif > 127) { dif = 127; *statp = 0; }
+		os->samp += dif;
+		*v++ = dif;
+	    }
+	    else
+		*v++ = os->samp = samp;
+	    os->info.cksum += os->samp;
+	}
+    }
+    *framep = frame;
+    return (s);
+}
+
+/* putvecs writes n consecutive frames from the array frames, each laid out
+   as for putvec.  The samples written, and the checksums and initial values
+   recorded in the header, are the same as if putvec had been called n
+   times.  Each frame of each signal group is packed directly into the
+   group's output buffer;  if the record has only one signal group, in a
+   format that has a block packer (see sigpack.c), as many frames as fit in
+   the buffer are packed at once.  The file is written, and checked for
+   errors, only when a buffer is flushed.  The value returned is n if all
+   frames were written successfully, 0 if one or more first differences in a
+   format 8 signal had to be clipped (as for putvec), or -1 if a write error
+   occurred. */
+long putvecs_ctx(WFDB_Context *ctx, const WFDB_Sample *frames, long n)
+{
+    int c, err = 0, stat = 1;
+    long i, m, mmax = 0;
+    struct osdata *os;
+    struct ogdata *og;
+    WFDB_Group g;
+    WFDB_Signal s;
+    WFDB_Sample *v, *fv = NULL;
+    unsigned k, flen, gspfmax = 0, ufr = 0, ubytes = 0;
+
+    /* Records containing signals that have no frame encoder (null signals,
+       and FLAC-compressed signals if the library was built without FLAC
+       support) are written using putvec. */
+    for (g = 0; g < nogroup; g++) {
+	if (ogd[g]->encode == NULL) break;
+	if (gspfmax < ogd[g]->spf) gspfmax = ogd[g]->spf;
+    }
+    if (g < nogroup || nosig == 0) {
+	for (s = 0, flen = 0; s < nosig; s++)
+	    flen += osd[s]->info.spf;
+	for (i = 0; i < n; i++, frames += flen)
+	    if ((c = putvec_ctx(ctx, frames)) < 0)
+		return (-1);
+	    else if (c == 0 && nosig > 0)
+		stat = 0;
+	return (stat ? n : 0);
+    }
+
+    /* Check for a write error left over from a previous call. */
+    for (g = 0; g < nogroup; g++)
+	if (wfdb_ferror(ogd[g]->fp)) {
+	    wfdb_error_ctx(ctx, "putvecs: write error in signal group %d\n",
+			   g);
+	    return (-1);
+	}
+
+    /* Blocks of frames are packed in runs of ufr frames (ubytes bytes),
+       which fill a whole number of units of the group's format;  mmax is
+       the largest number of frames in a block. */
+    og = ogd[0];
+    if (nogroup == 1 && og->pack && og->spf > 0) {
+	ufr = (og->spf % og->unsamp) ? og->unsamp : 1;
+	ubytes = og->spf * ufr / og->unsamp * og->unbytes;
+	mmax = (WFDB_PVBLK / (og->spf * ufr)) * ufr;
+	if (mmax > n) mmax = n;
+    }
+    SUALLOC(fv, (unsigned)mmax * og->spf > gspfmax ? mmax * og->spf : gspfmax,
+	    sizeof(WFDB_Sample));
+    if (fv == NULL)
+	return (-1);
+
+    for (i = 0; i < n; ) {
+	/* Pack a block of frames, as long as no samples are left over from
+	   a previous frame, and the block fits in the buffer with at least
+	   one byte to spare (see the frame encoders in sigformat.c). */
+	if (mmax > 0 && og->count == 0 &&
+	    (m = (og->be - og->bp - 1) / ubytes * ufr) > 0) {
+	    if (m > n - i) m = (n - i) / ufr * ufr;
+	    if (m > mmax) m = mmax;
+	    if (m > 0) {
+		for (k = 0, v = fv; k < m; k++, v += og->spf)
+		    (void)pvconvert(ctx, &frames, v, 0, &stat);
+		(*og->pack)(fv, (unsigned char *)og->bp, m * og->spf);
+		og->bp += m / ufr * ubytes;
+		i += m;
+		continue;
+	    }
+	}
+
+	for (s = 0; s < nosig; ) {
+	    g = osd[s]->info.group;
+	    og = ogd[g];
+	    os = osd[s];
+	    s = pvconvert(ctx, &frames, fv, s, &stat);
+
+	    /* Pack them into the output buffer.  If the buffer is nearly
+	       full, write the samples one at a time instead, so that the
+	       buffer is flushed when it fills, and check for errors. */
+	    if ((*og->encode)(og, fv, og->spf) < 0) {
+		for (k = 0, v = fv; k < og->spf; k++, v++) {
+		    switch (os->info.fmt) {
+		      case 8:	w8(*v, og); break;
+		      case 16:	w16(*v, og); break;
+		      case 61:	w61(*v, og); break;
+		      case 80:	w80(*v, og); break;
+		      case 160:	w160(*v, og); break;
+		      case 212:	w212(ctx, *v, og); break;
+		      case 310:	w310(ctx, *v, og); break;
+		      case 311:	w311(ctx, *v, og); break;
+		      case 24:	w24(*v, og); break;
+		      case 32:	w32(*v, og); break;
+		      case 508:
+		      case 516:
+		      case 524:
+			if (flac_putsamp(ctx, *v, os->info.fmt, og) < 0)
+			    err = 1;
+			break;
+		    }
+		}
+		if (err || wfdb_ferror(og->fp)) {
+		    wfdb_error_ctx(ctx,
+				   "putvecs: write error in signal group %d\n",
+				   g);
+		    SFREE(fv);
+		    ostime += i + 1;
+		    return (-1);
+		}
+	    }
+	}
+	i++;
+    }
+    SFREE(fv);
+    ostime += n;
+    return (stat ? n : 0);
+}
+
+long putvecs(const WFDB_Sample *frames, long n)
+{
+    return putvecs_ctx(wfdb_get_default_context(), frames, n);
+}
+
+/* Return the time of the sample vector that getvec will read next, or -1 if
+   it is not known (when resampling, see setifreq). */
+static WFDB_Time igvtime(WFDB_Context *ctx)
+{
+    if (ifreq > (WFDB_Frequency)0)
+	return (-1L);
+    if (!(gvmode & WFDB_HIGHRES) || ispfmax < 2)
+	return (istime);
+    return ((istime - 1) * ispfmax + gvc);
+}
+
 int isigsettime_ctx(WFDB_Context *ctx, WFDB_Time t)
 {
     WFDB_Group g;
-    WFDB_Time curtime;
     int stat = 0;
 
     /* Return immediately if no seek is needed. */
     if (nisig == 0) return (0);
-    if (ifreq <= (WFDB_Frequency)0) {
-	if (!(gvmode & WFDB_HIGHRES) || ispfmax < 2)
-	    curtime = istime;
-	else
-	    curtime = (istime - 1) * ispfmax + gvc;
-	if (t == curtime) return (0);
-    }
+    if (ifreq <= (WFDB_Frequency)0 && t == igvtime(ctx)) return (0);
 
     for (g = 1; g < nigroup; g++)
-        if ((stat = isgsettime(g, t)) < 0) break;
+        if ((stat = isgsettime_ctx(ctx, g, t)) < 0) break;
     /* Seek on signal group 0 last (since doing so updates istime and would
        confuse isgsettime if done first). */
-    if (stat == 0) stat = isgsettime(0, t);
+    if (stat == 0) stat = isgsettime_ctx(ctx, 0, t);
     return (stat);
 }
 
@@ -1129,12 +1770,15 @@ int isigsettime(WFDB_Time t)
 int isgsettime_ctx(WFDB_Context *ctx, WFDB_Group g, WFDB_Time t)
 {
     int spf, stat, trem = 0;
+    long back = 0, ph = 0;
     double tt;
 
     /* Handle negative arguments as equivalent positive arguments. */
     if (t < 0L) {
 	if (t < -WFDB_TIME_MAX) {
-	    wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+	    wfdb_error_ctx(ctx,
+			   "isigsettime: improper seek on signal group %d\n",
+			   g);
 	    return (-1);
 	}
 	t = -t;
@@ -1144,10 +1788,22 @@ int isgsettime_ctx(WFDB_Context *ctx, WFDB_Group g, WFDB_Time t)
     if (ifreq > (WFDB_Frequency)0) {
 	tt = t * sfreq/ifreq;
 	if (tt > WFDB_TIME_MAX) {
-	    wfdb_error("isigsettime: improper seek on signal group %d\n", g);
+	    wfdb_error_ctx(ctx,
+			   "isigsettime: improper seek on signal group %d\n",
+			   g);
 	    return (-1);
 	}
-	t = (WFDB_Time) tt;
+	/* The FIR resampler (if any) needs the exact position of the first
+	   output, as a raw sample and the phase that follows it, and also
+	   needs the samples before that raw sample. */
+	if (ifreq != sfreq && (back = rsfhist(ctx)) > 0) {
+	    ph = (long)(t % nticks * mticks % nticks);
+	    t = t / nticks * mticks + t % nticks * mticks / nticks;
+	    if (back > t) back = t;
+	    t -= back;
+	}
+	else
+	    t = (WFDB_Time) tt;
     }
 
     /* If we're in WFDB_HIGHRES mode, convert t from samples to frames, and
@@ -1157,21 +1813,24 @@ int isgsettime_ctx(WFDB_Context *ctx, WFDB_Group g, WFDB_Time t)
 	t /= ispfmax;
     }
 
-    /* Mark the contents of the deskewing buffer (if any) as invalid. */
+    /* Mark the contents of the deskewing buffer (if any) as invalid, and
+       discard any checksum error not yet reported by getvecs or getframes. */
     dsbi = -1;
+    gvpend = 0;
 
-    if ((stat = isgsetframe(g, t)) == 0 && g == 0) {
+    if ((stat = isgsetframe(ctx, g, t)) == 0 && g == 0) {
 	while (trem-- > 0) {
-	    if (rgetvec(uvector) < 0) {
-		wfdb_error("isigsettime: improper seek on signal group %d\n",
-			   g);
+	    if (rgetvec(ctx, uvector) < 0) {
+		wfdb_error_ctx(ctx,
+			       "isigsettime: improper seek on signal group "
+			       "%d\n", g);
 		return (-1);
 	    }
 	}
-	if (ifreq > (WFDB_Frequency)0 && ifreq != sfreq) {
+	if (ifreq > (WFDB_Frequency)0 && ifreq != sfreq && !rsfinit(ctx, back, ph)) {
 	    gvtime = 0;
-	    rgvstat = rgetvec(gv0);
-	    rgvstat = rgetvec(gv1);
+	    rgvstat = rgetvec(ctx, gv0);
+	    rgvstat = rgetvec(ctx, gv1);
 	    rgvtime = nticks;
 	}
     }
@@ -1191,11 +1850,12 @@ WFDB_Time tnextvec_ctx(WFDB_Context *ctx, WFDB_Signal s, WFDB_Time t)
 
     if (in_msrec && need_sigmap) { /* variable-layout multi-segment record */
 	if (s >= nvsig) {
-	    wfdb_error("nextvect: illegal signal number %d\n", s);
+	    wfdb_error_ctx(ctx, "nextvect: illegal signal number %d\n", s);
 	    return ((WFDB_Time) -1);
 	}
 	/* Go to the start (t) if not already there. */
-	if (t != istime && isigsettime(t) < 0) return ((WFDB_Time) -1);
+	if (t != istime && isigsettime_ctx(ctx, t) < 0)
+	    return ((WFDB_Time) -1);
 	while (stat >= 0) {
 	    char *p = vsd[s]->info.desc, *q;
 	    int ss;
@@ -1209,29 +1869,30 @@ WFDB_Time tnextvec_ctx(WFDB_Context *ctx, WFDB_Signal s, WFDB_Time t)
 		/* The current segment contains the desired signal.
 		   Read samples until we find a valid one or reach
 		   the end of the segment. */
-		for ( ; t <= tf && (stat = getvec(vvector)) > 0; t++)
+		for ( ; t <= tf && (stat = getvec_ctx(ctx, vvector)) > 0; t++)
 		    if (vvector[s] != WFDB_INVALID_SAMPLE) {
-			isigsettime(t);
+			isigsettime_ctx(ctx, t);
 			return (t);
 		    }
 		if (stat < 0) return ((WFDB_Time) -1);
 	    }
 	    /* Go on to the next segment. */
-	    if (t != tf) stat = isigsettime(t = tf);
+	    if (t != tf) stat = isigsettime_ctx(ctx, t = tf);
 	}
     }
     else {	/* single-segment or fixed-layout multi-segment record */
 	/* Go to the start (t) if not already there. */
-	if (t != istime && isigsettime(t) < 0) return ((WFDB_Time) -1);
+	if (t != istime && isigsettime_ctx(ctx, t) < 0)
+	    return ((WFDB_Time) -1);
 	if (s >= nisig) {
-	    wfdb_error("nextvect: illegal signal number %d\n", s);
+	    wfdb_error_ctx(ctx, "nextvect: illegal signal number %d\n", s);
 	    return ((WFDB_Time) -1);
 	}
-	for ( ; (stat = getvec(vvector)) > 0; t++)
+	for ( ; (stat = getvec_ctx(ctx, vvector)) > 0; t++)
 	    /* Read samples until we find a valid one or reach the end of the
 	       record. */
 	    if (vvector[s] != WFDB_INVALID_SAMPLE) {
-		isigsettime(t);
+		isigsettime_ctx(ctx, t);
 		return (t);
 	    }
     }
@@ -1247,11 +1908,12 @@ WFDB_Time tnextvec(WFDB_Signal s, WFDB_Time t)
 int setibsize_ctx(WFDB_Context *ctx, int n)
 {
     if (nisig) {
-	wfdb_error("setibsize: can't change buffer size after isigopen\n");
+	wfdb_error_ctx(ctx,
+		       "setibsize: can't change buffer size after isigopen\n");
 	return (-1);
     }
     if (n < 0) {
-	wfdb_error("setibsize: illegal buffer size %d\n", n);
+	wfdb_error_ctx(ctx, "setibsize: illegal buffer size %d\n", n);
 	return (-2);
     }
     if (n == 0) n = BUFSIZ;
@@ -1263,14 +1925,114 @@ int setibsize(int n)
     return setibsize_ctx(wfdb_get_default_context(), n);
 }
 
+/* Function isigselect restricts reading to the n input signals listed in
+sigs (by their numbers, as in the array filled by isigopen), for applications
+that need only some of the signals of a record.  getvec and the other reading
+functions continue to return a sample for every signal, but samples of the
+other signals are returned as WFDB_INVALID_SAMPLE;  where possible, they are
+not decoded at all.  If sigs is NULL or n is zero, all signals are selected.
+The selection takes effect with the next frame read from the signal files,
+and remains in effect until the record is closed.  The value returned is the
+number of signals selected, or -1 if sigs includes an invalid signal number. */
+
+int isigselect_ctx(WFDB_Context *ctx, const int *sigs, int n)
+{
+    int i, nsel = 0;
+
+    if (nvsig == 0)
+	return (0);
+    if (sigs == NULL || n <= 0) {
+	SFREE(isigsel);
+	nisigsel = 0;
+	isigselapply(ctx);
+	return (nvsig);
+    }
+    for (i = 0; i < n; i++)
+	if (sigs[i] < 0 || sigs[i] >= nvsig) {
+	    wfdb_error_ctx(ctx, "isigselect: signal %d is not open\n",
+			   sigs[i]);
+	    return (-1);
+	}
+    SALLOC(isigsel, nvsig, sizeof(char));
+    nisigsel = nvsig;
+    for (i = 0; i < n; i++)
+	if (!isigsel[sigs[i]]) {
+	    isigsel[sigs[i]] = 1;
+	    nsel++;
+	}
+    isigselapply(ctx);
+    return (nsel);
+}
+
+int isigselect(const int *sigs, int n)
+{
+    return isigselect_ctx(wfdb_get_default_context(), sigs, n);
+}
+
+/* Function setiseekindex sets the interval, in frames, between the
+checkpoints that isigopen will keep for format 8 signal groups.  The samples
+of a format 8 signal are stored as first differences, so that seeking to a
+sample (as by isigsettime or sample) requires either reading the signal file
+from its beginning or accepting an unknown offset in the signal's values.  If
+interval is positive, the sample values of each format 8 group are recorded
+every interval frames as the group is read, and a seek reads forward only from
+the nearest checkpoint, so that the values that follow are exact.  If interval
+is zero, no checkpoints are kept, and seeks are approximate, as in earlier
+versions of the library;  if interval is negative, the interval is taken from
+the environment variable WFDBSEEKINDEX (no checkpoints if it is not set to a
+positive integer), which is also the default.  The setting takes effect at
+the next isigopen. */
+
+void setiseekindex_ctx(WFDB_Context *ctx, long interval)
+{
+    if (interval < 0) {
+	char *p;
+
+	interval = (p = getenv("WFDBSEEKINDEX")) ? strtol(p, NULL, 10) : 0;
+    }
+    iseekint = (interval > 0) ? interval : -1;
+}
+
+void setiseekindex(long interval)
+{
+    setiseekindex_ctx(wfdb_get_default_context(), interval);
+}
+
+/* Function setimmap determines whether isigopen maps local signal files into
+memory rather than reading them through a buffer.  Mapped input avoids copying
+the data, and makes seeking (as by isigsettime and sample) inexpensive.  If
+mode is positive, signal files are mapped when possible;  if mode is zero,
+they are read normally;  and if mode is negative, the choice is determined by
+environment variable WFDBMMAP (mapped if WFDBMMAP is set to a positive
+integer), which is also the default.  FLAC-compressed files, files that cannot
+be seeked (those with negative block sizes in the header), and remote files
+are never mapped.  The setting takes effect at the next isigopen. */
+
+void setimmap_ctx(WFDB_Context *ctx, int mode)
+{
+    if (mode < 0) {
+	char *p;
+
+	mode = ((p = getenv("WFDBMMAP")) && strtol(p, NULL, 10) > 0);
+    }
+    immap = mode ? 1 : -1;
+}
+
+void setimmap(int mode)
+{
+    setimmap_ctx(wfdb_get_default_context(), mode);
+}
+
 int setobsize_ctx(WFDB_Context *ctx, int n)
 {
     if (nosig) {
-	wfdb_error("setobsize: can't change buffer size after osig[f]open\n");
+	wfdb_error_ctx(ctx,
+		       "setobsize: can't change buffer size after "
+		       "osig[f]open\n");
 	return (-1);
     }
     if (n < 0) {
-	wfdb_error("setobsize: illegal buffer size %d\n", n);
+	wfdb_error_ctx(ctx, "setobsize: illegal buffer size %d\n", n);
 	return (-2);
     }
     if (n == 0) n = BUFSIZ;
@@ -1294,7 +2056,7 @@ int newheader_ctx(WFDB_Context *ctx, char *record)
     SUALLOC(osi, nosig, sizeof(WFDB_Siginfo));
     for (s = 0; s < nosig; s++)
 	copysi(&osi[s], &osd[s]->info);
-    stat = setheader(record, osi, nosig);
+    stat = setheader_ctx(ctx, record, osi, nosig);
     for (s = 0; s < nosig; s++) {
 	SFREE(osi[s].fname);
 	SFREE(osi[s].desc);
@@ -1325,12 +2087,16 @@ int setheader_ctx(WFDB_Context *ctx, char *record, const WFDB_Siginfo *siarray,
     wfdb_striphea(record);
 
     /* Quit (with message from wfdb_checkname) if name is illegal. */
-    if (wfdb_checkname(record, "record"))
+    if (wfdb_checkname_ctx(ctx, record, "record"))
 	return (-1);
 
+    /* The header cache may hold an old copy of this header. */
+    hcachefree(ctx);
+
     /* Try to create the header file. */
-    if ((oheader = wfdb_open("hea", record, WFDB_WRITE)) == NULL) {
-	wfdb_error("newheader: can't create header for record %s\n", record);
+    if ((oheader = wfdb_open_ctx(ctx, "hea", record, WFDB_WRITE)) == NULL) {
+	wfdb_error_ctx(ctx, "newheader: can't create header for record %s\n",
+		       record);
 	return (-1);
     }
 
@@ -1347,13 +2113,13 @@ int setheader_ctx(WFDB_Context *ctx, char *record, const WFDB_Siginfo *siarray,
 	    (void)wfdb_fprintf(oheader, " 0:00");
         else if (btime % 1000 == 0)
 	    (void)wfdb_fprintf(oheader, " %s",
-			       ftimstr(btime, 1000.0));
+			       ftimstr(ctx, btime, 1000.0));
 	else
 	    (void)wfdb_fprintf(oheader, " %s",
-			       fmstimstr(btime, 1000.0));
+			       fmstimstr(ctx, btime, 1000.0));
     }
     if (bdate)
-	(void)wfdb_fprintf(oheader, "%s", datstr(bdate));
+	(void)wfdb_fprintf(oheader, "%s", datstr_ctx(ctx, bdate));
     (void)wfdb_fprintf(oheader, "\r\n");
 
     /* Write a signal specification line for each signal. */
@@ -1409,7 +2175,7 @@ int setmsheader_ctx(WFDB_Context *ctx, char *record, char **segment_name, unsign
     WFDB_Time *ns;
     unsigned i;
 
-    isigclose();	/* close any open input signals */
+    isigclose(ctx);	/* close any open input signals */
 
     /* If another output header file was opened, close it. */
     if (oheader) {
@@ -1422,36 +2188,39 @@ int setmsheader_ctx(WFDB_Context *ctx, char *record, char **segment_name, unsign
     wfdb_striphea(record);
 
     /* Quit (with message from wfdb_checkname) if name is illegal. */
-    if (wfdb_checkname(record, "record"))
+    if (wfdb_checkname_ctx(ctx, record, "record"))
 	return (-1);
 
     if (nsegments < 1) {
-	wfdb_error("setmsheader: record must contain at least one segment\n");
+	wfdb_error_ctx(ctx,
+		       "setmsheader: record must contain at least "
+		       "one segment\n");
 	return (-1);
     }
 
     SUALLOC(ns, nsegments, sizeof(WFDB_Time));
     for (i = 0; i < nsegments; i++) {
 	if (strlen(segment_name[i]) > WFDB_MAXRNL) {
-	    wfdb_error(
-	     "setmsheader: `%s' is too long for a segment name in record %s\n",
-		     segment_name[i], record);
+	    wfdb_error_ctx(ctx,
+			   "setmsheader: `%s' is too long for a segment name "
+			   "in record %s\n", segment_name[i], record);
 	    SFREE(ns);
 	    return (-2);
 	}
 	in_msrec = 1;
 	nsamples = 0;
-	n = readheader(segment_name[i]);
+	n = readheader(ctx, segment_name[i]);
 	in_msrec = old_in_msrec;
 	if (n < 0) {
-	    wfdb_error("setmsheader: can't read segment %s header\n",
-		     segment_name[i]);
+	    wfdb_error_ctx(ctx, "setmsheader: can't read segment %s header\n",
+			   segment_name[i]);
 	    SFREE(ns);
 	    return (-3);
 	}
 	if ((ns[i] = nsamples) <= 0L) {
-	    wfdb_error("setmsheader: length of segment %s must be specified\n",
-		     segment_name[i]);
+	    wfdb_error_ctx(ctx,
+			   "setmsheader: length of segment %s must "
+			   "be specified\n", segment_name[i]);
 	    SFREE(ns);
 	    return (-4);
 	}
@@ -1466,16 +2235,16 @@ int setmsheader_ctx(WFDB_Context *ctx, char *record, char **segment_name, unsign
 	}
 	else {
 	    if (nsig != n) {
-		wfdb_error(
-		    "setmsheader: incorrect number of signals in segment %s\n",
-			 segment_name[i]);
+		wfdb_error_ctx(ctx,
+			       "setmsheader: incorrect number of signals in "
+			       "segment %s\n", segment_name[i]);
 		SFREE(ns);
 		return (-4);
 	    }
 	    if (msfreq != ffreq) {
-		wfdb_error(
-		   "setmsheader: incorrect sampling frequency in segment %s\n",
-			 segment_name[i]);
+		wfdb_error_ctx(ctx,
+			       "setmsheader: incorrect sampling frequency in "
+			       "segment %s\n", segment_name[i]);
 		SFREE(ns);
 		return (-4);
 	    }
@@ -1484,9 +2253,10 @@ int setmsheader_ctx(WFDB_Context *ctx, char *record, char **segment_name, unsign
     }
 
     /* Try to create the header file. */
-    if ((oheader = wfdb_open("hea", record, WFDB_WRITE)) == NULL) {
-	wfdb_error("setmsheader: can't create header file for record %s\n",
-		 record);
+    if ((oheader = wfdb_open_ctx(ctx, "hea", record, WFDB_WRITE)) == NULL) {
+	wfdb_error_ctx(ctx,
+		       "setmsheader: can't create header file for record %s\n",
+		       record);
 	SFREE(ns);
 	return (-1);
     }
@@ -1502,13 +2272,13 @@ int setmsheader_ctx(WFDB_Context *ctx, char *record, char **segment_name, unsign
     if (msbtime != 0L || msbdate != (WFDB_Date)0) {
         if (msbtime % 1000 == 0)
 	    (void)wfdb_fprintf(oheader, " %s",
-			       ftimstr(msbtime, 1000.0));
+			       ftimstr(ctx, msbtime, 1000.0));
 	else
 	    (void)wfdb_fprintf(oheader, " %s",
-			       fmstimstr(msbtime, 1000.0));
+			       fmstimstr(ctx, msbtime, 1000.0));
     }
     if (msbdate)
-	(void)wfdb_fprintf(oheader, "%s", datstr(msbdate));
+	(void)wfdb_fprintf(oheader, "%s", datstr_ctx(ctx, msbdate));
     (void)wfdb_fprintf(oheader, "\r\n");
 
     /* Write a line for each segment. */
@@ -1601,9 +2371,10 @@ int wfdbputprolog_ctx(WFDB_Context *ctx, const char *buf, long int size, WFDB_Si
     WFDB_Group g = osd[s]->info.group;
 
     n = wfdb_fwrite(buf, 1, size, ogd[g]->fp);
-    wfdbsetstart(s, n);
+    wfdbsetstart_ctx(ctx, s, n);
     if (n != size)
-	wfdb_error("wfdbputprolog: only %ld of %ld bytes written\n", n, size);
+	wfdb_error_ctx(ctx, "wfdbputprolog: only %ld of %ld bytes written\n",
+		       n, size);
     return (n == size ? 0 : -1);
 }
 
@@ -1616,7 +2387,7 @@ int wfdbputprolog(const char *buf, long int size, WFDB_Signal s)
 int setinfo_ctx(WFDB_Context *ctx, char *record)
 {
     /* Close any previously opened output info file. */
-    int stat = wfdb_oinfoclose();
+    int stat = wfdb_oinfoclose_ctx(ctx);
 
     /* Quit unless a record name has been specified. */
     if (record == NULL) return (stat);
@@ -1625,12 +2396,13 @@ int setinfo_ctx(WFDB_Context *ctx, char *record)
     wfdb_striphea(record);
 
     /* Quit (with message from wfdb_checkname) if name is illegal. */
-    if (wfdb_checkname(record, "record"))
+    if (wfdb_checkname_ctx(ctx, record, "record"))
 	return (-1);
 
     /* Try to create the .info file. */
-    if ((outinfo = wfdb_open("info", record, WFDB_APPEND)) == NULL) {
-	wfdb_error("setinfo: can't create info file for record %s\n", record);
+    if ((outinfo = wfdb_open_ctx(ctx, "info", record, WFDB_APPEND)) == NULL) {
+	wfdb_error_ctx(ctx, "setinfo: can't create info file for record %s\n",
+		       record);
 	return (-1);
     }
 
@@ -1649,7 +2421,9 @@ int putinfo_ctx(WFDB_Context *ctx, const char *s)
     if (outinfo == NULL) {
 	if (oheader) outinfo = oheader;
 	else {
-	    wfdb_error("putinfo: caller has not specified a record name\n");
+	    wfdb_error_ctx(ctx,
+			   "putinfo: caller has not specified a "
+			   "record name\n");
 	    return (-1);
 	}
     }
@@ -1675,16 +2449,17 @@ char *getinfo_ctx(WFDB_Context *ctx, char *record)
     WFDB_FILE *ifile;
 
     if (record)
-	wfdb_freeinfo();
+	wfdb_freeinfo_ctx(ctx);
 
     if (pinfo == NULL) {	/* info for record has not yet been read */
-	if (record == NULL && (record = wfdb_getirec()) == NULL) {
-	    wfdb_error("getinfo: caller did not specify record name\n");
+	if (record == NULL && (record = wfdb_getirec_ctx(ctx)) == NULL) {
+	    wfdb_error_ctx(ctx,
+			   "getinfo: caller did not specify record name\n");
 	    return (NULL);
 	}
 
 	if (ninfo) {
-	    wfdb_freeinfo();  /* free memory allocated previously to info */
+	    wfdb_freeinfo_ctx(ctx);  /* free memory allocated previously */
 	    ninfo = 0;
 	}
 
@@ -1696,7 +2471,7 @@ char *getinfo_ctx(WFDB_Context *ctx, char *record)
 	if (!isedf) {
 	    /* Remove trailing .hea, if any, from record name. */
 	    wfdb_striphea(record);
-	    if ((ifile = wfdb_open("hea", record, WFDB_READ))) {
+	    if ((ifile = wfdb_open_ctx(ctx, "hea", record, WFDB_READ))) {
 		while (wfdb_getline(&buf, &bufsize, ifile))
 		    if (*buf != '#') break; /* skip initial comments, if any */
 		while (wfdb_getline(&buf, &bufsize, ifile))
@@ -1721,7 +2496,7 @@ char *getinfo_ctx(WFDB_Context *ctx, char *record)
 	    }
 	}
 	/* Read more info from the .info file, if available */
-	if ((ifile = wfdb_open("info", record, WFDB_READ))) {
+	if ((ifile = wfdb_open_ctx(ctx, "info", record, WFDB_READ))) {
 	    while (wfdb_getline(&buf, &bufsize, ifile)) {
 		if (*buf == '#') {
 		    p = buf + strlen(buf) - 1;
@@ -1759,21 +2534,97 @@ sample_vflag is true (non-zero) if the requested sample is not beyond the end
 of the record, false (zero) otherwise.  The caller must open the input signals
 and must set the global variable nisig to the number of input signals before
 invoking sample().  Once this has been done, the caller may request samples in
-any order. */
+any order.
+
+Samples are cached in blocks of sblen consecutive frames (a power of 2), each
+beginning at a multiple of sblen.  Up to sbmaxblk blocks are kept (see
+setsampcache), so that an application can move back and forth among several
+regions of a record without reading any of them more than once.  If a block is
+needed that is not in the cache, the least recently used block is refilled. */
+
+/* Discard the contents of the cache. */
+void sbfree(WFDB_Context *ctx)
+{
+    if (sbcache) {
+	while (sbnblk > 0) {
+	    sbnblk--;
+	    SFREE(sbcache[sbnblk].buf);
+	}
+	SFREE(sbcache);
+    }
+    sblast = NULL;
+}
+
+/* Return 1 if isigsettime positions the input signals exactly, or 0 if an
+   open format 8 signal has no checkpoints (see setiseekindex), so that a seek
+   may leave its values offset. */
+static int sbexact(WFDB_Context *ctx)
+{
+    WFDB_Signal s;
+
+    for (s = 0; s < nisig; s++)
+	if (isd[s]->info.fmt == 8 && igd[isd[s]->info.group]->cpint == 0)
+	    return (0);
+    return (1);
+}
 
-#define BUFLN   4096	/* must be a power of 2, see sample() */
+/* Return the cached block that begins at time t0, reading it first if
+   necessary, or NULL if the input signals cannot be positioned at t0. */
+static struct sblock *sbget(WFDB_Context *ctx, WFDB_Time t0)
+{
+    struct sblock *b, *lru;
+    WFDB_Time tnext, skip = 0;
+    int i;
+
+    for (i = 0, lru = b = sbcache; i < sbnblk; i++, b++) {
+	if (b->t0 == t0) {
+	    sbhits++;
+	    b->used = ++sbclock;
+	    return (sblast = b);
+	}
+	if (b->used < lru->used)
+	    lru = b;
+    }
+
+    /* Not found -- read the block, into a new buffer if the cache is not yet
+       full, or else into the least recently used one. */
+    sbmisses++;
+
+    /* If the block begins at or after the next sample vector to be read,
+       read forward to it if it is near (within 4096 frames, the length of
+       the buffer sample() used before it had a cache) or if a seek would be
+       inexact;  otherwise seek to it. */
+    if ((tnext = igvtime(ctx)) >= 0L && t0 >= tnext &&
+	(t0 - tnext < WFDB_DEFSBLEN*4 || !sbexact(ctx)))
+	skip = t0 - tnext;
+    else if (isigsettime_ctx(ctx, t0) < 0)
+	return (NULL);
+    if (sbcache == NULL)
+	SUALLOC(sbcache, sbmaxblk, sizeof(struct sblock));
+    if (sbnblk < sbmaxblk) {
+	b = &sbcache[sbnblk++];
+	SUALLOC(b->buf, sblen, sbnsig * sizeof(WFDB_Sample));
+    }
+    else
+	b = lru;
+    b->t0 = t0;
+    b->used = ++sbclock;
+    for (b->n = 0; skip > 0; skip--)
+	if (getvec_ctx(ctx, b->buf) < 0)
+	    return (sblast = b);
+    for ( ; b->n < sblen; b->n++)
+	if (getvec_ctx(ctx, b->buf + b->n * sbnsig) < 0)
+	    break;
+    return (sblast = b);
+}
 
 WFDB_Sample sample_ctx(WFDB_Context *ctx, WFDB_Signal s, WFDB_Time t)
 {
+    struct sblock *b;
     WFDB_Sample v;
+    WFDB_Time t0;
     int nsig = (nvsig > nisig) ? nvsig : nisig;
 
-    /* Allocate the sample buffer on the first call. */
-    if (sbuf == NULL) {
-	SALLOC(sbuf, nsig, BUFLN*sizeof(WFDB_Sample));
-	sample_tt = (WFDB_Time)-1L;
-    }
-
     /* If the caller requested a sample from an unavailable signal, return
        an invalid value.  Note that sample_vflag is not cleared in this
        case.  */
@@ -1787,33 +2638,36 @@ WFDB_Sample sample_ctx(WFDB_Context *ctx, WFDB_Signal s, WFDB_Time t)
        absolute value of the sample number matters. */
     if (t < 0L) t = 0L;
 
-    /* If the caller has requested a sample that is no longer in the buffer,
-       or if the caller has requested a sample that is further ahead than the
-       length of the buffer, we need to reset the signal file pointer(s).
-       If we do this, we must be sure that the buffer is refilled so that
-       any subsequent requests for samples between t - BUFLN+1 and t will
-       receive correct responses. */
-    if (t <= sample_tt - BUFLN || t > sample_tt + BUFLN) {
-	sample_tt = t - BUFLN;
-	if (sample_tt < 0L) sample_tt = -1L;
-	if (isigsettime(sample_tt+1) < 0) {
-	    sample_vflag = 0;
-	    return (WFDB_INVALID_SAMPLE);
-	}
-    }
-    /* If the requested sample is not yet in the buffer, read and buffer
-       more samples.  If we reach the end of the record, clear sample_vflag
-       and return the last valid value. */
-    while (t > sample_tt)
-        if (getvec(sbuf + nsig * ((++sample_tt)&(BUFLN-1))) < 0) {
-	    --sample_tt;
-	    sample_vflag = 0;
-	    return (*(sbuf + nsig * (sample_tt&(BUFLN-1)) + s));
-	}
+    /* Set up the cache on the first call (or if the number of signals has
+       changed since it was filled). */
+    if (sbnsig != nsig) {
+	sbfree(ctx);
+	sbnsig = nsig;
+    }
+    if (sblen <= 0) sblen = WFDB_DEFSBLEN;
+    if (sbmaxblk <= 0) sbmaxblk = WFDB_DEFSBLOCKS;
+
+    /* Find the block that contains the requested sample.  Most requests
+       are for samples in the most recently used block. */
+    t0 = t & ~(WFDB_Time)(sblen - 1);
+    if ((b = sblast) != NULL && b->t0 == t0)
+	sbhits++;
+    else if ((b = sbget(ctx, t0)) == NULL) {
+	sample_vflag = 0;
+	return (WFDB_INVALID_SAMPLE);
+    }
+
+    /* If the record ends before t, clear sample_vflag and return the last
+       valid value. */
+    if (t - t0 >= b->n) {
+	sample_vflag = 0;
+	return (b->n > 0 ? b->buf[(b->n - 1) * sbnsig + s] :
+		WFDB_INVALID_SAMPLE);
+    }
 
     /* The requested sample is in the buffer.  Set sample_vflag and
        return the requested sample. */
-    if ((v = *(sbuf + nsig * (t&(BUFLN-1)) + s)) == WFDB_INVALID_SAMPLE)
+    if ((v = b->buf[(t - t0) * sbnsig + s]) == WFDB_INVALID_SAMPLE)
         sample_vflag = -1;
     else
         sample_vflag = 1;
@@ -1835,26 +2689,73 @@ int sample_valid(void)
     return sample_valid_ctx(wfdb_get_default_context());
 }
 
+/* Function setsampcache sets the number of frames in each block cached by
+sample (rounded up to a power of 2), and the maximum number of blocks in the
+cache.  If either argument is not positive, its default (WFDB_DEFSBLEN or
+WFDB_DEFSBLOCKS) is used.  Any cached samples are discarded, and the counters
+reported by sampcachestats are reset. */
+
+void setsampcache_ctx(WFDB_Context *ctx, long blocklen, int nblocks)
+{
+    sbfree(ctx);
+    if (blocklen <= 0)
+	blocklen = WFDB_DEFSBLEN;
+    else if (blocklen > LONG_MAX/2 + 1)
+	blocklen = LONG_MAX/2 + 1;
+    for (sblen = 1; sblen < blocklen; sblen <<= 1)
+	;
+    sbmaxblk = (nblocks > 0) ? nblocks : WFDB_DEFSBLOCKS;
+    sbhits = sbmisses = 0;
+}
+
+void setsampcache(long blocklen, int nblocks)
+{
+    setsampcache_ctx(wfdb_get_default_context(), blocklen, nblocks);
+}
+
+/* Function sampcachestats reports the number of calls to sample that found
+the requested sample in the cache (hits), and the number that required a
+block of samples to be read (misses). */
+
+void sampcachestats_ctx(WFDB_Context *ctx, long *hits, long *misses)
+{
+    if (hits) *hits = sbhits;
+    if (misses) *misses = sbmisses;
+}
+
+void sampcachestats(long *hits, long *misses)
+{
+    sampcachestats_ctx(wfdb_get_default_context(), hits, misses);
+}
+
 /* Private functions (for use by other WFDB library functions only). */
 
-void wfdb_sampquit(void)
+void wfdb_sampquit_ctx(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
-    if (sbuf) {
-	SFREE(sbuf);
+    if (sbcache) {
+	sbfree(ctx);
 	sample_vflag = 0;
     }
 }
 
-void wfdb_sigclose(void)
+void wfdb_sampquit(void)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
-    isigclose();
-    osigclose();
+    wfdb_sampquit_ctx(wfdb_get_default_context());
+}
+
+void wfdb_sigclose_ctx(WFDB_Context *ctx)
+{
+    isigclose(ctx);
+    osigclose(ctx);
     btime = bdate = nsamples = msbtime = msbdate = msnsamples = 0;
     sfreq = ifreq = ffreq = 0;
     pdays = -1;
     segments = in_msrec = skewmax = 0;
+    segprefetchfree(ctx);
+    hcachefree(ctx);
+    raiofree(ctx);
+    SFREE(isigsel);
+    nisigsel = 0;
     if (dsbuf) {
 	SFREE(dsbuf);
 	dsbi = -1;
@@ -1872,17 +2773,29 @@ void wfdb_sigclose(void)
     }
     SFREE(gv0);
     SFREE(gv1);
+    SFREE(rsbuf);
+    rsbuflen = 0;
+    rsffree(ctx);
     SFREE(tvector);
     SFREE(uvector);
     SFREE(vvector);
     tuvlen = 0;
+    SFREE(gvblk);
+    SFREE(gvmap);
+    gvblklen = gvmaplen = 0;
+    SFREE(physbuf);
+    physbuflen = 0;
 
-    sigmap_cleanup();
+    sigmap_cleanup(ctx);
 }
 
-void wfdb_osflush(void)
+void wfdb_sigclose(void)
+{
+    wfdb_sigclose_ctx(wfdb_get_default_context());
+}
+
+void wfdb_osflush_ctx(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     WFDB_Group g;
     WFDB_Signal s;
     struct ogdata *og;
@@ -1904,9 +2817,9 @@ void wfdb_osflush(void)
 		   or the file is seekable: write out any
 		   partially-completed sets of bit-packed samples. */
 		switch (os->info.fmt) {
-		  case 212: f212(og); break;
-		  case 310: f310(og); break;
-		  case 311: f311(og); break;
+		  case 212: f212(ctx, og); break;
+		  case 310: f310(ctx, og); break;
+		  case 311: f311(ctx, og); break;
 		  default: break;
 		}
 	    }
@@ -1930,6 +2843,11 @@ void wfdb_osflush(void)
     }
 }
 
+void wfdb_osflush(void)
+{
+    wfdb_osflush_ctx(wfdb_get_default_context());
+}
+
 /* Release resources allocated for info string handling */
 void wfdb_freeinfo_ctx(WFDB_Context *ctx)
 {
@@ -1947,9 +2865,8 @@ void wfdb_freeinfo(void)
 }
 
 /* Close any previously opened output info file. */
-int wfdb_oinfoclose(void)
+int wfdb_oinfoclose_ctx(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int stat = 0, errflag;
 
     if (outinfo && outinfo != oheader) {
@@ -1957,10 +2874,15 @@ int wfdb_oinfoclose(void)
 	if (wfdb_fclose(outinfo))
 	    errflag = 1;
 	if (errflag) {
-	    wfdb_error("setinfo: write error in info file\n");
+	    wfdb_error_ctx(ctx, "setinfo: write error in info file\n");
 	    stat = -2;
 	}
     }
     outinfo = NULL;
     return (stat);
 }
+
+int wfdb_oinfoclose(void)
+{
+    return (wfdb_oinfoclose_ctx(wfdb_get_default_context()));
+}
@@ -5,10 +5,11 @@
    shared state used by the signal processing modules (signal.c, sigformat.c,
    flac.c, header.c, sigmap.c, timeconv.c).
 
-   All shared state is now held in the WFDB_Context structure.  Each function
-   that uses these variables must declare a local variable:
-       WFDB_Context *ctx = wfdb_get_default_context();
-   The macros below then provide transparent access to the context fields.
+   All shared state is now held in the WFDB_Context structure.  Each
+   internal function that uses these variables takes the context as its
+   first argument (WFDB_Context *ctx);  only the legacy wrappers for the
+   public API call wfdb_get_default_context().  The macros below then
+   provide transparent access to the context fields.
 */
 
 #ifndef WFDB_SIGNAL_INTERNAL_H
@@ -43,12 +44,33 @@ struct hsdata {
     int skew;			/* intersignal skew (in frames) */
 };
 
+#define WFDB_DEFHCACHE	256	/* default number of cached segment headers */
+
+/* Parsed contents of a segment header, cached by readheader so that a
+   multi-segment record can switch segments without rereading headers. */
+struct hcentry {
+    struct hcentry *next;	/* next (less recently used) entry */
+    char *record;		/* segment name, as passed to readheader */
+    char irec[WFDB_MAXRNL+1];	/* current record name when read */
+    unsigned path_gen;		/* value of wfdb_path_gen when read */
+    unsigned nsig;		/* number of signals */
+    WFDB_Frequency freq;	/* frame rate, or 0 if not specified */
+    WFDB_Frequency ctrfreq;	/* counter frequency, or 0 if not specified */
+    double basecount;		/* base counter value */
+    WFDB_Time nsamp;		/* number of samples, or 0 if not specified */
+    char *btstr;		/* base time and date, or NULL if not given */
+    int maxspf;			/* maximum samples per frame */
+    struct hsdata *hs;		/* signal specifications */
+};
+
 struct isdata {			/* unique for each input signal */
     WFDB_Siginfo info;		/* input signal information */
     WFDB_Sample samp;		/* most recent sample read */
     int skew;			/* intersignal skew (in frames) */
     int gvindex;		/* current high-resolution sample number */
     int gvcount;		/* counter for updating gvindex */
+    char skip;			/* 1 if not selected (see isigselect) */
+    char nocksum;		/* 1 if the checksum cannot be verified */
 };
 
 struct igdata {			/* shared by all signals in a group (file) */
@@ -69,6 +91,94 @@ struct igdata {			/* shared by all signals in a group (file) */
     char seek;			/* 0: do not seek on file, 1: seeks permitted */
     char initial_skip;		/* 1 if isgsetframe is needed before reading */
     int stat;			/* signal file status flag */
+    int (*decode)(struct igdata *ig, WFDB_Sample *v, unsigned n);
+				/* frame decoder for this group's format
+				   (NULL if none), see isgdecoder() */
+    unsigned nsig;		/* number of signals in the group */
+    unsigned spf;		/* total samples per frame in the group */
+    WFDB_Sample invalid;	/* raw value that marks an invalid sample */
+    unsigned bps;		/* bytes per sample (0 if not fixed-width) */
+    int (*unpack)(const unsigned char *p, WFDB_Sample *v, long n);
+				/* block unpacker for this group's format
+				   (NULL if none), see sigpack.c */
+    unsigned ufr;		/* frames that fill a whole number of units
+				   of a bit-packed format */
+    unsigned ubytes;		/* bytes in ufr frames */
+    unsigned nsel;		/* number of selected signals in the group */
+    unsigned *run;		/* runs of selected samples within a frame, as
+				   pairs (first sample, count), if the
+				   others can be skipped;  see isgselect() */
+    unsigned nrun;		/* number of runs */
+    struct igra *ra;		/* read-ahead state (NULL if none) */
+    long cpint;			/* frames between checkpoints, or 0 if none
+				   are kept (see isgcheckpoint()) */
+    WFDB_Time frame;		/* number of frames read, if cpint > 0 (-1 if
+				   the file has not yet been positioned) */
+    WFDB_Sample *cp;		/* sample values at checkpoints 1, 2, ... */
+    unsigned ncp;		/* number of checkpoints in cp */
+    unsigned maxcp;		/* number of checkpoints allocated in cp */
+    struct igbc *bc;		/* shared block cache state (NULL if the
+				   cache is not used), see blkcache.c */
+    struct igfa *fa;		/* FLAC decode-ahead state (NULL if none),
+				   see flac.c */
+    struct igfx *fx;		/* FLAC frame index (NULL if none), see
+				   flac.c */
+};
+
+#define WFDB_BCBLK	3072	/* frames per block in the shared block cache
+				   (a multiple of 6, so that every block begins
+				   on a byte boundary in formats 212, 310 and
+				   311) */
+
+struct bckey {			/* identifies a block in the block cache */
+    unsigned long long dev;	/* device number of the signal file */
+    unsigned long long ino;	/* inode number of the signal file */
+    long long size;		/* size of the signal file in bytes */
+    long long mtime;		/* modification time of the signal file */
+    long long ctime;		/* status change time of the signal file */
+    long mtimens, ctimens;	/* nanoseconds of mtime and ctime, or 0 if
+				   unavailable */
+    long start;			/* byte offset of sample 0 in the file */
+    int fmt;			/* format of the group's signals */
+    unsigned spf;		/* total samples per frame in the group */
+    WFDB_Time blk;		/* block number (the block's first frame is
+				   blk * WFDB_BCBLK) */
+};
+
+struct bcblock {		/* a block of frames in the block cache */
+    struct bckey key;		/* identity of the block */
+    struct bcblock *hnext;	/* next block in the same hash chain */
+    struct bcblock *prev, *next;/* neighbors in the LRU list */
+    unsigned refs;		/* number of references held by readers */
+    size_t size;		/* memory used by the block, in bytes */
+    long n;			/* number of frames (< WFDB_BCBLK only at the
+				   end of the file) */
+    WFDB_Sample *v;		/* n frames, each of key.spf raw samples */
+};
+
+struct igbc {			/* block cache state for a signal group */
+    struct bckey key;		/* identity of the group's signal file */
+    struct bcblock *blk;	/* block being read (NULL if none) */
+    WFDB_Time frame;		/* next frame to be read from the group */
+    WFDB_Time fpos;		/* next frame in the signal file, or -1 if the
+				   file position is unknown */
+};
+
+#define WFDB_GVBLK	64	/* frames read at once by rgetvecs */
+#define WFDB_DSBLK	64	/* frames deskewed at once by getdsframes */
+#define WFDB_PHYSBLK	256	/* vectors converted at once by getphys etc. */
+#define WFDB_PVBLK	4096	/* samples packed at once by putvecs */
+
+#define WFDB_DEFSBLEN	1024	/* default frames per sample() cache block
+				   (must be a power of 2) */
+#define WFDB_DEFSBLOCKS	8	/* default number of sample() cache blocks */
+
+struct sblock {			/* a block of frames cached by sample() */
+    WFDB_Time t0;		/* time of the first frame in the block */
+    unsigned long used;		/* value of sbclock when last used */
+    long n;			/* number of frames read (< sblen at the end of
+				   the record) */
+    WFDB_Sample *buf;		/* n frames, each of sbnsig samples */
 };
 
 struct osdata {			/* unique for each output signal */
@@ -89,12 +199,26 @@ struct ogdata {			/* shared by all signals in a group (file) */
     char *be;			/* pointer to output buffer endpoint */
     FLAC__StreamEncoder *flacenc; /* internal state for FLAC encoder */
     unsigned packspf;		/* number of samples per frame */
+    char *packbuf;		/* samples rearranged by signal for the FLAC
+				   encoder (NULL if not needed) */
+    struct ogsk *sk;		/* FLAC seek table state (NULL if none), see
+				   flac.c */
     char count;			/* output counter for bit-packed signal */
     signed char seek;		/* 1: seek works, -1: seek doesn't work,
 				   0: unknown */
     char force_flush;		/* flush even if seek doesn't work */
     char nrewind;		/* number of bytes to seek backwards
 				   after flushing */
+    int (*encode)(struct ogdata *og, const WFDB_Sample *v, unsigned n);
+				/* frame encoder for this group's format
+				   (NULL if none), see osgencoder() */
+    void (*pack)(const WFDB_Sample *v, unsigned char *p, long n);
+				/* block packer for this group's format
+				   (NULL if none), see sigpack.c */
+    unsigned unsamp;		/* samples per unit of the packer's format */
+    unsigned unbytes;		/* bytes per unit of the packer's format */
+    unsigned spf;		/* total samples per frame in the group */
+    WFDB_Sample invalid;	/* value written for an invalid sample */
 };
 
 struct sigmapinfo {
@@ -115,6 +239,9 @@ struct sigmapinfo {
 #define linebuf		(ctx->linebuf)
 #define linebufsize	(ctx->linebufsize)
 #define hsd		(ctx->hsd)
+#define hcache		(ctx->hcache)
+#define nhcache		(ctx->nhcache)
+#define hclimit		(ctx->hclimit)
 
 /* Time/frequency/conversion */
 #define ffreq		(ctx->ffreq)
@@ -150,17 +277,31 @@ struct sigmapinfo {
 #define uvector		(ctx->uvector)
 #define vvector		(ctx->vvector)
 #define tuvlen		(ctx->tuvlen)
+#define gvblk		(ctx->gvblk)
+#define gvblklen	(ctx->gvblklen)
+#define gvmap		(ctx->gvmap)
+#define gvmaplen	(ctx->gvmaplen)
+#define physbuf		(ctx->physbuf)
+#define physbuflen	(ctx->physbuflen)
 #define istime		(ctx->istime)
 #define ibsize		(ctx->ibsize)
+#define immap		(ctx->immap)
+#define iramode		(ctx->iramode)
+#define iflacthreads	(ctx->iflacthreads)
+#define iseekint	(ctx->iseekint)
+#define isigsel		(ctx->isigsel)
+#define nisigsel	(ctx->nisigsel)
 #define skewmax		(ctx->skewmax)
 #define dsbuf		(ctx->dsbuf)
 #define dsbi		(ctx->dsbi)
+#define dsnf		(ctx->dsnf)
 #define dsblen		(ctx->dsblen)
 #define framelen	(ctx->framelen)
 #define gvmode		(ctx->gvmode)
 #define gvc		(ctx->gvc)
+#define gvstat		(ctx->gvstat)
+#define gvpend		(ctx->gvpend)
 #define isedf		(ctx->isedf)
-#define sbuf		(ctx->sbuf)
 #define sample_vflag	(ctx->sample_vflag)
 
 /* Resampling state */
@@ -172,12 +313,24 @@ struct sigmapinfo {
 #define gvtime		(ctx->gvtime)
 #define gv0		(ctx->gv0)
 #define gv1		(ctx->gv1)
+#define rsfilter	(ctx->rsfilter)
+#define rsf		(ctx->rsf)
+#define rsbuf		(ctx->rsbuf)
+#define rsbuflen	(ctx->rsbuflen)
 
 /* getinfo iteration index */
 #define getinfo_index	(ctx->getinfo_index)
 
 /* sample() function cache */
-#define sample_tt	(ctx->sample_tt)
+#define sbcache		(ctx->sbcache)
+#define sblast		(ctx->sblast)
+#define sbclock		(ctx->sbclock)
+#define sbnblk		(ctx->sbnblk)
+#define sbmaxblk	(ctx->sbmaxblk)
+#define sblen		(ctx->sblen)
+#define sbnsig		(ctx->sbnsig)
+#define sbhits		(ctx->sbhits)
+#define sbmisses	(ctx->sbmisses)
 
 /* Output signals */
 #define maxosig		(ctx->maxosig)
@@ -190,6 +343,9 @@ struct sigmapinfo {
 #define ogd		(ctx->ogd)
 #define ostime		(ctx->ostime)
 #define obsize		(ctx->obsize)
+#define oflaclevel	(ctx->oflaclevel)
+#define oflacbsize	(ctx->oflacbsize)
+#define oflacthreads	(ctx->oflacthreads)
 
 /* Info strings */
 #define pinfo		(ctx->pinfo)
@@ -213,10 +369,7 @@ struct sigmapinfo {
 
 /* Format I/O macros (require ctx in scope via the helpers above) */
 #define r8(G)	((G->bp < G->be) ? *(G->bp++) : \
-		  ((_n = (G->bsize > 0) ? G->bsize : ibsize), \
-		   (G->stat = _n = wfdb_fread(G->buf, 1, _n, G->fp)), \
-		   (G->be = (G->bp = G->buf) + _n),\
-		  *(G->bp++)))
+		  (isgfill(ctx, G), *(G->bp++)))
 
 #define w8(V,G)	(((*(G->bp++) = (char)V)), \
 		  (_l = (G->bp != G->be) ? 0 : \
@@ -246,53 +399,111 @@ struct sigmapinfo {
 /* ---- Internal function declarations ---- */
 
 /* From timeconv.c */
-WFDB_INTERNAL char *ftimstr(WFDB_Time t, WFDB_Frequency f);
-WFDB_INTERNAL char *fmstimstr(WFDB_Time t, WFDB_Frequency f);
-WFDB_INTERNAL WFDB_Time fstrtim(const char *string, WFDB_Frequency f);
+WFDB_INTERNAL char *ftimstr(WFDB_Context *ctx, WFDB_Time t, WFDB_Frequency f);
+WFDB_INTERNAL char *fmstimstr(WFDB_Context *ctx, WFDB_Time t,
+			      WFDB_Frequency f);
+WFDB_INTERNAL WFDB_Time fstrtim(WFDB_Context *ctx, const char *string,
+				WFDB_Frequency f);
 
 /* From header.c */
 WFDB_INTERNAL void read_edf_str(char *buf, int size, WFDB_FILE *ifile);
-WFDB_INTERNAL int edfparse(WFDB_FILE *ifile);
-WFDB_INTERNAL int readheader(const char *record);
-WFDB_INTERNAL void hsdfree(void);
+WFDB_INTERNAL int edfparse(WFDB_Context *ctx, WFDB_FILE *ifile);
+WFDB_INTERNAL int readheader(WFDB_Context *ctx, const char *record);
+WFDB_INTERNAL void hsdfree(WFDB_Context *ctx);
+WFDB_INTERNAL void hcachefree(WFDB_Context *ctx);
+WFDB_INTERNAL void hcachemove(WFDB_Context *ctx, WFDB_Context *from,
+			      unsigned path_gen);
+
+/* From segprefetch.c */
+WFDB_INTERNAL void segprefetch(WFDB_Context *ctx, const char *record);
+WFDB_INTERNAL void segadopt(WFDB_Context *ctx, const char *record);
+WFDB_INTERNAL WFDB_FILE *segfopen(WFDB_Context *ctx, const char *fname);
+WFDB_INTERNAL void segprefetchfree(WFDB_Context *ctx);
+
+/* From readahead.c */
+WFDB_INTERNAL void isgrainit(WFDB_Context *ctx, struct igdata *g);
+WFDB_INTERNAL int isgfill(WFDB_Context *ctx, struct igdata *g);
+WFDB_INTERNAL void isgracancel(WFDB_Context *ctx, struct igdata *g);
+WFDB_INTERNAL void isgrafree(WFDB_Context *ctx, struct igdata *g);
+WFDB_INTERNAL void raiofree(WFDB_Context *ctx);
+
+/* From blkcache.c */
+WFDB_INTERNAL void isgbcinit(WFDB_Context *ctx, struct igdata *ig, int fmt);
+WFDB_INTERNAL void isgbcfree(WFDB_Context *ctx, struct igdata *ig);
+WFDB_INTERNAL struct bcblock *bcget(const struct bckey *key);
+WFDB_INTERNAL struct bcblock *bcnew(size_t nsamp);
+WFDB_INTERNAL struct bcblock *bcput(const struct bckey *key,
+				    struct bcblock *b);
+WFDB_INTERNAL void bcrelease(struct bcblock *b);
+
+/* From resample.c */
+WFDB_INTERNAL int rsfinit(WFDB_Context *ctx, long back, long ph);
+WFDB_INTERNAL long rsfhist(WFDB_Context *ctx);
+WFDB_INTERNAL void rsffree(WFDB_Context *ctx);
+WFDB_INTERNAL long rsfgetvecs(WFDB_Context *ctx, WFDB_Sample *vector, long n);
+WFDB_INTERNAL long rslgetvecs(WFDB_Context *ctx, WFDB_Sample *vector, long n);
 
 /* From sigformat.c */
-WFDB_INTERNAL int isgsetframe(WFDB_Group g, WFDB_Time t);
-WFDB_INTERNAL int getskewedframe(WFDB_Sample *vector);
-WFDB_INTERNAL void w212(WFDB_Sample v, struct ogdata *g);
-WFDB_INTERNAL void f212(struct ogdata *g);
-WFDB_INTERNAL void w310(WFDB_Sample v, struct ogdata *g);
-WFDB_INTERNAL void f310(struct ogdata *g);
-WFDB_INTERNAL void w311(WFDB_Sample v, struct ogdata *g);
-WFDB_INTERNAL void f311(struct ogdata *g);
+WFDB_INTERNAL int isgsetframe(WFDB_Context *ctx, WFDB_Group g, WFDB_Time t);
+WFDB_INTERNAL int getskewedframe(WFDB_Context *ctx, WFDB_Sample *vector);
+WFDB_INTERNAL long getblkframes(WFDB_Context *ctx, WFDB_Sample *vector,
+				long n);
+WFDB_INTERNAL void isgdecoder(struct igdata *ig, int fmt, unsigned spf);
+WFDB_INTERNAL void isgselect(WFDB_Context *ctx, WFDB_Group g);
+WFDB_INTERNAL void osgencoder(struct ogdata *og, int fmt);
+WFDB_INTERNAL void w212(WFDB_Context *ctx, WFDB_Sample v, struct ogdata *g);
+WFDB_INTERNAL void f212(WFDB_Context *ctx, struct ogdata *g);
+WFDB_INTERNAL void w310(WFDB_Context *ctx, WFDB_Sample v, struct ogdata *g);
+WFDB_INTERNAL void f310(WFDB_Context *ctx, struct ogdata *g);
+WFDB_INTERNAL void w311(WFDB_Context *ctx, WFDB_Sample v, struct ogdata *g);
+WFDB_INTERNAL void f311(WFDB_Context *ctx, struct ogdata *g);
+
+/* From sigpack.c */
+WFDB_INTERNAL int unpack212(const unsigned char *p, WFDB_Sample *v, long n);
+WFDB_INTERNAL int unpack310(const unsigned char *p, WFDB_Sample *v, long n);
+WFDB_INTERNAL int unpack311(const unsigned char *p, WFDB_Sample *v, long n);
+WFDB_INTERNAL void pack16(const WFDB_Sample *v, unsigned char *p, long n);
+WFDB_INTERNAL void pack24(const WFDB_Sample *v, unsigned char *p, long n);
+WFDB_INTERNAL void pack212(const WFDB_Sample *v, unsigned char *p, long n);
+WFDB_INTERNAL void pack310(const WFDB_Sample *v, unsigned char *p, long n);
+WFDB_INTERNAL void pack311(const WFDB_Sample *v, unsigned char *p, long n);
 
 /* From flac.c */
-WFDB_INTERNAL int flac_getsamp(struct igdata *g);
-WFDB_INTERNAL int flac_isopen(struct igdata *ig, struct hsdata **hs, unsigned ns);
-WFDB_INTERNAL int flac_isclose(struct igdata *ig);
-WFDB_INTERNAL int flac_isseek(struct igdata *ig, WFDB_Time t);
-WFDB_INTERNAL int flac_putsamp(WFDB_Sample v, int fmt, struct ogdata *g);
-WFDB_INTERNAL int flac_osinit(struct ogdata *og, const WFDB_Siginfo *si, unsigned ns);
-WFDB_INTERNAL int flac_osopen(struct ogdata *og);
-WFDB_INTERNAL int flac_osclose(struct ogdata *og);
+WFDB_INTERNAL int flac_getsamp(WFDB_Context *ctx, struct igdata *g);
+WFDB_INTERNAL int flac_isopen(WFDB_Context *ctx, struct igdata *ig,
+			      struct hsdata **hs, unsigned ns);
+WFDB_INTERNAL int flac_isclose(WFDB_Context *ctx, struct igdata *ig);
+WFDB_INTERNAL int flac_isseek(WFDB_Context *ctx, struct igdata *ig,
+			      WFDB_Time t);
+WFDB_INTERNAL int flac_putsamp(WFDB_Context *ctx, WFDB_Sample v, int fmt,
+			       struct ogdata *g);
+WFDB_INTERNAL int flac_osinit(WFDB_Context *ctx, struct ogdata *og,
+			      const WFDB_Siginfo *si, unsigned ns);
+WFDB_INTERNAL int flac_osopen(WFDB_Context *ctx, struct ogdata *og);
+WFDB_INTERNAL int flac_osclose(WFDB_Context *ctx, struct ogdata *og);
+WFDB_INTERNAL int flac_encode(struct ogdata *og, const WFDB_Sample *v,
+			      unsigned n);
 
 /* From sigmap.c */
-WFDB_INTERNAL void sigmap_cleanup(void);
-WFDB_INTERNAL int make_vsd(void);
-WFDB_INTERNAL int sigmap_init(int first_segment);
-WFDB_INTERNAL int sigmap(WFDB_Sample *vector, const WFDB_Sample *ivec);
+WFDB_INTERNAL void sigmap_cleanup(WFDB_Context *ctx);
+WFDB_INTERNAL int make_vsd(WFDB_Context *ctx);
+WFDB_INTERNAL int sigmap_init(WFDB_Context *ctx, int first_segment);
+WFDB_INTERNAL int sigmap(WFDB_Context *ctx, WFDB_Sample *vector,
+			  const WFDB_Sample *ivec);
 
 /* From signal.c */
-WFDB_INTERNAL int allocisig(unsigned int n);
-WFDB_INTERNAL int allocigroup(unsigned int n);
-WFDB_INTERNAL int allocosig(unsigned int n);
-WFDB_INTERNAL int allocogroup(unsigned int n);
+WFDB_INTERNAL int allocisig(WFDB_Context *ctx, unsigned int n);
+WFDB_INTERNAL int allocigroup(WFDB_Context *ctx, unsigned int n);
+WFDB_INTERNAL int allocosig(WFDB_Context *ctx, unsigned int n);
+WFDB_INTERNAL int allocogroup(WFDB_Context *ctx, unsigned int n);
 WFDB_INTERNAL int isfmt(int f);
 WFDB_INTERNAL int isflacfmt(int f);
 WFDB_INTERNAL int copysi(WFDB_Siginfo *to, const WFDB_Siginfo *from);
-WFDB_INTERNAL void isigclose(void);
-WFDB_INTERNAL int osigclose(void);
+WFDB_INTERNAL void isigclose(WFDB_Context *ctx);
+WFDB_INTERNAL int osigclose(WFDB_Context *ctx);
 WFDB_INTERNAL WFDB_Sample meansamp(const WFDB_Sample *s, int n);
-WFDB_INTERNAL int rgetvec(WFDB_Sample *vector);
+WFDB_INTERNAL int rgetvec(WFDB_Context *ctx, WFDB_Sample *vector);
+WFDB_INTERNAL long rgetvecs(WFDB_Context *ctx, WFDB_Sample *vector, long n);
+WFDB_INTERNAL void sbfree(WFDB_Context *ctx);
 
 #endif /* WFDB_SIGNAL_INTERNAL_H */
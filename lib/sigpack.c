@@ -0,0 +1,717 @@
+/* file: sigpack.c	2026
+   Block unpacking and packing of the bit-packed and multi-byte signal
+   formats.
+
+   The unpacking functions defined here decode a run of consecutive samples
+   of one of the bit-packed formats (212, 310 and 311) that begins on a byte
+   boundary (on a 3-byte unit in format 212, and a 4-byte unit in formats 310
+   and 311).  They are used by the frame decoders in sigformat.c for long
+   frames, and by getblkframes() and the block cache to decode many frames at
+   once.  The packing functions do the reverse for formats 16, 24, 212, 310
+   and 311;  they are used by the frame encoders in sigformat.c for long
+   frames, and by putvecs() to encode many frames at once.
+
+   Each format has a plain C version, and on x86 processors an SSE2 version
+   (which handles 4 units at a time) and an AVX2 version (8 units at a
+   time).  The fastest version supported by the processor is chosen the
+   first time any of them is used.  All of the versions produce exactly the
+   same results.  The vector versions are compiled only by compilers that
+   accept the GCC target attribute, so that the rest of the library does not
+   need to be built with any special options;  other compilers, and other
+   processors, use the C versions.
+
+   Each unpacking function decodes the n samples (n is a multiple of 2 for
+   format 212, or of 3 for formats 310 and 311) that begin at p, storing them
+   in v, and returns 1 if any of them is the format's invalid-sample value
+   (-2048 in format 212, -512 in formats 310 and 311), or 0 otherwise, so
+   that callers need look for invalid samples only if there are any.  Exactly
+   3*n/2 (format 212) or 4*n/3 (formats 310 and 311) bytes are read.
+
+   Each packing function encodes the n samples in v (with the same
+   restrictions on n), storing them at p exactly as the wN() functions in
+   signal.c would, so that only the low-order bits of each sample that fit in
+   the format are used.  Exactly 2*n (format 16), 3*n (format 24), 3*n/2
+   (format 212) or 4*n/3 (formats 310 and 311) bytes are written.
+*/
+
+#include "signal_internal.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SP_X86
+#include <immintrin.h>
+#endif
+
+#ifdef WFDB_THREADS
+#include <pthread.h>
+#endif
+
+typedef int (*spfunc)(const unsigned char *p, WFDB_Sample *v, long n);
+typedef void (*spfuncw)(const WFDB_Sample *v, unsigned char *p, long n);
+
+static int u212c(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    int bad = 0;
+
+    for ( ; n >= 2; n -= 2, p += 3, v += 2) {
+	v[0] = ((p[0] | ((p[1] & 0x0f) << 8)) ^ 0x800) - 0x800;
+	v[1] = ((p[2] | ((p[1] & 0xf0) << 4)) ^ 0x800) - 0x800;
+	bad |= (v[0] == -2048) | (v[1] == -2048);
+    }
+    return (bad);
+}
+
+static int u310c(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    int bad = 0;
+
+    for ( ; n >= 3; n -= 3, p += 4, v += 3) {
+	unsigned w0 = p[0] | (p[1] << 8), w1 = p[2] | (p[3] << 8);
+
+	v[0] = (((w0 >> 1) & 0x3ff) ^ 0x200) - 0x200;
+	v[1] = (((w1 >> 1) & 0x3ff) ^ 0x200) - 0x200;
+	v[2] = ((((w0 >> 11) | ((w1 >> 11) << 5)) & 0x3ff) ^ 0x200) - 0x200;
+	bad |= (v[0] == -512) | (v[1] == -512) | (v[2] == -512);
+    }
+    return (bad);
+}
+
+static int u311c(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    int bad = 0;
+
+    for ( ; n >= 3; n -= 3, p += 4, v += 3) {
+	unsigned long w = p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16) |
+	    ((unsigned long)p[3] << 24);
+
+	v[0] = ((w & 0x3ff) ^ 0x200) - 0x200;
+	v[1] = (((w >> 10) & 0x3ff) ^ 0x200) - 0x200;
+	v[2] = (((w >> 20) & 0x3ff) ^ 0x200) - 0x200;
+	bad |= (v[0] == -512) | (v[1] == -512) | (v[2] == -512);
+    }
+    return (bad);
+}
+
+#ifdef SP_X86
+/* In the vector versions, each 32-bit lane holds one unit (3 bytes of
+   format 212, or 4 bytes of formats 310 and 311), from which the 2 or 3
+   samples are extracted into separate vectors with shifts and masks, and
+   sign-extended by shifting them to the top of the lane and back.  The
+   vectors of first, second (and third) samples are then interleaved to
+   obtain the samples in their original order. */
+
+/* Interleave the samples of units a, b and c (4 of each) into o[0..2]. */
+#define SP_ILV3(a, b, c, o) do { \
+    __m128 ab_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b)), \
+	   ab_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b)), \
+	   bc_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c)), \
+	   bc_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c)), \
+	   ca_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a)), \
+	   ca_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a)); \
+    o[0] = _mm_castps_si128(_mm_shuffle_ps(ab_lo, ca_lo, \
+					   _MM_SHUFFLE(3, 0, 1, 0))); \
+    o[1] = _mm_castps_si128(_mm_shuffle_ps(bc_lo, ab_hi, \
+					   _MM_SHUFFLE(1, 0, 3, 2))); \
+    o[2] = _mm_castps_si128(_mm_shuffle_ps(ca_hi, bc_hi, \
+					   _MM_SHUFFLE(3, 2, 3, 0))); \
+} while (0)
+
+__attribute__((target("sse2")))
+static int u212sse2(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    const __m128i lo8 = _mm_set1_epi32(0xff), hi4 = _mm_set1_epi32(0xf00),
+	inv = _mm_set1_epi32(-2048);
+    __m128i bad = _mm_setzero_si128();
+
+    /* Each iteration reads 16 bytes, of which 12 (4 units) are used. */
+    for ( ; n >= 12; n -= 8, p += 12, v += 8) {
+	__m128i x = _mm_loadu_si128((const __m128i *)p), w, s0, s1;
+
+	w = _mm_unpacklo_epi64(
+	    _mm_unpacklo_epi32(x, _mm_srli_si128(x, 3)),
+	    _mm_unpacklo_epi32(_mm_srli_si128(x, 6), _mm_srli_si128(x, 9)));
+	s0 = _mm_srai_epi32(_mm_slli_epi32(w, 20), 20);
+	s1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 16), lo8),
+			  _mm_and_si128(_mm_srli_epi32(w, 4), hi4));
+	s1 = _mm_srai_epi32(_mm_slli_epi32(s1, 20), 20);
+	x = _mm_unpacklo_epi32(s0, s1);
+	w = _mm_unpackhi_epi32(s0, s1);
+	_mm_storeu_si128((__m128i *)v, x);
+	_mm_storeu_si128((__m128i *)(v + 4), w);
+	bad = _mm_or_si128(bad, _mm_or_si128(_mm_cmpeq_epi32(x, inv),
+					     _mm_cmpeq_epi32(w, inv)));
+    }
+    return ((_mm_movemask_epi8(bad) != 0) | u212c(p, v, n));
+}
+
+__attribute__((target("sse2")))
+static int u310sse2(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    const __m128i lo5 = _mm_set1_epi32(0x1f), hi5 = _mm_set1_epi32(0x3e0),
+	inv = _mm_set1_epi32(-512);
+    __m128i bad = _mm_setzero_si128(), o[3];
+
+    for ( ; n >= 12; n -= 12, p += 16, v += 12) {
+	__m128i w = _mm_loadu_si128((const __m128i *)p), a, b, c;
+
+	a = _mm_srai_epi32(_mm_slli_epi32(w, 21), 22);
+	b = _mm_srai_epi32(_mm_slli_epi32(w, 5), 22);
+	c = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 11), lo5),
+			 _mm_and_si128(_mm_srli_epi32(w, 22), hi5));
+	c = _mm_srai_epi32(_mm_slli_epi32(c, 22), 22);
+	SP_ILV3(a, b, c, o);
+	_mm_storeu_si128((__m128i *)v, o[0]);
+	_mm_storeu_si128((__m128i *)(v + 4), o[1]);
+	_mm_storeu_si128((__m128i *)(v + 8), o[2]);
+	bad = _mm_or_si128(bad, _mm_or_si128(_mm_cmpeq_epi32(a, inv),
+			   _mm_or_si128(_mm_cmpeq_epi32(b, inv),
+					_mm_cmpeq_epi32(c, inv))));
+    }
+    return ((_mm_movemask_epi8(bad) != 0) | u310c(p, v, n));
+}
+
+__attribute__((target("sse2")))
+static int u311sse2(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    const __m128i inv = _mm_set1_epi32(-512);
+    __m128i bad = _mm_setzero_si128(), o[3];
+
+    for ( ; n >= 12; n -= 12, p += 16, v += 12) {
+	__m128i w = _mm_loadu_si128((const __m128i *)p), a, b, c;
+
+	a = _mm_srai_epi32(_mm_slli_epi32(w, 22), 22);
+	b = _mm_srai_epi32(_mm_slli_epi32(w, 12), 22);
+	c = _mm_srai_epi32(_mm_slli_epi32(w, 2), 22);
+	SP_ILV3(a, b, c, o);
+	_mm_storeu_si128((__m128i *)v, o[0]);
+	_mm_storeu_si128((__m128i *)(v + 4), o[1]);
+	_mm_storeu_si128((__m128i *)(v + 8), o[2]);
+	bad = _mm_or_si128(bad, _mm_or_si128(_mm_cmpeq_epi32(a, inv),
+			   _mm_or_si128(_mm_cmpeq_epi32(b, inv),
+					_mm_cmpeq_epi32(c, inv))));
+    }
+    return ((_mm_movemask_epi8(bad) != 0) | u311c(p, v, n));
+}
+
+/* The AVX2 versions work on two groups of 4 units, one in each 128-bit half
+   of a vector, and the halves of the interleaved results are then put in
+   order. */
+
+#define SP_ILV3X2(a, b, c, o) do { \
+    __m256 ab_lo = _mm256_castsi256_ps(_mm256_unpacklo_epi32(a, b)), \
+	   ab_hi = _mm256_castsi256_ps(_mm256_unpackhi_epi32(a, b)), \
+	   bc_lo = _mm256_castsi256_ps(_mm256_unpacklo_epi32(b, c)), \
+	   bc_hi = _mm256_castsi256_ps(_mm256_unpackhi_epi32(b, c)), \
+	   ca_lo = _mm256_castsi256_ps(_mm256_unpacklo_epi32(c, a)), \
+	   ca_hi = _mm256_castsi256_ps(_mm256_unpackhi_epi32(c, a)); \
+    __m256i t0, t1, t2; \
+    t0 = _mm256_castps_si256(_mm256_shuffle_ps(ab_lo, ca_lo, \
+					       _MM_SHUFFLE(3, 0, 1, 0))); \
+    t1 = _mm256_castps_si256(_mm256_shuffle_ps(bc_lo, ab_hi, \
+					       _MM_SHUFFLE(1, 0, 3, 2))); \
+    t2 = _mm256_castps_si256(_mm256_shuffle_ps(ca_hi, bc_hi, \
+					       _MM_SHUFFLE(3, 2, 3, 0))); \
+    o[0] = _mm256_permute2x128_si256(t0, t1, 0x20); \
+    o[1] = _mm256_permute2x128_si256(t2, t0, 0x30); \
+    o[2] = _mm256_permute2x128_si256(t1, t2, 0x31); \
+} while (0)
+
+__attribute__((target("avx2")))
+static int u212avx2(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    const __m256i lo8 = _mm256_set1_epi32(0xff),
+	hi4 = _mm256_set1_epi32(0xf00), inv = _mm256_set1_epi32(-2048),
+	shuf = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1,
+				9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1,
+				6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i bad = _mm256_setzero_si256();
+
+    /* Each iteration reads 28 bytes, of which 24 (8 units) are used. */
+    for ( ; n >= 20; n -= 16, p += 24, v += 16) {
+	__m256i w, s0, s1, lo, hi;
+
+	w = _mm256_inserti128_si256(
+	    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+	    _mm_loadu_si128((const __m128i *)(p + 12)), 1);
+	w = _mm256_shuffle_epi8(w, shuf);
+	s0 = _mm256_srai_epi32(_mm256_slli_epi32(w, 20), 20);
+	s1 = _mm256_or_si256(
+	    _mm256_and_si256(_mm256_srli_epi32(w, 16), lo8),
+	    _mm256_and_si256(_mm256_srli_epi32(w, 4), hi4));
+	s1 = _mm256_srai_epi32(_mm256_slli_epi32(s1, 20), 20);
+	lo = _mm256_unpacklo_epi32(s0, s1);
+	hi = _mm256_unpackhi_epi32(s0, s1);
+	_mm256_storeu_si256((__m256i *)v,
+			    _mm256_permute2x128_si256(lo, hi, 0x20));
+	_mm256_storeu_si256((__m256i *)(v + 8),
+			    _mm256_permute2x128_si256(lo, hi, 0x31));
+	bad = _mm256_or_si256(bad, _mm256_or_si256(
+	    _mm256_cmpeq_epi32(lo, inv), _mm256_cmpeq_epi32(hi, inv)));
+    }
+    return ((_mm256_movemask_epi8(bad) != 0) | u212c(p, v, n));
+}
+
+__attribute__((target("avx2")))
+static int u310avx2(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    const __m256i lo5 = _mm256_set1_epi32(0x1f),
+	hi5 = _mm256_set1_epi32(0x3e0), inv = _mm256_set1_epi32(-512);
+    __m256i bad = _mm256_setzero_si256(), o[3];
+
+    for ( ; n >= 24; n -= 24, p += 32, v += 24) {
+	__m256i w = _mm256_loadu_si256((const __m256i *)p), a, b, c;
+
+	a = _mm256_srai_epi32(_mm256_slli_epi32(w, 21), 22);
+	b = _mm256_srai_epi32(_mm256_slli_epi32(w, 5), 22);
+	c = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 11), lo5),
+			    _mm256_and_si256(_mm256_srli_epi32(w, 22), hi5));
+	c = _mm256_srai_epi32(_mm256_slli_epi32(c, 22), 22);
+	SP_ILV3X2(a, b, c, o);
+	_mm256_storeu_si256((__m256i *)v, o[0]);
+	_mm256_storeu_si256((__m256i *)(v + 8), o[1]);
+	_mm256_storeu_si256((__m256i *)(v + 16), o[2]);
+	bad = _mm256_or_si256(bad, _mm256_or_si256(
+	    _mm256_cmpeq_epi32(a, inv),
+	    _mm256_or_si256(_mm256_cmpeq_epi32(b, inv),
+			    _mm256_cmpeq_epi32(c, inv))));
+    }
+    return ((_mm256_movemask_epi8(bad) != 0) | u310c(p, v, n));
+}
+
+__attribute__((target("avx2")))
+static int u311avx2(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    const __m256i inv = _mm256_set1_epi32(-512);
+    __m256i bad = _mm256_setzero_si256(), o[3];
+
+    for ( ; n >= 24; n -= 24, p += 32, v += 24) {
+	__m256i w = _mm256_loadu_si256((const __m256i *)p), a, b, c;
+
+	a = _mm256_srai_epi32(_mm256_slli_epi32(w, 22), 22);
+	b = _mm256_srai_epi32(_mm256_slli_epi32(w, 12), 22);
+	c = _mm256_srai_epi32(_mm256_slli_epi32(w, 2), 22);
+	SP_ILV3X2(a, b, c, o);
+	_mm256_storeu_si256((__m256i *)v, o[0]);
+	_mm256_storeu_si256((__m256i *)(v + 8), o[1]);
+	_mm256_storeu_si256((__m256i *)(v + 16), o[2]);
+	bad = _mm256_or_si256(bad, _mm256_or_si256(
+	    _mm256_cmpeq_epi32(a, inv),
+	    _mm256_or_si256(_mm256_cmpeq_epi32(b, inv),
+			    _mm256_cmpeq_epi32(c, inv))));
+    }
+    return ((_mm256_movemask_epi8(bad) != 0) | u311c(p, v, n));
+}
+#endif
+
+/* Packing functions.  As in the wN() functions, the shifts are applied to
+   unsigned values so that negative samples are handled portably. */
+
+static void p16c(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    for ( ; n > 0; n--, v++, p += 2) {
+	unsigned x = (unsigned)*v;
+
+	p[0] = (unsigned char)x;
+	p[1] = (unsigned char)(x >> 8);
+    }
+}
+
+static void p24c(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    for ( ; n > 0; n--, v++, p += 3) {
+	unsigned x = (unsigned)*v;
+
+	p[0] = (unsigned char)x;
+	p[1] = (unsigned char)(x >> 8);
+	p[2] = (unsigned char)(x >> 16);
+    }
+}
+
+static void p212c(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    for ( ; n >= 2; n -= 2, v += 2, p += 3) {
+	unsigned x0 = (unsigned)v[0], x1 = (unsigned)v[1];
+
+	p[0] = (unsigned char)x0;
+	p[1] = (unsigned char)(((x0 >> 8) & 0x0f) | ((x1 >> 4) & 0xf0));
+	p[2] = (unsigned char)x1;
+    }
+}
+
+static void p310c(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    for ( ; n >= 3; n -= 3, v += 3, p += 4) {
+	unsigned x2 = (unsigned)v[2],
+	    w0 = (((unsigned)v[0] << 1) & 0x7fe) | (x2 << 11),
+	    w1 = (((unsigned)v[1] << 1) & 0x7fe) | ((x2 << 6) & 0xf800);
+
+	p[0] = (unsigned char)w0; p[1] = (unsigned char)(w0 >> 8);
+	p[2] = (unsigned char)w1; p[3] = (unsigned char)(w1 >> 8);
+    }
+}
+
+static void p311c(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    for ( ; n >= 3; n -= 3, v += 3, p += 4) {
+	unsigned long w = ((unsigned long)v[0] & 0x3ff) |
+	    (((unsigned long)v[1] & 0x3ff) << 10) |
+	    (((unsigned long)v[2] & 0x3ff) << 20);
+
+	p[0] = (unsigned char)w; p[1] = (unsigned char)(w >> 8);
+	p[2] = (unsigned char)(w >> 16); p[3] = (unsigned char)(w >> 24);
+    }
+}
+
+#ifdef SP_X86
+/* The vector packing functions reverse the steps of the unpacking
+   functions:  the samples of 4 (or 8) units are separated into vectors of
+   first, second (and third) samples, which are then combined with shifts and
+   masks into one unit per 32-bit lane.  In formats 212 and 24, the 3-byte
+   units are then moved together, and the stores may write up to 8 bytes
+   past the last unit;  the loops stop early enough that these bytes are
+   always within the space to be written, and they are overwritten by the
+   following units. */
+
+/* Separate the samples of 4 units in o0, o1 and o2 into a, b and c. */
+#define SP_DLV3(o0, o1, o2, a, b, c) do { \
+    __m128 f0 = _mm_castsi128_ps(o0), f1 = _mm_castsi128_ps(o1), \
+	   f2 = _mm_castsi128_ps(o2), t; \
+    t = _mm_shuffle_ps(f1, f2, _MM_SHUFFLE(1, 1, 2, 2)); \
+    a = _mm_castps_si128(_mm_shuffle_ps(f0, t, _MM_SHUFFLE(2, 0, 3, 0))); \
+    b = _mm_castps_si128(_mm_shuffle_ps( \
+	    _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(0, 0, 1, 1)), \
+	    _mm_shuffle_ps(f1, f2, _MM_SHUFFLE(2, 2, 3, 3)), \
+	    _MM_SHUFFLE(2, 0, 2, 0))); \
+    c = _mm_castps_si128(_mm_shuffle_ps( \
+	    _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(1, 1, 2, 2)), \
+	    _mm_shuffle_ps(f2, f2, _MM_SHUFFLE(3, 3, 0, 0)), \
+	    _MM_SHUFFLE(2, 0, 2, 0))); \
+} while (0)
+
+/* Move the low 3 bytes of each lane of u together, into the low 12 bytes of
+   the result. */
+__attribute__((target("sse2")))
+static __m128i sp24sse2(__m128i u)
+{
+    const __m128i m0 = _mm_setr_epi32(0xffffff, 0, 0, 0),
+	m1 = _mm_setr_epi32(0, 0xffffff, 0, 0),
+	m2 = _mm_setr_epi32(0, 0, 0xffffff, 0),
+	m3 = _mm_setr_epi32(0, 0, 0, 0xffffff);
+
+    return (_mm_or_si128(
+		_mm_or_si128(_mm_and_si128(u, m0),
+			     _mm_srli_si128(_mm_and_si128(u, m1), 1)),
+		_mm_or_si128(_mm_srli_si128(_mm_and_si128(u, m2), 2),
+			     _mm_srli_si128(_mm_and_si128(u, m3), 3))));
+}
+
+/* Combine the samples of 4 format 212 units (in v[0..7]) into one unit per
+   lane. */
+__attribute__((target("sse2")))
+static __m128i sp212units(const WFDB_Sample *v)
+{
+    const __m128i m12 = _mm_set1_epi32(0xfff), hi4 = _mm_set1_epi32(0xf00),
+	lo8 = _mm_set1_epi32(0xff);
+    __m128i x = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)v),
+				  _MM_SHUFFLE(3, 1, 2, 0)),
+	y = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(v + 4)),
+			      _MM_SHUFFLE(3, 1, 2, 0)),
+	a = _mm_unpacklo_epi64(x, y), b = _mm_unpackhi_epi64(x, y);
+
+    return (_mm_or_si128(_mm_and_si128(a, m12),
+	       _mm_or_si128(_mm_slli_epi32(_mm_and_si128(b, hi4), 4),
+			    _mm_slli_epi32(_mm_and_si128(b, lo8), 16))));
+}
+
+__attribute__((target("sse2")))
+static void p16sse2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    for ( ; n >= 8; n -= 8, v += 8, p += 16) {
+	__m128i a = _mm_loadu_si128((const __m128i *)v),
+	    b = _mm_loadu_si128((const __m128i *)(v + 4));
+
+	/* Sign-extend the low 16 bits, so that packs does not saturate. */
+	a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+	b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+	_mm_storeu_si128((__m128i *)p, _mm_packs_epi32(a, b));
+    }
+    p16c(v, p, n);
+}
+
+__attribute__((target("sse2")))
+static void p24sse2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    /* Each iteration writes 16 bytes, of which 12 (4 samples) are used. */
+    for ( ; n >= 6; n -= 4, v += 4, p += 12)
+	_mm_storeu_si128((__m128i *)p,
+			 sp24sse2(_mm_loadu_si128((const __m128i *)v)));
+    p24c(v, p, n);
+}
+
+__attribute__((target("sse2")))
+static void p212sse2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    /* Each iteration writes 16 bytes, of which 12 (4 units) are used. */
+    for ( ; n >= 12; n -= 8, v += 8, p += 12)
+	_mm_storeu_si128((__m128i *)p, sp24sse2(sp212units(v)));
+    p212c(v, p, n);
+}
+
+__attribute__((target("sse2")))
+static void p310sse2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    const __m128i m10 = _mm_set1_epi32(0x7fe), hi5 = _mm_set1_epi32(0xf800);
+
+    for ( ; n >= 12; n -= 12, v += 12, p += 16) {
+	__m128i a, b, c, w;
+
+	SP_DLV3(_mm_loadu_si128((const __m128i *)v),
+		_mm_loadu_si128((const __m128i *)(v + 4)),
+		_mm_loadu_si128((const __m128i *)(v + 8)), a, b, c);
+	w = _mm_or_si128(
+	    _mm_or_si128(_mm_and_si128(_mm_slli_epi32(a, 1), m10),
+			 _mm_and_si128(_mm_slli_epi32(c, 11), hi5)),
+	    _mm_slli_epi32(
+		_mm_or_si128(_mm_and_si128(_mm_slli_epi32(b, 1), m10),
+			     _mm_and_si128(_mm_slli_epi32(c, 6), hi5)), 16));
+	_mm_storeu_si128((__m128i *)p, w);
+    }
+    p310c(v, p, n);
+}
+
+__attribute__((target("sse2")))
+static void p311sse2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    const __m128i m10 = _mm_set1_epi32(0x3ff);
+
+    for ( ; n >= 12; n -= 12, v += 12, p += 16) {
+	__m128i a, b, c, w;
+
+	SP_DLV3(_mm_loadu_si128((const __m128i *)v),
+		_mm_loadu_si128((const __m128i *)(v + 4)),
+		_mm_loadu_si128((const __m128i *)(v + 8)), a, b, c);
+	w = _mm_or_si128(_mm_and_si128(a, m10),
+	      _mm_or_si128(_mm_slli_epi32(_mm_and_si128(b, m10), 10),
+			   _mm_slli_epi32(_mm_and_si128(c, m10), 20)));
+	_mm_storeu_si128((__m128i *)p, w);
+    }
+    p311c(v, p, n);
+}
+
+/* The AVX2 versions put the units of each group of 4 in one 128-bit half of
+   a vector, as in the AVX2 unpacking functions. */
+
+#define SP_DLV3X2(r0, r1, r2, a, b, c) do { \
+    __m256 f0 = _mm256_castsi256_ps(_mm256_permute2x128_si256(r0, r1, 0x30)), \
+	   f1 = _mm256_castsi256_ps(_mm256_permute2x128_si256(r0, r2, 0x21)), \
+	   f2 = _mm256_castsi256_ps(_mm256_permute2x128_si256(r1, r2, 0x30)), \
+	   t; \
+    t = _mm256_shuffle_ps(f1, f2, _MM_SHUFFLE(1, 1, 2, 2)); \
+    a = _mm256_castps_si256(_mm256_shuffle_ps(f0, t, _MM_SHUFFLE(2, 0, 3, 0))); \
+    b = _mm256_castps_si256(_mm256_shuffle_ps( \
+	    _mm256_shuffle_ps(f0, f1, _MM_SHUFFLE(0, 0, 1, 1)), \
+	    _mm256_shuffle_ps(f1, f2, _MM_SHUFFLE(2, 2, 3, 3)), \
+	    _MM_SHUFFLE(2, 0, 2, 0))); \
+    c = _mm256_castps_si256(_mm256_shuffle_ps( \
+	    _mm256_shuffle_ps(f0, f1, _MM_SHUFFLE(1, 1, 2, 2)), \
+	    _mm256_shuffle_ps(f2, f2, _MM_SHUFFLE(3, 3, 0, 0)), \
+	    _MM_SHUFFLE(2, 0, 2, 0))); \
+} while (0)
+
+/* Move the low 3 bytes of each lane of u together, into the low 24 bytes of
+   the result. */
+__attribute__((target("avx2")))
+static __m256i sp24avx2(__m256i u)
+{
+    const __m256i shuf = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13,
+					  14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6,
+					  8, 9, 10, 12, 13, 14, -1, -1, -1, -1),
+	perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    return (_mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(u, shuf), perm));
+}
+
+__attribute__((target("avx2")))
+static void p16avx2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    for ( ; n >= 16; n -= 16, v += 16, p += 32) {
+	__m256i a = _mm256_loadu_si256((const __m256i *)v),
+	    b = _mm256_loadu_si256((const __m256i *)(v + 8));
+
+	a = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+	b = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+	_mm256_storeu_si256((__m256i *)p, _mm256_permute4x64_epi64(
+				_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    p16c(v, p, n);
+}
+
+__attribute__((target("avx2")))
+static void p24avx2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    /* Each iteration writes 32 bytes, of which 24 (8 samples) are used. */
+    for ( ; n >= 11; n -= 8, v += 8, p += 24)
+	_mm256_storeu_si256((__m256i *)p, sp24avx2(
+				_mm256_loadu_si256((const __m256i *)v)));
+    p24c(v, p, n);
+}
+
+__attribute__((target("avx2")))
+static void p212avx2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    const __m256i m12 = _mm256_set1_epi32(0xfff),
+	hi4 = _mm256_set1_epi32(0xf00), lo8 = _mm256_set1_epi32(0xff);
+
+    /* Each iteration writes 32 bytes, of which 24 (8 units) are used. */
+    for ( ; n >= 22; n -= 16, v += 16, p += 24) {
+	__m256i x = _mm256_shuffle_epi32(
+	    _mm256_loadu_si256((const __m256i *)v), _MM_SHUFFLE(3, 1, 2, 0)),
+	    y = _mm256_shuffle_epi32(
+	    _mm256_loadu_si256((const __m256i *)(v + 8)),
+	    _MM_SHUFFLE(3, 1, 2, 0)), a, b, u;
+
+	/* a and b hold the first and second samples of units 0, 1, 4, 5, 2,
+	   3, 6 and 7, in that order. */
+	a = _mm256_unpacklo_epi64(x, y);
+	b = _mm256_unpackhi_epi64(x, y);
+	u = _mm256_or_si256(_mm256_and_si256(a, m12),
+	      _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(b, hi4), 4),
+			      _mm256_slli_epi32(_mm256_and_si256(b, lo8), 16)));
+	u = _mm256_permute4x64_epi64(u, _MM_SHUFFLE(3, 1, 2, 0));
+	_mm256_storeu_si256((__m256i *)p, sp24avx2(u));
+    }
+    p212c(v, p, n);
+}
+
+__attribute__((target("avx2")))
+static void p310avx2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    const __m256i m10 = _mm256_set1_epi32(0x7fe),
+	hi5 = _mm256_set1_epi32(0xf800);
+
+    for ( ; n >= 24; n -= 24, v += 24, p += 32) {
+	__m256i r0 = _mm256_loadu_si256((const __m256i *)v),
+	    r1 = _mm256_loadu_si256((const __m256i *)(v + 8)),
+	    r2 = _mm256_loadu_si256((const __m256i *)(v + 16)), a, b, c, w;
+
+	SP_DLV3X2(r0, r1, r2, a, b, c);
+	w = _mm256_or_si256(
+	    _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(a, 1), m10),
+			    _mm256_and_si256(_mm256_slli_epi32(c, 11), hi5)),
+	    _mm256_slli_epi32(
+		_mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(b, 1), m10),
+				_mm256_and_si256(_mm256_slli_epi32(c, 6), hi5)),
+		16));
+	_mm256_storeu_si256((__m256i *)p, w);
+    }
+    p310c(v, p, n);
+}
+
+__attribute__((target("avx2")))
+static void p311avx2(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    const __m256i m10 = _mm256_set1_epi32(0x3ff);
+
+    for ( ; n >= 24; n -= 24, v += 24, p += 32) {
+	__m256i r0 = _mm256_loadu_si256((const __m256i *)v),
+	    r1 = _mm256_loadu_si256((const __m256i *)(v + 8)),
+	    r2 = _mm256_loadu_si256((const __m256i *)(v + 16)), a, b, c, w;
+
+	SP_DLV3X2(r0, r1, r2, a, b, c);
+	w = _mm256_or_si256(_mm256_and_si256(a, m10),
+	      _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(b, m10), 10),
+			      _mm256_slli_epi32(_mm256_and_si256(c, m10), 20)));
+	_mm256_storeu_si256((__m256i *)p, w);
+    }
+    p311c(v, p, n);
+}
+#endif
+
+/* The versions in use, chosen by spinit(). */
+static spfunc sp212 = u212c, sp310 = u310c, sp311 = u311c;
+static spfuncw sw16 = p16c, sw24 = p24c, sw212 = p212c, sw310 = p310c,
+    sw311 = p311c;
+
+static void spinit(void)
+{
+#ifdef SP_X86
+    __builtin_cpu_init();
+    if (sizeof(WFDB_Sample) != 4)
+	return;
+    if (__builtin_cpu_supports("avx2")) {
+	sp212 = u212avx2;
+	sp310 = u310avx2;
+	sp311 = u311avx2;
+	sw16 = p16avx2;
+	sw24 = p24avx2;
+	sw212 = p212avx2;
+	sw310 = p310avx2;
+	sw311 = p311avx2;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+	sp212 = u212sse2;
+	sp310 = u310sse2;
+	sp311 = u311sse2;
+	sw16 = p16sse2;
+	sw24 = p24sse2;
+	sw212 = p212sse2;
+	sw310 = p310sse2;
+	sw311 = p311sse2;
+    }
+#endif
+}
+
+#ifdef WFDB_THREADS
+static pthread_once_t sponce = PTHREAD_ONCE_INIT;
+#define SPINIT()	pthread_once(&sponce, spinit)
+#else
+static int spdone;
+#define SPINIT()	if (!spdone) { spinit(); spdone = 1; }
+#endif
+
+int unpack212(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    SPINIT();
+    return ((*sp212)(p, v, n));
+}
+
+int unpack310(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    SPINIT();
+    return ((*sp310)(p, v, n));
+}
+
+int unpack311(const unsigned char *p, WFDB_Sample *v, long n)
+{
+    SPINIT();
+    return ((*sp311)(p, v, n));
+}
+
+void pack16(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    SPINIT();
+    (*sw16)(v, p, n);
+}
+
+void pack24(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    SPINIT();
+    (*sw24)(v, p, n);
+}
+
+void pack212(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    SPINIT();
+    (*sw212)(v, p, n);
+}
+
+void pack310(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    SPINIT();
+    (*sw310)(v, p, n);
+}
+
+void pack311(const WFDB_Sample *v, unsigned char *p, long n)
+{
+    SPINIT();
+    (*sw311)(v, p, n);
+}
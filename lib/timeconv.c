@@ -32,6 +32,8 @@ This file contains definitions of the following WFDB library functions:
  timstr		(converts sample intervals to time strings)
  fmstimstr	(converts sample intervals to time strings with milliseconds)
  mstimstr	(converts sample intervals to time strings with milliseconds)
+ timstr_r	(reentrant version of timstr)
+ mstimstr_r	(reentrant version of mstimstr)
  getcfreq	(gets the counter frequency)
  setcfreq	(sets the counter frequency)
  getbasecount	(gets the base counter value)
@@ -39,10 +41,12 @@ This file contains definitions of the following WFDB library functions:
  fstrtim	(converts time strings to sample intervals)
  strtim		(converts time strings to sample intervals)
  datstr		(converts Julian dates to date strings)
+ datstr_r	(reentrant version of datstr)
  strdat		(converts date strings to Julian dates)
  adumuv		(converts ADC units to microvolts)
  muvadu		(converts microvolts to ADC units)
  aduphys	(converts ADC units to physical units)
+ aduphysv [11.0] (converts an array of samples to physical units)
  physadu	(converts physical units to ADC units)
 
 These functions were previously part of signal.c.
@@ -51,6 +55,7 @@ These functions were previously part of signal.c.
 #include "signal_internal.h"
 
 #include <time.h>
+#include <math.h>
 
 WFDB_Frequency sampfreq_ctx(WFDB_Context *ctx, char *record)
 {
@@ -61,13 +66,13 @@ WFDB_Frequency sampfreq_ctx(WFDB_Context *ctx, char *record)
 
     if (record != NULL) {
 	/* Save the current record name. */
-	wfdb_setirec(record);
+	wfdb_setirec_ctx(ctx, record);
 	/* Don't require the sampling frequency of this record to match that
 	   of the previously opened record, if any.  (readheader will
 	   complain if the previously defined sampling frequency was > 0.) */
-	setsampfreq(0.);
+	setsampfreq_ctx(ctx, 0.);
 	/* readheader sets sfreq if successful. */
-	if ((n = readheader(record)) < 0)
+	if ((n = readheader(ctx, record)) < 0)
 	    /* error message will come from readheader */
 	    return ((WFDB_Frequency)n);
     }
@@ -87,7 +92,8 @@ int setsampfreq_ctx(WFDB_Context *ctx, WFDB_Frequency freq)
 	if ((gvmode & WFDB_HIGHRES) == WFDB_HIGHRES) sfreq *= spfmax;
 	return (0);
     }
-    wfdb_error("setsampfreq: sampling frequency must not be negative\n");
+    wfdb_error_ctx(ctx,
+		   "setsampfreq: sampling frequency must not be negative\n");
     return (-1);
 }
 
@@ -112,17 +118,18 @@ int setbasetime_ctx(WFDB_Context *ctx, char *string)
 	bdate = strdat(date_string);
 	(void)snprintf(time_string, sizeof(time_string), "%d:%d:%d",
 		now->tm_hour, now->tm_min, now->tm_sec);
-	btime = fstrtim(time_string, 1000.0);
+	btime = fstrtim(ctx, time_string, 1000.0);
 	return (0);
     }
     while (*string == ' ') string++;
     if (p = strchr(string, ' '))
         *p++ = '\0';	/* split time and date components */
-    btime = fstrtim(string, 1000.0);
+    btime = fstrtim(ctx, string, 1000.0);
     bdate = p ? strdat(p) : (WFDB_Date)0;
     if (btime == 0L && bdate == (WFDB_Date)0 && *string != '[') {
 	if (p) *(--p) = ' ';
-	wfdb_error("setbasetime: incorrect time format, '%s'\n", string);
+	wfdb_error_ctx(ctx, "setbasetime: incorrect time format, '%s'\n",
+		       string);
 	return (-1);
     }
     return (0);
@@ -133,42 +140,65 @@ int setbasetime(char *string)
     return setbasetime_ctx(wfdb_get_default_context(), string);
 }
 
-/* Convert sample number to string, using the given sampling
-   frequency */
-char *ftimstr(WFDB_Time t, WFDB_Frequency f)
-{
-    WFDB_Context *ctx = wfdb_get_default_context();
-    char *p;
-
-    p = strtok(fmstimstr(t, f), ".");		 /* discard msec field */
-    if (t <= 0L && (btime != 0L || bdate != (WFDB_Date)0)) { /* time of day */
-	(void)strcat(p, date_string);		  /* append dd/mm/yyyy */
-	(void)strcat(p, "]");
-    }
+/* The time and date formatting functions below write their digits
+   directly rather than through snprintf, which otherwise dominates the
+   cost of text export (rdsamp, rdann).  fmt_int writes v in decimal,
+   padded on the left with pad characters to a width of at least w. */
+static char *fmt_int(char *p, long v, int w, char pad)
+{
+    char d[24];
+    int n = 0, neg = (v < 0);
+    unsigned long u = neg ? -(unsigned long)v : (unsigned long)v;
+
+    do {
+	d[n++] = '0' + u % 10;
+	u /= 10;
+    } while (u);
+    if (neg) d[n++] = '-';
+    while (w-- > n)
+	*p++ = pad;
+    while (n > 0)
+	*p++ = d[--n];
     return (p);
 }
 
-char *timstr_ctx(WFDB_Context *ctx, WFDB_Time t)
+/* fmt_date writes the Julian date, date, as " DD/MM/YYYY" (see datstr). */
+static char *fmt_date(char *p, WFDB_Date date)
 {
-    double f;
-
-    if (ifreq > 0.) f = ifreq;
-    else if (sfreq > 0.) f = sfreq;
-    else f = 1.0;
-
-    return ftimstr(t, f);
-}
-
-char *timstr(WFDB_Time t)
-{
-    return timstr_ctx(wfdb_get_default_context(), t);
-}
+    int d, m, y, gcorr, jm, jy;
+    WFDB_Date jd;
 
-/* Convert sample number to string, using the given sampling
-   frequency */
-char *fmstimstr(WFDB_Time t, WFDB_Frequency f)
+    if (date >= 2299161L) {	/* Gregorian calendar correction */
+	gcorr = (int)(((date - 1867216L) - 0.25)/36524.25);
+	date += 1 + gcorr - (long)(0.25*gcorr);
+    }
+    date += 1524;
+    jy = (int)(6680 + ((date - 2439870L) - 122.1)/365.25);
+    jd = (WFDB_Date)(365L*jy + (0.25*jy));
+    jm = (int)((date - jd)/30.6001);
+    d = date - jd - (int)(30.6001*jm);
+    if ((m = jm - 1) > 12) m -= 12;
+    y = jy - 4715;
+    if (m > 2) y--;
+    if (y <= 0) y--;
+    *p++ = ' ';
+    p = fmt_int(p, d, 2, '0');
+    *p++ = '/';
+    p = fmt_int(p, m, 2, '0');
+    *p++ = '/';
+    return (fmt_int(p, y, 0, ' '));
+}
+
+/* fmt_time writes t (in sample intervals at frequency f) in the format
+   used by mstimstr (if msflag is non-zero) or timstr.  If the result is a
+   time of day, the date (or day number) is taken from dbuf if *dcache
+   matches it, or written into dbuf otherwise;  pass a NULL dcache to
+   bypass the cache.  The output is null-terminated, and a pointer to the
+   null is returned. */
+static char *fmt_time(WFDB_Context *ctx, char *p, WFDB_Time t,
+		      WFDB_Frequency f, int msflag, char *dbuf,
+		      WFDB_Date *dcache)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     int hours, minutes, seconds, msec;
     WFDB_Date days;
     double tms;
@@ -185,12 +215,21 @@ char *fmstimstr(WFDB_Time t, WFDB_Frequency f)
 	t /= 60;
 	minutes = t % 60;
 	hours = t / 60;
-	if (hours > 0)
-	    (void)snprintf(time_string, sizeof(time_string), "%2d:%02d:%02d.%03d",
-			  hours, minutes, seconds, msec);
-	else
-	    (void)snprintf(time_string, sizeof(time_string), "   %2d:%02d.%03d",
-			  minutes, seconds, msec);
+	if (hours > 0) {
+	    p = fmt_int(p, hours, 2, ' ');
+	    *p++ = ':';
+	    p = fmt_int(p, minutes, 2, '0');
+	}
+	else {
+	    *p++ = ' '; *p++ = ' '; *p++ = ' ';
+	    p = fmt_int(p, minutes, 2, ' ');
+	}
+	*p++ = ':';
+	p = fmt_int(p, seconds, 2, '0');
+	if (msflag) {
+	    *p++ = '.';
+	    p = fmt_int(p, msec, 3, '0');
+	}
     }
     else {			/* time of day */
 	/* Convert to milliseconds since midnight. */
@@ -206,18 +245,76 @@ char *fmstimstr(WFDB_Time t, WFDB_Frequency f)
 	t /= 60;
 	hours = t % 24;
 	days = t / 24;
-	if (days != pdays) {
+	if (dcache == NULL || days != *dcache) {
 	    if (bdate > 0)
-		(void)datstr(days + bdate);
+		*fmt_date(dbuf, days + bdate) = '\0';
 	    else if (days == 0)
-		date_string[0] = '\0';
-	    else
-		(void)snprintf(date_string, sizeof(date_string), " %ld", days);
-	    pdays = days;
+		dbuf[0] = '\0';
+	    else {
+		dbuf[0] = ' ';
+		*fmt_int(dbuf+1, days, 0, ' ') = '\0';
+	    }
+	    if (dcache) *dcache = days;
 	}
-	(void)snprintf(time_string, sizeof(time_string), "[%02d:%02d:%02d.%03d%s]",
-		      hours, minutes, seconds, msec, date_string);
+	*p++ = '[';
+	p = fmt_int(p, hours, 2, '0');
+	*p++ = ':';
+	p = fmt_int(p, minutes, 2, '0');
+	*p++ = ':';
+	p = fmt_int(p, seconds, 2, '0');
+	if (msflag) {
+	    *p++ = '.';
+	    p = fmt_int(p, msec, 3, '0');
+	}
+	while (*dbuf)
+	    *p++ = *dbuf++;
+	*p++ = ']';
     }
+    *p = '\0';
+    return (p);
+}
+
+/* Copy a formatted string into a caller-supplied buffer of length len,
+   truncating it if necessary (as snprintf would). */
+static char *copy_r(char *buf, int len, const char *s, int n)
+{
+    if (buf == NULL || len <= 0)
+	return (NULL);
+    if (n >= len) n = len - 1;
+    memcpy(buf, s, n);
+    buf[n] = '\0';
+    return (buf);
+}
+
+/* Convert sample number to string, using the given sampling
+   frequency */
+char *ftimstr(WFDB_Context *ctx, WFDB_Time t, WFDB_Frequency f)
+{
+    (void)fmt_time(ctx, time_string, t, f, 0, date_string, &pdays);
+    return (time_string);
+}
+
+char *timstr_ctx(WFDB_Context *ctx, WFDB_Time t)
+{
+    double f;
+
+    if (ifreq > 0.) f = ifreq;
+    else if (sfreq > 0.) f = sfreq;
+    else f = 1.0;
+
+    return ftimstr(ctx, t, f);
+}
+
+char *timstr(WFDB_Time t)
+{
+    return timstr_ctx(wfdb_get_default_context(), t);
+}
+
+/* Convert sample number to string, using the given sampling
+   frequency */
+char *fmstimstr(WFDB_Context *ctx, WFDB_Time t, WFDB_Frequency f)
+{
+    (void)fmt_time(ctx, time_string, t, f, 1, date_string, &pdays);
     return (time_string);
 }
 
@@ -229,7 +326,7 @@ char *mstimstr_ctx(WFDB_Context *ctx, WFDB_Time t)
     else if (sfreq > 0.) f = sfreq;
     else f = 1.0;
 
-    return fmstimstr(t, f);
+    return fmstimstr(ctx, t, f);
 }
 
 char *mstimstr(WFDB_Time t)
@@ -237,6 +334,39 @@ char *mstimstr(WFDB_Time t)
     return mstimstr_ctx(wfdb_get_default_context(), t);
 }
 
+/* timstr_r and mstimstr_r are reentrant versions of timstr and mstimstr.
+   They write the result into buf (of length len) rather than into the
+   context's time_string, and do not use or update the context's cached
+   date, so that several threads can format times for the same context
+   concurrently once the record has been opened.  If ctx is NULL, the
+   default context (that used by timstr and mstimstr) is used. */
+static WFDB_Frequency timstr_freq(WFDB_Context *ctx)
+{
+    if (ifreq > 0.) return (ifreq);
+    else if (sfreq > 0.) return (sfreq);
+    else return (1.0);
+}
+
+char *timstr_r(WFDB_Context *ctx, WFDB_Time t, char *buf, int len)
+{
+    char tbuf[WFDB_TIMSTRLEN], dbuf[WFDB_TIMSTRLEN], *p;
+
+    if (ctx == NULL) ctx = wfdb_get_default_context();
+    p = fmt_time(ctx, tbuf, t, timstr_freq(ctx), 0, dbuf, NULL);
+
+    return (copy_r(buf, len, tbuf, p - tbuf));
+}
+
+char *mstimstr_r(WFDB_Context *ctx, WFDB_Time t, char *buf, int len)
+{
+    char tbuf[WFDB_TIMSTRLEN], dbuf[WFDB_TIMSTRLEN], *p;
+
+    if (ctx == NULL) ctx = wfdb_get_default_context();
+    p = fmt_time(ctx, tbuf, t, timstr_freq(ctx), 1, dbuf, NULL);
+
+    return (copy_r(buf, len, tbuf, p - tbuf));
+}
+
 WFDB_Frequency getcfreq_ctx(WFDB_Context *ctx)
 {
     return (cfreq > 0. ? cfreq : ffreq);
@@ -279,9 +409,8 @@ void setbasecount(double counter)
 
 /* Convert string to sample number, using the given sampling
    frequency */
-WFDB_Time fstrtim(const char *string, WFDB_Frequency f)
+WFDB_Time fstrtim(WFDB_Context *ctx, const char *string, WFDB_Frequency f)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     const char *p, *q, *r;
     double x, y, z;
     WFDB_Date days;
@@ -310,7 +439,7 @@ WFDB_Time fstrtim(const char *string, WFDB_Frequency f)
 	    days = (WFDB_Date)strtol(p+1, NULL, 10); /* '[hh:mm:ss.sss d]' */
 	else
 	    days = strdat(p+1) - bdate; /* '[hh:mm:ss.sss dd/mm/yyyy]' */
-        x = fstrtim(string, 1000.0) - btime;
+        x = fstrtim(ctx, string, 1000.0) - btime;
         if (days > 0L) x += (days*(24*60*60*1000.0));
         t = (WFDB_Time)(x * f / 1000.0 + 0.5);
 	return (-t);
@@ -332,7 +461,7 @@ WFDB_Time strtim_ctx(WFDB_Context *ctx, const char *string)
     else if (sfreq > 0.) f = sfreq;
     else f = 1.0;
 
-    return fstrtim(string, f);
+    return fstrtim(ctx, string, f);
 }
 
 WFDB_Time strtim(const char *string)
@@ -349,23 +478,7 @@ WFDB_Time strtim(const char *string)
 
 char *datstr_ctx(WFDB_Context *ctx, WFDB_Date date)
 {
-    int d, m, y, gcorr, jm, jy;
-    WFDB_Date jd;
-
-    if (date >= 2299161L) {	/* Gregorian calendar correction */
-	gcorr = (int)(((date - 1867216L) - 0.25)/36524.25);
-	date += 1 + gcorr - (long)(0.25*gcorr);
-    }
-    date += 1524;
-    jy = (int)(6680 + ((date - 2439870L) - 122.1)/365.25);
-    jd = (WFDB_Date)(365L*jy + (0.25*jy));
-    jm = (int)((date - jd)/30.6001);
-    d = date - jd - (int)(30.6001*jm);
-    if ((m = jm - 1) > 12) m -= 12;
-    y = jy - 4715;
-    if (m > 2) y--;
-    if (y <= 0) y--;
-    (void)snprintf(date_string, sizeof(date_string), " %02d/%02d/%d", d, m, y);
+    *fmt_date(date_string, date) = '\0';
     pdays = -1;
     return (date_string);
 }
@@ -375,6 +488,15 @@ char *datstr(WFDB_Date date)
     return datstr_ctx(wfdb_get_default_context(), date);
 }
 
+/* datstr_r is a reentrant version of datstr. */
+char *datstr_r(WFDB_Date date, char *buf, int len)
+{
+    char dbuf[WFDB_TIMSTRLEN];
+    char *p = fmt_date(dbuf, date);
+
+    return (copy_r(buf, len, dbuf, p - dbuf));
+}
+
 WFDB_Date strdat(const char *string)
 {
     const char *mp, *yp;
@@ -461,6 +583,28 @@ double aduphys(WFDB_Signal s, WFDB_Sample a)
     return aduphys_ctx(wfdb_get_default_context(), s, a);
 }
 
+/* aduphysv converts the n samples of signal s in a to physical units in v,
+   as aduphys does for one sample, except that invalid samples become NaN. */
+void aduphysv_ctx(WFDB_Context *ctx, WFDB_Signal s, const WFDB_Sample *a,
+		  double *v, long n)
+{
+    double b = 0;
+    WFDB_Gain g = WFDB_DEFGAIN;
+    long i;
+
+    if (s < nvsig) {
+	b = vsd[s]->info.baseline;
+	if ((g = vsd[s]->info.gain) == 0.) g = WFDB_DEFGAIN;
+    }
+    for (i = 0; i < n; i++)
+	v[i] = (a[i] == WFDB_INVALID_SAMPLE) ? NAN : (a[i] - b) / g;
+}
+
+void aduphysv(WFDB_Signal s, const WFDB_Sample *a, double *v, long n)
+{
+    aduphysv_ctx(wfdb_get_default_context(), s, a, v, n);
+}
+
 WFDB_Sample physadu_ctx(WFDB_Context *ctx, WFDB_Signal s, double v)
 {
     int b;
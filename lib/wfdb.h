@@ -35,6 +35,7 @@ _______________________________________________________________________________
 
 /* Simple data types */
 typedef int	     WFDB_Sample;   /* units are adus */
+typedef short	     WFDB_Sample16; /* units are adus (see getvecs16) */
 typedef long	     WFDB_Date;	    /* units are days */
 typedef double	     WFDB_Frequency;/* units are Hz (samples/second/signal) */
 typedef double	     WFDB_Gain;	    /* units are adus per physical unit */
@@ -138,6 +139,14 @@ _Static_assert(sizeof(WFDB_Time) >= 8, "WFDB_Time must be at least 64 bits");
    can be redefined and the WFDB library can be recompiled. */
 #define WFDB_INVALID_SAMPLE (-32768)
 
+/* getvecs16 and getframes16 return samples as WFDB_Sample16 values.  Invalid
+   samples become WFDB_INVALID_SAMPLE16, and valid samples outside the range
+   WFDB_SAMPLE16_MIN to WFDB_SAMPLE16_MAX are clipped to that range, so that
+   they cannot be mistaken for invalid samples. */
+#define WFDB_INVALID_SAMPLE16 (-32768)
+#define WFDB_SAMPLE16_MIN   (-32767)
+#define WFDB_SAMPLE16_MAX     32767
+
 /* Array sizes
    Many older applications use the values of WFDB_MAXANN, WFDB_MAXSIG, and
    WFDB_MAXSPF to determine array sizes, but (since WFDB library version 10.2)
@@ -149,6 +158,7 @@ _Static_assert(sizeof(WFDB_Time) >= 8, "WFDB_Time must be at least 64 bits");
 #define WFDB_MAXRNL   50   /* maximum length of record name */
 #define WFDB_MAXUSL   50   /* maximum length of WFDB_siginfo `.units' string */
 #define WFDB_MAXDSL  100   /* maximum length of WFDB_siginfo `.desc' string */
+#define WFDB_TIMSTRLEN 64  /* buffer length for timstr_r, mstimstr_r, datstr_r */
 
 /* wfdb_fopen mode values (WFDB_anninfo '.stat' values) */
 #define WFDB_READ      0   /* standard input annotation file */
@@ -192,6 +202,14 @@ the legal values for the format field in a WFDB_siginfo structure.
 #define WFDB_GVPAD	2	/* replace invalid samples with previous valid
 				   samples */
 
+/* Layouts of blocks of samples (see getphys) */
+#define WFDB_INTERLEAVED 0	/* sample i of vector j in buf[j*nsig + i] */
+#define WFDB_PLANAR	1	/* sample j of signal i in buf[i*nframes + j] */
+
+/* getvec resampling methods (see setiresamp) */
+#define WFDB_RSLINEAR	0	/* linear interpolation */
+#define WFDB_RSFIR	1	/* polyphase FIR (windowed sinc) filter */
+
 /* calinfo '.caltype' values
 WFDB_AC_COUPLED and WFDB_DC_COUPLED are used in combination with the pulse
 shape definitions below to characterize calibration pulses. */
@@ -320,7 +338,15 @@ extern int setifreq(WFDB_Frequency freq);
 extern WFDB_Frequency getifreq(void);
 extern int getvec(WFDB_Sample *vector);
 extern int getframe(WFDB_Sample *vector);
+extern long getvecs(WFDB_Sample *buf, long nframes);
+extern long getframes(WFDB_Sample *buf, long nframes);
+extern long getphys(double *buf, long nframes, int layout);
+extern long getphysf(float *buf, long nframes, int layout);
+extern long getvecsp(WFDB_Sample **sigbuf, long nframes);
+extern long getvecs16(WFDB_Sample16 *buf, long nframes);
+extern long getframes16(WFDB_Sample16 *buf, long nframes);
 extern int putvec(const WFDB_Sample *vector);
+extern long putvecs(const WFDB_Sample *frames, long nframes);
 extern int getann(WFDB_Annotator a, WFDB_Annotation *annot);
 extern int ungetann(WFDB_Annotator a, const WFDB_Annotation *annot);
 extern int putann(WFDB_Annotator a, const WFDB_Annotation *annot);
@@ -365,9 +391,12 @@ extern WFDB_Date strdat(const char *date_string);
 extern int adumuv(WFDB_Signal s, WFDB_Sample a);
 extern WFDB_Sample muvadu(WFDB_Signal s, int microvolts);
 extern double aduphys(WFDB_Signal s, WFDB_Sample a);
+extern void aduphysv(WFDB_Signal s, const WFDB_Sample *a, double *v, long n);
 extern WFDB_Sample physadu(WFDB_Signal s, double v);
 extern WFDB_Sample sample(WFDB_Signal s, WFDB_Time t);
 extern int sample_valid(void);
+extern void setsampcache(long blocklen, int nblocks);
+extern void sampcachestats(long *hits, long *misses);
 extern int calopen(const char *calibration_filename);
 extern int getcal(const char *description, const char *units,
 		   WFDB_Calinfo *cal);
@@ -404,7 +433,18 @@ extern void setwfdb(const char *database_path_string);
 extern char *getwfdb(void);
 extern void resetwfdb(void);
 extern int setibsize(int input_buffer_size);
+extern void setimmap(int mode);
+extern void sethcache(int n);
+extern void setsegprefetch(int mode);
+extern void setireadahead(int mode);
+extern void setiflacthreads(int n);
+extern void setiseekindex(long interval);
+extern void setblkcache(long nbytes);
+extern void blkcachestats(long *hits, long *misses);
+extern void setiresamp(int mode);
+extern int isigselect(const int *sigs, int n);
 extern int setobsize(int output_buffer_size);
+extern void setoflac(int level, int blocksize, int nthreads);
 extern char *wfdbfile(const char *file_type, char *record);
 extern void wfdbflush(void);
 extern void wfdbmemerr(int exit_on_error);
@@ -444,14 +484,41 @@ extern int setifreq_ctx(WFDB_Context *ctx, WFDB_Frequency freq);
 extern WFDB_Frequency getifreq_ctx(WFDB_Context *ctx);
 extern int getvec_ctx(WFDB_Context *ctx, WFDB_Sample *vector);
 extern int getframe_ctx(WFDB_Context *ctx, WFDB_Sample *vector);
+extern long getvecs_ctx(WFDB_Context *ctx, WFDB_Sample *buf, long nframes);
+extern long getframes_ctx(WFDB_Context *ctx, WFDB_Sample *buf,
+			  long nframes);
+extern long getphys_ctx(WFDB_Context *ctx, double *buf, long nframes,
+			int layout);
+extern long getphysf_ctx(WFDB_Context *ctx, float *buf, long nframes,
+			 int layout);
+extern long getvecsp_ctx(WFDB_Context *ctx, WFDB_Sample **sigbuf,
+			 long nframes);
+extern long getvecs16_ctx(WFDB_Context *ctx, WFDB_Sample16 *buf,
+			  long nframes);
+extern long getframes16_ctx(WFDB_Context *ctx, WFDB_Sample16 *buf,
+			    long nframes);
 extern int putvec_ctx(WFDB_Context *ctx, const WFDB_Sample *vector);
+extern long putvecs_ctx(WFDB_Context *ctx, const WFDB_Sample *frames,
+			long nframes);
 extern int isigsettime_ctx(WFDB_Context *ctx, WFDB_Time t);
 extern int isgsettime_ctx(WFDB_Context *ctx, WFDB_Group g, WFDB_Time t);
 extern WFDB_Time tnextvec_ctx(WFDB_Context *ctx, WFDB_Signal s, WFDB_Time t);
 extern int setibsize_ctx(WFDB_Context *ctx, int input_buffer_size);
+extern void setimmap_ctx(WFDB_Context *ctx, int mode);
+extern void sethcache_ctx(WFDB_Context *ctx, int n);
+extern void setsegprefetch_ctx(WFDB_Context *ctx, int mode);
+extern void setireadahead_ctx(WFDB_Context *ctx, int mode);
+extern void setiflacthreads_ctx(WFDB_Context *ctx, int n);
+extern void setiseekindex_ctx(WFDB_Context *ctx, long interval);
+extern void setiresamp_ctx(WFDB_Context *ctx, int mode);
+extern int isigselect_ctx(WFDB_Context *ctx, const int *sigs, int n);
 extern int setobsize_ctx(WFDB_Context *ctx, int output_buffer_size);
+extern void setoflac_ctx(WFDB_Context *ctx, int level, int blocksize,
+			 int nthreads);
 extern WFDB_Sample sample_ctx(WFDB_Context *ctx, WFDB_Signal s, WFDB_Time t);
 extern int sample_valid_ctx(WFDB_Context *ctx);
+extern void setsampcache_ctx(WFDB_Context *ctx, long blocklen, int nblocks);
+extern void sampcachestats_ctx(WFDB_Context *ctx, long *hits, long *misses);
 
 /* Header/info (signal.c) */
 extern int newheader_ctx(WFDB_Context *ctx, char *record);
@@ -520,8 +587,11 @@ extern int setsampfreq_ctx(WFDB_Context *ctx,
 extern int setbasetime_ctx(WFDB_Context *ctx, char *time_string);
 extern char *timstr_ctx(WFDB_Context *ctx, WFDB_Time t);
 extern char *mstimstr_ctx(WFDB_Context *ctx, WFDB_Time t);
+extern char *timstr_r(WFDB_Context *ctx, WFDB_Time t, char *buf, int len);
+extern char *mstimstr_r(WFDB_Context *ctx, WFDB_Time t, char *buf, int len);
 extern WFDB_Time strtim_ctx(WFDB_Context *ctx, const char *time_string);
 extern char *datstr_ctx(WFDB_Context *ctx, WFDB_Date d);
+extern char *datstr_r(WFDB_Date d, char *buf, int len);
 extern WFDB_Date strdat_ctx(WFDB_Context *ctx, const char *date_string);
 extern WFDB_Frequency getcfreq_ctx(WFDB_Context *ctx);
 extern void setcfreq_ctx(WFDB_Context *ctx, WFDB_Frequency counter_frequency);
@@ -533,6 +603,8 @@ extern int adumuv_ctx(WFDB_Context *ctx, WFDB_Signal s, WFDB_Sample a);
 extern WFDB_Sample muvadu_ctx(WFDB_Context *ctx, WFDB_Signal s,
 			       int microvolts);
 extern double aduphys_ctx(WFDB_Context *ctx, WFDB_Signal s, WFDB_Sample a);
+extern void aduphysv_ctx(WFDB_Context *ctx, WFDB_Signal s, const WFDB_Sample *a,
+			 double *v, long n);
 extern WFDB_Sample physadu_ctx(WFDB_Context *ctx, WFDB_Signal s, double v);
 
 /* Library control (wfdbio.c) */
@@ -542,6 +614,10 @@ extern void resetwfdb_ctx(WFDB_Context *ctx);
 extern void wfdbquiet_ctx(WFDB_Context *ctx);
 extern void wfdbverbose_ctx(WFDB_Context *ctx);
 extern char *wfdberror_ctx(WFDB_Context *ctx);
+#if __GNUC__ >= 3
+__attribute__((__format__(__printf__, 2, 3)))
+#endif
+extern void wfdb_error_ctx(WFDB_Context *ctx, const char *format_string, ...);
 extern char *wfdbfile_ctx(WFDB_Context *ctx, const char *file_type,
 			   char *record);
 extern void wfdbmemerr_ctx(WFDB_Context *ctx, int exit_on_error);
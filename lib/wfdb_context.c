@@ -6,22 +6,22 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* The default global context, used by all legacy API functions. */
-static WFDB_Context default_context;
-static int default_context_initialized;
+/* The default global context, used by all legacy API functions.  It is
+   initialized statically so that threads working in their own contexts
+   can safely compare against it without racing on a lazy initializer. */
+static WFDB_Context default_context = {
+    .initialized = 1,
+    .error_print = 1,
+    .wfdb_mem_behavior = 1,
+#if WFDB_NETFILES
+    .nf_page_size = NF_PAGE_SIZE,
+    .nf_cache_size = NF_CACHE_SIZE,
+    .nf_disk_size = NF_DISK_CACHE_SIZE,
+#endif
+};
 
 WFDB_Context *wfdb_get_default_context(void)
 {
-    if (!default_context_initialized) {
-	memset(&default_context, 0, sizeof(default_context));
-	default_context.initialized = 1;
-	default_context.error_print = 1;
-	default_context.wfdb_mem_behavior = 1;
-#if WFDB_NETFILES
-	default_context.nf_page_size = NF_PAGE_SIZE;
-#endif
-	default_context_initialized = 1;
-    }
     return &default_context;
 }
 
@@ -34,6 +34,8 @@ WFDB_Context *wfdb_context_new(void)
 	ctx->wfdb_mem_behavior = 1;
 #if WFDB_NETFILES
 	ctx->nf_page_size = NF_PAGE_SIZE;
+	ctx->nf_cache_size = NF_CACHE_SIZE;
+	ctx->nf_disk_size = NF_DISK_CACHE_SIZE;
 #endif
     }
     return ctx;
@@ -118,6 +120,7 @@ void wfdb_context_free(WFDB_Context *ctx)
 	    free(ctx->www_passwords);
 	}
 	free(ctx->curl_ua_string);
+	free(ctx->nf_disk_dir);
 #endif
 	free(ctx);
     }
@@ -112,6 +112,7 @@ struct WFDB_Context {
     char *p_wfdbannsort;
     char *p_wfdbgvmode;
     int wfdbpath_parsed;	/* nonzero after first getwfdb call */
+    unsigned wfdb_path_gen;	/* incremented whenever the path changes */
 
     /* Signal state (from signal.c / signal_internal.h) */
 
@@ -121,6 +122,11 @@ struct WFDB_Context {
     char *linebuf;
     size_t linebufsize;
     struct hsdata **hsd;
+    struct hcentry *hcache;	/* cached segment headers, most recent first */
+    int nhcache;		/* number of entries in hcache */
+    int hclimit;		/* max entries (-1: disabled, 0: not yet set) */
+    struct segprefetch *segpf;	/* segment prefetcher (see segprefetch.c) */
+    int segpfmode;		/* 1: prefetch, -1: don't, 0: not yet set */
 
     /* Time/frequency/conversion */
     WFDB_Frequency ffreq;
@@ -154,17 +160,36 @@ struct WFDB_Context {
     WFDB_Sample *uvector;
     WFDB_Sample *vvector;
     int tuvlen;
+    WFDB_Sample *gvblk;		/* frames being converted by rgetvecs */
+    int gvblklen;		/* number of samples allocated in gvblk */
+    unsigned *gvmap;		/* frame sample indices (see rgvexpand) */
+    int gvmaplen;		/* number of entries allocated in gvmap */
+    WFDB_Sample *physbuf;	/* blocks read by getphys, getvecs16, etc. */
+    int physbuflen;		/* number of samples allocated in physbuf */
     WFDB_Time istime;
     int ibsize;
+    int immap;
+    int iramode;		/* 1: read ahead, -1: don't, 0: not yet set */
+    struct raio *raio;		/* read-ahead I/O thread (see readahead.c) */
+    int iflacthreads;		/* FLAC decoding threads per group (-1: none,
+				   0: not yet set), see flac.c */
+    long iseekint;		/* frames between format 8 checkpoints (0: not
+				   yet set, -1: no checkpoints) */
+    char *isigsel;		/* selected input signals, or NULL if all */
+    unsigned nisigsel;		/* number of entries in isigsel */
     unsigned skewmax;
-    WFDB_Sample *dsbuf;
-    int dsbi;
-    unsigned dsblen;
+    WFDB_Sample *dsbuf;		/* deskewing window (see getdsframes) */
+    int dsbi;			/* next frame to be deskewed in dsbuf, or
+				   -1 if dsbuf must be refilled */
+    int dsnf;			/* number of frames read into dsbuf */
+    unsigned dsblen;		/* samples needed to deskew one frame */
     unsigned framelen;
     int gvmode;
     int gvc;
+    int gvstat;		/* status of the last frame read by rgetvec */
+    int gvpend;		/* status to be returned by the next getvecs or
+				   getframes (see getframes) */
     int isedf;
-    WFDB_Sample *sbuf;
     int sample_vflag;
 
     /* Output signals */
@@ -178,6 +203,9 @@ struct WFDB_Context {
     struct ogdata **ogd;
     WFDB_Time ostime;
     int obsize;
+    int oflaclevel;		/* FLAC compression level (see setoflac) */
+    int oflacbsize;		/* FLAC block size (0: libFLAC's default) */
+    int oflacthreads;		/* FLAC encoding threads (0: not yet set) */
 
     /* Info strings */
     char **pinfo;
@@ -195,12 +223,23 @@ struct WFDB_Context {
     int rgvstat;
     WFDB_Time rgvtime, gvtime;
     WFDB_Sample *gv0, *gv1;
+    int rsfilter;		/* 1: FIR, -1: linear, 0: not yet set */
+    struct rsfir *rsf;		/* FIR resampler (see resample.c) */
+    WFDB_Sample *rsbuf;		/* raw vectors read by rslgetvecs */
+    int rsbuflen;		/* number of samples allocated in rsbuf */
 
     /* getinfo iteration index */
     int getinfo_index;
 
-    /* sample() function cache */
-    WFDB_Time sample_tt;
+    /* sample() block cache (from signal.c) */
+    struct sblock *sbcache;	/* cached blocks */
+    struct sblock *sblast;	/* most recently used block */
+    unsigned long sbclock;	/* number of uses of the cache */
+    int sbnblk;			/* number of blocks allocated */
+    int sbmaxblk;		/* maximum number of blocks (0: default) */
+    long sblen;			/* frames per block (0: default) */
+    int sbnsig;			/* samples per frame in each block */
+    long sbhits, sbmisses;	/* see sampcachestats */
 
     /* Format I/O helpers */
     int _l;		/* macro temp for low byte of word */
@@ -216,6 +255,10 @@ struct WFDB_Context {
     /* NETFILES state (from wfdbio.c) */
     int nf_open_files;		/* number of open netfiles */
     long nf_page_size;		/* bytes per http range request */
+    long nf_cache_size;		/* bytes of pages cached per netfile */
+    char *nf_disk_dir;		/* directory of the disk cache, or NULL */
+    long nf_disk_size;		/* maximum bytes in the disk cache */
+    long nf_disk_written;	/* bytes written to it since it was trimmed */
     int www_done_init;		/* nonzero once libcurl is initialized */
     CURL *curl_ua;		/* libcurl easy handle */
     char curl_error_buf[CURL_ERROR_SIZE]; /* curl error message buffer */
@@ -51,12 +51,12 @@ int wfdbinit(char *record, const WFDB_Anninfo *aiarray, unsigned int nann,
 
 void wfdbquit_ctx(WFDB_Context *ctx)
 {
-    wfdb_anclose();	/* close annotation files, reset variables */
-    wfdb_oinfoclose();	/* close info file */
-    wfdb_sigclose();	/* close signals, reset variables */
-    resetwfdb_ctx(ctx);	/* restore the WFDB path */
-    wfdb_sampquit();	/* release sample data buffer */
-    wfdb_freeinfo();	/* release info strings */
+    wfdb_anclose_ctx(ctx);	/* close annotation files, reset variables */
+    wfdb_oinfoclose_ctx(ctx);	/* close info file */
+    wfdb_sigclose_ctx(ctx);	/* close signals, reset variables */
+    resetwfdb_ctx(ctx);		/* restore the WFDB path */
+    wfdb_sampquit_ctx(ctx);	/* release sample data buffer */
+    wfdb_freeinfo_ctx(ctx);	/* release info strings */
 }
 
 void wfdbquit(void)
@@ -66,8 +66,8 @@ void wfdbquit(void)
 
 void wfdbflush_ctx(WFDB_Context *ctx)
 {
-    wfdb_oaflush();	/* flush buffered output annotations */
-    wfdb_osflush();	/* flush buffered output samples */
+    wfdb_oaflush_ctx(ctx);	/* flush buffered output annotations */
+    wfdb_osflush_ctx(ctx);	/* flush buffered output samples */
 }
 
 void wfdbflush(void)	/* write all buffered output to files */
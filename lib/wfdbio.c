@@ -60,9 +60,11 @@ library functions defined elsewhere:
  wfdb_export_config [10.3.9] (puts the WFDB path, etc. into the environment)
  wfdb_getiwfdb [6.2]	(sets WFDB from the contents of a file)
  wfdb_addtopath [6.2]	(adds path component of string argument to WFDB path)
+ wfdb_copy_path_ctx [11.0] (copies the WFDB path from one context to another)
  wfdb_vasprintf		(allocates and formats a message)
  wfdb_asprintf		(allocates and formats a message)
  wfdb_error		(produces an error message)
+ wfdb_error_ctx [11.0] (produces an error message in a specified context)
  wfdb_fprintf [10.0.1]	(like fprintf, but first arg is a WFDB_FILE pointer)
  wfdb_open		(finds and opens database files)
  wfdb_checkname		(checks record and annotator names for validity)
@@ -90,6 +92,12 @@ visible outside of this file):
  www_get_url_range_chunk (get a block of data from a given url)
  www_get_url_chunk	(get all data from a given url)
  nf_delete		(free data structures associated with an open netfile)
+ nf_page_find		(find a cached page of a netfile)
+ nf_disk_trim		(remove least recently used pages from the disk cache)
+ nf_disk_write		(add a page of a netfile to the disk cache)
+ nf_disk_page		(read a page of a netfile from the disk cache)
+ nf_disk_first		(read or revalidate the first page of a netfile)
+ nf_page_fetch		(read pages of a netfile into its cache)
  nf_new			(associate a netfile with a url)
  nf_get_range		(get a block of data from a netfile)
  nf_feof		(emulates feof, for netfiles)
@@ -132,6 +140,8 @@ similarly-named ANSI/ISO C standard I/O functions:
  wfdb_putc		(emulates putc, for local files only)
  wfdb_fclose		(emulates fclose)
  wfdb_fopen		(emulates fopen, but returns a WFDB_FILE pointer)
+ wfdb_fmap [11.0]	(converts a local input WFDB_FILE to a memory-mapped one)
+ wfdb_fsetctx [11.0]	(transfers a WFDB_FILE to another context)
 
 (If WFDB_NETFILES is zero, wfdblib.h defines all but the last two of these
 functions as macros that invoke the standard I/O functions that they would
@@ -144,6 +154,10 @@ is non-zero.  All of these functions are new in version 10.0.1.)
 #include "wfdb_context.h"
 #include <stdarg.h>
 #include <time.h>
+#include <limits.h>
+#if WFDB_MMAP_SUPPORT
+#include <sys/mman.h>
+#endif
 
 /* WFDB library functions */
 
@@ -156,7 +170,7 @@ If WFDB or DEFWFDB is of the form '@FILE', getwfdb reads the WFDB path from the
 specified (local) FILE (using wfdb_getiwfdb); such files may be nested up to
 10 levels. */
 
-static const char *wfdb_getiwfdb(char **p);
+static const char *wfdb_getiwfdb(WFDB_Context *ctx, char **p);
 
 /* resetwfdb is called by wfdbquit, and can be called within an application,
 to restore the WFDB path to the value that was returned by the first call
@@ -179,9 +193,9 @@ char *getwfdb_ctx(WFDB_Context *ctx)
 
 	if (p == NULL) p = DEFWFDB;
 	SSTRCPY(ctx->wfdbpath, p);
-	p = wfdb_getiwfdb(&ctx->wfdbpath);
+	p = wfdb_getiwfdb(ctx, &ctx->wfdbpath);
 	SSTRCPY(ctx->wfdbpath_init, ctx->wfdbpath);
-	wfdb_parse_path(p);
+	wfdb_parse_path_ctx(ctx, p);
     }
     return (ctx->wfdbpath);
 }
@@ -191,7 +205,9 @@ char *getwfdb(void)
     return getwfdb_ctx(wfdb_get_default_context());
 }
 
-/* setwfdb can be called within an application to change the WFDB path. */
+/* setwfdb can be called within an application to change the WFDB path.
+Only the default context exports the new path into the environment (which is
+shared by all contexts). */
 
 void setwfdb_ctx(WFDB_Context *ctx, const char *p)
 {
@@ -199,11 +215,12 @@ void setwfdb_ctx(WFDB_Context *ctx, const char *p)
 
     if (p == NULL && (p = getenv("WFDB")) == NULL) p = DEFWFDB;
     SSTRCPY(ctx->wfdbpath, p);
-    wfdb_export_config();
+    if (ctx == wfdb_get_default_context())
+	wfdb_export_config();
 
     SSTRCPY(ctx->wfdbpath, p);
-    p = wfdb_getiwfdb(&ctx->wfdbpath);
-    wfdb_parse_path(p);
+    p = wfdb_getiwfdb(ctx, &ctx->wfdbpath);
+    wfdb_parse_path_ctx(ctx, p);
 }
 
 void setwfdb(const char *p)
@@ -247,7 +264,7 @@ char *wfdbfile_ctx(WFDB_Context *ctx, const char *s, char *record)
     /* Remove trailing .hea, if any, from record name. */
     wfdb_striphea(record);
 
-    if ((ifile = wfdb_open(s, record, WFDB_READ))) {
+    if ((ifile = wfdb_open_ctx(ctx, s, record, WFDB_READ))) {
 	(void)wfdb_fclose(ifile);
 	return (ctx->wfdb_filename);
     }
@@ -400,9 +417,8 @@ size_t wfdb_getline(char **buffer, size_t *buffer_size, WFDB_FILE *fp)
 
 /* wfdb_free_path_list clears out the path list, freeing all memory allocated
    to it. */
-void wfdb_free_path_list(void)
+static void wfdb_free_path_list_ctx(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     struct wfdb_path_component *c0 = NULL, *c1 = ctx->wfdb_path_list;
 
     while (c1) {
@@ -414,25 +430,31 @@ void wfdb_free_path_list(void)
     ctx->wfdb_path_list = NULL;
 }
 
+void wfdb_free_path_list(void)
+{
+    wfdb_free_path_list_ctx(wfdb_get_default_context());
+}
+
 /* wfdb_parse_path constructs a linked list of path components by splitting
 its string input (usually the value of WFDB). */
 
-int wfdb_parse_path(const char *p)
+int wfdb_parse_path_ctx(WFDB_Context *ctx, const char *p)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     const char *q;
     int current_type, slashes, found_end;
     struct wfdb_path_component *c0 = NULL, *c1 = ctx->wfdb_path_list;
     static int first_call = 1;
 
     /* First, free the existing wfdb_path_list, if any. */
-    wfdb_free_path_list();
+    wfdb_free_path_list_ctx(ctx);
+    ctx->wfdb_path_gen++;
 
     /* Do nothing else if no path string was supplied. */
     if (p == NULL) return (0);
 
-    /* Register the cleanup function so that it is invoked on exit. */
-    if (first_call) {
+    /* Register the cleanup function so that it is invoked on exit.  Other
+       contexts release their path lists in wfdb_context_free. */
+    if (first_call && ctx == wfdb_get_default_context()) {
 	atexit(wfdb_free_path_list);
 	first_call = 0;
     }
@@ -486,6 +508,11 @@ int wfdb_parse_path(const char *p)
     return (0);
 }	
 
+int wfdb_parse_path(const char *p)
+{
+    return wfdb_parse_path_ctx(wfdb_get_default_context(), p);
+}
+
 
 /* wfdb_getiwfdb reads a new value for WFDB from the file named by the second
 through last characters of its input argument.  If that value begins with '@',
@@ -496,7 +523,7 @@ functions rather than their wfdb_* counterparts).  This limitation is
 intentional, since the alternative (to allow remote files to determine the
 contents of the WFDB path) seems an unnecessary security risk. */
 
-static const char *wfdb_getiwfdb(char **p)
+static const char *wfdb_getiwfdb(WFDB_Context *ctx, char **p)
 {
     FILE *wfdbpfile;
     int i = 0;
@@ -521,7 +548,7 @@ static const char *wfdb_getiwfdb(char **p)
 	}
     }	
     if (*p != NULL && **p == '@') {
-	wfdb_error("getwfdb: files nested too deeply\n");
+	wfdb_error_ctx(ctx, "getwfdb: files nested too deeply\n");
 	**p = 0;
     }
     return (*p);
@@ -616,9 +643,8 @@ current directory should not be specified initially as the first component of
 the WFDB path.
  */
 
-void wfdb_addtopath(const char *s)
+void wfdb_addtopath_ctx(WFDB_Context *ctx, const char *s)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     const char *p;
     int i, len;
     struct wfdb_path_component *c0, *c1;
@@ -642,7 +668,7 @@ void wfdb_addtopath(const char *s)
 
     /* If p > s, then p points to the first character following the path
        component of s. Search the current WFDB path for this path component. */
-    if (ctx->wfdbpath == NULL) (void)getwfdb();
+    if (ctx->wfdbpath == NULL) (void)getwfdb_ctx(ctx);
     for (c0 = c1 = ctx->wfdb_path_list, i = p-s; c1; c1 = c1->next) {
 	if (strncmp(c1->prefix, s, i) == 0) {
 	    if (c0 == c1 || (c1->prev == c0 && strcmp(c0->prefix, ".") == 0))
@@ -661,6 +687,8 @@ void wfdb_addtopath(const char *s)
 	if (strstr(c1->prefix, "://")) c1->type = WFDB_NET;
 	else c1->type = WFDB_LOCAL;
     }
+    ctx->wfdb_path_gen++;
+
     /* (Re)link the unlinked node. */
     if (strcmp(c0->prefix, ".") == 0) {  /* skip initial "." if present */
 	c1->prev = c0;
@@ -677,6 +705,39 @@ void wfdb_addtopath(const char *s)
     return;
 }
 
+void wfdb_addtopath(const char *s)
+{
+    wfdb_addtopath_ctx(wfdb_get_default_context(), s);
+}
+
+/* wfdb_copy_path_ctx replaces the WFDB path of one context with a copy of
+that of another, including any components added by wfdb_addtopath, and also
+copies the current record name, so that wfdb_open finds the same files in
+both contexts. */
+
+void wfdb_copy_path_ctx(WFDB_Context *to, WFDB_Context *from)
+{
+    struct wfdb_path_component *c0, *c1, *prev = NULL;
+
+    if (from->wfdb_path_list == NULL) (void)getwfdb_ctx(from);
+    SSTRCPY(to->wfdbpath, from->wfdbpath);
+    SSTRCPY(to->wfdbpath_init, from->wfdbpath_init);
+    wfdb_free_path_list_ctx(to);
+    to->wfdb_path_gen++;
+    for (c0 = from->wfdb_path_list; c0; c0 = c0->next) {
+	c1 = NULL;
+	SUALLOC(c1, 1, sizeof(struct wfdb_path_component));
+	SSTRCPY(c1->prefix, c0->prefix);
+	c1->type = c0->type;
+	if ((c1->prev = prev) != NULL)
+	    prev->next = c1;
+	else
+	    to->wfdb_path_list = c1;
+	prev = c1;
+    }
+    (void)strcpy(to->irec, from->irec);
+}
+
 /* wfdb_vasprintf formats a string in the same manner as vsprintf, and
 allocates a new buffer that is sufficiently large to hold the result.
 The original buffer, if any, is freed afterwards (meaning that, unlike
@@ -750,6 +811,9 @@ message passed to wfdb_error (even if output was suppressed by wfdbquiet).
 This feature permits programs to handle errors somewhat more flexibly (in
 windowing environments, for example, where using the standard error output may
 be inappropriate).
+
+wfdb_error_ctx records the message in the specified context instead of the
+default context;  it is used by the _ctx variants of the library functions.
 */
 
 #ifndef WFDB_BUILD_DATE
@@ -773,22 +837,34 @@ char *wfdberror(void)
     return wfdberror_ctx(wfdb_get_default_context());
 }
 
-void wfdb_error(const char *format, ...)
+static void wfdb_verror(WFDB_Context *ctx, const char *format,
+			va_list arguments)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
-    va_list arguments;
-
     ctx->error_flag = 1;
-    va_start(arguments, format);
     wfdb_vasprintf(&ctx->error_message, format, arguments);
-    va_end(arguments);
 
     if (ctx->error_print) {
-	(void)fprintf(stderr, "%s", wfdberror());
+	(void)fprintf(stderr, "%s", wfdberror_ctx(ctx));
 	(void)fflush(stderr);
     }
 }
 
+void wfdb_error_ctx(WFDB_Context *ctx, const char *format,
+		    ...) {     va_list arguments;      va_start(arguments,
+		    format);
+    wfdb_verror(ctx, format, arguments);
+    va_end(arguments);
+}
+
+void wfdb_error(const char *format, ...)
+{
+    va_list arguments;
+
+    va_start(arguments, format);
+    wfdb_verror(wfdb_get_default_context(), format, arguments);
+    va_end(arguments);
+}
+
 /* The wfdb_fprintf function handles all formatted output to files.  It is
 used in the same way as the standard fprintf function, except that its first
 argument is a pointer to a WFDB_FILE rather than a FILE. */
@@ -857,9 +933,9 @@ wfdb_open swaps the record name and the type string.  If the type string
 (after swapping, if necessary) is empty, spr1 uses the record name as the
 literal file name. */
 
-WFDB_FILE *wfdb_open(const char *s, const char *record, int mode)
+WFDB_FILE *wfdb_open_ctx(WFDB_Context *ctx, const char *s, const char *record,
+			 int mode)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     char *wfdb, *p, *q, *r, *buf = NULL;
     int rlen;
     struct wfdb_path_component *c0;
@@ -922,25 +998,25 @@ WFDB_FILE *wfdb_open(const char *s, const char *record, int mode)
     if (mode == WFDB_WRITE) {
 	spr1(&ctx->wfdb_filename, r, s);
 	SFREE(r);
-	return (wfdb_fopen(ctx->wfdb_filename, "wb"));
+	return (wfdb_fopen_ctx(ctx, ctx->wfdb_filename, "wb"));
     }
     else if (mode == WFDB_APPEND) {
 	spr1(&ctx->wfdb_filename, r, s);
 	SFREE(r);
-	return (wfdb_fopen(ctx->wfdb_filename, "ab"));
+	return (wfdb_fopen_ctx(ctx, ctx->wfdb_filename, "ab"));
     }
 
     /* Parse the WFDB path if not done previously. */
-    if (ctx->wfdb_path_list == NULL) (void)getwfdb();
+    if (ctx->wfdb_path_list == NULL) (void)getwfdb_ctx(ctx);
 
     /* If the filename begins with 'http://' or 'https://', it's a URL.  In
        this case, don't search the WFDB path, but add its parent directory
        to the path if the file can be read. */
     if (strncmp(r, "http://", 7) == 0 || strncmp(r, "https://", 8) == 0) {
 	spr1(&ctx->wfdb_filename, r, s);
-	if ((ifile = wfdb_fopen(ctx->wfdb_filename, "rb")) != NULL) {
+	if ((ifile = wfdb_fopen_ctx(ctx, ctx->wfdb_filename, "rb")) != NULL) {
 	    /* Found it! Add its path info to the WFDB path. */
-	    wfdb_addtopath(ctx->wfdb_filename);
+	    wfdb_addtopath_ctx(ctx, ctx->wfdb_filename);
 	    SFREE(r);
 	    return (ifile);
 	}
@@ -1007,9 +1083,9 @@ WFDB_FILE *wfdb_open(const char *s, const char *record, int mode)
 	    continue;
 
 	spr1(&ctx->wfdb_filename, buf, s);
-	if ((ifile = wfdb_fopen(ctx->wfdb_filename, "rb")) != NULL) {
+	if ((ifile = wfdb_fopen_ctx(ctx, ctx->wfdb_filename, "rb")) != NULL) {
 	    /* Found it! Add its path info to the WFDB path. */
-	    wfdb_addtopath(ctx->wfdb_filename);
+	    wfdb_addtopath_ctx(ctx, ctx->wfdb_filename);
 	    SFREE(buf);
 	    SFREE(r);
 	    return (ifile);
@@ -1022,11 +1098,16 @@ WFDB_FILE *wfdb_open(const char *s, const char *record, int mode)
     return (NULL);
 }
 
+WFDB_FILE *wfdb_open(const char *s, const char *record, int mode)
+{
+    return wfdb_open_ctx(wfdb_get_default_context(), s, record, mode);
+}
+
 /* wfdb_checkname checks record and annotator names -- they must not be empty,
    and they must contain only letters, digits, hyphens, tildes, underscores, and
    directory separators. */
 
-int wfdb_checkname(const char *p, const char *s)
+int wfdb_checkname_ctx(WFDB_Context *ctx, const char *p, const char *s)
 {
     do {
 	if (('0' <= *p && *p <= '9') || *p == '_' || *p == '~' || *p== '-' ||
@@ -1034,22 +1115,27 @@ int wfdb_checkname(const char *p, const char *s)
 	    ('a' <= *p && *p <= 'z') || ('A' <= *p && *p <= 'Z'))
 	    p++;
 	else {
-	    wfdb_error("init: illegal character %d in %s name\n", *p, s);
+	    wfdb_error_ctx(ctx, "init: illegal character %d in %s name\n", *p,
+			   s);
 	    return (-1);
 	}
     } while (*p);
     return (0);
 }
 
+int wfdb_checkname(const char *p, const char *s)
+{
+    return wfdb_checkname_ctx(wfdb_get_default_context(), p, s);
+}
+
 /* wfdb_setirec saves the current record name (its argument) in irec (defined
 above) to be substituted for '%r' in the WFDB path by wfdb_open as necessary.
 wfdb_setirec is invoked by isigopen (except when isigopen is invoked
 recursively to open a segment within a multi-segment record) and by annopen
 (when it is about to open a file for input). */
 
-void wfdb_setirec(const char *p)
+void wfdb_setirec_ctx(WFDB_Context *ctx, const char *p)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     const char *r;
     int len;
 
@@ -1064,12 +1150,21 @@ void wfdb_setirec(const char *p)
     }
 }
 
-char *wfdb_getirec(void)
+void wfdb_setirec(const char *p)
+{
+    wfdb_setirec_ctx(wfdb_get_default_context(), p);
+}
+
+char *wfdb_getirec_ctx(WFDB_Context *ctx)
 {
-    WFDB_Context *ctx = wfdb_get_default_context();
     return (*ctx->irec ? ctx->irec: NULL);
 }
 
+char *wfdb_getirec(void)
+{
+    return wfdb_getirec_ctx(wfdb_get_default_context());
+}
+
 /* Remove trailing '.hea' from a record name, if present. */
 void wfdb_striphea(char *p)
 {
@@ -1125,16 +1220,44 @@ to set the search order in any way you wish, as in this example.
 /* cache redirections for 5 minutes */
 #define REDIRECT_CACHE_TIME (5 * 60)
 
+/* maximum length of the ETag and Last-Modified validators of a netfile */
+#define NF_VALIDATOR_LEN 128
+
+/* In NF_CHUNK_MODE, the parts of a remote file that have been read are kept
+   in memory as pages of page_size bytes, each beginning at a multiple of
+   page_size (the last page of the file may be shorter).  Up to budget bytes of
+   pages are kept for each netfile;  when there are more, those used least
+   recently are discarded.  When the pages are read in sequence, each range
+   request reads ahead of the page needed, by twice as much as the previous
+   one, up to a quarter of the budget. */
+struct nf_page {
+  long addr;			/* byte offset of the page within the file */
+  long len;			/* number of bytes in the page */
+  char *data;			/* contents of the page */
+  struct nf_page *prev, *next;	/* neighbors in the LRU list */
+  struct nf_page *hnext;	/* next page in the same hash bucket */
+};
+
 struct netfile {
   char *url;
-  char *data;
+  char *data;			/* contents of the file, in NF_FULL_MODE */
   int mode;
-  long base_addr;
   long cont_len;
   long pos;
   long err;
   char *redirect_url;
   unsigned int redirect_time;
+  long page_size;		/* bytes per page, in NF_CHUNK_MODE */
+  long budget;			/* maximum total bytes of cached pages */
+  long cached;			/* total bytes of cached pages */
+  struct nf_page **hash;	/* hash table of cached pages */
+  unsigned long hsize;		/* number of entries in hash (a power of 2) */
+  struct nf_page *mru, *lru;	/* ends of the LRU list */
+  long ra_next;			/* end of the last range read */
+  long ra_len;			/* bytes read by the last range request */
+  char etag[NF_VALIDATOR_LEN];	/* ETag of the file when opened */
+  char lastmod[NF_VALIDATOR_LEN]; /* Last-Modified date of the file */
+  int disk;			/* 1 if pages may be kept in the disk cache */
 };
 
 /* Construct the User-Agent string to be sent with HTTP requests. */
@@ -1157,7 +1280,7 @@ static char *curl_get_ua_string(WFDB_Context *ctx)
 static int curl_try(WFDB_Context *ctx, CURLcode err)
 {
     if (err) {
-      wfdb_error("curl error: %s\n", ctx->curl_error_buf);
+      wfdb_error_ctx(ctx, "curl error: %s\n", ctx->curl_error_buf);
     }
     return err;
 }
@@ -1177,6 +1300,9 @@ struct chunk {
     unsigned long start_pos, end_pos, total_size;
     char *data;
     char *url;
+    long code;			/* HTTP response code */
+    char etag[NF_VALIDATOR_LEN];	/* ETag response header, if any */
+    char lastmod[NF_VALIDATOR_LEN];	/* Last-Modified header, if any */
 };
 
 /* This is a dummy write callback, for when we don't care about the
@@ -1215,7 +1341,7 @@ static void www_parse_passwords(WFDB_Context *ctx, const char *str)
     int n;
 
     SSTRCPY(xstr, str);
-    wfdb_getiwfdb(&xstr);
+    wfdb_getiwfdb(ctx, &xstr);
     if (!xstr)
 	return;
 
@@ -1272,6 +1398,7 @@ static void wfdb_wwwquit(void)
 	    SFREE(ctx->www_passwords[i]);
 	SFREE(ctx->www_passwords);
 	SFREE(ctx->curl_ua_string);
+	SFREE(ctx->nf_disk_dir);
     }
 }
 
@@ -1282,6 +1409,16 @@ static void www_init(WFDB_Context *ctx)
 
 	if ((p = getenv("WFDB_PAGESIZE")) && *p)
 	    ctx->nf_page_size = strtol(p, NULL, 10);
+	if ((p = getenv("WFDB_NETCACHE")) && *p)
+	    ctx->nf_cache_size = strtol(p, NULL, 10);
+#if WFDB_MMAP_SUPPORT
+	if ((p = getenv("WFDB_CACHE_DIR")) && *p) {
+	    SSTRCPY(ctx->nf_disk_dir, p);
+	    mkdir(p, 0700);	/* in case it doesn't exist yet */
+	}
+	if ((p = getenv("WFDB_CACHE_SIZE")) && *p)
+	    ctx->nf_disk_size = strtol(p, NULL, 10);
+#endif
 
 	/* Initialize the curl "easy" handle. */
 	curl_global_init(CURL_GLOBAL_ALL);
@@ -1396,8 +1533,9 @@ static void curl_chunk_delete(struct chunk *c)
 static size_t curl_chunk_header_write(void *ptr, size_t size, size_t nmemb,
 				      void *stream)
 {
-    char *s = ptr;
+    char *s = ptr, *v = NULL;
     struct chunk *c = stream;
+    size_t n = size * nmemb;
 
     if (0 == strncasecmp(s, "Content-Range:", 14)) {
 	s += 14;
@@ -1407,6 +1545,29 @@ static size_t curl_chunk_header_write(void *ptr, size_t size, size_t nmemb,
 	    sscanf(s + 6, "%lu-%lu/%lu",
 		   &c->start_pos, &c->end_pos, &c->total_size);
     }
+    else if (n >= 5 && 0 == strncasecmp(s, "HTTP/", 5))
+	/* A new response (after a redirection, for example) begins. */
+	c->etag[0] = c->lastmod[0] = '\0';
+    else if (n > 5 && 0 == strncasecmp(s, "ETag:", 5)) {
+	v = c->etag;
+	s += 5;
+	n -= 5;
+    }
+    else if (n > 14 && 0 == strncasecmp(s, "Last-Modified:", 14)) {
+	v = c->lastmod;
+	s += 14;
+	n -= 14;
+    }
+    if (v) {	/* copy the value, without surrounding white space */
+	while (n > 0 && (*s == ' ' || *s == '\t'))
+	    s++, n--;
+	while (n > 0 && (s[n-1] == '\r' || s[n-1] == '\n' || s[n-1] == ' '))
+	    n--;
+	if (n >= NF_VALIDATOR_LEN)
+	    n = 0;	/* too long to be kept -- ignore it */
+	memcpy(v, s, n);
+	v[n] = '\0';
+    }
     return (size * nmemb);
 }
 
@@ -1435,12 +1596,17 @@ static size_t curl_chunk_write(void *ptr, size_t size, size_t nmemb,
     return (count);
 }
 
+/* www_get_url_range_chunk reads len bytes of url, beginning at byte startb.
+   If headers is not NULL, it is a list of additional request headers (such
+   as If-None-Match) to be sent. */
 static CHUNK *www_get_url_range_chunk(WFDB_Context *ctx, const char *url,
-				      long startb, long len)
+				      long startb, long len,
+				      struct curl_slist *headers)
 {
     CHUNK *chunk = NULL;
     char range_req_str[6*sizeof(long) + 2];
     const char *url2 = NULL;
+    int err;
 
     if (url && *url) {
 	snprintf(range_req_str, sizeof(range_req_str), "%ld-%ld", startb, startb+len-1);
@@ -1448,10 +1614,13 @@ static CHUNK *www_get_url_range_chunk(WFDB_Context *ctx, const char *url,
 	if (!chunk)
 	    return (NULL);
 
-	if (/* In this case we want to send a GET request rather than
-	       a HEAD */
+	err = (/* In this case we want to send a GET request rather than
+		  a HEAD */
 	    curl_try(ctx, curl_easy_setopt(ctx->curl_ua, CURLOPT_NOBODY, 0L))
 	    || curl_try(ctx, curl_easy_setopt(ctx->curl_ua, CURLOPT_HTTPGET, 1L))
+	    /* Additional request headers, if any */
+	    || curl_try(ctx, curl_easy_setopt(ctx->curl_ua, CURLOPT_HTTPHEADER,
+					 headers))
 	    /* URL to retrieve */
 	    || curl_try(ctx, curl_easy_setopt(ctx->curl_ua, CURLOPT_URL, url))
 	    /* Set username/password */
@@ -1471,11 +1640,15 @@ static CHUNK *www_get_url_range_chunk(WFDB_Context *ctx, const char *url,
 	    /* The pointer to pass to the header function */
 	    || curl_try(ctx, curl_easy_setopt(ctx->curl_ua, CURLOPT_HEADERDATA, chunk))
 	    /* Perform the request */
-	    || www_perform_request(ctx->curl_ua)) {
-
+	    || www_perform_request(ctx->curl_ua));
+	/* The caller frees the headers, so don't send them again. */
+	if (headers)
+	    curl_easy_setopt(ctx->curl_ua, CURLOPT_HTTPHEADER, NULL);
+	if (err) {
 	    chunk_delete(chunk);
 	    return (NULL);
 	}
+	curl_easy_getinfo(ctx->curl_ua, CURLINFO_RESPONSE_CODE, &chunk->code);
 	if (!chunk->data) {
 	    chunk_delete(chunk);
 	    chunk = NULL;
@@ -1530,7 +1703,14 @@ static CHUNK *www_get_url_chunk(WFDB_Context *ctx, const char *url)
 
 static void nf_delete(netfile *nf)
 {
+    struct nf_page *p;
+
     if (nf) {
+	while ((p = nf->mru) != NULL) {
+	    nf->mru = p->next;
+	    free(p);
+	}
+	SFREE(nf->hash);
 	SFREE(nf->url);
 	SFREE(nf->data);
 	SFREE(nf->redirect_url);
@@ -1539,7 +1719,8 @@ static void nf_delete(netfile *nf)
 }
 
 static CHUNK *nf_get_url_range_chunk(WFDB_Context *ctx, netfile *nf,
-				     long startb, long len)
+				     long startb, long len,
+				     struct curl_slist *headers)
 {
     char *url;
     CHUNK *chunk;
@@ -1555,7 +1736,7 @@ static CHUNK *nf_get_url_range_chunk(WFDB_Context *ctx, netfile *nf,
     }
     url = (nf->redirect_url ? nf->redirect_url : nf->url);
 
-    chunk = www_get_url_range_chunk(ctx, url, startb, len);
+    chunk = www_get_url_range_chunk(ctx, url, startb, len, headers);
 
     if (chunk && chunk->url) {
 	/* don't update redirect_time if we didn't hit nf->url */
@@ -1566,6 +1747,462 @@ static CHUNK *nf_get_url_range_chunk(WFDB_Context *ctx, netfile *nf,
     return (chunk);
 }
 
+/* nf_page_find returns the cached page of nf that begins at byte addr, or
+   NULL if there is none. */
+static struct nf_page *nf_page_find(netfile *nf, long addr)
+{
+    struct nf_page *p = NULL;
+
+    if (nf->hsize > 0)
+	for (p = nf->hash[(addr / nf->page_size) & (nf->hsize - 1)]; p;
+	     p = p->hnext)
+	    if (p->addr == addr)
+		break;
+    return (p);
+}
+
+/* nf_page_unlink removes page p from the LRU list of nf. */
+static void nf_page_unlink(netfile *nf, struct nf_page *p)
+{
+    if (p->prev) p->prev->next = p->next;
+    else nf->mru = p->next;
+    if (p->next) p->next->prev = p->prev;
+    else nf->lru = p->prev;
+    p->prev = p->next = NULL;
+}
+
+/* nf_page_touch makes page p the most recently used page of nf. */
+static void nf_page_touch(netfile *nf, struct nf_page *p)
+{
+    if (nf->mru == p)
+	return;
+    if (p->prev || p->next || nf->lru == p)
+	nf_page_unlink(nf, p);
+    p->next = nf->mru;
+    if (nf->mru) nf->mru->prev = p;
+    nf->mru = p;
+    if (nf->lru == NULL) nf->lru = p;
+}
+
+/* nf_page_add adds a page containing the len bytes at data, which are those
+   of nf beginning at byte addr, to the cache of nf as its most recently used
+   page, and returns the page, or NULL if there is insufficient memory. */
+static struct nf_page *nf_page_add(netfile *nf, long addr, const char *data,
+				   long len)
+{
+    struct nf_page *p, **hp;
+
+    if (nf->hsize == 0) {
+	unsigned long n = 16;
+
+	while (n < (unsigned long)(nf->budget / nf->page_size) + 1 &&
+	       n < 65536)
+	    n *= 2;
+	if ((nf->hash = calloc(n, sizeof(struct nf_page *))) == NULL)
+	    return (NULL);
+	nf->hsize = n;
+    }
+    if ((p = malloc(sizeof(struct nf_page) + len)) == NULL)
+	return (NULL);
+    p->addr = addr;
+    p->len = len;
+    p->data = (char *)(p + 1);
+    memcpy(p->data, data, len);
+    p->prev = p->next = NULL;
+    hp = &nf->hash[(addr / nf->page_size) & (nf->hsize - 1)];
+    p->hnext = *hp;
+    *hp = p;
+    nf_page_touch(nf, p);
+    nf->cached += len;
+    return (p);
+}
+
+/* nf_page_trim discards the least recently used pages of nf until their total
+   size is within its budget.  The most recently used page is never
+   discarded. */
+static void nf_page_trim(netfile *nf)
+{
+    struct nf_page *p, **hp;
+
+    while (nf->cached > nf->budget && (p = nf->lru) != nf->mru) {
+	for (hp = &nf->hash[(p->addr / nf->page_size) & (nf->hsize - 1)];
+	     *hp != p; hp = &(*hp)->hnext)
+	    ;
+	*hp = p->hnext;
+	nf_page_unlink(nf, p);
+	nf->cached -= p->len;
+	free(p);
+    }
+}
+
+#if WFDB_MMAP_SUPPORT
+/* If the environment variable WFDB_CACHE_DIR names a directory, the pages of
+   remote files are also kept there, so that other processes (and later runs
+   of the same program) that read the same files need not fetch them again.
+   Each page is kept in a file whose name is made from a hash of the URL, the
+   page's byte offset, and the page size.  The file begins with a header that
+   records the URL, the ETag and Last-Modified validators sent by the server,
+   and the length of the remote file;  a page is used only if these match
+   those of the open netfile.  When a remote file is opened, the cached copy
+   of its first page is revalidated by a conditional request (If-None-Match,
+   or If-Modified-Since if the server did not send an ETag), and the response
+   supplies the validators that the other pages must match.  Remote files for
+   which the server sends neither validator, and those whose URLs match an
+   entry of WFDBPASSWORD (which may be private), are not cached on disk.
+   The directory is created with mode 0700, and pages with mode 0600.
+
+   Cached pages are touched when they are used.  When more than a sixteenth
+   of the size limit (WFDB_CACHE_SIZE, or NF_DISK_CACHE_SIZE bytes by default)
+   has been written, and before the first page is written, the directory is
+   scanned, and if it holds more than the limit, the pages modified least
+   recently are removed until it holds no more than seven-eighths of it.
+   Pages are written to temporary files and renamed, so that several
+   processes can share the cache. */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+
+#define NF_DISK_MAGIC	"WFDB cache 1"
+
+struct nf_disk_entry {
+    char *name;
+    time_t mtime;
+    long size;
+};
+
+/* nf_disk_name returns the name of the file in the disk cache that holds the
+   page of url that begins at byte addr, in pages of page_size bytes.  The
+   caller must free it. */
+static char *nf_disk_name(WFDB_Context *ctx, const char *url, long addr,
+			  long page_size)
+{
+    unsigned long long h = 14695981039346656037ULL;	/* FNV-1a hash */
+    char *name = NULL;
+
+    for ( ; *url; url++)
+	h = (h ^ (unsigned char)*url) * 1099511628211ULL;
+    wfdb_asprintf(&name, "%s/%016llx-%ld-%ld", ctx->nf_disk_dir, h, addr,
+		  page_size);
+    return (name);
+}
+
+/* nf_disk_getline reads a line of fewer than n characters from fp into s,
+   without its newline, and returns 1, or returns 0 if there is none. */
+static int nf_disk_getline(FILE *fp, char *s, size_t n)
+{
+    size_t len;
+
+    if (fgets(s, (int)n, fp) == NULL || (len = strlen(s)) == 0 ||
+	s[len-1] != '\n')
+	return (0);
+    s[len-1] = '\0';
+    return (1);
+}
+
+/* nf_disk_read reads the cached page of url that begins at byte addr into
+   buf, which has room for page_size bytes, and the validators and length of
+   the remote file recorded with it into etag, lastmod, and *cont_len.  It
+   returns the length of the page, or -1 if it is not cached.  If buf is
+   NULL, only the validators and length are read. */
+static long nf_disk_read(WFDB_Context *ctx, const char *url, long addr,
+			 long page_size, char *etag, char *lastmod,
+			 long *cont_len, char *buf)
+{
+    char *name, *u, line[80];
+    long a, len, n = -1L;
+    size_t ulen = strlen(url) + 2;
+    FILE *fp;
+
+    if ((name = nf_disk_name(ctx, url, addr, page_size)) == NULL)
+	return (-1L);
+    if ((fp = fopen(name, "rb")) != NULL) {
+	if ((u = malloc(ulen)) != NULL &&
+	    nf_disk_getline(fp, line, sizeof(line)) &&
+	    strcmp(line, NF_DISK_MAGIC) == 0 &&
+	    nf_disk_getline(fp, u, ulen) && strcmp(u, url) == 0 &&
+	    nf_disk_getline(fp, etag, NF_VALIDATOR_LEN) &&
+	    nf_disk_getline(fp, lastmod, NF_VALIDATOR_LEN) &&
+	    nf_disk_getline(fp, line, sizeof(line)) &&
+	    sscanf(line, "%ld %ld %ld", cont_len, &a, &len) == 3 &&
+	    a == addr && len > 0 && len <= page_size &&
+	    (buf == NULL || fread(buf, 1, len, fp) == (size_t)len)) {
+	    n = len;
+	    if (buf)
+		utime(name, NULL);	/* mark the page as recently used */
+	}
+	SFREE(u);
+	fclose(fp);
+    }
+    SFREE(name);
+    return (n);
+}
+
+static int nf_disk_cmp(const void *a, const void *b)
+{
+    const struct nf_disk_entry *x = a, *y = b;
+
+    return ((x->mtime > y->mtime) - (x->mtime < y->mtime));
+}
+
+/* nf_disk_trim removes the least recently used pages from the disk cache if
+   it holds more than its size limit. */
+static void nf_disk_trim(WFDB_Context *ctx)
+{
+    DIR *dir;
+    struct dirent *d;
+    struct stat st;
+    struct nf_disk_entry *e = NULL, *t;
+    size_t i, n = 0, max = 0;
+    long long total = 0;
+    char *name;
+
+    if ((dir = opendir(ctx->nf_disk_dir)) == NULL)
+	return;
+    while ((d = readdir(dir)) != NULL) {
+	/* Only the files written by nf_disk_write are considered. */
+	if (strspn(d->d_name, "0123456789abcdef") != 16 || d->d_name[16] != '-')
+	    continue;
+	name = NULL;
+	if (wfdb_asprintf(&name, "%s/%s", ctx->nf_disk_dir, d->d_name) < 0 ||
+	    name == NULL)
+	    break;
+	if (stat(name, &st) || !S_ISREG(st.st_mode)) {
+	    SFREE(name);
+	    continue;
+	}
+	if (n == max) {
+	    max = max ? 2*max : 256;
+	    if ((t = realloc(e, max * sizeof(struct nf_disk_entry))) == NULL) {
+		SFREE(name);
+		break;
+	    }
+	    e = t;
+	}
+	e[n].name = name;
+	e[n].mtime = st.st_mtime;
+	e[n].size = (long)st.st_size;
+	total += e[n++].size;
+    }
+    closedir(dir);
+    if (total > ctx->nf_disk_size) {
+	qsort(e, n, sizeof(struct nf_disk_entry), nf_disk_cmp);
+	for (i = 0; i < n && total > ctx->nf_disk_size - ctx->nf_disk_size/8;
+	     i++)
+	    if (unlink(e[i].name) == 0)
+		total -= e[i].size;
+    }
+    for (i = 0; i < n; i++)
+	SFREE(e[i].name);
+    SFREE(e);
+}
+
+/* nf_disk_write adds len bytes of data, the page of url that begins at byte
+   addr, to the disk cache, together with the validators and length of the
+   remote file, unless the remote file has no validators. */
+static void nf_disk_write(WFDB_Context *ctx, const char *url, long addr,
+			  long page_size, const char *etag,
+			  const char *lastmod, long cont_len,
+			  const char *data, long len)
+{
+    char *name, *tmp = NULL;
+    FILE *fp = NULL;
+    int fd, ok;
+
+    if (*etag == '\0' && *lastmod == '\0')
+	return;
+    if (ctx->nf_disk_written == 0 ||
+	ctx->nf_disk_written > ctx->nf_disk_size / 16) {
+	nf_disk_trim(ctx);
+	ctx->nf_disk_written = 0;
+    }
+    if ((name = nf_disk_name(ctx, url, addr, page_size)) == NULL)
+	return;
+    wfdb_asprintf(&tmp, "%s.%ld.%lx.tmp", name, (long)getpid(),
+		  (unsigned long)(size_t)data);
+    if (tmp && (fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0600)) >= 0 &&
+	(fp = fdopen(fd, "wb")) == NULL) {
+	close(fd);
+	unlink(tmp);
+    }
+    if (fp) {
+	ok = (fprintf(fp, "%s\n%s\n%s\n%s\n%ld %ld %ld\n", NF_DISK_MAGIC, url,
+		      etag, lastmod, cont_len, addr, len) > 0 &&
+	      fwrite(data, 1, len, fp) == (size_t)len);
+	if (fclose(fp) == 0 && ok && rename(tmp, name) == 0)
+	    ctx->nf_disk_written += len;
+	else
+	    unlink(tmp);
+    }
+    SFREE(tmp);
+    SFREE(name);
+}
+
+/* nf_disk_valid returns 1 if the validators etag and lastmod match those of
+   netfile nf, which has at least one of them. */
+static int nf_disk_valid(netfile *nf, const char *etag, const char *lastmod)
+{
+    return ((*nf->etag || *nf->lastmod) && strcmp(etag, nf->etag) == 0 &&
+	    strcmp(lastmod, nf->lastmod) == 0);
+}
+
+/* nf_disk_has returns 1 if a valid copy of the page of nf that begins at
+   byte addr is in the disk cache. */
+static int nf_disk_has(WFDB_Context *ctx, netfile *nf, long addr)
+{
+    char etag[NF_VALIDATOR_LEN], lastmod[NF_VALIDATOR_LEN];
+    long cont_len;
+
+    return (nf->disk && (*nf->etag || *nf->lastmod) &&
+	    nf_disk_read(ctx, nf->url, addr, nf->page_size, etag, lastmod,
+			 &cont_len, NULL) > 0 &&
+	    cont_len == nf->cont_len && nf_disk_valid(nf, etag, lastmod));
+}
+
+/* nf_disk_page adds the page of nf that begins at byte addr to its cache in
+   memory, if a valid copy of it is found in the disk cache, and returns it;
+   otherwise, it returns NULL. */
+static struct nf_page *nf_disk_page(WFDB_Context *ctx, netfile *nf, long addr)
+{
+    char etag[NF_VALIDATOR_LEN], lastmod[NF_VALIDATOR_LEN], *buf;
+    long len, cont_len, plen = nf->cont_len - addr;
+    struct nf_page *p = NULL;
+
+    if (!nf->disk || (*nf->etag == '\0' && *nf->lastmod == '\0') ||
+	(buf = malloc(nf->page_size)) == NULL)
+	return (NULL);
+    if (plen > nf->page_size) plen = nf->page_size;
+    len = nf_disk_read(ctx, nf->url, addr, nf->page_size, etag, lastmod,
+		       &cont_len, buf);
+    if (len == plen && cont_len == nf->cont_len &&
+	nf_disk_valid(nf, etag, lastmod))
+	p = nf_page_add(nf, addr, buf, len);
+    SFREE(buf);
+    return (p);
+}
+
+/* nf_disk_first reads the first page_size bytes of nf, using the copy in the
+   disk cache if the server confirms (with a 304 response to a conditional
+   request) that it is still valid, and adding them to the disk cache
+   otherwise.  The result is returned in the same form as that of
+   nf_get_url_range_chunk. */
+static CHUNK *nf_disk_first(WFDB_Context *ctx, netfile *nf, long page_size)
+{
+    char etag[NF_VALIDATOR_LEN], lastmod[NF_VALIDATOR_LEN], *h = NULL, *buf;
+    long len = -1L, cont_len = 0L;
+    struct curl_slist *headers = NULL;
+    CHUNK *chunk;
+
+    if ((buf = malloc(page_size)) != NULL &&
+	(len = nf_disk_read(ctx, nf->url, 0L, page_size, etag, lastmod,
+			    &cont_len, buf)) > 0) {
+	if (*etag)
+	    wfdb_asprintf(&h, "If-None-Match: %s", etag);
+	else if (*lastmod)
+	    wfdb_asprintf(&h, "If-Modified-Since: %s", lastmod);
+	if (h)
+	    headers = curl_slist_append(NULL, h);
+    }
+    chunk = nf_get_url_range_chunk(ctx, nf, 0L, page_size, headers);
+    if (chunk && chunk->code == 304 && headers && chunk->data) {
+	/* The cached copy is still valid. */
+	memcpy(chunk->data, buf, len);
+	chunk->size = len;
+	chunk->start_pos = 0;
+	chunk->end_pos = len - 1;
+	chunk->total_size = cont_len;
+	strcpy(chunk->etag, etag);
+	strcpy(chunk->lastmod, lastmod);
+    }
+    else if (chunk && chunk->code == 206 && chunk->size > 0 &&
+	     chunk->start_pos == 0 && chunk->end_pos == chunk->size - 1 &&
+	     chunk->total_size >= chunk->size)
+	nf_disk_write(ctx, nf->url, 0L, page_size, chunk->etag,
+		      chunk->lastmod, chunk->total_size, chunk->data,
+		      chunk->size);
+    curl_slist_free_all(headers);
+    SFREE(h);
+    SFREE(buf);
+    return (chunk);
+}
+
+#else
+#define nf_disk_write(ctx, url, addr, page_size, etag, lastmod, cont_len, \
+		      data, len)
+#define nf_disk_valid(nf, etag, lastmod)	(0)
+#define nf_disk_has(ctx, nf, addr)		(0)
+#define nf_disk_page(ctx, nf, addr)		(NULL)
+#define nf_disk_first(ctx, nf, page_size)	(NULL)
+#endif
+
+/* nf_page_fetch reads the page of nf that begins at byte addr (which is not
+   cached), and as many of the following pages as the read-ahead policy allows
+   (see struct nf_page above), in a single range request.  The pages that are
+   needed to read up to byte end are read in the same request, unless they are
+   cached already, or unless there are more of them than fit in the budget.
+   The page beginning at addr is returned as the most recently used page, or
+   NULL if the pages could not be read. */
+static struct nf_page *nf_page_fetch(WFDB_Context *ctx, netfile *nf,
+				     long addr, long end)
+{
+    CHUNK *chunk;
+    struct nf_page *p = NULL;
+    long a, len, ps = nf->page_size, maxlen = nf->budget / ps * ps;
+
+    if ((p = nf_disk_page(ctx, nf, addr)) != NULL) {	/* on disk */
+	nf->ra_next = addr + p->len;
+	nf_page_trim(nf);
+	return (p);
+    }
+    if (addr != nf->ra_next)
+	nf->ra_len = ps;
+    else if ((nf->ra_len *= 2) > maxlen / 4)
+	nf->ra_len = maxlen / 4 / ps * ps;
+    len = (end - addr + ps - 1) / ps * ps;
+    if (len < nf->ra_len) len = nf->ra_len;
+    if (len > maxlen) len = maxlen;
+    if (len > nf->cont_len - addr) len = nf->cont_len - addr;
+    for (a = addr + ps; a < addr + len; a += ps)
+	if (nf_page_find(nf, a) || nf_disk_has(ctx, nf, a)) {
+	    len = a - addr;
+	    break;
+	}
+
+    if ((chunk = nf_get_url_range_chunk(ctx, nf, addr, len, NULL)) == NULL) {
+	wfdb_error_ctx(ctx, "nf_get_range: couldn't read %ld bytes of %s "
+		       "starting at %ld\n", len, nf->url, addr);
+	return (NULL);
+    }
+    if (chunk_size(chunk) != len) {
+	wfdb_error_ctx(ctx, "nf_get_range: requested %ld bytes, received "
+		       "%ld bytes\n", len, (long)chunk_size(chunk));
+	chunk_delete(chunk);
+	return (NULL);
+    }
+    /* Add the pages last to first, so that the one that is needed now is
+       the most recently used, and the others are discarded before it. */
+    for (a = addr + (len - 1) / ps * ps; a >= addr; a -= ps) {
+	long plen = (a + ps <= addr + len) ? ps : addr + len - a;
+
+	if ((p = nf_page_add(nf, a, chunk_data(chunk) + (a - addr), plen))
+	    == NULL) {
+	    wfdb_error_ctx(ctx, "nf_get_range: insufficient memory\n");
+	    break;
+	}
+	/* Keep the page on disk too, unless the file has changed since it
+	   was opened. */
+	if (nf->disk && nf_disk_valid(nf, chunk->etag, chunk->lastmod))
+	    nf_disk_write(ctx, nf->url, a, ps, nf->etag, nf->lastmod,
+			  nf->cont_len, p->data, plen);
+    }
+    chunk_delete(chunk);
+    nf->ra_next = addr + len;
+    nf->ra_len = len;
+    nf_page_trim(nf);
+    return (p);
+}
+
 /* nf_new attempts to read (at least part of) the file named by its
    argument (normally an http:// or ftp:// url).  If page_size is nonzero and
    the file can be read in segments (this will be true for files served by http
@@ -1588,15 +2225,19 @@ static netfile *nf_new(WFDB_Context *ctx, const char* url)
     SUALLOC(nf, 1, sizeof(netfile));
     if (nf && url && *url) {
 	SSTRCPY(nf->url, url);
-	nf->base_addr = 0;
 	nf->pos = 0;
 	nf->data = NULL;
 	nf->err = NF_NO_ERR;
 	nf->redirect_url = NULL;
+	nf->disk = (ctx->nf_disk_dir && !www_userpwd(ctx, url));
 
-	if (page_size > 0L)
+	if (page_size > 0L && nf->disk)
+	    /* Read the first part of the file, or check that the copy of it
+	       in the disk cache is still valid. */
+	    chunk = nf_disk_first(ctx, nf, page_size);
+	else if (page_size > 0L)
 	    /* Try to read the first part of the file. */
-	    chunk = nf_get_url_range_chunk(ctx, nf, 0L, page_size);
+	    chunk = nf_get_url_range_chunk(ctx, nf, 0L, page_size, NULL);
 	else
 	    /* Try to read the entire file. */
 	    chunk = www_get_url_chunk(ctx, nf->url);
@@ -1630,20 +2271,33 @@ static netfile *nf_new(WFDB_Context *ctx, const char* url)
 		nf->mode = NF_FULL_MODE;
 	}
 	else {
-	    wfdb_error("nf_new: unexpected range response (%lu-%lu/%lu)\n",
-		       chunk->start_pos, chunk->end_pos, chunk->total_size);
+	    wfdb_error_ctx(ctx,
+			   "nf_new: unexpected range response (%lu-%lu/%lu)\n",
+			   chunk->start_pos, chunk->end_pos,
+			   chunk->total_size);
 	    chunk_delete(chunk);
 	    nf_delete(nf);
 	    return (NULL);
 	}
-	if (chunk->size > 0L) {
+	if (chunk->size > 0L && nf->mode == NF_CHUNK_MODE) {
+	    /* Keep the first page in the cache. */
+	    nf->page_size = page_size;
+	    strcpy(nf->etag, chunk->etag);
+	    strcpy(nf->lastmod, chunk->lastmod);
+	    nf->budget = ctx->nf_cache_size;
+	    if (nf->budget < page_size) nf->budget = page_size;
+	    nf_page_add(nf, 0L, chunk->data, chunk->size);
+	    nf->ra_next = nf->ra_len = chunk->size;
+	}
+	else if (chunk->size > 0L) {
 	    nf->data = chunk->data;
 	    chunk->data = NULL;
 	}
-	if (nf->data == NULL) {
+	if (nf->data == NULL && nf->mru == NULL) {
 	    if (chunk->size > 0L)
-		wfdb_error("nf_new: insufficient memory (needed %ld bytes)\n",
-			   chunk->size);
+		wfdb_error_ctx(ctx,
+			       "nf_new: insufficient memory (needed %ld "
+			       "bytes)\n", chunk->size);
 	    /* If no bytes were received, the remote file probably doesn't
 	       exist.  This happens routinely while searching the WFDB path, so
 	       it's not flagged as an error.  Note, however, that we can't tell
@@ -1662,10 +2316,8 @@ static netfile *nf_new(WFDB_Context *ctx, const char* url)
 static long nf_get_range(WFDB_Context *ctx, netfile* nf, long startb,
 			long len, char *rbuf)
 {
-    CHUNK *chunk = NULL;
-    char *rp = NULL;
-    long avail = nf->cont_len - startb;
-    long page_size = ctx->nf_page_size;
+    struct nf_page *p;
+    long avail = nf->cont_len - startb, done = 0L, addr, n;
 
     if (len > avail) len = avail;	/* limit request to available bytes */
     if (nf == NULL || nf->url == NULL || *nf->url == '\0' ||
@@ -1673,60 +2325,25 @@ static long nf_get_range(WFDB_Context *ctx, netfile* nf, long startb,
 	return (0L);	/* invalid inputs -- fail silently */
 
     if (nf->mode == NF_CHUNK_MODE) {	/* range requests acceptable */
-	long rlen = (avail >= page_size) ? page_size : avail;
-
-	if (len <= page_size) {	/* short request -- check if cached */
-	    if ((startb < nf->base_addr) ||
-		((startb + len) > (nf->base_addr + page_size))) {
-		/* requested data not in cache -- update the cache */
-		if (chunk = nf_get_url_range_chunk(ctx, nf, startb, rlen)) {
-		    if (chunk_size(chunk) != rlen) {
-			wfdb_error(
-		     "nf_get_range: requested %ld bytes, received %ld bytes\n",
-		                   rlen, (long)chunk_size(chunk));
-			len = 0L;
-		    }
-		    else {
-			nf->base_addr = startb;
-			memcpy(nf->data, chunk_data(chunk), rlen);
-		    }
-		}
-		else {	/* attempt to update cache failed */
-		    wfdb_error(
-	     "nf_get_range: couldn't read %ld bytes of %s starting at %ld\n", 
-	                       len, nf->url, startb);
-		    len = 0L;
-		}
-	    } 
-      
-	    /* move cached data to the return buffer */
-	    rp = nf->data + startb - nf->base_addr;
-	}
-
-	else if (chunk = nf_get_url_range_chunk(ctx, nf, startb, len)) {
-	    /* long request (> page_size) */
-	    if (chunk_size(chunk) != len) {
-		wfdb_error(
-		     "nf_get_range: requested %ld bytes, received %ld bytes\n",
-		           len, (long)chunk_size(chunk));
-		len = 0L;
-	    }
-	    rp = chunk_data(chunk);
-	}
-	else {
-	    wfdb_error(
-	       "nf_get_range: couldn't read %ld bytes of %s starting at %ld\n",
-		       len, nf->url, startb);
-	    len = 0L;
+	/* Copy the requested data from the cached pages, reading those that
+	   are not cached. */
+	while (done < len) {
+	    addr = startb + done;
+	    if (p = nf_page_find(nf, addr - addr % nf->page_size))
+		nf_page_touch(nf, p);
+	    else if ((p = nf_page_fetch(ctx, nf, addr - addr % nf->page_size,
+					startb + len)) == NULL)
+		break;
+	    n = p->addr + p->len - addr;
+	    if (n > len - done) n = len - done;
+	    memcpy(rbuf + done, p->data + (addr - p->addr), n);
+	    done += n;
 	}
+	return (done);
     }
 
     else  /* cannot use range requests -- cache contains full file */
-	rp = nf->data + startb;		
-
-    if (rp != NULL && len > 0)
-	memcpy(rbuf, rp, len);
-    if (chunk) chunk_delete(chunk);
+	memcpy(rbuf, nf->data + startb, len);
     return (len);
 }
 
@@ -1880,10 +2497,61 @@ static int nf_putc(int c, netfile *nf)
    now just before wfdb_fprintf, which refers to it.  There is no completely
    portable way to make a forward reference to a static (local) function. */
 
+/* Memory-mapped files (type WFDB_MMAP) are read-only, and are read by
+   copying from the mapping.  Library functions that can use the mapped
+   data in place (such as isigopen) do so directly via the 'map' and
+   'maplen' fields. */
+
+static size_t mm_fread(void *ptr, size_t size, size_t nmemb, WFDB_FILE *wp)
+{
+    long avail = wp->maplen - wp->mappos;
+
+    if (size == 0 || nmemb == 0) return (0);
+    if (avail < 0) avail = 0;
+    if (nmemb > (size_t)avail / size) {
+	nmemb = (size_t)avail / size;
+	wp->mapeof = 1;
+    }
+    memcpy(ptr, wp->map + wp->mappos, nmemb * size);
+    wp->mappos += nmemb * size;
+    return (nmemb);
+}
+
+static char *mm_fgets(char *s, int size, WFDB_FILE *wp)
+{
+    char *p = s;
+
+    if (wp->mappos >= wp->maplen) {
+	wp->mapeof = 1;
+	return (NULL);
+    }
+    while (--size > 0 && wp->mappos < wp->maplen)
+	if ((*p++ = wp->map[wp->mappos++]) == '\n')
+	    break;
+    *p = '\0';
+    return (s);
+}
+
+static int mm_fseek(WFDB_FILE *wp, long offset, int whence)
+{
+    switch (whence) {
+      case SEEK_SET: break;
+      case SEEK_CUR: offset += wp->mappos; break;
+      case SEEK_END: offset += wp->maplen; break;
+      default: return (-1);
+    }
+    if (offset < 0) return (-1);
+    wp->mappos = offset;
+    wp->mapeof = 0;
+    return (0);
+}
+
 void wfdb_clearerr(WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
 	nf_clearerr(wp->netfp);
+    else if (wp->type == WFDB_MMAP)
+	wp->mapeof = 0;
     else
 	clearerr(wp->fp);
 }
@@ -1892,6 +2560,8 @@ int wfdb_feof(WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
 	return (nf_feof(wp->netfp));
+    if (wp->type == WFDB_MMAP)
+	return (wp->mapeof);
     return (feof(wp->fp));
 }
 
@@ -1899,6 +2569,8 @@ int wfdb_ferror(WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
 	return (nf_ferror(wp->netfp));
+    if (wp->type == WFDB_MMAP)
+	return (0);
     return (ferror(wp->fp));
 }
 
@@ -1910,6 +2582,8 @@ int wfdb_fflush(WFDB_FILE *wp)
     }
     else if (wp->type == WFDB_NET)
 	return (nf_fflush(wp->netfp));
+    else if (wp->type == WFDB_MMAP)
+	return (0);
     else
 	return (fflush(wp->fp));
 }
@@ -1917,14 +2591,18 @@ int wfdb_fflush(WFDB_FILE *wp)
 char* wfdb_fgets(char *s, int size, WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
-	return (nf_fgets(wfdb_get_default_context(), s, size, wp->netfp));
+	return (nf_fgets(wp->ctx, s, size, wp->netfp));
+    if (wp->type == WFDB_MMAP)
+	return (mm_fgets(s, size, wp));
     return (fgets(s, size, wp->fp));
 }
 
 size_t wfdb_fread(void *ptr, size_t size, size_t nmemb, WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
-	return (nf_fread(wfdb_get_default_context(), ptr, size, nmemb, wp->netfp));
+	return (nf_fread(wp->ctx, ptr, size, nmemb, wp->netfp));
+    if (wp->type == WFDB_MMAP)
+	return (mm_fread(ptr, size, nmemb, wp));
     return (fread(ptr, size, nmemb, wp->fp));
 }
 
@@ -1932,6 +2610,8 @@ int wfdb_fseek(WFDB_FILE *wp, long int offset, int whence)
 {
     if (wp->type == WFDB_NET)
 	return (nf_fseek(wp->netfp, offset, whence));
+    if (wp->type == WFDB_MMAP)
+	return (mm_fseek(wp, offset, whence));
     return(fseek(wp->fp, offset, whence));
 }
 
@@ -1939,6 +2619,8 @@ long wfdb_ftell(WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
 	return (nf_ftell(wp->netfp));
+    if (wp->type == WFDB_MMAP)
+	return (wp->mappos);
     return (ftell(wp->fp));
 }
 
@@ -1946,13 +2628,21 @@ size_t wfdb_fwrite(const void *ptr, size_t size, size_t nmemb, WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
 	return (nf_fwrite(ptr, size, nmemb, wp->netfp));
+    if (wp->type == WFDB_MMAP)
+	return (0);
     return (fwrite(ptr, size, nmemb, wp->fp));
 }
 
 int wfdb_getc(WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
-	return (nf_fgetc(wfdb_get_default_context(), wp->netfp));
+	return (nf_fgetc(wp->ctx, wp->netfp));
+    if (wp->type == WFDB_MMAP) {
+	if (wp->mappos < wp->maplen)
+	    return (wp->map[wp->mappos++] & 0xff);
+	wp->mapeof = 1;
+	return (EOF);
+    }
     return (getc(wp->fp));
 }
 
@@ -1960,6 +2650,8 @@ int wfdb_putc(int c, WFDB_FILE *wp)
 {
     if (wp->type == WFDB_NET)
 	return (nf_putc(c, wp->netfp));
+    if (wp->type == WFDB_MMAP)
+	return (EOF);
     return (putc(c, wp->fp));
 }
 
@@ -1967,9 +2659,16 @@ int wfdb_fclose(WFDB_FILE *wp)
 {
     int status;
 
+#if WFDB_MMAP_SUPPORT
+    if (wp->type == WFDB_MMAP) {
+	status = munmap(wp->map, (size_t)wp->maplen) ? EOF : 0;
+	SFREE(wp);
+	return (status);
+    }
+#endif
 #if WFDB_NETFILES
     status = (wp->type == WFDB_NET) ?
-	nf_fclose(wfdb_get_default_context(), wp->netfp) : fclose(wp->fp);
+	nf_fclose(wp->ctx, wp->netfp) : fclose(wp->fp);
 #else
     status = fclose(wp->fp);
 #endif
@@ -1978,7 +2677,7 @@ int wfdb_fclose(WFDB_FILE *wp)
     return (status);
 }
 
-WFDB_FILE *wfdb_fopen(char *fname, const char *mode)
+WFDB_FILE *wfdb_fopen_ctx(WFDB_Context *ctx, char *fname, const char *mode)
 {
     char *p = fname;
     WFDB_FILE *wp;
@@ -1986,9 +2685,10 @@ WFDB_FILE *wfdb_fopen(char *fname, const char *mode)
     if (p == NULL || strstr(p, ".."))
 	return (NULL);
     SUALLOC(wp, 1, sizeof(WFDB_FILE));
+    wp->ctx = ctx;
     if (strstr(p, "://")) {
 #if WFDB_NETFILES
-	if (wp->netfp = nf_fopen(wfdb_get_default_context(), fname, mode)) {
+	if (wp->netfp = nf_fopen(ctx, fname, mode)) {
 	    wp->type = WFDB_NET;
 	    return (wp);
 	}
@@ -2024,3 +2724,57 @@ WFDB_FILE *wfdb_fopen(char *fname, const char *mode)
     SFREE(wp);
     return (NULL);
 }
+
+WFDB_FILE *wfdb_fopen(char *fname, const char *mode)
+{
+    return wfdb_fopen_ctx(wfdb_get_default_context(), fname, mode);
+}
+
+/* wfdb_fmap converts a local file opened for reading into a memory-mapped
+   file (type WFDB_MMAP), preserving the current file position.  It returns
+   0 if successful, or -1 if the file cannot be mapped (because it is not a
+   regular file, it is empty, or mmap is not supported or fails), in which
+   case the WFDB_FILE is unchanged. */
+int wfdb_fmap(WFDB_FILE *wp)
+{
+#if WFDB_MMAP_SUPPORT
+    struct stat st;
+    void *map;
+    long pos;
+    int fd;
+
+    if (wp == NULL || wp->type != WFDB_LOCAL || wp->fp == stdin ||
+	(pos = ftell(wp->fp)) < 0)
+	return (-1);
+    fd = fileno(wp->fp);
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+	st.st_size > LONG_MAX)
+	return (-1);
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+	return (-1);
+    (void)fclose(wp->fp);
+    wp->fp = NULL;
+    wp->map = map;
+    wp->maplen = (long)st.st_size;
+    wp->mappos = pos;
+    wp->mapeof = 0;
+    wp->type = WFDB_MMAP;
+    return (0);
+#else
+    return (-1);
+#endif
+}
+
+/* wfdb_fsetctx transfers an open WFDB_FILE to another context, which then
+   becomes responsible for closing it. */
+void wfdb_fsetctx(WFDB_FILE *wp, WFDB_Context *ctx)
+{
+#if WFDB_NETFILES
+    if (wp->type == WFDB_NET) {
+	wp->ctx->nf_open_files--;
+	ctx->nf_open_files++;
+    }
+#endif
+    wp->ctx = ctx;
+}
@@ -78,11 +78,27 @@ struct WFDB_FILE {
   FILE *fp;
   struct netfile *netfp;
   int type;
+  WFDB_Context *ctx;	/* context that opened the file */
+  char *map;		/* contents of a memory-mapped file */
+  long maplen;		/* length of the mapping in bytes */
+  long mappos;		/* current read position in the mapping */
+  int mapeof;		/* 1 if a read has passed the end of the mapping */
 };
 
 /* Values for WFDB_FILE 'type' field */
 #define WFDB_LOCAL	0	/* a local file, read via C standard I/O */
 #define WFDB_NET	1	/* a remote file, read via libcurl */
+#define WFDB_MMAP	2	/* a local file, read via mmap (read-only) */
+
+/* Memory-mapped input (see wfdb_fmap) is available on POSIX systems only.
+   Define WFDB_MMAP_SUPPORT=0 to disable it. */
+#ifndef WFDB_MMAP_SUPPORT
+# if defined(__unix__) || defined(__APPLE__)
+#  define WFDB_MMAP_SUPPORT 1
+# else
+#  define WFDB_MMAP_SUPPORT 0
+# endif
+#endif
 
 /* Composite data types */
 typedef struct netfile netfile;
@@ -96,6 +112,8 @@ typedef struct WFDB_FILE WFDB_FILE;
 #include <errno.h>
 
 #define NF_PAGE_SIZE	32768 	/* default bytes per http range request */
+#define NF_CACHE_SIZE	2097152	/* default bytes of pages cached per netfile */
+#define NF_DISK_CACHE_SIZE 1073741824L /* default limit of WFDB_CACHE_DIR */
 
 /* values for netfile 'err' field */
 #define NF_NO_ERR	0	/* no errors */
@@ -118,7 +136,11 @@ extern "C" {
 /* These functions are defined in wfdbio.c */
 extern int wfdb_fclose(WFDB_FILE *fp);
 extern WFDB_FILE *wfdb_open(const char *file_type, const char *record, int mode);
+extern WFDB_FILE *wfdb_open_ctx(WFDB_Context *ctx, const char *file_type,
+				const char *record, int mode);
 extern int wfdb_checkname(const char *name, const char *description);
+extern int wfdb_checkname_ctx(WFDB_Context *ctx, const char *name,
+			      const char *description);
 extern void wfdb_striphea(char *record);
 extern int wfdb_g16(WFDB_FILE *fp);
 extern long wfdb_g32(WFDB_FILE *fp);
@@ -126,18 +148,27 @@ extern void wfdb_p16(unsigned int x, WFDB_FILE *fp);
 extern void wfdb_p32(long x, WFDB_FILE *fp);
 extern size_t wfdb_getline(char **buffer, size_t *buffer_size, WFDB_FILE *fp);
 extern int wfdb_parse_path(const char *wfdb_path);
+extern int wfdb_parse_path_ctx(WFDB_Context *ctx, const char *wfdb_path);
 extern void wfdb_addtopath(const char *pathname);
+extern void wfdb_addtopath_ctx(WFDB_Context *ctx, const char *pathname);
+extern void wfdb_copy_path_ctx(WFDB_Context *to, WFDB_Context *from);
 #if __GNUC__ >= 3
 __attribute__((__format__(__printf__, 2, 3)))
 #endif
 extern int wfdb_asprintf(char **buffer, const char *format, ...);
 extern WFDB_FILE *wfdb_fopen(char *fname, const char *mode);
+extern WFDB_FILE *wfdb_fopen_ctx(WFDB_Context *ctx, char *fname,
+				 const char *mode);
+extern int wfdb_fmap(WFDB_FILE *fp);
+extern void wfdb_fsetctx(WFDB_FILE *fp, WFDB_Context *ctx);
 #if __GNUC__ >= 3
 __attribute__((__format__(__printf__, 2, 3)))
 #endif
 extern int wfdb_fprintf(WFDB_FILE *fp, const char *format, ...);
 extern void wfdb_setirec(const char *record_name);
+extern void wfdb_setirec_ctx(WFDB_Context *ctx, const char *record_name);
 extern char *wfdb_getirec(void);
+extern char *wfdb_getirec_ctx(WFDB_Context *ctx);
 
 extern void wfdb_clearerr(WFDB_FILE *fp);
 extern int wfdb_feof(WFDB_FILE *fp);
@@ -154,14 +185,20 @@ extern int wfdb_putc(int c, WFDB_FILE *fp);
 
 /* These functions are defined in signal.c */
 extern void wfdb_sampquit(void);
+extern void wfdb_sampquit_ctx(WFDB_Context *ctx);
 extern void wfdb_sigclose(void);
+extern void wfdb_sigclose_ctx(WFDB_Context *ctx);
 extern void wfdb_osflush(void);
+extern void wfdb_osflush_ctx(WFDB_Context *ctx);
 extern void wfdb_freeinfo(void);
 extern int wfdb_oinfoclose(void);
+extern int wfdb_oinfoclose_ctx(WFDB_Context *ctx);
 
 /* These functions are defined in annot.c */
 extern void wfdb_anclose(void);
+extern void wfdb_anclose_ctx(WFDB_Context *ctx);
 extern void wfdb_oaflush(void);
+extern void wfdb_oaflush_ctx(WFDB_Context *ctx);
 
 #ifdef __cplusplus
 }